@@ -17,22 +17,37 @@
 #			--asm "${CMAKE_SOURCE_DIR}/tests/cli/<name>/program.S"
 #			<other CLI commands>
 #		EXPECTED_OUTPUT "tests/cli/<name>/stdout.txt"
+#		[OUTPUT "Testing/<file written by the CLI>"]
+#		[FIXTURE <fixture>]
 #   )
+#
+# OUTPUT is compared instead of the stdout, paths are relative to the build directory. Without EXPECTED_OUTPUT only
+# the return value is checked. FIXTURE marks the test as a setup of the fixture required by tool tests (see
+# add_tool_test), e.g. when it writes files processed by them.
 
 function(add_cli_test)
 	cmake_parse_arguments(
 			CLI_TEST
 			""
-			"NAME;EXPECTED_OUTPUT"
+			"NAME;EXPECTED_OUTPUT;OUTPUT;FIXTURE"
 			"ARGS"
 			${ARGN}
 	)
+	set(CLI_TEST_STDOUT "Testing/cli_${CLI_TEST_NAME}.out")
+	if(NOT CLI_TEST_OUTPUT)
+		set(CLI_TEST_OUTPUT "${CLI_TEST_STDOUT}")
+	endif()
+	set(CLI_TEST_COMPARE)
+	if(CLI_TEST_EXPECTED_OUTPUT)
+		set(CLI_TEST_COMPARE
+				COMMAND ${CMAKE_COMMAND} -E compare_files "${CLI_TEST_OUTPUT}"
+				"${CMAKE_SOURCE_DIR}/${CLI_TEST_EXPECTED_OUTPUT}")
+	endif()
 	add_custom_target(
 			cli_test_${CLI_TEST_NAME}
 			COMMAND ${CMAKE_COMMAND} -E make_directory "Testing"
-			COMMAND cli ${CLI_TEST_ARGS} > "Testing/stall_test.out"
-			COMMAND ${CMAKE_COMMAND} -E compare_files "Testing/stall_test.out"
-			"${CMAKE_SOURCE_DIR}/${CLI_TEST_EXPECTED_OUTPUT}"
+			COMMAND cli ${CLI_TEST_ARGS} > "${CLI_TEST_STDOUT}"
+			${CLI_TEST_COMPARE}
 			WORKING_DIRECTORY "${CMAKE_BINARY_DIR}"
 			DEPENDS cli
 	)
@@ -41,4 +56,57 @@ function(add_cli_test)
 			NAME "cli_${CLI_TEST_NAME}"
 			COMMAND ${CMAKE_COMMAND} --build . --target "cli_test_${CLI_TEST_NAME}"
 			WORKING_DIRECTORY "${CMAKE_BINARY_DIR}")
+	if(CLI_TEST_FIXTURE)
+		set_tests_properties("cli_${CLI_TEST_NAME}" PROPERTIES FIXTURES_SETUP "${CLI_TEST_FIXTURE}")
+	endif()
+endfunction()
+
+# Creates a test of a tool processing files written by CLI tests. The test passes when the output of the tool matches
+# the regular expression, the return value is not checked then, so expected failures (e.g. found differences) can be
+# tested as well. With EXPECTED_OUTPUT the tool has to succeed and its stdout is compared with the file like in
+# add_cli_test. Without either the tool just has to succeed.
+#
+# Usage:
+#   add_tool_test(
+#		NAME <name>
+#		COMMAND <tool target> <arguments>
+#		REQUIRES <fixtures set up by the CLI tests>
+#		[PASS_REGULAR_EXPRESSION <regular expression>]
+#		[EXPECTED_OUTPUT "tests/cli/<name>/<file>"]
+#   )
+
+function(add_tool_test)
+	cmake_parse_arguments(
+			TOOL_TEST
+			""
+			"NAME;PASS_REGULAR_EXPRESSION;EXPECTED_OUTPUT"
+			"COMMAND;REQUIRES"
+			${ARGN}
+	)
+	if(TOOL_TEST_EXPECTED_OUTPUT)
+		list(GET TOOL_TEST_COMMAND 0 TOOL_TEST_TARGET)
+		add_custom_target(
+				tool_test_${TOOL_TEST_NAME}
+				COMMAND ${CMAKE_COMMAND} -E make_directory "Testing"
+				COMMAND ${TOOL_TEST_COMMAND} > "Testing/tool_${TOOL_TEST_NAME}.out"
+				COMMAND ${CMAKE_COMMAND} -E compare_files "Testing/tool_${TOOL_TEST_NAME}.out"
+				"${CMAKE_SOURCE_DIR}/${TOOL_TEST_EXPECTED_OUTPUT}"
+				WORKING_DIRECTORY "${CMAKE_BINARY_DIR}"
+				DEPENDS ${TOOL_TEST_TARGET}
+		)
+		add_test(
+				NAME "tool_${TOOL_TEST_NAME}"
+				COMMAND ${CMAKE_COMMAND} --build . --target "tool_test_${TOOL_TEST_NAME}"
+				WORKING_DIRECTORY "${CMAKE_BINARY_DIR}")
+	else()
+		add_test(
+				NAME "tool_${TOOL_TEST_NAME}"
+				COMMAND ${TOOL_TEST_COMMAND}
+				WORKING_DIRECTORY "${CMAKE_BINARY_DIR}")
+	endif()
+	set_tests_properties("tool_${TOOL_TEST_NAME}" PROPERTIES FIXTURES_REQUIRED "${TOOL_TEST_REQUIRES}")
+	if(TOOL_TEST_PASS_REGULAR_EXPRESSION)
+		set_tests_properties("tool_${TOOL_TEST_NAME}" PROPERTIES
+				PASS_REGULAR_EXPRESSION "${TOOL_TEST_PASS_REGULAR_EXPRESSION}")
+	endif()
 endfunction()
@@ -0,0 +1,58 @@
+/*
+ * Region of interest markers for programs running in QtRvSim.
+ *
+ * The functions write to the ROI control peripheral. The simulator
+ * evaluates each command after the store completes, so statistics of
+ * a region exclude the store opening it and include the one closing it.
+ * Statistics are printed by the command line simulator with
+ * `--dump-roi-stats`.
+ *
+ *     qtrvsim_roi_begin(1);
+ *     kernel();
+ *     qtrvsim_roi_end(1);
+ *     qtrvsim_exit(check() ? 0 : 1);
+ */
+
+#ifndef QTRVSIM_ROI_H
+#define QTRVSIM_ROI_H
+
+#include <stdint.h>
+
+#define QTRVSIM_ROI_BASE          0xffffc200
+
+#define QTRVSIM_ROI_BEGIN_o       0x000
+#define QTRVSIM_ROI_END_o         0x004
+#define QTRVSIM_ROI_STATS_RESET_o 0x008
+#define QTRVSIM_ROI_STATS_DUMP_o  0x00c
+#define QTRVSIM_ROI_EXIT_o        0x010
+
+static inline void qtrvsim_roi_write(uint32_t offset, uint32_t value) {
+    *(volatile uint32_t *)(QTRVSIM_ROI_BASE + offset) = value;
+}
+
+/* Start region of interest, regions with different ids may overlap. */
+static inline void qtrvsim_roi_begin(uint32_t id) {
+    qtrvsim_roi_write(QTRVSIM_ROI_BEGIN_o, id);
+}
+
+/* End region of interest, repeated executions of a region are summed up. */
+static inline void qtrvsim_roi_end(uint32_t id) {
+    qtrvsim_roi_write(QTRVSIM_ROI_END_o, id);
+}
+
+/* Start accumulating statistics for the next dump. */
+static inline void qtrvsim_stats_reset(void) {
+    qtrvsim_roi_write(QTRVSIM_ROI_STATS_RESET_o, 0);
+}
+
+/* Record statistics since the last reset (or start) tagged by the value. */
+static inline void qtrvsim_stats_dump(uint32_t tag) {
+    qtrvsim_roi_write(QTRVSIM_ROI_STATS_DUMP_o, tag);
+}
+
+/* Stop the simulation, the command line simulator exits with the code. */
+static inline void qtrvsim_exit(uint32_t code) {
+    qtrvsim_roi_write(QTRVSIM_ROI_EXIT_o, code);
+}
+
+#endif /* QTRVSIM_ROI_H */
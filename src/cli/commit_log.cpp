@@ -0,0 +1,113 @@
+#include "commit_log.h"
+
+#include "machine/instruction.h"
+#include "machine/simulator_exception.h"
+
+#include <cinttypes>
+
+using namespace machine;
+
+bool CommitRecord::operator==(const CommitRecord &other) const {
+    return privilege == other.privilege && pc == other.pc && inst == other.inst
+           && regwrite == other.regwrite && num_rd == other.num_rd
+           && reg_value == other.reg_value && memread == other.memread
+           && memwrite == other.memwrite && mem_addr == other.mem_addr
+           && mem_size == other.mem_size && write_value == other.write_value;
+}
+
+/** Spike prints values as zero padded hexadecimal numbers of the given bit width. */
+static void append_value(std::string &out, unsigned bits, uint64_t value) {
+    char buf[24];
+    snprintf(buf, sizeof(buf), "0x%0*" PRIx64, (int)(bits / 4), value);
+    out += buf;
+}
+
+std::string format_spike_commit(const CommitRecord &record, Xlen xlen) {
+    const unsigned xlen_bits = static_cast<unsigned>(xlen);
+    std::string out;
+    char buf[32];
+    snprintf(buf, sizeof(buf), "core%4d: %1d ", 0, static_cast<int>(record.privilege));
+    out += buf;
+    append_value(out, xlen_bits, record.pc.get_raw());
+    out += " (";
+    append_value(out, record.inst_size * 8, record.inst);
+    out += ")";
+    if (record.regwrite) {
+        snprintf(buf, sizeof(buf), " x%-2u ", unsigned(record.num_rd));
+        out += buf;
+        append_value(out, xlen_bits, record.reg_value);
+    }
+    if (record.memread) {
+        out += " mem ";
+        append_value(out, xlen_bits, record.mem_addr);
+    }
+    if (record.memwrite) {
+        out += " mem ";
+        append_value(out, xlen_bits, record.mem_addr);
+        out += " ";
+        append_value(out, record.mem_size * 8, record.write_value);
+    }
+    return out;
+}
+
+CommitTracker::CommitTracker(Machine *machine)
+    : core_state(machine->core()->get_state())
+    , control_state(machine->control_state())
+    , xlen(machine->core()->get_xlen()) {}
+
+bool CommitTracker::step(CommitRecord &record) {
+    const CSR::PrivilegeLevel level = privilege;
+    privilege = control_state->get_privilege_level();
+
+    const MemoryInterstage &mem_wb = core_state.pipeline.memory.result;
+    if (!mem_wb.is_valid || mem_wb.excause != EXCAUSE_NONE) { return false; }
+
+    const uint64_t xlen_mask = (xlen == Xlen::_32) ? UINT32_MAX : UINT64_MAX;
+    record.privilege = level;
+    record.pc = mem_wb.inst_addr;
+    record.inst = mem_wb.inst.data();
+    record.inst_size = mem_wb.inst.size();
+    record.regwrite = mem_wb.regwrite && mem_wb.num_rd != 0;
+    record.num_rd = record.regwrite ? (uint8_t)mem_wb.num_rd : 0;
+    record.reg_value = record.regwrite ? mem_wb.towrite_val.as_u64() & xlen_mask : 0;
+    record.memread = mem_wb.memtoreg;
+    record.memwrite = core_state.pipeline.memory.internal.memwrite;
+    record.mem_addr = 0;
+    record.mem_size = 0;
+    record.write_value = 0;
+    if (record.memread || record.memwrite) {
+        record.mem_addr = mem_wb.mem_addr.get_raw() & xlen_mask;
+        record.mem_size = access_control_size(mem_wb.inst.mem_ctl());
+    }
+    if (record.memwrite) {
+        const uint64_t value = core_state.pipeline.memory.internal.mem_write_val.as_u64();
+        record.write_value
+            = (record.mem_size < 8) ? value & ((UINT64_C(1) << (8 * record.mem_size)) - 1) : value;
+    }
+    return true;
+}
+
+CommitLog::CommitLog(Machine *machine, const QString &path)
+    : tracker(machine)
+    , path(path)
+    , file((path == "-") ? stdout : fopen(path.toLocal8Bit().data(), "w")) {
+    if (file == nullptr) {
+        throw SIMULATOR_EXCEPTION(Input, "Cannot open commit log file for writing", path);
+    }
+    connect(machine->core(), &Core::step_done, this, &CommitLog::step_done);
+}
+
+CommitLog::~CommitLog() {
+    const int result = (file != stdout) ? fclose(file) : fflush(file);
+    if (result != 0 || write_failed) {
+        fprintf(stderr, "Failure writing commit log %s\n", path.toLocal8Bit().data());
+    }
+}
+
+void CommitLog::step_done() {
+    CommitRecord record;
+    if (!tracker.step(record)) { return; }
+    if (write_failed) { return; }
+    const std::string line = format_spike_commit(record, tracker.get_xlen()) + "\n";
+    if (fputs(line.c_str(), file) == EOF) { write_failed = true; }
+}
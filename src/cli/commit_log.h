@@ -0,0 +1,105 @@
+#ifndef COMMIT_LOG_H
+#define COMMIT_LOG_H
+
+#include "machine/core/core_state.h"
+#include "machine/csr/address.h"
+#include "machine/machine.h"
+#include "machine/memory/address.h"
+
+#include <QObject>
+#include <QString>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+/**
+ * Architectural effect of a single retired instruction.
+ *
+ * Instruction retires when it passes the memory stage without exception (the
+ * same condition under which `minstret` is incremented), so both the single
+ * cycle and the pipelined core produce the same sequence of records.
+ */
+struct CommitRecord {
+    machine::CSR::PrivilegeLevel privilege = machine::CSR::PrivilegeLevel::MACHINE;
+    machine::Address pc;
+    uint32_t inst = 0;
+    unsigned inst_size = 4;
+    /** Writes into x0 are not recorded. */
+    bool regwrite = false;
+    uint8_t num_rd = 0;
+    uint64_t reg_value = 0;
+    bool memread = false;
+    bool memwrite = false;
+    /** Virtual address of the access. */
+    uint64_t mem_addr = 0;
+    unsigned mem_size = 0;
+    /** Value written to memory, truncated to the access size. */
+    uint64_t write_value = 0;
+
+    bool operator==(const CommitRecord &other) const;
+    bool operator!=(const CommitRecord &other) const { return !(*this == other); }
+};
+
+/**
+ * Format the record as a line (without newline) of Spike `--log-commits`:
+ *
+ *     core   0: 3 0x0000000080000004 (0x00c58533) x10 0x0000000000000007 mem 0x...
+ *
+ * Register write is followed by load address, store is logged as address and
+ * value. CSR writes are not logged.
+ */
+std::string format_spike_commit(const CommitRecord &record, machine::Xlen xlen);
+
+/**
+ * Extracts the retired instruction from the core state after each step.
+ */
+class CommitTracker {
+public:
+    explicit CommitTracker(machine::Machine *machine);
+
+    /**
+     * Has to be called after every step of the core.
+     * @return false when no instruction retired in the step
+     */
+    bool step(CommitRecord &record);
+
+    [[nodiscard]] machine::Xlen get_xlen() const { return xlen; }
+
+private:
+    const machine::CoreState &core_state;
+    const machine::CSR::ControlState *const control_state;
+    const machine::Xlen xlen;
+    /**
+     * Level at the end of previous step. Level changes only in the memory
+     * stage or in the exception handling, the instruction in the memory stage
+     * therefore executes at this level.
+     */
+    machine::CSR::PrivilegeLevel privilege = machine::CSR::PrivilegeLevel::MACHINE;
+};
+
+/**
+ * Writes every retired instruction in the format of Spike `--log-commits`,
+ * so the trace can be compared with the reference simulator.
+ */
+class CommitLog final : public QObject {
+    Q_OBJECT
+public:
+    /**
+     * @param path  file to write, "-" for standard output
+     * @throws SimulatorExceptionInput when the file cannot be opened
+     */
+    CommitLog(machine::Machine *machine, const QString &path);
+    /** Write errors are reported to stderr. */
+    ~CommitLog() override;
+
+private slots:
+    void step_done();
+
+private:
+    CommitTracker tracker;
+    const QString path;
+    FILE *file;
+    bool write_failed = false; //> Later lines are skipped
+};
+
+#endif // COMMIT_LOG_H
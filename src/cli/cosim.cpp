@@ -0,0 +1,53 @@
+#include "cosim.h"
+
+#include <cinttypes>
+
+using namespace machine;
+
+/** Reference which does not retire an instruction for this long is considered stuck. */
+static constexpr unsigned COSIM_MAX_REFERENCE_CYCLES = 1000;
+
+CoSimulation::CoSimulation(Machine *machine, std::unique_ptr<Machine> reference)
+    : reference(std::move(reference))
+    , tracker(machine)
+    , reference_tracker(this->reference.get()) {
+    connect(machine->core(), &Core::step_done, this, &CoSimulation::step_done);
+}
+
+void CoSimulation::step_done() {
+    CommitRecord record;
+    if (!tracker.step(record) || diverged) { return; }
+
+    CommitRecord expected;
+    for (unsigned cycles = 0;; cycles++) {
+        if (reference->exited() || cycles == COSIM_MAX_REFERENCE_CYCLES) {
+            report_divergence(record, nullptr);
+            return;
+        }
+        reference->step();
+        // Trapped machine did not finish the step, its state is stale.
+        if (reference->status() != Machine::ST_TRAPPED && reference_tracker.step(expected)) {
+            break;
+        }
+    }
+    if (record != expected) {
+        report_divergence(record, &expected);
+        return;
+    }
+    matched++;
+}
+
+void CoSimulation::report_divergence(const CommitRecord &record, const CommitRecord *expected) {
+    diverged = true;
+    printf("Co-simulation diverged after %" PRIu64 " matching instructions\n", matched);
+    printf("machine:   %s\n", format_spike_commit(record, tracker.get_xlen()).c_str());
+    if (expected != nullptr) {
+        printf("reference: %s\n", format_spike_commit(*expected, tracker.get_xlen()).c_str());
+    } else if (reference->exited()) {
+        printf("reference: exited\n");
+    } else {
+        printf(
+            "reference: no instruction retired in %u cycles\n", COSIM_MAX_REFERENCE_CYCLES);
+    }
+    emit divergence_found();
+}
@@ -0,0 +1,53 @@
+#ifndef COSIM_H
+#define COSIM_H
+
+#include "commit_log.h"
+#include "machine/machine.h"
+
+#include <QObject>
+#include <cstdint>
+#include <memory>
+
+/**
+ * Runs a reference machine in lockstep with the simulated one and stops at the
+ * first retired instruction whose architectural effect (see `CommitRecord`)
+ * differs. The reference is usually the same program on a different core
+ * (e.g. `CoreSingle` against `CorePipelined`), which checks the hazard
+ * handling and forwarding of the pipeline.
+ *
+ * The reference is stepped from the `step_done` of the simulated core until
+ * it retires the same number of instructions. Everything that is not a
+ * function of the retired instructions alone (timer interrupts, input of the
+ * serial port) can cause a false divergence.
+ */
+class CoSimulation final : public QObject {
+    Q_OBJECT
+public:
+    /**
+     * @param machine    simulated machine
+     * @param reference  machine with the same program loaded, it must not be
+     *  run by anything else
+     */
+    CoSimulation(machine::Machine *machine, std::unique_ptr<machine::Machine> reference);
+
+    /** Number of instructions retired identically by both machines. */
+    [[nodiscard]] uint64_t get_matched_count() const { return matched; }
+
+signals:
+    /** Emitted once, the difference is already printed. */
+    void divergence_found();
+
+private slots:
+    void step_done();
+
+private:
+    void report_divergence(const CommitRecord &record, const CommitRecord *expected);
+
+    std::unique_ptr<machine::Machine> reference;
+    CommitTracker tracker;
+    CommitTracker reference_tracker;
+    uint64_t matched = 0;
+    bool diverged = false;
+};
+
+#endif // COSIM_H
@@ -0,0 +1,83 @@
+/**
+ * Comparator of state digests recorded by `qtrvsim_cli --state-digest`.
+ */
+
+#include "machine/simulator_exception.h"
+#include "state_digest.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <algorithm>
+#include <cinttypes>
+
+using namespace machine;
+
+void create_parser(QCommandLineParser &p) {
+    p.setApplicationDescription(
+        "Compare state digests of two runs and print the first interval of retired "
+        "instructions where the architectural state differs.");
+    p.addHelpOption();
+    p.addVersionOption();
+
+    p.addPositionalArgument("EXPECTED", "State digest of the reference run");
+    p.addPositionalArgument("ACTUAL", "State digest of the compared run");
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(APP_NAME);
+    QCoreApplication::setApplicationVersion(APP_VERSION);
+
+    QCommandLineParser p;
+    create_parser(p);
+    p.process(app);
+
+    if (p.positionalArguments().size() != 2) {
+        fprintf(stderr, "Two state digest files have to be specified\n");
+        exit(EXIT_FAILURE);
+    }
+
+    try {
+        StateDigestReader expected(p.positionalArguments().at(0));
+        StateDigestReader actual(p.positionalArguments().at(1));
+        if (expected.get_interval() != actual.get_interval()) {
+            fprintf(
+                stderr, "Digest intervals differ (%" PRIu64 " and %" PRIu64 ")\n",
+                expected.get_interval(), actual.get_interval());
+            exit(EXIT_FAILURE);
+        }
+
+        StateDigest digest_expected, digest_actual;
+        uint64_t retired = 0;
+        uint64_t intervals = 0;
+        while (true) {
+            const bool has_expected = expected.next(digest_expected);
+            const bool has_actual = actual.next(digest_actual);
+            if (!has_expected && !has_actual) { break; }
+            if (has_expected != has_actual) {
+                printf(
+                    "Runs differ in length: %s ends after %" PRIu64 " retired instructions.\n",
+                    has_expected ? "actual" : "expected", retired);
+                return 1;
+            }
+            if (digest_expected.retired != digest_actual.retired
+                || digest_expected.hash != digest_actual.hash) {
+                printf(
+                    "First difference in interval %" PRIu64 " (retired instructions %" PRIu64
+                    " to %" PRIu64 ").\n",
+                    intervals, retired + 1,
+                    std::max(digest_expected.retired, digest_actual.retired));
+                return 1;
+            }
+            retired = digest_expected.retired;
+            intervals++;
+        }
+        printf(
+            "Digests match: %" PRIu64 " intervals, %" PRIu64 " retired instructions.\n",
+            intervals, retired);
+    } catch (SimulatorException &e) {
+        fprintf(stderr, "%s\n", qPrintable(e.msg(false)));
+        exit(EXIT_FAILURE);
+    }
+    return 0;
+}
@@ -0,0 +1,284 @@
+#include "execution_trace.h"
+
+#include "machine/instruction.h"
+#include "machine/simulator_exception.h"
+
+#include <cinttypes>
+#include <cstring>
+
+using namespace machine;
+
+static constexpr char TRACE_MAGIC[8] = { 'Q', 'T', 'R', 'V', 'E', 'T', 'R', 1 };
+static constexpr size_t TRACE_BUFFER_SIZE = 1 << 20;
+static constexpr size_t TRACE_MAX_RECORD_SIZE = 128;
+/** Simulation waits when the writer thread falls behind by this many buffers. */
+static constexpr size_t TRACE_MAX_PENDING_BUFFERS = 4;
+
+enum TraceRecordFlags : uint64_t {
+    F_INST = 1 << 0,
+    F_REGWRITE = 1 << 1,
+    F_MEMREAD = 1 << 2,
+    F_MEMWRITE = 1 << 3,
+    F_EXCEPTION = 1 << 4, // One bit for each stage up to writeback
+};
+
+ExecutionTraceRecord ExecutionTraceRecord::from_state(const CoreState &state) {
+    const auto &if_id = state.pipeline.fetch.final;
+    const auto &id_ex = state.pipeline.decode.final;
+    const auto &ex_mem = state.pipeline.execute.final;
+    const auto &mem = state.pipeline.memory.internal;
+    const auto &mem_wb = state.pipeline.memory.final;
+    const auto &wb = state.pipeline.writeback.internal;
+    ExecutionTraceRecord record;
+    record.cycle = state.cycle_count;
+    record.stage_addr = { if_id.inst_addr, id_ex.inst_addr, ex_mem.inst_addr, mem_wb.inst_addr,
+                          wb.inst_addr };
+    record.stage_excause = { if_id.excause, id_ex.excause, ex_mem.excause, mem_wb.excause };
+    record.inst = wb.inst.data();
+    record.regwrite = wb.regwrite;
+    record.num_rd = wb.num_rd;
+    record.reg_value = wb.value.as_u64();
+    record.memread = mem_wb.memtoreg;
+    record.memwrite = mem.memwrite;
+    record.mem_addr = mem_wb.mem_addr.get_raw();
+    record.read_value = mem_wb.towrite_val.as_u64();
+    record.write_value = mem.mem_write_val.as_u64();
+    return record;
+}
+
+void print_trace_text(const ExecutionTraceRecord &record, const TraceTextOptions &options) {
+    using Stage = ExecutionTraceRecord::Stage;
+    const Instruction inst(record.inst);
+    auto trace_instruction_in_stage = [&](const char *stage_name, Stage stage) {
+        printf(
+            "%s: %s%s\n", stage_name, (record.stage_excause[stage] != EXCAUSE_NONE) ? "!" : "",
+            qPrintable(inst.to_str(record.stage_addr[stage])));
+    };
+    if (options.trace_fetch) { trace_instruction_in_stage("Fetch", Stage::FETCH); }
+    if (options.trace_decode) { trace_instruction_in_stage("Decode", Stage::DECODE); }
+    if (options.trace_execute) { trace_instruction_in_stage("Execute", Stage::EXECUTE); }
+    if (options.trace_memory) { trace_instruction_in_stage("Memory", Stage::MEMORY); }
+    if (options.trace_writeback) {
+        printf("Writeback: %s\n", qPrintable(inst.to_str(record.stage_addr[Stage::WRITEBACK])));
+    }
+    if (options.trace_pc) {
+        printf("PC: %" PRIx64 "\n", record.stage_addr[Stage::FETCH].get_raw());
+    }
+    if (options.trace_regs_gp && record.regwrite && options.regs_to_trace.at(record.num_rd)) {
+        printf("GP %zu: %" PRIx64 "\n", size_t(record.num_rd), record.reg_value);
+    }
+    if (options.trace_rdmem && record.memread) {
+        printf("MEM[%" PRIx64 "]:  RD %" PRIx64 "\n", record.mem_addr, record.read_value);
+    }
+    if (options.trace_wrmem && record.memwrite) {
+        printf("MEM[%" PRIx64 "]:  WR %" PRIx64 "\n", record.mem_addr, record.write_value);
+    }
+}
+
+static void put_uleb(std::vector<uint8_t> &buffer, uint64_t value) {
+    do {
+        uint8_t b = value & 0x7f;
+        value >>= 7;
+        buffer.push_back(b | (value != 0 ? 0x80 : 0));
+    } while (value != 0);
+}
+
+static void put_sleb(std::vector<uint8_t> &buffer, int64_t value) {
+    put_uleb(buffer, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+ExecutionTraceWriter::ExecutionTraceWriter(const QString &path)
+    : file(fopen(path.toLocal8Bit().data(), "wb"))
+    , path(path) {
+    if (file == nullptr) {
+        throw SIMULATOR_EXCEPTION(Input, "Cannot open execution trace file for writing", path);
+    }
+    buffer.reserve(TRACE_BUFFER_SIZE + TRACE_MAX_RECORD_SIZE);
+    buffer.insert(buffer.end(), std::begin(TRACE_MAGIC), std::end(TRACE_MAGIC));
+    writer = std::thread(&ExecutionTraceWriter::writer_loop, this);
+}
+
+ExecutionTraceWriter::~ExecutionTraceWriter() {
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    queue_changed.notify_all();
+    writer.join();
+    if (fclose(file) != 0 || write_failed) {
+        fprintf(stderr, "Failure writing execution trace %s\n", qPrintable(path));
+    }
+}
+
+void ExecutionTraceWriter::write(const ExecutionTraceRecord &record) {
+    uint64_t flags = 0;
+    if (record.inst != last.inst) { flags |= F_INST; }
+    if (record.regwrite) { flags |= F_REGWRITE; }
+    if (record.memread) { flags |= F_MEMREAD; }
+    if (record.memwrite) { flags |= F_MEMWRITE; }
+    for (size_t stage = 0; stage < record.stage_excause.size(); stage++) {
+        if (record.stage_excause[stage] != EXCAUSE_NONE) { flags |= F_EXCEPTION << stage; }
+    }
+
+    put_uleb(buffer, flags);
+    put_sleb(buffer, (int64_t)(record.cycle - last.cycle));
+    for (size_t stage = 0; stage < record.stage_addr.size(); stage++) {
+        put_sleb(buffer, (int64_t)(record.stage_addr[stage] - last.stage_addr[stage]));
+    }
+    if (flags & F_INST) {
+        for (size_t i = 0; i < sizeof(record.inst); i++) {
+            buffer.push_back((uint8_t)(record.inst >> (8 * i)));
+        }
+    }
+    for (size_t stage = 0; stage < record.stage_excause.size(); stage++) {
+        if (flags & (F_EXCEPTION << stage)) { put_uleb(buffer, record.stage_excause[stage]); }
+    }
+    if (flags & F_REGWRITE) {
+        put_uleb(buffer, record.num_rd);
+        put_uleb(buffer, record.reg_value);
+    }
+    const uint64_t last_mem_addr = last.mem_addr;
+    if (flags & (F_MEMREAD | F_MEMWRITE)) {
+        put_sleb(buffer, (int64_t)(record.mem_addr - last_mem_addr));
+        if (flags & F_MEMREAD) { put_uleb(buffer, record.read_value); }
+        if (flags & F_MEMWRITE) { put_uleb(buffer, record.write_value); }
+    }
+
+    last = record;
+    // Memory address is a delta to the last access.
+    if (!(flags & (F_MEMREAD | F_MEMWRITE))) { last.mem_addr = last_mem_addr; }
+    record_count++;
+    if (buffer.size() >= TRACE_BUFFER_SIZE) { flush(); }
+}
+
+void ExecutionTraceWriter::flush() {
+    if (buffer.empty()) { return; }
+    std::unique_lock<std::mutex> lock(mutex);
+    queue_changed.wait(lock, [this] { return queue.size() < TRACE_MAX_PENDING_BUFFERS; });
+    queue.push_back(std::move(buffer));
+    if (!free_buffers.empty()) {
+        buffer = std::move(free_buffers.back());
+        free_buffers.pop_back();
+    } else {
+        buffer = {};
+        buffer.reserve(TRACE_BUFFER_SIZE + TRACE_MAX_RECORD_SIZE);
+    }
+    lock.unlock();
+    queue_changed.notify_all();
+}
+
+void ExecutionTraceWriter::writer_loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        queue_changed.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) { return; } // Stopping and everything is written.
+        std::vector<uint8_t> data = std::move(queue.front());
+        queue.pop_front();
+        const bool skip = write_failed;
+        lock.unlock();
+        const bool failed = !skip && fwrite(data.data(), 1, data.size(), file) != data.size();
+        data.clear();
+        lock.lock();
+        if (failed) { write_failed = true; }
+        free_buffers.push_back(std::move(data));
+        queue_changed.notify_all();
+    }
+}
+
+uint64_t ExecutionTraceWriter::get_record_count() const {
+    return record_count;
+}
+
+ExecutionTraceReader::ExecutionTraceReader(const QString &path)
+    : file(fopen(path.toLocal8Bit().data(), "rb"))
+    , buffer(TRACE_BUFFER_SIZE) {
+    if (file == nullptr) {
+        throw SIMULATOR_EXCEPTION(Input, "Cannot open execution trace file", path);
+    }
+    char magic[sizeof(TRACE_MAGIC)];
+    if (fread(magic, 1, sizeof(magic), file) != sizeof(magic)
+        || memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0) {
+        fclose(file);
+        throw SIMULATOR_EXCEPTION(Input, "File is not a supported execution trace", path);
+    }
+}
+
+ExecutionTraceReader::~ExecutionTraceReader() {
+    fclose(file);
+}
+
+bool ExecutionTraceReader::read_byte(uint8_t &value) {
+    if (buffer_pos == buffer_len) {
+        buffer_len = fread(buffer.data(), 1, buffer.size(), file);
+        buffer_pos = 0;
+        if (buffer_len == 0) { return false; }
+    }
+    value = buffer[buffer_pos++];
+    return true;
+}
+
+uint64_t ExecutionTraceReader::read_uleb() {
+    uint64_t value = 0;
+    uint8_t b;
+    unsigned shift = 0;
+    do {
+        if (!read_byte(b) || shift > 63) {
+            throw SIMULATOR_EXCEPTION(Input, "Corrupted execution trace", "truncated record");
+        }
+        value |= (uint64_t)(b & 0x7f) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    return value;
+}
+
+int64_t ExecutionTraceReader::read_sleb() {
+    const uint64_t zigzag = read_uleb();
+    return (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+}
+
+bool ExecutionTraceReader::next(ExecutionTraceRecord &record) {
+    uint8_t first;
+    if (!read_byte(first)) { return false; }
+    buffer_pos--; // Flags are read as a whole.
+    const uint64_t flags = read_uleb();
+    if (flags >> 8 != 0) {
+        throw SIMULATOR_EXCEPTION(Input, "Corrupted execution trace", "invalid record flags");
+    }
+
+    record = last;
+    record.cycle += read_sleb();
+    for (auto &addr : record.stage_addr) {
+        addr += read_sleb();
+    }
+    if (flags & F_INST) {
+        record.inst = 0;
+        for (size_t i = 0; i < sizeof(record.inst); i++) {
+            uint8_t b;
+            if (!read_byte(b)) {
+                throw SIMULATOR_EXCEPTION(Input, "Corrupted execution trace", "truncated record");
+            }
+            record.inst |= (uint32_t)b << (8 * i);
+        }
+    }
+    for (size_t stage = 0; stage < record.stage_excause.size(); stage++) {
+        record.stage_excause[stage] = EXCAUSE_NONE;
+        if (flags & (F_EXCEPTION << stage)) {
+            record.stage_excause[stage] = (ExceptionCause)read_uleb();
+        }
+    }
+    record.regwrite = flags & F_REGWRITE;
+    if (record.regwrite) {
+        record.num_rd = (uint8_t)read_uleb();
+        record.reg_value = read_uleb();
+    }
+    record.memread = flags & F_MEMREAD;
+    record.memwrite = flags & F_MEMWRITE;
+    if (record.memread || record.memwrite) {
+        record.mem_addr += read_sleb();
+        if (record.memread) { record.read_value = read_uleb(); }
+        if (record.memwrite) { record.write_value = read_uleb(); }
+    }
+    last = record;
+    return true;
+}
@@ -0,0 +1,149 @@
+#ifndef EXECUTION_TRACE_H
+#define EXECUTION_TRACE_H
+
+#include "machine/core/core_state.h"
+#include "machine/machinedefs.h"
+#include "machine/memory/address.h"
+#include "machine/registers.h"
+
+#include <QString>
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * State of the pipeline after a single cycle, as printed by the tracer.
+ */
+struct ExecutionTraceRecord {
+    enum Stage { FETCH, DECODE, EXECUTE, MEMORY, WRITEBACK, STAGE_COUNT };
+
+    uint64_t cycle = 0;
+    std::array<machine::Address, STAGE_COUNT> stage_addr {};
+    /** Writeback stage has no exception, all are resolved in memory. */
+    std::array<machine::ExceptionCause, WRITEBACK> stage_excause {};
+    /** Instruction word in writeback (the tracer prints it for all stages). */
+    uint32_t inst = 0;
+    bool regwrite = false;
+    uint8_t num_rd = 0;
+    uint64_t reg_value = 0;
+    bool memread = false;
+    bool memwrite = false;
+    uint64_t mem_addr = 0;
+    uint64_t read_value = 0;
+    uint64_t write_value = 0;
+
+    static ExecutionTraceRecord from_state(const machine::CoreState &state);
+};
+
+/** Selection of the text trace items, see `print_trace_text`. */
+struct TraceTextOptions {
+    std::array<bool, machine::REGISTER_COUNT> regs_to_trace = {};
+    bool trace_fetch = false, trace_decode = false, trace_execute = false, trace_memory = false,
+         trace_writeback = false, trace_pc = false, trace_wrmem = false, trace_rdmem = false,
+         trace_regs_gp = false;
+
+    [[nodiscard]] bool any() const {
+        return trace_fetch || trace_decode || trace_execute || trace_memory || trace_writeback
+               || trace_pc || trace_wrmem || trace_rdmem || trace_regs_gp;
+    }
+};
+
+/** Print the record in the text format of the command line tracer. */
+void print_trace_text(const ExecutionTraceRecord &record, const TraceTextOptions &options);
+
+/**
+ * Writes records into a compact binary file. Records are encoded into a
+ * buffer in the simulation thread, full buffers are written to the file by a
+ * background thread.
+ *
+ * File format:
+ *  - 7 byte magic `QTRVETR` and format version byte (8 bytes),
+ *  - sequence of records.
+ *
+ * Record starts with LEB128 flags telling which optional fields follow,
+ * then the cycle delta and stage addresses as zig-zag LEB128 deltas to the
+ * previous record. Optional fields are the instruction word (when changed),
+ * exception causes, register write and memory access (address delta and
+ * values). A record of a pipeline flowing without memory access therefore
+ * costs about 7 bytes.
+ */
+class ExecutionTraceWriter {
+public:
+    /**
+     * @param path  file to write, truncated when it exists
+     * @throws SimulatorExceptionInput when the file cannot be opened
+     */
+    explicit ExecutionTraceWriter(const QString &path);
+    /**
+     * Writes remaining records and waits for the writer thread. Failure to
+     * write the file is reported to standard error.
+     */
+    ~ExecutionTraceWriter();
+
+    ExecutionTraceWriter(const ExecutionTraceWriter &) = delete;
+    ExecutionTraceWriter &operator=(const ExecutionTraceWriter &) = delete;
+
+    void write(const ExecutionTraceRecord &record);
+    /** Hand buffered records to the writer thread. */
+    void flush();
+
+    [[nodiscard]] uint64_t get_record_count() const;
+
+private:
+    void writer_loop();
+
+    FILE *file;
+    const QString path;
+    std::vector<uint8_t> buffer;
+    ExecutionTraceRecord last {};
+    uint64_t record_count = 0;
+
+    std::mutex mutex;
+    std::condition_variable queue_changed;
+    std::deque<std::vector<uint8_t>> queue;
+    std::vector<std::vector<uint8_t>> free_buffers;
+    bool stopping = false;
+    /** Writing of some buffer failed, remaining ones are dropped. */
+    bool write_failed = false;
+    std::thread writer;
+};
+
+/**
+ * Sequential reader of files produced by `ExecutionTraceWriter`.
+ */
+class ExecutionTraceReader {
+public:
+    /**
+     * @throws SimulatorExceptionInput when the file cannot be opened or it is
+     *  not an execution trace
+     */
+    explicit ExecutionTraceReader(const QString &path);
+    ~ExecutionTraceReader();
+
+    ExecutionTraceReader(const ExecutionTraceReader &) = delete;
+    ExecutionTraceReader &operator=(const ExecutionTraceReader &) = delete;
+
+    /**
+     * @return false at the end of the trace
+     * @throws SimulatorExceptionInput when the trace is truncated or corrupted
+     */
+    bool next(ExecutionTraceRecord &record);
+
+private:
+    bool read_byte(uint8_t &value);
+    uint64_t read_uleb();
+    int64_t read_sleb();
+
+    FILE *file;
+    std::vector<uint8_t> buffer;
+    size_t buffer_pos = 0;
+    size_t buffer_len = 0;
+    ExecutionTraceRecord last {};
+};
+
+#endif // EXECUTION_TRACE_H
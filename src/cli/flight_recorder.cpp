@@ -0,0 +1,85 @@
+#include "flight_recorder.h"
+
+#include "machine/instruction.h"
+#include "machine/simulator_exception.h"
+
+#include <cinttypes>
+
+using namespace machine;
+
+FlightRecorder::FlightRecorder(Machine *machine, size_t capacity)
+    : core_state(machine->core()->get_state())
+    , ring(capacity) {
+    if (capacity != 0) {
+        connect(machine->core(), &Core::step_done, this, &FlightRecorder::step_done);
+    }
+}
+
+void FlightRecorder::step_done() {
+    ring[next] = ExecutionTraceRecord::from_state(core_state);
+    if (++next == ring.size()) { next = 0; }
+    recorded++;
+}
+
+size_t FlightRecorder::size() const {
+    return (recorded < ring.size()) ? recorded : ring.size();
+}
+
+const ExecutionTraceRecord &FlightRecorder::at(size_t index) const {
+    // Until the ring is full, the oldest record is in the first slot.
+    const size_t oldest = (recorded < ring.size()) ? 0 : next;
+    return ring[(oldest + index) % ring.size()];
+}
+
+void FlightRecorder::dump(const char *reason) const {
+    if (ring.empty()) { return; }
+    if (text_path.isEmpty()) {
+        dump_text(stderr, reason);
+    } else {
+        FILE *out = fopen(text_path.toLocal8Bit().data(), "w");
+        if (out == nullptr) {
+            fprintf(stderr, "Failed to open %s for writing\n", qPrintable(text_path));
+        } else {
+            dump_text(out, reason);
+            if (fclose(out)) { fprintf(stderr, "Failure closing %s\n", qPrintable(text_path)); }
+        }
+    }
+    if (!binary_path.isEmpty()) { dump_binary(); }
+}
+
+void FlightRecorder::dump_text(FILE *out, const char *reason) const {
+    static const char STAGE_NAMES[] = "FDEM";
+    fprintf(out, "Flight recorder: last %zu cycles before %s\n", size(), reason);
+    for (size_t i = 0; i < size(); i++) {
+        const ExecutionTraceRecord &record = at(i);
+        const Address wb_addr = record.stage_addr[ExecutionTraceRecord::WRITEBACK];
+        fprintf(
+            out, "%10" PRIu64 " %s", record.cycle,
+            qPrintable(Instruction(record.inst).to_str(wb_addr)));
+        if (record.regwrite && record.num_rd != 0) {
+            fprintf(out, " x%u=0x%" PRIx64, unsigned(record.num_rd), record.reg_value);
+        }
+        if (record.memread) {
+            fprintf(out, " RD[0x%" PRIx64 "]=0x%" PRIx64, record.mem_addr, record.read_value);
+        }
+        if (record.memwrite) {
+            fprintf(out, " WR[0x%" PRIx64 "]=0x%" PRIx64, record.mem_addr, record.write_value);
+        }
+        for (size_t stage = 0; stage < record.stage_excause.size(); stage++) {
+            if (record.stage_excause[stage] == EXCAUSE_NONE) { continue; }
+            fprintf(
+                out, " !%c:0x%" PRIx64 ":%d", STAGE_NAMES[stage],
+                record.stage_addr[stage].get_raw(), int(record.stage_excause[stage]));
+        }
+        fputc('\n', out);
+    }
+}
+
+void FlightRecorder::dump_binary() const {
+    try {
+        ExecutionTraceWriter writer(binary_path);
+        for (size_t i = 0; i < size(); i++) {
+            writer.write(at(i));
+        }
+    } catch (SimulatorException &e) { fprintf(stderr, "%s\n", qPrintable(e.msg(false))); }
+}
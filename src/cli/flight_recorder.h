@@ -0,0 +1,57 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include "execution_trace.h"
+#include "machine/machine.h"
+
+#include <QObject>
+#include <QString>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Keeps the last cycles of the execution (retired instruction, register
+ * write, memory access and exceptions in the pipeline) in a fixed size ring
+ * buffer, so they can be printed when the program fails. Recording only
+ * copies the record into a preallocated slot, so it is cheap enough to stay
+ * enabled in runs without any tracing.
+ */
+class FlightRecorder final : public QObject {
+    Q_OBJECT
+public:
+    /** Upper bound of the capacity, the whole buffer is allocated upfront. */
+    static constexpr size_t MAX_CAPACITY = 1 << 20;
+
+    /** @param capacity  number of kept cycles */
+    FlightRecorder(machine::Machine *machine, size_t capacity);
+
+    /** Write the text dump to the file instead of standard error. */
+    void set_text_path(const QString &path) { text_path = path; }
+    /** Also write the dump as a binary trace (see `ExecutionTraceWriter`). */
+    void set_binary_path(const QString &path) { binary_path = path; }
+
+    /** Write the kept cycles from the oldest one. */
+    void dump(const char *reason) const;
+
+    /** Number of kept cycles. */
+    [[nodiscard]] size_t size() const;
+
+private slots:
+    void step_done();
+
+private:
+    void dump_text(FILE *out, const char *reason) const;
+    void dump_binary() const;
+    /** Kept record, 0 is the oldest one. */
+    [[nodiscard]] const ExecutionTraceRecord &at(size_t index) const;
+
+    const machine::CoreState &core_state;
+    std::vector<ExecutionTraceRecord> ring;
+    /** Slot for the next record. */
+    size_t next = 0;
+    uint64_t recorded = 0;
+    QString text_path;
+    QString binary_path;
+};
+
+#endif // FLIGHT_RECORDER_H
@@ -1,19 +1,35 @@
 #include "assembler/simpleasm.h"
 #include "chariohandler.h"
+#include "commit_log.h"
 #include "common/logging.h"
 #include "common/logging_format_colors.h"
+#include "cosim.h"
+#include "flight_recorder.h"
 #include "machine/machineconfig.h"
+#include "machine/memory/cache/access_trace.h"
+#include "machine/memory/cache/cache_sweep.h"
+#include "machine/memory/memory_image.h"
+#include "machine/memory/reuse_analysis.h"
+#include "machine/profiler/call_profile.h"
+#include "machine/profiler/flat_profile.h"
+#include "machine/profiler/miss_profile.h"
 #include "os_emulation/ossyscall.h"
 #include "msgreport.h"
+#include "pipeline_view.h"
 #include "reporter.h"
+#include "state_digest.h"
 #include "tracer.h"
 
 #include <QCommandLineParser>
 #include <QCoreApplication>
 #include <QFile>
 #include <cctype>
+#include <cinttypes>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <thread>
 
 using namespace machine;
 using namespace std;
@@ -51,11 +67,93 @@ void create_parser(QCommandLineParser &p) {
                   "Print general purpose register changes. You can use * for "
                   "all registers.",
                   "REG" });
+    p.addOption({ "trace-binary",
+                  "Record every cycle into a compact binary trace. Use qtrvsim_trace to decode "
+                  "it.",
+                  "FNAME" });
+    p.addOption({ "log-commits",
+                  "Log every retired instruction in the format of Spike --log-commits ('-' for "
+                  "standard output).",
+                  "FNAME" });
+    p.addOption({ "flight-recorder",
+                  "Number of last cycles kept in memory and dumped when the machine traps or "
+                  "the run does not end as expected (default 4096, at most 1048576, 0 "
+                  "disables it).",
+                  "CYCLES" });
+    p.addOption({ "flight-recorder-text",
+                  "Write the flight recorder dump to the file instead of standard error.",
+                  "FNAME" });
+    p.addOption({ "flight-recorder-binary",
+                  "Also write the flight recorder dump as a binary trace (see --trace-binary).",
+                  "FNAME" });
+    p.addOption({ "pipeline-view",
+                  "Write stages of every instruction in the pipelined core in the Kanata format "
+                  "(for the Konata pipeline viewer).",
+                  "FNAME" });
+    p.addOption({ "pipeline-view-cycles",
+                  "Write only cycles in the inclusive range to --pipeline-view.", "FROM:TO" });
+    p.addOption({ "state-digest",
+                  "Write hash of the architectural state (registers, CSRs and written memory "
+                  "pages) every --state-digest-interval retired instructions. Use "
+                  "qtrvsim_digest to find the first difference of two runs.",
+                  "FNAME" });
+    p.addOption({ "state-digest-interval",
+                  "Retired instructions between state digests (default 100000).", "NUMBER" });
+    p.addOption({ "cosim",
+                  "Run the program on a reference core in lockstep and stop at the first "
+                  "retired instruction with a different effect. KIND is single or pipelined "
+                  "core with hazard unit [none|stall|forward].",
+                  "KIND" });
+    p.addOption({ "profile",
+                  "Print retired instructions, cycles, stalls and cache misses by symbol and by "
+                  "instruction at program exit." });
+    p.addOption({ "profile-callgrind",
+                  "Write the execution profile in callgrind format (for KCachegrind).", "FNAME" });
+    p.addOption({ "profile-folded",
+                  "Write cycles by function as folded stacks (for flamegraph.pl).", "FNAME" });
+    p.addOption({ "profile-calls",
+                  "Print inclusive and exclusive costs by call path (calls and returns are "
+                  "detected from jal/jalr) at program exit." });
+    p.addOption({ "profile-calls-callgrind",
+                  "Write the call graph profile in callgrind format (for KCachegrind).",
+                  "FNAME" });
+    p.addOption({ "profile-calls-folded",
+                  "Write cycles by call stack as folded stacks (for flamegraph.pl).", "FNAME" });
+    p.addOption({ "profile-misses",
+                  "Print data cache misses by instruction and by data object (sized symbol) "
+                  "split to compulsory, capacity and conflict misses at program exit." });
     p.addOption({ { "dump-registers", "d-regs" }, "Dump registers state at program exit." });
     p.addOption({ "dump-cache-stats", "Dump cache statistics at program exit." });
     p.addOption({ "dump-cycles", "Dump number of CPU cycles till program end." });
+    p.addOption({ "dump-cpi-stack",
+                  "Dump cycles split to retired instructions and penalties by cause (stalls, "
+                  "flushes) with their contribution to CPI." });
+    p.addOption({ "cpi-stack-json", "Write the CPI stack in JSON at program exit.", "FNAME" });
+    p.addOption({ "dump-roi-stats",
+                  "Dump statistics of regions of interest and statistics dumps marked by the "
+                  "program through the ROI control peripheral." });
     p.addOption({ "dump-range", "Dump memory range.", "START,LENGTH,FNAME" });
-    p.addOption({ "load-range", "Load memory range.", "START,FNAME" });
+    p.addOption({ "dump-range-format",
+                  "Format of --dump-range files: text (one word per line, default), image "
+                  "(sparse binary image) or image-lz (compressed sparse binary image).",
+                  "FORMAT" });
+    p.addOption({ "load-range",
+                  "Load memory range. Binary images are detected automatically and relocated "
+                  "to START.",
+                  "START,FNAME" });
+    p.addOption({ "find",
+                  "Search memory (including data held in caches) for a pattern at program exit. "
+                  "Format hex:BYTES (?? matches any byte), u32:VALUE[/MASK], u64:VALUE[/MASK] or "
+                  "str:TEXT.",
+                  "PATTERN" });
+    p.addOption({ "memory-diff",
+                  "Report memory ranges changed by the program (from the loaded state) at program "
+                  "exit." });
+    p.addOption({ "memory-diff-from",
+                  "Like --memory-diff, but compare with memory state after the first instruction "
+                  "at ADDR (address or symbol) retires.",
+                  "ADDR" });
+    p.addOption({ "memory-diff-hex", "Print hexdump of old and new content of changed ranges." });
     p.addOption({ "expect-fail", "Expect that program causes CPU trap and fail if it doesn't." });
     p.addOption({ "fail-match",
                   "Program should exit with exactly this CPU TRAP. Possible values are "
@@ -75,6 +173,25 @@ void create_parser(QCommandLineParser &p) {
                   "L2 cache. Format policy,sets,words_in_blocks,associativity where "
                   "policy is random/lru/lfu",
                   "L2CACHE" });
+    p.addOption({ "i-tlb",
+                  "Instruction TLB used with supervisor mode (S in --isa-variant). Format "
+                  "policy,sets,associativity where policy is random/lru/lfu, zero sets "
+                  "disables the TLB.",
+                  "ITLB" });
+    p.addOption({ "d-tlb", "Data TLB. Format as for --i-tlb.", "DTLB" });
+    p.addOption({ "page-walk-cache",
+                  "Number of non-leaf page table entries cached to speed up page walks "
+                  "(default 0 - disabled).",
+                  "NUMBER" });
+    p.addOption({ "memory-section-size",
+                  "Size of lazily allocated memory sections in bytes. Power of two from 256 "
+                  "to 2097152 (default 4096).",
+                  "BYTES" });
+    p.addOption({ "map-file",
+                  "Map host file into physical memory at ADDR outside of the main memory (e.g. "
+                  "above 4 GiB for RV64). Mode is ro, rw (writes are not stored to the file) or "
+                  "rw-shared.",
+                  "ADDR,FNAME,MODE" });
     p.addOption({ "read-time", "Memory read access time (cycles).", "RTIME" });
     p.addOption({ "write-time", "Memory read access time (cycles).", "WTIME" });
     p.addOption({ "burst-time", "Memory read access time (cycles).", "BTIME" });
@@ -86,6 +203,37 @@ void create_parser(QCommandLineParser &p) {
     p.addOption({ { "os-fs-root", "osfsroot" }, "Emulated system root/prefix for opened files", "DIR" });
     p.addOption({ { "isa-variant", "isavariant" }, "Instruction set to emulate (default RV32IMA)", "STR" });
     p.addOption({ "cycle-limit", "Limit execution to specified maximum clock cycles", "NUMBER" });
+    p.addOption({ "record-access-trace",
+                  "Record instruction and data address streams of the core into binary file "
+                  "for later cache sweep.",
+                  "FNAME" });
+    p.addOption({ "sweep-trace",
+                  "Do not run any program, evaluate caches given by --sweep-i-cache and "
+                  "--sweep-d-cache on the recorded access trace and print miss rate table.",
+                  "FNAME" });
+    p.addOption({ "sweep-i-cache",
+                  "Instruction cache evaluated by --sweep-trace. Format as for --i-cache, numeric "
+                  "parameters can be given as range FROM:TO of powers of two (e.g. "
+                  "lru,1:64,4,1:8,wb). Can be used multiple times.",
+                  "CONFIG" });
+    p.addOption({ "sweep-d-cache",
+                  "Data cache evaluated by --sweep-trace. Format as for --sweep-i-cache.",
+                  "CONFIG" });
+    p.addOption({ "sweep-jobs", "Number of worker threads used by --sweep-trace.", "NUMBER" });
+    p.addOption({ "reuse-histogram",
+                  "Write reuse distance histograms of instruction and data accesses (total and "
+                  "per symbol) at program exit. JSON when FNAME ends with .json, CSV otherwise.",
+                  "FNAME" });
+    p.addOption({ "working-set",
+                  "Write working set size (touched blocks and pages) for each window of retired "
+                  "instructions at program exit. JSON when FNAME ends with .json, CSV otherwise.",
+                  "FNAME" });
+    p.addOption({ "reuse-block-size",
+                  "Block size in bytes used by --reuse-histogram and --working-set (default 64).",
+                  "BYTES" });
+    p.addOption({ "working-set-window",
+                  "Number of retired instructions in one --working-set window (default 10000).",
+                  "NUMBER" });
 }
 
 void configure_cache(CacheConfig &cacheconf, const QStringList &cachearg, const QString &which) {
@@ -145,6 +293,325 @@ void configure_cache(CacheConfig &cacheconf, const QStringList &cachearg, const
     }
 }
 
+void configure_tlb(CacheConfig &tlbconf, const QStringList &tlbarg, const QString &which) {
+    if (tlbarg.empty()) { return; }
+    QStringList pieces = tlbarg.last().split(",");
+    if (!pieces.isEmpty() && pieces.at(0).size() > 0 && !pieces.at(0).at(0).isDigit()) {
+        if (pieces.at(0).toLower() == "random") {
+            tlbconf.set_replacement_policy(CacheConfig::RP_RAND);
+        } else if (pieces.at(0).toLower() == "lru") {
+            tlbconf.set_replacement_policy(CacheConfig::RP_LRU);
+        } else if (pieces.at(0).toLower() == "lfu") {
+            tlbconf.set_replacement_policy(CacheConfig::RP_LFU);
+        } else {
+            fprintf(stderr, "Policy for %s TLB is incorrect.\n", qPrintable(which));
+            exit(EXIT_FAILURE);
+        }
+        pieces.removeFirst();
+    }
+    bool sets_ok = false, assoc_ok = false;
+    const unsigned sets = (pieces.size() == 2) ? pieces.at(0).toUInt(&sets_ok) : 0;
+    const unsigned associativity = (pieces.size() == 2) ? pieces.at(1).toUInt(&assoc_ok) : 0;
+    if (!sets_ok || !assoc_ok || (sets != 0 && associativity == 0)) {
+        fprintf(
+            stderr, "Parameters for %s TLB incorrect (correct lru,16,2).\n", qPrintable(which));
+        exit(EXIT_FAILURE);
+    }
+    tlbconf.set_enabled(sets != 0);
+    tlbconf.set_set_count(sets);
+    tlbconf.set_associativity(associativity);
+}
+
+/**
+ * Expands numeric ranges `FROM:TO` in cache specification into all powers of
+ * two within the range. Both ends have to be powers of two.
+ */
+QStringList expand_cache_sweep_spec(const QString &spec) {
+    QStringList pieces = spec.split(",");
+    for (int i = 0; i < pieces.size(); i++) {
+        QStringList range = pieces.at(i).split(":");
+        if (range.size() != 2) { continue; }
+        bool ok_from, ok_to;
+        unsigned long from = range.at(0).toULong(&ok_from, 0);
+        unsigned long to = range.at(1).toULong(&ok_to, 0);
+        auto is_power_of_two = [](unsigned long value) {
+            return value != 0 && (value & (value - 1)) == 0;
+        };
+        if (!ok_from || !ok_to || !is_power_of_two(from) || !is_power_of_two(to) || from > to) {
+            fprintf(stderr, "Invalid range in cache specification %s.\n", qPrintable(spec));
+            exit(EXIT_FAILURE);
+        }
+        QStringList expanded;
+        // Doubling reaches `to` exactly, so the value never overflows.
+        for (unsigned long value = from;; value *= 2) {
+            pieces[i] = QString::number(value);
+            expanded.append(expand_cache_sweep_spec(pieces.join(",")));
+            if (value == to) { break; }
+        }
+        return expanded;
+    }
+    return { spec };
+}
+
+const char *cache_policy_name(CacheConfig::ReplacementPolicy policy) {
+    switch (policy) {
+    case CacheConfig::RP_RAND: return "random";
+    case CacheConfig::RP_LRU: return "lru";
+    case CacheConfig::RP_LFU: return "lfu";
+    }
+    return "?";
+}
+
+const char *cache_write_policy_name(CacheConfig::WritePolicy policy) {
+    switch (policy) {
+    case CacheConfig::WP_THROUGH_NOALLOC: return "wtna";
+    case CacheConfig::WP_THROUGH_ALLOC: return "wta";
+    case CacheConfig::WP_BACK: return "wb";
+    }
+    return "?";
+}
+
+int run_cache_sweep(QCommandLineParser &p) {
+    CacheSweep sweep;
+    auto add_configs = [&](const QString &option, CacheSweepStream stream, const QString &which) {
+        for (const QString &spec : p.values(option)) {
+            for (const QString &expanded : expand_cache_sweep_spec(spec)) {
+                CacheConfig config;
+                configure_cache(config, { expanded }, which);
+                sweep.add_config(stream, config);
+            }
+        }
+    };
+    add_configs("sweep-i-cache", CacheSweepStream::PROGRAM, "instruction");
+    add_configs("sweep-d-cache", CacheSweepStream::DATA, "data");
+
+    unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+    if (p.isSet("sweep-jobs")) {
+        bool ok;
+        jobs = p.value("sweep-jobs").toUInt(&ok);
+        if (!ok || jobs == 0) {
+            fprintf(stderr, "Value of option sweep-jobs is not a valid positive integer.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    try {
+        sweep.run(p.value("sweep-trace"), jobs);
+    } catch (SimulatorException &e) {
+        fprintf(stderr, "%s\n", qPrintable(e.msg(false)));
+        return EXIT_FAILURE;
+    }
+
+    printf(
+        "%-6s %-6s %-5s %6s %6s %5s %10s %14s %14s %9s\n", "stream", "policy", "write", "sets",
+        "words", "ways", "bytes", "accesses", "misses", "miss-rate");
+    for (const auto &result : sweep.get_results()) {
+        const CacheConfig &c = result.config;
+        printf(
+            "%-6s %-6s %-5s %6u %6u %5u %10u %14" PRIu64 " %14" PRIu64 " %9.6f\n",
+            result.stream == CacheSweepStream::PROGRAM ? "i" : "d",
+            cache_policy_name(c.replacement_policy()), cache_write_policy_name(c.write_policy()),
+            c.set_count(), c.block_size(), c.associativity(),
+            c.set_count() * c.block_size() * c.associativity() * 4, result.get_access_count(),
+            result.get_miss_count(), result.get_miss_rate());
+    }
+    return EXIT_SUCCESS;
+}
+
+std::unique_ptr<ReuseAnalysis> create_reuse_analysis(QCommandLineParser &p, Machine &machine) {
+    if (!p.isSet("reuse-histogram") && !p.isSet("working-set")) { return nullptr; }
+    bool ok = true;
+    unsigned block_size = 64;
+    if (p.isSet("reuse-block-size")) { block_size = p.value("reuse-block-size").toUInt(&ok, 0); }
+    if (!ok || block_size == 0 || (block_size & (block_size - 1)) != 0) {
+        fprintf(stderr, "Value of option reuse-block-size has to be a power of two.\n");
+        exit(EXIT_FAILURE);
+    }
+    uint64_t window = 10000;
+    if (p.isSet("working-set-window")) { window = p.value("working-set-window").toULongLong(&ok); }
+    if (!ok) {
+        fprintf(stderr, "Value of option working-set-window is not a valid unsigned integer.\n");
+        exit(EXIT_FAILURE);
+    }
+    auto analysis = std::make_unique<ReuseAnalysis>(machine.symbol_table(), block_size, window);
+    machine.add_memory_access_observer(analysis.get());
+    return analysis;
+}
+
+void write_output_file(const QString &path, const std::function<void(QTextStream &)> &write) {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        fprintf(stderr, "Cannot open %s for writing.\n", qPrintable(path));
+        return;
+    }
+    QTextStream out(&file);
+    write(out);
+}
+
+/** Writes JSON when the file name ends with .json, CSV otherwise. */
+void write_analysis_file(
+    const QString &path,
+    const std::function<void(QTextStream &)> &write_csv,
+    const std::function<void(QTextStream &)> &write_json) {
+    write_output_file(
+        path, path.endsWith(".json", Qt::CaseInsensitive) ? write_json : write_csv);
+}
+
+void write_reuse_analysis(QCommandLineParser &p, const ReuseAnalysis &analysis) {
+    if (p.isSet("reuse-histogram")) {
+        write_analysis_file(
+            p.value("reuse-histogram"),
+            [&](QTextStream &out) { analysis.write_reuse_csv(out); },
+            [&](QTextStream &out) { analysis.write_reuse_json(out); });
+    }
+    if (p.isSet("working-set")) {
+        write_analysis_file(
+            p.value("working-set"),
+            [&](QTextStream &out) { analysis.write_working_set_csv(out); },
+            [&](QTextStream &out) { analysis.write_working_set_json(out); });
+    }
+}
+
+/** Feeds every step of the core with the current cache miss counts to the profile. */
+template<typename Profile>
+void record_profile_steps(Machine &machine, Profile *profile) {
+    const Cache *cache_program = machine.cache_program();
+    const Cache *cache_data = machine.cache_data();
+    QObject::connect(
+        machine.core(), &Core::step_done,
+        [profile, cache_program, cache_data](const CoreState &state) {
+            profile->record_step(
+                state, cache_program->get_miss_count(), cache_data->get_miss_count());
+        });
+}
+
+std::unique_ptr<FlatProfile> create_profile(QCommandLineParser &p, Machine &machine) {
+    if (!p.isSet("profile") && !p.isSet("profile-callgrind") && !p.isSet("profile-folded")) {
+        return nullptr;
+    }
+    auto profile = std::make_unique<FlatProfile>();
+    record_profile_steps(machine, profile.get());
+    return profile;
+}
+
+void write_profile(QCommandLineParser &p, const FlatProfile &profile, const SymbolTable *symtab) {
+    if (p.isSet("profile-callgrind")) {
+        write_output_file(p.value("profile-callgrind"), [&](QTextStream &out) {
+            profile.write_callgrind(out, symtab);
+        });
+    }
+    if (p.isSet("profile-folded")) {
+        write_output_file(p.value("profile-folded"), [&](QTextStream &out) {
+            profile.write_folded(out, symtab);
+        });
+    }
+}
+
+std::unique_ptr<CallProfile> create_call_profile(QCommandLineParser &p, Machine &machine) {
+    if (!p.isSet("profile-calls") && !p.isSet("profile-calls-callgrind")
+        && !p.isSet("profile-calls-folded")) {
+        return nullptr;
+    }
+    auto profile = std::make_unique<CallProfile>(machine.symbol_table(), machine.control_state());
+    record_profile_steps(machine, profile.get());
+    return profile;
+}
+
+void write_call_profile(QCommandLineParser &p, const CallProfile &profile) {
+    if (p.isSet("profile-calls-callgrind")) {
+        write_output_file(p.value("profile-calls-callgrind"), [&](QTextStream &out) {
+            profile.write_callgrind(out);
+        });
+    }
+    if (p.isSet("profile-calls-folded")) {
+        write_output_file(p.value("profile-calls-folded"), [&](QTextStream &out) {
+            profile.write_folded(out);
+        });
+    }
+}
+
+std::unique_ptr<MissProfile> create_miss_profile(QCommandLineParser &p, Machine &machine) {
+    if (!p.isSet("profile-misses")) { return nullptr; }
+    Cache *cache_data = machine.cache_data_rw();
+    auto profile = std::make_unique<MissProfile>(machine.symbol_table(), cache_data->get_config());
+    machine.add_memory_access_observer(profile.get());
+    cache_data->set_miss_observer(profile.get());
+    return profile;
+}
+
+std::unique_ptr<PipelineView> create_pipeline_view(QCommandLineParser &p, Machine &machine) {
+    if (!p.isSet("pipeline-view")) { return nullptr; }
+    if (!machine.config().pipelined()) {
+        fprintf(stderr, "Pipeline view requires the pipelined core (--pipelined)\n");
+        exit(EXIT_FAILURE);
+    }
+    uint64_t from_cycle = 0;
+    uint64_t to_cycle = UINT64_MAX;
+    if (p.isSet("pipeline-view-cycles")) {
+        const QStringList range = p.value("pipeline-view-cycles").split(':');
+        bool ok1 = range.size() == 2, ok2 = ok1;
+        if (ok1 && !range[0].isEmpty()) { from_cycle = range[0].toULongLong(&ok1, 0); }
+        if (ok2 && !range[1].isEmpty()) { to_cycle = range[1].toULongLong(&ok2, 0); }
+        if (!ok1 || !ok2) {
+            fprintf(stderr, "Pipeline view cycle range specification error.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    try {
+        return std::make_unique<PipelineView>(
+            machine.core(), p.value("pipeline-view"), from_cycle, to_cycle);
+    } catch (SimulatorException &e) {
+        fprintf(stderr, "%s\n", qPrintable(e.msg(false)));
+        exit(EXIT_FAILURE);
+    }
+}
+
+std::unique_ptr<StateDigestWriter> create_state_digest(QCommandLineParser &p, Machine &machine) {
+    if (!p.isSet("state-digest")) { return nullptr; }
+    uint64_t interval = 100000;
+    if (p.isSet("state-digest-interval")) {
+        bool ok;
+        interval = p.value("state-digest-interval").toULongLong(&ok);
+        if (!ok || interval == 0) {
+            fprintf(stderr, "State digest interval has to be a positive number\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    try {
+        return std::make_unique<StateDigestWriter>(&machine, p.value("state-digest"), interval);
+    } catch (SimulatorException &e) {
+        fprintf(stderr, "%s\n", qPrintable(e.msg(false)));
+        exit(EXIT_FAILURE);
+    }
+}
+
+std::unique_ptr<FlightRecorder> create_flight_recorder(QCommandLineParser &p, Machine &machine) {
+    size_t capacity = 4096;
+    if (p.isSet("flight-recorder")) {
+        bool ok;
+        capacity = p.value("flight-recorder").toULong(&ok);
+        if (!ok) {
+            fprintf(stderr, "Flight recorder size parse error\n");
+            exit(EXIT_FAILURE);
+        }
+        if (capacity > FlightRecorder::MAX_CAPACITY) {
+            fprintf(
+                stderr, "Flight recorder can keep at most %zu cycles\n",
+                FlightRecorder::MAX_CAPACITY);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (capacity == 0) { return nullptr; }
+    auto recorder = std::make_unique<FlightRecorder>(&machine, capacity);
+    if (p.isSet("flight-recorder-text")) {
+        recorder->set_text_path(p.value("flight-recorder-text"));
+    }
+    if (p.isSet("flight-recorder-binary")) {
+        recorder->set_binary_path(p.value("flight-recorder-binary"));
+    }
+    return recorder;
+}
+
 void parse_u32_option(
     QCommandLineParser &parser,
     const QString &option_name,
@@ -190,10 +657,28 @@ void configure_machine(QCommandLineParser &parser, MachineConfig &config) {
     parse_u32_option(parser, "write-time", config, &MachineConfig::set_memory_access_time_write);
     parse_u32_option(parser, "burst-time", config, &MachineConfig::set_memory_access_time_burst);
     if (!parser.values("burst-time").empty()) config.set_memory_access_enable_burst(true);
+    parse_u32_option(
+        parser, "memory-section-size", config, &MachineConfig::set_memory_section_size);
+    if (!Memory::is_valid_section_size(config.memory_section_size())) {
+        fprintf(stderr, "Memory section size has to be a power of two from 256 to 2097152.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (const QString &spec : parser.values("map-file")) {
+        FileMappingConfig mapping;
+        if (!FileMappingConfig::from_string(spec, mapping)) {
+            fprintf(stderr, "File mapping specification error: %s\n", qPrintable(spec));
+            exit(EXIT_FAILURE);
+        }
+        config.add_file_mapping(mapping);
+    }
 
     configure_cache(*config.access_cache_data(), parser.values("d-cache"), "data");
     configure_cache(*config.access_cache_program(), parser.values("i-cache"), "instruction");
     configure_cache(*config.access_cache_level2(), parser.values("l2-cache"), "level2");
+    configure_tlb(*config.access_tlb_data(), parser.values("d-tlb"), "data");
+    configure_tlb(*config.access_tlb_program(), parser.values("i-tlb"), "instruction");
+    parse_u32_option(
+        parser, "page-walk-cache", config, &MachineConfig::set_page_walk_cache_size);
 
     config.set_osemu_enable(parser.isSet("os-emulation"));
     config.set_osemu_known_syscall_stop(false);
@@ -240,26 +725,26 @@ void configure_machine(QCommandLineParser &parser, MachineConfig &config) {
 }
 
 void configure_tracer(QCommandLineParser &p, Tracer &tr) {
-    if (p.isSet("trace-fetch")) { tr.trace_fetch = true; }
+    if (p.isSet("trace-fetch")) { tr.text.trace_fetch = true; }
     if (p.isSet("pipelined")) { // Following are added only if we have stages
-        if (p.isSet("trace-decode")) { tr.trace_decode = true; }
-        if (p.isSet("trace-execute")) { tr.trace_fetch = true; }
-        if (p.isSet("trace-memory")) { tr.trace_memory = true; }
-        if (p.isSet("trace-writeback")) { tr.trace_writeback = true; }
+        if (p.isSet("trace-decode")) { tr.text.trace_decode = true; }
+        if (p.isSet("trace-execute")) { tr.text.trace_fetch = true; }
+        if (p.isSet("trace-memory")) { tr.text.trace_memory = true; }
+        if (p.isSet("trace-writeback")) { tr.text.trace_writeback = true; }
     }
 
-    if (p.isSet("trace-pc")) { tr.trace_pc = true; }
-    if (p.isSet("trace-gp")) { tr.trace_regs_gp = true; }
+    if (p.isSet("trace-pc")) { tr.text.trace_pc = true; }
+    if (p.isSet("trace-gp")) { tr.text.trace_regs_gp = true; }
 
     QStringList gps = p.values("trace-gp");
     for (const auto & gp : gps) {
         if (gp == "*") {
-            tr.regs_to_trace.fill(true);
+            tr.text.regs_to_trace.fill(true);
         } else {
             bool res;
             size_t num = gp.toInt(&res);
             if (res && num <= machine::REGISTER_COUNT) {
-                tr.regs_to_trace.at(num) = true;
+                tr.text.regs_to_trace.at(num) = true;
             } else {
                 fprintf(
                     stderr, "Unknown register number given for trace-gp: %s\n", qPrintable(gp));
@@ -268,8 +753,17 @@ void configure_tracer(QCommandLineParser &p, Tracer &tr) {
         }
     }
 
-    if (p.isSet("trace-rdmem")) { tr.trace_rdmem = true; }
-    if (p.isSet("trace-wrmem")) { tr.trace_wrmem = true; }
+    if (p.isSet("trace-rdmem")) { tr.text.trace_rdmem = true; }
+    if (p.isSet("trace-wrmem")) { tr.text.trace_wrmem = true; }
+
+    if (p.isSet("trace-binary")) {
+        try {
+            tr.enable_binary_trace(p.value("trace-binary"));
+        } catch (SimulatorException &e) {
+            fprintf(stderr, "%s\n", qPrintable(e.msg(false)));
+            exit(EXIT_FAILURE);
+        }
+    }
 
     QStringList clim = p.values("cycle-limit");
     if (!clim.empty()) {
@@ -289,6 +783,9 @@ void configure_reporter(QCommandLineParser &p, Reporter &r, const SymbolTable *s
     if (p.isSet("dump-registers")) { r.enable_regs_reporting(); }
     if (p.isSet("dump-cache-stats")) { r.enable_cache_stats(); }
     if (p.isSet("dump-cycles")) { r.enable_cycles_reporting(); }
+    if (p.isSet("dump-cpi-stack")) { r.enable_cpi_stack_reporting(); }
+    if (p.isSet("cpi-stack-json")) { r.enable_cpi_stack_json(p.value("cpi-stack-json")); }
+    if (p.isSet("dump-roi-stats")) { r.enable_roi_stats_reporting(); }
 
     QStringList fail = p.values("fail-match");
     for (const auto & i : fail) {
@@ -305,6 +802,18 @@ void configure_reporter(QCommandLineParser &p, Reporter &r, const SymbolTable *s
     }
     if (p.isSet("expect-fail") && !p.isSet("fail-match")) { r.expect_fail(Reporter::FailAny); }
 
+    Reporter::DumpFormat dump_format = Reporter::DUMP_TEXT;
+    if (p.isSet("dump-range-format")) {
+        const QString format = p.value("dump-range-format").toLower();
+        if (format == "image") {
+            dump_format = Reporter::DUMP_IMAGE;
+        } else if (format == "image-lz") {
+            dump_format = Reporter::DUMP_IMAGE_LZ;
+        } else if (format != "text") {
+            fprintf(stderr, "Unknown dump range format: %s\n", qPrintable(format));
+            exit(EXIT_FAILURE);
+        }
+    }
     foreach (QString range_arg, p.values("dump-range")) {
         uint64_t len;
         bool ok1 = true;
@@ -339,7 +848,34 @@ void configure_reporter(QCommandLineParser &p, Reporter &r, const SymbolTable *s
             fprintf(stderr, "Range start/length specification error.\n");
             exit(EXIT_FAILURE);
         }
-        r.add_dump_range(start, len, range_arg.mid(comma2 + 1));
+        r.add_dump_range(start, len, range_arg.mid(comma2 + 1), dump_format);
+    }
+
+    if (p.isSet("memory-diff-from")) {
+        QString str = p.value("memory-diff-from");
+        bool ok;
+        Address from;
+        if (str.size() >= 1 && !str.at(0).isDigit() && symtab != nullptr) {
+            SymbolValue _from;
+            ok = symtab->name_to_value(_from, str);
+            from = Address(_from);
+        } else {
+            from = Address(str.toULong(&ok, 0));
+        }
+        if (!ok) {
+            fprintf(stderr, "Memory diff start address specification error.\n");
+            exit(EXIT_FAILURE);
+        }
+        r.enable_memory_diff_from(from, p.isSet("memory-diff-hex"));
+    } else if (p.isSet("memory-diff")) {
+        r.enable_memory_diff(p.isSet("memory-diff-hex"));
+    }
+
+    for (const QString &find_arg : p.values("find")) {
+        if (!r.add_find_pattern(find_arg)) {
+            fprintf(stderr, "Invalid search pattern: %s\n", qPrintable(find_arg));
+            exit(EXIT_FAILURE);
+        }
     }
 
     // TODO
@@ -395,12 +931,16 @@ void configure_serial_port(QCommandLineParser &p, SerialPort *ser_port) {
     }
 }
 
-void configure_osemu(QCommandLineParser &p, MachineConfig &config, Machine *machine) {
+void configure_osemu(
+    QCommandLineParser &p,
+    MachineConfig &config,
+    Machine *machine,
+    bool connect_std_out = true) {
     CharIOHandler *std_out = nullptr;
     int siz;
 
     siz = p.values("std-out").size();
-    if (siz >= 1) {
+    if (siz >= 1 && connect_std_out) {
         auto *qf = new QFile(p.values("std-out").at(siz - 1));
         std_out = new CharIOHandler(qf, machine);
         if (!std_out->open(QFile::WriteOnly)) {
@@ -458,8 +998,18 @@ void load_ranges(Machine &machine, const QStringList &ranges) {
             fprintf(stderr, "Range start/length specification error.\n");
             exit(EXIT_FAILURE);
         }
+        const QString path = range_arg.mid(comma1 + 1);
+        if (is_memory_image(path)) {
+            try {
+                load_memory_image(path, machine.memory_data_bus_rw(), start);
+            } catch (SimulatorException &e) {
+                fprintf(stderr, "%s\n", qPrintable(e.msg(false)));
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
         ifstream in;
-        in.open(range_arg.mid(comma1 + 1).toLocal8Bit().data(), ios::in);
+        in.open(path.toLocal8Bit().data(), ios::in);
         Address addr = start;
         for (std::string line; getline(in, line);) {
             size_t end_pos = line.find_last_not_of(" \t\n");
@@ -502,6 +1052,32 @@ bool assemble(Machine &machine, MsgReport &msgrep, const QString &filename) {
     return assembler.finish();
 }
 
+/**
+ * Machine running the same program as the simulated one on the core selected by `--cosim`.
+ * Its system calls are emulated too, but their output is discarded.
+ */
+std::unique_ptr<Machine>
+create_cosim_reference(QCommandLineParser &p, MachineConfig config, bool asm_source) {
+    const QString kind = p.value("cosim").toLower();
+    if (kind == "single") {
+        config.set_pipelined(false);
+    } else {
+        config.set_pipelined(true);
+        if (kind != "pipelined" && !config.set_hazard_unit(kind)) {
+            fprintf(stderr, "Unknown kind of co-simulation core specified\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    auto reference = std::make_unique<Machine>(config, !asm_source, !asm_source);
+    configure_osemu(p, config, reference.get(), false);
+    if (asm_source) {
+        MsgReport msg_report(QCoreApplication::instance());
+        if (!assemble(*reference, msg_report, p.positionalArguments()[0])) { exit(EXIT_FAILURE); }
+    }
+    load_ranges(*reference, p.values("load-range"));
+    return reference;
+}
+
 int main(int argc, char *argv[]) {
     QCoreApplication app(argc, argv);
     QCoreApplication::setApplicationName(APP_NAME);
@@ -512,6 +1088,8 @@ int main(int argc, char *argv[]) {
     create_parser(p);
     p.process(app);
 
+    if (p.isSet("sweep-trace")) { return run_cache_sweep(p); }
+
     MachineConfig config;
     configure_machine(p, config);
 
@@ -525,18 +1103,70 @@ int main(int argc, char *argv[]) {
 
     configure_osemu(p, config, &machine);
 
+    std::unique_ptr<AccessTraceWriter> access_trace;
+    if (p.isSet("record-access-trace")) {
+        try {
+            access_trace = std::make_unique<AccessTraceWriter>(p.value("record-access-trace"));
+        } catch (SimulatorException &e) {
+            fprintf(stderr, "%s\n", qPrintable(e.msg(false)));
+            exit(EXIT_FAILURE);
+        }
+        machine.add_memory_access_observer(access_trace.get());
+    }
+
+    std::unique_ptr<PipelineView> pipeline_view = create_pipeline_view(p, machine);
+
+    std::unique_ptr<CommitLog> commit_log;
+    if (p.isSet("log-commits")) {
+        try {
+            commit_log = std::make_unique<CommitLog>(&machine, p.value("log-commits"));
+        } catch (SimulatorException &e) {
+            fprintf(stderr, "%s\n", qPrintable(e.msg(false)));
+            exit(EXIT_FAILURE);
+        }
+    }
+
     if (asm_source) {
         MsgReport msg_report(&app);
         if (!assemble(machine, msg_report, p.positionalArguments()[0])) { exit(EXIT_FAILURE); }
     }
 
+    // Memory diff compares with the memory after loading.
+    load_ranges(machine, p.values("load-range"));
+
+    // Symbols are known after the program is loaded.
+    std::unique_ptr<ReuseAnalysis> reuse_analysis = create_reuse_analysis(p, machine);
+    std::unique_ptr<FlatProfile> profile = create_profile(p, machine);
+    std::unique_ptr<CallProfile> call_profile = create_call_profile(p, machine);
+    std::unique_ptr<MissProfile> miss_profile = create_miss_profile(p, machine);
+
     Reporter r(&app, &machine);
     configure_reporter(p, r, machine.symbol_table());
+    std::unique_ptr<FlightRecorder> flight_recorder = create_flight_recorder(p, machine);
+    std::unique_ptr<StateDigestWriter> state_digest = create_state_digest(p, machine);
+    if (flight_recorder != nullptr) { r.enable_flight_recorder(flight_recorder.get()); }
+    if (profile != nullptr && p.isSet("profile")) { r.enable_profile(profile.get()); }
+    if (call_profile != nullptr && p.isSet("profile-calls")) {
+        r.enable_call_profile(call_profile.get());
+    }
+    if (miss_profile != nullptr) { r.enable_miss_profile(miss_profile.get()); }
 
     QObject::connect(&tr, &Tracer::cycle_limit_reached, &r, &Reporter::cycle_limit_reached);
 
-    load_ranges(machine, p.values("load-range"));
+    std::unique_ptr<CoSimulation> cosim;
+    if (p.isSet("cosim")) {
+        cosim = std::make_unique<CoSimulation>(
+            &machine, create_cosim_reference(p, config, asm_source));
+        QObject::connect(
+            cosim.get(), &CoSimulation::divergence_found, &r, &Reporter::cosim_divergence);
+    }
 
     machine.play();
-    return QCoreApplication::exec();
+    int ret = QCoreApplication::exec();
+
+    if (reuse_analysis != nullptr) { write_reuse_analysis(p, *reuse_analysis); }
+    if (profile != nullptr) { write_profile(p, *profile, machine.symbol_table()); }
+    if (call_profile != nullptr) { write_call_profile(p, *call_profile); }
+    if (state_digest != nullptr) { state_digest->finish(); }
+    return ret;
 }
@@ -0,0 +1,168 @@
+#include "pipeline_view.h"
+
+#include "machine/simulator_exception.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <iterator>
+
+using namespace machine;
+
+static constexpr size_t PIPELINE_VIEW_BUFFER_SIZE = 1 << 20;
+static constexpr const char *STAGE_NAMES[] = { "F", "D", "E", "M", "W" };
+
+PipelineView::PipelineView(
+    const Core *core,
+    const QString &path,
+    uint64_t from_cycle,
+    uint64_t to_cycle)
+    : path(path)
+    , file(fopen(path.toLocal8Bit().data(), "w"))
+    , from_cycle(from_cycle)
+    , to_cycle(to_cycle) {
+    if (file == nullptr) {
+        throw SIMULATOR_EXCEPTION(Input, "Cannot open pipeline view file for writing", path);
+    }
+    buffer.reserve(PIPELINE_VIEW_BUFFER_SIZE + 4096);
+    buffer += "Kanata\t0004\n";
+    connect(core, &Core::step_done, this, &PipelineView::step_done);
+}
+
+PipelineView::~PipelineView() {
+    if (!pending_leave.empty() || !in_flight.empty()) {
+        set_cycle(cycle + 1);
+        write_leaves();
+        for (const auto &item : in_flight) {
+            const std::string id = std::to_string(item.second.id);
+            buffer += "E\t" + id + "\t0\t" + STAGE_NAMES[item.second.stage] + "\n";
+            buffer += "R\t" + id + "\t0\t1\n";
+        }
+    }
+    flush_buffer();
+    if (fclose(file) != 0 || write_failed) {
+        fprintf(stderr, "Failure writing pipeline view %s\n", path.toLocal8Bit().data());
+    }
+}
+
+void PipelineView::set_cycle(uint64_t new_cycle) {
+    if (!started) {
+        buffer += "C=\t" + std::to_string(new_cycle) + "\n";
+        started = true;
+    } else if (new_cycle != cycle) {
+        buffer += "C\t" + std::to_string(new_cycle - cycle) + "\n";
+    }
+    cycle = new_cycle;
+}
+
+void PipelineView::step_done(const CoreState &state) {
+    const uint64_t now = state.cycle_count;
+    if (now < from_cycle || (now > to_cycle && pending_leave.empty())) { return; }
+    set_cycle(now);
+    write_leaves();
+    if (now > to_cycle) { return; } // Instructions still in flight are ended by the destructor.
+
+    const Pipeline &p = state.pipeline;
+    enter_stage(p.fetch.result.seq, FETCH, p.fetch.result.inst_addr, p.fetch.result.inst);
+    enter_stage(p.decode.result.seq, DECODE, p.decode.result.inst_addr, p.decode.result.inst);
+    enter_stage(
+        p.execute.result.seq, EXECUTE, p.execute.result.inst_addr, p.execute.result.inst);
+    enter_stage(p.memory.result.seq, MEMORY, p.memory.result.inst_addr, p.memory.result.inst);
+    enter_stage(
+        p.writeback.internal.seq, WRITEBACK, p.writeback.internal.inst_addr,
+        p.writeback.internal.inst);
+
+    if (p.memory.result.excause != EXCAUSE_NONE) {
+        auto iter = in_flight.find(p.memory.result.seq);
+        if (iter != in_flight.end()) { iter->second.failed = true; }
+    }
+    if (p.decode.final.stall) {
+        auto iter = in_flight.find(p.decode.result.seq);
+        if (iter != in_flight.end() && !iter->second.stall_noted) {
+            buffer += "L\t" + std::to_string(iter->second.id) + "\t1\tstall: "
+                      + cpi_component_name(p.decode.final.bubble_cause) + " \n";
+            iter->second.stall_noted = true;
+        }
+    }
+    leave_pipeline(state);
+
+    if (buffer.size() >= PIPELINE_VIEW_BUFFER_SIZE) { flush_buffer(); }
+}
+
+void PipelineView::enter_stage(
+    uint64_t seq,
+    Stage stage,
+    Address inst_addr,
+    const Instruction &inst) {
+    if (seq == 0) { return; } // Bubble
+    auto iter = in_flight.find(seq);
+    if (iter == in_flight.end()) {
+        if (stage != FETCH) { return; } // Fetched before the recorded cycles.
+        const std::string id = std::to_string(next_id);
+        in_flight.emplace(seq, InFlight { next_id++, stage });
+        char addr[24];
+        snprintf(addr, sizeof(addr), "%08" PRIx64 ": ", inst_addr.get_raw());
+        buffer += "I\t" + id + "\t" + std::to_string(seq) + "\t0\n";
+        buffer += "L\t" + id + "\t0\t" + addr + inst.to_str(inst_addr).toStdString() + "\n";
+        buffer += "S\t" + id + "\t0\t" + STAGE_NAMES[stage] + "\n";
+        return;
+    }
+    InFlight &instruction = iter->second;
+    if (instruction.stage == stage) { return; } // Stalled
+    const std::string id = std::to_string(instruction.id);
+    buffer += "E\t" + id + "\t0\t" + STAGE_NAMES[instruction.stage] + "\n";
+    buffer += "S\t" + id + "\t0\t" + STAGE_NAMES[stage] + "\n";
+    instruction.stage = stage;
+    instruction.stall_noted = false;
+}
+
+void PipelineView::leave_pipeline(const CoreState &state) {
+    const Pipeline &p = state.pipeline;
+    // Interstage registers after the stage, they hold the instructions for the next cycle.
+    // Instruction stalled in decode is kept in the register before it.
+    const uint64_t kept[STAGE_COUNT]
+        = { p.fetch.final.seq, p.decode.final.seq, p.execute.final.seq, p.memory.final.seq, 0 };
+    const CpiComponent causes[STAGE_COUNT]
+        = { p.fetch.final.bubble_cause, p.decode.final.bubble_cause,
+            p.execute.final.bubble_cause, p.memory.final.bubble_cause, CpiComponent::BASE };
+    for (auto iter = in_flight.begin(); iter != in_flight.end();) {
+        const uint64_t seq = iter->first;
+        if (std::find(std::begin(kept), std::end(kept), seq) != std::end(kept)) {
+            ++iter;
+            continue;
+        }
+        const InFlight &instruction = iter->second;
+        const Stage stage = instruction.stage;
+        Leave leave { instruction.id, stage, false, {} };
+        if (stage == WRITEBACK) {
+            leave.retired = !instruction.failed;
+            if (instruction.failed) { leave.note = "exception"; }
+        } else if (kept[stage] != 0) {
+            leave.note = "fetch repeated after stall";
+        } else {
+            leave.note = std::string("flush: ") + cpi_component_name(causes[stage]);
+        }
+        pending_leave.push_back(std::move(leave));
+        iter = in_flight.erase(iter);
+    }
+}
+
+void PipelineView::write_leaves() {
+    for (const Leave &leave : pending_leave) {
+        const std::string id = std::to_string(leave.id);
+        if (!leave.note.empty()) { buffer += "L\t" + id + "\t1\t" + leave.note + " \n"; }
+        buffer += "E\t" + id + "\t0\t" + STAGE_NAMES[leave.stage] + "\n";
+        if (leave.retired) {
+            buffer += "R\t" + id + "\t" + std::to_string(next_retire_id++) + "\t0\n";
+        } else {
+            buffer += "R\t" + id + "\t0\t1\n";
+        }
+    }
+    pending_leave.clear();
+}
+
+void PipelineView::flush_buffer() {
+    if (!write_failed && fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+        write_failed = true;
+    }
+    buffer.clear();
+}
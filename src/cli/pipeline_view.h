@@ -0,0 +1,92 @@
+#ifndef PIPELINE_VIEW_H
+#define PIPELINE_VIEW_H
+
+#include "machine/core.h"
+
+#include <QObject>
+#include <QString>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Streams occupancy of the pipeline stages by individual instructions in
+ * the Kanata log format of the Konata pipeline viewer.
+ *
+ * Instructions are told apart by the sequence number assigned at fetch
+ * (see `CoreState::fetch_seq`). An instruction is in a stage in the cycle
+ * when the stage processes it. When it stays there (stall), the stage
+ * gets longer. An instruction which leaves the pipeline anywhere other
+ * than after writeback is shown as flushed. This includes instructions
+ * fetched during a stall, which the core fetches again later. The hover
+ * text of the instruction gives the cause of stalls and flushes.
+ */
+class PipelineView final : public QObject {
+    Q_OBJECT
+public:
+    /**
+     * Only cycles in the inclusive range are written, instructions fetched
+     * before the first cycle are omitted.
+     * @throws SimulatorExceptionInput when the file cannot be opened
+     */
+    PipelineView(
+        const machine::Core *core,
+        const QString &path,
+        uint64_t from_cycle = 0,
+        uint64_t to_cycle = UINT64_MAX);
+    /**
+     * Ends instructions still in the pipeline as flushed and writes the rest
+     * of the log. Write errors are reported to stderr.
+     */
+    ~PipelineView() override;
+
+private slots:
+    void step_done(const machine::CoreState &state);
+
+private:
+    enum Stage { FETCH, DECODE, EXECUTE, MEMORY, WRITEBACK, STAGE_COUNT };
+
+    struct InFlight {
+        uint64_t id;
+        Stage stage;
+        bool failed = false;      //> Raised exception in the memory stage
+        bool stall_noted = false; //> Stall in the current stage is in the hover text
+    };
+
+    /** Instruction which left the pipeline, it is ended in the next cycle. */
+    struct Leave {
+        uint64_t id;
+        Stage stage;
+        bool retired;
+        std::string note;
+    };
+
+    void enter_stage(
+        uint64_t seq,
+        Stage stage,
+        machine::Address inst_addr,
+        const machine::Instruction &inst);
+    /** Find instructions which did not stay in any interstage register. */
+    void leave_pipeline(const machine::CoreState &state);
+    void write_leaves();
+    void set_cycle(uint64_t cycle);
+    void flush_buffer();
+
+    const QString path;
+    FILE *file;
+    std::string buffer;
+    bool write_failed = false; //> Later writes are skipped, reported by the destructor
+    const uint64_t from_cycle;
+    const uint64_t to_cycle;
+    bool started = false;
+    uint64_t cycle = 0;
+    uint64_t next_id = 0;
+    uint64_t next_retire_id = 0;
+    /** Instructions by sequence number. */
+    std::map<uint64_t, InFlight> in_flight;
+    std::vector<Leave> pending_leave;
+};
+
+#endif // PIPELINE_VIEW_H
@@ -1,6 +1,10 @@
 #include "reporter.h"
 
+#include "machine/memory/memory_image.h"
+
+#include <algorithm>
 #include <cinttypes>
+#include <vector>
 
 using namespace machine;
 using namespace std;
@@ -16,17 +20,31 @@ Reporter::Reporter(QCoreApplication *app, Machine *machine)
         &Reporter::machine_exception_reached);
 }
 
-void Reporter::add_dump_range(Address start, size_t len, const QString &path_to_write) {
-    dump_ranges.append({ start, len, path_to_write });
+void Reporter::add_dump_range(
+    Address start,
+    size_t len,
+    const QString &path_to_write,
+    DumpFormat format) {
+    dump_ranges.append({ start, len, path_to_write, format });
+}
+
+bool Reporter::add_find_pattern(const QString &spec) {
+    FindPattern find { spec, {} };
+    if (!MemorySearchPattern::parse(spec, machine->config().get_simulated_endian(), find.pattern)) {
+        return false;
+    }
+    find_patterns.append(find);
+    return true;
 }
 
 void Reporter::machine_exit() {
     report();
     if (e_fail != 0) {
         printf("Machine was expected to fail but it didn't.\n");
+        if (flight_recorder != nullptr) { flight_recorder->dump("unexpected exit"); }
         QCoreApplication::exit(1);
     } else {
-        QCoreApplication::exit();
+        QCoreApplication::exit(static_cast<int>(machine->get_exit_code()));
     }
 }
 
@@ -58,6 +76,28 @@ constexpr const char *get_exception_name(ExceptionCause exception_cause) {
     }
 }
 
+void Reporter::enable_memory_diff(bool hexdump) {
+    e_memory_diff = true;
+    e_memory_diff_hexdump = hexdump;
+    // Copy shares all sections, it is cheap.
+    memory_snapshot = machine->memory_with_cached_data();
+}
+
+void Reporter::enable_memory_diff_from(Address from_pc, bool hexdump) {
+    e_memory_diff = true;
+    e_memory_diff_hexdump = hexdump;
+    memory_diff_watch.pc = from_pc;
+    // Observers must not access the memory, snapshot is taken after the step.
+    machine->add_memory_access_observer(&memory_diff_watch);
+    connect(machine->core(), &Core::step_done, this, &Reporter::memory_diff_step);
+}
+
+void Reporter::memory_diff_step() {
+    if (!memory_diff_watch.reached) { return; }
+    disconnect(machine->core(), &Core::step_done, this, &Reporter::memory_diff_step);
+    memory_snapshot = machine->memory_with_cached_data();
+}
+
 void Reporter::machine_exception_reached() {
     ExceptionCause excause = machine->get_exception_cause();
     printf("Machine stopped on %s exception.\n", get_exception_name(excause));
@@ -71,6 +111,12 @@ void Reporter::cycle_limit_reached() {
     QCoreApplication::exit();
 }
 
+void Reporter::cosim_divergence() {
+    report();
+    if (flight_recorder != nullptr) { flight_recorder->dump("co-simulation divergence"); }
+    QCoreApplication::exit(1);
+}
+
 void Reporter::machine_trap(SimulatorException &e) {
     report();
 
@@ -80,11 +126,12 @@ void Reporter::machine_trap(SimulatorException &e) {
     }
 
     printf("Machine trapped: %s\n", qPrintable(e.msg(false)));
+    if (flight_recorder != nullptr && !expected) { flight_recorder->dump("trap"); }
     QCoreApplication::exit(expected ? 0 : 1);
 }
 
 void Reporter::report() {
-    if (e_regs | e_cycles | e_cycles | e_fail) { printf("Machine state report:\n"); }
+    if (e_regs | e_cycles | e_cpi_stack | e_fail) { printf("Machine state report:\n"); }
 
     if (e_regs) { report_regs(); }
     if (e_cache_stats) { report_caches(); }
@@ -92,9 +139,19 @@ void Reporter::report() {
         printf("cycles: %" PRIu32 "\n", machine->core()->get_cycle_count());
         printf("stalls: %" PRIu32 "\n", machine->core()->get_stall_count());
     }
+    if (e_cpi_stack) { report_cpi_stack(); }
+    if (!cpi_stack_json_path.isEmpty()) { write_cpi_stack_json(); }
+    if (e_roi_stats) { report_roi_stats(); }
     for (const DumpRange &range : dump_ranges) {
         report_range(range);
     }
+    for (const FindPattern &find : find_patterns) {
+        report_find(find);
+    }
+    if (e_memory_diff) { report_memory_diff(); }
+    if (profile != nullptr) { report_profile(); }
+    if (call_profile != nullptr) { report_call_profile(); }
+    if (miss_profile != nullptr) { report_miss_profile(); }
 }
 
 void Reporter::report_regs() const {
@@ -125,6 +182,7 @@ void Reporter::report_caches() const {
     if (machine->config().cache_level2().enabled()) {
         report_cache("l2-cache", *machine->cache_level2());
     }
+    if (machine->mmu() != nullptr) { report_mmu(*machine->mmu()); }
 }
 
 void Reporter::report_cache(const char *cache_name, const Cache &cache) {
@@ -136,7 +194,109 @@ void Reporter::report_cache(const char *cache_name, const Cache &cache) {
     printf("%s:improved-speed: %.3lf\n", cache_name, cache.get_speed_improvement());
 }
 
+void Reporter::report_mmu(const Mmu &mmu) {
+    report_tlb("i-tlb", mmu.get_tlb_program());
+    report_tlb("d-tlb", mmu.get_tlb_data());
+    printf("page-walk:count: %" PRIu32 "\n", mmu.get_walk_count());
+    printf("page-walk:memory-reads: %" PRIu32 "\n", mmu.get_walk_memory_read_count());
+    printf("page-walk:cache-hit: %" PRIu32 "\n", mmu.get_walk_cache_hit_count());
+    printf("page-walk:cache-miss: %" PRIu32 "\n", mmu.get_walk_cache_miss_count());
+}
+
+void Reporter::report_tlb(const char *tlb_name, const Tlb &tlb) {
+    printf("%s:hit: %" PRIu32 "\n", tlb_name, tlb.get_hit_count());
+    printf("%s:miss: %" PRIu32 "\n", tlb_name, tlb.get_miss_count());
+    printf("%s:hit-rate: %.3lf\n", tlb_name, tlb.get_hit_rate());
+}
+
+void Reporter::report_cpi_stack() const {
+    const CpiStack &stack = machine->core()->get_cpi_stack();
+    const uint64_t retired = stack[static_cast<size_t>(CpiComponent::BASE)];
+    auto cpi = [&](uint64_t cycles) {
+        return (retired != 0) ? (double)cycles / (double)retired : 0.0;
+    };
+    printf("cpi: %.6f\n", cpi(machine->core()->get_cycle_count()));
+    for (size_t i = 0; i < CPI_COMPONENT_COUNT; i++) {
+        printf(
+            "cpi-%s: %" PRIu64 " %.6f\n", cpi_component_name(static_cast<CpiComponent>(i)),
+            stack[i], cpi(stack[i]));
+    }
+}
+
+void Reporter::write_cpi_stack_json() const {
+    FILE *out = fopen(cpi_stack_json_path.toLocal8Bit().data(), "w");
+    if (out == nullptr) {
+        fprintf(stderr, "Failed to open %s for writing\n", qPrintable(cpi_stack_json_path));
+        return;
+    }
+    const CpiStack &stack = machine->core()->get_cpi_stack();
+    const uint64_t cycles = machine->core()->get_cycle_count();
+    const uint64_t retired = stack[static_cast<size_t>(CpiComponent::BASE)];
+    auto cpi = [&](uint64_t part) {
+        return (retired != 0) ? (double)part / (double)retired : 0.0;
+    };
+    fprintf(
+        out, "{\n  \"cycles\": %" PRIu64 ",\n  \"retired\": %" PRIu64 ",\n  \"cpi\": %.6f,\n",
+        cycles, retired, cpi(cycles));
+    fprintf(out, "  \"components\": [");
+    for (size_t i = 0; i < CPI_COMPONENT_COUNT; i++) {
+        fprintf(
+            out, "%s\n    { \"name\": \"%s\", \"cycles\": %" PRIu64 ", \"cpi\": %.6f }",
+            (i == 0) ? "" : ",", cpi_component_name(static_cast<CpiComponent>(i)), stack[i],
+            cpi(stack[i]));
+    }
+    fprintf(out, "\n  ]\n}\n");
+    if (fclose(out)) { fprintf(stderr, "Failure closing %s\n", qPrintable(cpi_stack_json_path)); }
+}
+
+void Reporter::report_roi_stats() const {
+    const bool level2 = machine->config().cache_level2().enabled();
+    for (const StatsRegion &region : machine->stats_regions()) {
+        char prefix[32];
+        snprintf(
+            prefix, sizeof(prefix), "%s-%" PRIu32,
+            (region.kind == StatsRegion::ROI) ? "roi" : "dump", region.id);
+        const StatsSnapshot &stats = region.stats;
+        const uint64_t retired = stats.retired();
+        auto cpi = [&](uint64_t cycles) {
+            return (retired != 0) ? (double)cycles / (double)retired : 0.0;
+        };
+        printf("%s:count: %" PRIu64 "\n", prefix, region.count);
+        printf("%s:cycles: %" PRIu64 "\n", prefix, stats.cycles);
+        printf("%s:stalls: %" PRIu64 "\n", prefix, stats.stalls);
+        printf("%s:retired: %" PRIu64 "\n", prefix, retired);
+        printf("%s:cpi: %.6f\n", prefix, cpi(stats.cycles));
+        for (size_t i = 1; i < CPI_COMPONENT_COUNT; i++) {
+            if (stats.cpi_stack[i] == 0) { continue; }
+            printf(
+                "%s:cpi-%s: %" PRIu64 " %.6f\n", prefix,
+                cpi_component_name(static_cast<CpiComponent>(i)), stats.cpi_stack[i],
+                cpi(stats.cpi_stack[i]));
+        }
+        report_region_cache(prefix, "i-cache", stats.program_cache);
+        report_region_cache(prefix, "d-cache", stats.data_cache);
+        if (level2) { report_region_cache(prefix, "l2-cache", stats.level2_cache); }
+    }
+}
+
+void Reporter::report_region_cache(
+    const char *prefix,
+    const char *cache_name,
+    const CacheStats &cache) {
+    printf("%s:%s:hit: %" PRIu64 "\n", prefix, cache_name, cache.hits);
+    printf("%s:%s:miss: %" PRIu64 "\n", prefix, cache_name, cache.misses);
+    printf("%s:%s:stalled-cycles: %" PRIu64 "\n", prefix, cache_name, cache.stalled_cycles);
+}
+
 void Reporter::report_range(const Reporter::DumpRange &range) const {
+    if (range.format != DUMP_TEXT) {
+        try {
+            save_memory_image(
+                range.path_to_write, machine->cache_data(), range.start, range.len,
+                range.format == DUMP_IMAGE_LZ);
+        } catch (SimulatorException &e) { fprintf(stderr, "%s\n", qPrintable(e.msg(false))); }
+        return;
+    }
     FILE *out = fopen(range.path_to_write.toLocal8Bit().data(), "w");
     if (out == nullptr) {
         fprintf(
@@ -146,8 +306,8 @@ void Reporter::report_range(const Reporter::DumpRange &range) const {
     Address start = range.start & ~3;
     Address end = range.start + range.len;
     if (end < start) { end = 0xffffffff_addr; }
-    // TODO: report also cached memory?
-    const MemoryDataBus *mem = machine->memory_data_bus();
+    // Internal access reads data held in caches without side effects.
+    const FrontendMemory *mem = machine->cache_data();
     for (Address addr = start; addr < end; addr += 4) {
         fprintf(out, "0x%08" PRIx32 "\n", mem->read_u32(addr, ae::INTERNAL));
     }
@@ -155,3 +315,184 @@ void Reporter::report_range(const Reporter::DumpRange &range) const {
         fprintf(stderr, "Failure closing %s\n", range.path_to_write.toLocal8Bit().data());
     }
 }
+
+void Reporter::report_find(const FindPattern &find) const {
+    // Limits the output for patterns matching e.g. zeros.
+    constexpr size_t MAX_MATCHES = 1000;
+    std::vector<Offset> matches;
+    machine->memory_with_cached_data()->find(find.pattern, 0, matches, MAX_MATCHES + 1);
+    printf(
+        "find:%s: %zu%s\n", qPrintable(find.spec), std::min(matches.size(), MAX_MATCHES),
+        (matches.size() > MAX_MATCHES) ? "+" : "");
+    for (size_t i = 0; i < matches.size() && i < MAX_MATCHES; i++) {
+        printf("0x%08" PRIx64 "\n", matches[i]);
+    }
+}
+
+void Reporter::report_memory_diff() const {
+    if (memory_snapshot == nullptr) {
+        printf("memory-diff: start address 0x%08" PRIx64 " not reached\n",
+               memory_diff_watch.pc.get_raw());
+        return;
+    }
+    constexpr size_t MAX_RANGES = 10000;
+    // Hexdump is limited for each range.
+    constexpr Offset MAX_HEXDUMP_SIZE = 256;
+    std::vector<MemoryDiffRange> ranges;
+    const unique_ptr<Memory> memory = machine->memory_with_cached_data();
+    const bool complete = memory->diff(*memory_snapshot, ranges, MAX_RANGES);
+    printf("memory-diff: %zu%s\n", ranges.size(), complete ? "" : "+");
+    for (const MemoryDiffRange &range : ranges) {
+        printf(
+            "0x%08" PRIx64 "-0x%08" PRIx64 " (%" PRIu64 " bytes)\n", range.start, range.last,
+            range.last - range.start + 1);
+        if (!e_memory_diff_hexdump) { continue; }
+        const Offset last = std::min(range.last, range.start + MAX_HEXDUMP_SIZE - 1);
+        for (Offset row = range.start & ~(Offset)15; row <= last; row += 16) {
+            auto print_row = [&](char sign, const Memory *source) {
+                uint8_t data[16];
+                source->read(data, row, sizeof(data), { .type = ae::INTERNAL });
+                printf("%c0x%08" PRIx64 ":", sign, row);
+                for (Offset i = 0; i < sizeof(data); i++) {
+                    if (row + i < range.start || row + i > last) {
+                        printf("   ");
+                    } else {
+                        printf(" %02x", data[i]);
+                    }
+                }
+                printf("\n");
+            };
+            print_row('-', memory_snapshot.get());
+            print_row('+', memory.get());
+        }
+    }
+}
+
+void Reporter::report_profile() const {
+    static constexpr size_t MAX_INSTRUCTIONS = 20;
+    const ProfileCounters total = profile->get_total();
+    auto percent = [&](uint64_t cycles) {
+        return (total.cycles != 0) ? 100.0 * (double)cycles / (double)total.cycles : 0.0;
+    };
+
+    printf("Profile by symbol:\n");
+    printf(
+        "%12s %6s %12s %10s %8s %8s  %s\n", "cycles", "%", "retired", "stalls", "i-miss", "d-miss",
+        "symbol");
+    for (const ProfileSymbol &symbol : profile->by_symbol(machine->symbol_table())) {
+        const ProfileCounters &c = symbol.counters;
+        printf(
+            "%12" PRIu64 " %6.2f %12" PRIu64 " %10" PRIu64 " %8" PRIu64 " %8" PRIu64 "  %s\n",
+            c.cycles, percent(c.cycles), c.retired, c.stalls, c.program_misses, c.data_misses,
+            symbol.name.isEmpty() ? "[unknown]" : qPrintable(symbol.name));
+    }
+
+    std::vector<std::pair<Address, ProfileCounters>> instructions;
+    profile->for_each([&](Address pc, const ProfileCounters &counters) {
+        instructions.emplace_back(pc, counters);
+    });
+    const size_t count = std::min(instructions.size(), MAX_INSTRUCTIONS);
+    std::partial_sort(
+        instructions.begin(), instructions.begin() + count, instructions.end(),
+        [](const auto &a, const auto &b) { return a.second.cycles > b.second.cycles; });
+    printf("Profile by instruction (top %zu):\n", count);
+    for (size_t i = 0; i < count; i++) {
+        const Address pc = instructions[i].first;
+        const ProfileCounters &c = instructions[i].second;
+        const Instruction inst(machine->memory_data_bus()->read_u32(pc, ae::INTERNAL));
+        printf(
+            "%12" PRIu64 " %6.2f %12" PRIu64 " %10" PRIu64 " %8" PRIu64 " %8" PRIu64
+            "  0x%08" PRIx64 ": %s\n",
+            c.cycles, percent(c.cycles), c.retired, c.stalls, c.program_misses, c.data_misses,
+            pc.get_raw(), qPrintable(inst.to_str(pc)));
+    }
+}
+
+void Reporter::report_call_profile() const {
+    static constexpr size_t MAX_PATHS = 20;
+    std::vector<CallPath> paths = call_profile->get_paths();
+    uint64_t total_cycles = 0;
+    for (const CallPath &path : paths) {
+        if (path.frames.size() == 1) { total_cycles += path.inclusive.cycles; }
+    }
+    auto percent = [&](uint64_t cycles) {
+        return (total_cycles != 0) ? 100.0 * (double)cycles / (double)total_cycles : 0.0;
+    };
+
+    const size_t count = std::min(paths.size(), MAX_PATHS);
+    std::partial_sort(
+        paths.begin(), paths.begin() + count, paths.end(), [](const auto &a, const auto &b) {
+            return a.inclusive.cycles > b.inclusive.cycles;
+        });
+    printf("Profile by call path (top %zu):\n", count);
+    printf(
+        "%12s %6s %12s %10s %10s %8s %8s  %s\n", "cycles", "%", "self", "calls", "stalls",
+        "i-miss", "d-miss", "path");
+    for (size_t i = 0; i < count; i++) {
+        const CallPath &path = paths[i];
+        const ProfileCounters &c = path.inclusive;
+        QString frames;
+        for (const QString &frame : path.frames) {
+            frames += (frames.isEmpty() ? "" : " > ") + frame;
+        }
+        printf(
+            "%12" PRIu64 " %6.2f %12" PRIu64 " %10" PRIu64 " %10" PRIu64 " %8" PRIu64 " %8" PRIu64
+            "  %s\n",
+            c.cycles, percent(c.cycles), path.self.cycles, path.calls, c.stalls, c.program_misses,
+            c.data_misses, qPrintable(frames));
+    }
+}
+
+void Reporter::report_miss_profile() const {
+    static constexpr size_t MAX_INSTRUCTIONS = 20;
+    const MissCounters total = miss_profile->get_total();
+    auto percent = [](uint64_t part, uint64_t whole) {
+        return (whole != 0) ? 100.0 * (double)part / (double)whole : 0.0;
+    };
+
+    printf(
+        "Data cache misses: %" PRIu64 " of %" PRIu64 " accesses (compulsory %" PRIu64
+        ", capacity %" PRIu64 ", conflict %" PRIu64 ")\n",
+        total.misses, total.accesses, total.compulsory, total.capacity, total.conflict);
+
+    const std::vector<MissInstruction> instructions = miss_profile->by_instruction();
+    const size_t count = std::min(instructions.size(), MAX_INSTRUCTIONS);
+    printf("Data cache misses by instruction (top %zu):\n", count);
+    printf(
+        "%10s %6s %12s %7s %6s %6s %6s  %s\n", "misses", "%", "accesses", "rate", "comp%",
+        "cap%", "conf%", "instruction");
+    for (size_t i = 0; i < count && instructions[i].counters.misses != 0; i++) {
+        const MissInstruction &instruction = instructions[i];
+        const MissCounters &c = instruction.counters;
+        const Instruction inst(
+            machine->memory_data_bus()->read_u32(instruction.inst_addr, ae::INTERNAL));
+        printf(
+            "%10" PRIu64 " %6.2f %12" PRIu64 " %6.2f%% %6.1f %6.1f %6.1f  0x%08" PRIx64
+            ": %s%s\n",
+            c.misses, percent(c.misses, total.misses), c.accesses, percent(c.misses, c.accesses),
+            percent(c.compulsory, c.misses), percent(c.capacity, c.misses),
+            percent(c.conflict, c.misses), instruction.inst_addr.get_raw(),
+            qPrintable(inst.to_str(instruction.inst_addr)),
+            instruction.store ? (instruction.load ? " (load/store)" : " (store)") : "");
+    }
+
+    printf("Data cache misses by object:\n");
+    printf(
+        "%10s %6s %12s %7s %6s %6s %6s  %s\n", "misses", "%", "accesses", "rate", "comp%",
+        "cap%", "conf%", "object");
+    for (const MissObject &object : miss_profile->by_object()) {
+        const MissCounters &c = object.counters;
+        printf(
+            "%10" PRIu64 " %6.2f %12" PRIu64 " %6.2f%% %6.1f %6.1f %6.1f  ", c.misses,
+            percent(c.misses, total.misses), c.accesses, percent(c.misses, c.accesses),
+            percent(c.compulsory, c.misses), percent(c.capacity, c.misses),
+            percent(c.conflict, c.misses));
+        if (object.name.isEmpty()) {
+            printf("[unknown]\n");
+        } else {
+            printf(
+                "%s [0x%08" PRIx64 ", 0x%08" PRIx64 ")\n", qPrintable(object.name), object.start,
+                object.end);
+        }
+    }
+}
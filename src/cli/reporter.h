@@ -2,12 +2,18 @@
 #define REPORTER_H
 
 #include "common/memory_ownership.h"
+#include "flight_recorder.h"
+#include "machine/core/memory_access_observer.h"
 #include "machine/machine.h"
+#include "machine/profiler/call_profile.h"
+#include "machine/profiler/flat_profile.h"
+#include "machine/profiler/miss_profile.h"
 
 #include <QCoreApplication>
 #include <QObject>
 #include <QString>
 #include <QVector>
+#include <memory>
 
 using machine::Address;
 
@@ -24,6 +30,11 @@ public:
     void enable_regs_reporting() { e_regs = true; };
     void enable_cache_stats() { e_cache_stats = true; };
     void enable_cycles_reporting() { e_cycles = true; };
+    void enable_cpi_stack_reporting() { e_cpi_stack = true; };
+    /** Write the CPI stack to the file in JSON at program exit. */
+    void enable_cpi_stack_json(const QString &path) { cpi_stack_json_path = path; };
+    /** Print statistics of regions marked by the guest (see `machine::RoiControl`). */
+    void enable_roi_stats_reporting() { e_roi_stats = true; };
 
     enum FailReason {
         FR_NONE = 0,
@@ -32,39 +43,114 @@ public:
     static const enum FailReason FailAny = FR_UNSUPPORTED_INSTR;
     void expect_fail(enum FailReason reason) { e_fail = (FailReason)(e_fail | reason); };
 
+    enum DumpFormat {
+        DUMP_TEXT,     //> One hexadecimal word per line
+        DUMP_IMAGE,    //> Sparse binary image, see `save_memory_image`
+        DUMP_IMAGE_LZ, //> Sparse binary image with compressed content
+    };
+
     struct DumpRange {
         Address start;
         size_t len;
         /** Path to file, where this range will be dumped. */
         QString path_to_write;
+        DumpFormat format;
+    };
+    void add_dump_range(
+        Address start,
+        size_t len,
+        const QString &path_to_write,
+        DumpFormat format = DUMP_TEXT);
+
+    struct FindPattern {
+        QString spec;
+        machine::MemorySearchPattern pattern;
     };
-    void add_dump_range(Address start, size_t len, const QString &path_to_write);
+    /**
+     * Search memory for the pattern at program exit.
+     * @return false when the specification is invalid (see `MemorySearchPattern::parse`)
+     */
+    bool add_find_pattern(const QString &spec);
+
+    /**
+     * Report memory ranges changed since now (or since the first instruction at `from_pc` retired)
+     * at program exit.
+     */
+    void enable_memory_diff(bool hexdump);
+    void enable_memory_diff_from(Address from_pc, bool hexdump);
+    /** Print the profile sorted by symbols and by instructions at program exit. */
+    void enable_profile(const machine::FlatProfile *profile) { this->profile = profile; }
+    /** Print the most expensive call paths at program exit. */
+    void enable_call_profile(const machine::CallProfile *profile) { call_profile = profile; }
+    /** Print the most missing data accesses and data objects at program exit. */
+    void enable_miss_profile(const machine::MissProfile *profile) { miss_profile = profile; }
+    /** Dump the last cycles when the machine traps or the run does not end as expected. */
+    void enable_flight_recorder(const FlightRecorder *recorder) { flight_recorder = recorder; }
 
 public slots:
     void cycle_limit_reached();
+    /** Report state and exit with failure, the difference is printed by `CoSimulation`. */
+    void cosim_divergence();
 
 private slots:
     void machine_exit();
+    void memory_diff_step();
     void machine_trap(machine::SimulatorException &e);
     void machine_exception_reached();
 
 private:
+    /** Records retirement of instruction at the given address. */
+    class PcWatch final : public machine::MemoryAccessObserver {
+    public:
+        void memory_access(machine::MemoryAccessKind, Address, unsigned, Address) override {}
+        void instruction_retired(Address inst_addr) override { reached |= (inst_addr == pc); }
+
+        Address pc = Address::null();
+        bool reached = false;
+    };
+
     BORROWED QCoreApplication *const app;
     BORROWED machine::Machine *const machine;
     QVector<DumpRange> dump_ranges;
+    QVector<FindPattern> find_patterns;
 
     bool e_regs = false;
     bool e_cache_stats = false;
     bool e_cycles = false;
+    bool e_cpi_stack = false;
+    QString cpi_stack_json_path;
+    bool e_roi_stats = false;
     FailReason e_fail = FR_NONE;
+    bool e_memory_diff = false;
+    bool e_memory_diff_hexdump = false;
+    PcWatch memory_diff_watch;
+    std::unique_ptr<machine::Memory> memory_snapshot;
+    const machine::FlatProfile *profile = nullptr;
+    const machine::CallProfile *call_profile = nullptr;
+    const machine::MissProfile *miss_profile = nullptr;
+    const FlightRecorder *flight_recorder = nullptr;
 
     void report();
     void report_regs() const;
     void report_caches() const;
+    void report_cpi_stack() const;
+    void write_cpi_stack_json() const;
+    void report_roi_stats() const;
     void report_range(const DumpRange &range) const;
+    void report_find(const FindPattern &find) const;
+    void report_memory_diff() const;
+    void report_profile() const;
+    void report_call_profile() const;
+    void report_miss_profile() const;
     void report_csr_reg(size_t internal_id, bool last) const;
     void report_gp_reg(unsigned int i, bool last) const;
     static void report_cache(const char *cache_name, const machine::Cache &cache);
+    static void report_region_cache(
+        const char *prefix,
+        const char *cache_name,
+        const machine::CacheStats &cache);
+    static void report_mmu(const machine::Mmu &mmu);
+    static void report_tlb(const char *tlb_name, const machine::Tlb &tlb);
 };
 
 #endif // REPORTER_H
@@ -0,0 +1,220 @@
+#include "state_digest.h"
+
+#include "machine/memory/cache/cache.h"
+#include "machine/simulator_exception.h"
+
+#include <cstring>
+#include <iterator>
+
+using namespace machine;
+
+static constexpr char DIGEST_MAGIC[8] = { 'Q', 'T', 'R', 'V', 'S', 'D', 'G', 1 };
+static constexpr uint64_t DIGEST_PAGE_SIZE = 4096;
+
+/** CSRs with architectural effect which are not counters or read-only information. */
+static constexpr CSR::Id::IdxType DIGEST_CSRS[] = {
+    CSR::Id::SATP,     CSR::Id::MSTATUS, CSR::Id::MIE,    CSR::Id::MTVEC,
+    CSR::Id::MSCRATCH, CSR::Id::MEPC,    CSR::Id::MCAUSE, CSR::Id::MTVAL,
+};
+
+/** Order dependent combination of the running hash with the value (splitmix64 finalizer). */
+static uint64_t hash_combine(uint64_t hash, uint64_t value) {
+    value += 0x9e3779b97f4a7c15;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+    value ^= value >> 31;
+    return ((hash << 27) | (hash >> 37)) ^ value;
+}
+
+static uint64_t hash_page(const uint8_t *data) {
+    uint64_t hash = 0;
+    for (uint64_t offset = 0; offset < DIGEST_PAGE_SIZE; offset += sizeof(uint64_t)) {
+        uint64_t value;
+        memcpy(&value, data + offset, sizeof(value));
+        hash = hash_combine(hash, value);
+    }
+    return hash;
+}
+
+static void append_uleb(std::vector<uint8_t> &out, uint64_t value) {
+    do {
+        uint8_t b = value & 0x7f;
+        value >>= 7;
+        out.push_back(b | (value != 0 ? 0x80 : 0));
+    } while (value != 0);
+}
+
+StateDigestWriter::StateDigestWriter(Machine *machine, const QString &path, uint64_t interval)
+    : machine(machine)
+    , tracker(machine)
+    , path(path)
+    , file(fopen(path.toLocal8Bit().data(), "wb"))
+    , interval(interval)
+    , initial_memory(*machine->memory()) {
+    if (file == nullptr) {
+        throw SIMULATOR_EXCEPTION(Input, "Cannot open state digest file for writing", path);
+    }
+    std::vector<uint8_t> header(std::begin(DIGEST_MAGIC), std::end(DIGEST_MAGIC));
+    append_uleb(header, interval);
+    write(header);
+    const uint64_t xlen_mask = (tracker.get_xlen() == Xlen::_32) ? UINT32_MAX : UINT64_MAX;
+    for (unsigned i = 1; i < REGISTER_COUNT; i++) {
+        gp[i] = machine->registers()->read_gp(i).as_u64() & xlen_mask;
+    }
+    dirty_epoch = machine->memory_rw()->start_dirty_epoch();
+    machine->add_memory_access_observer(this);
+    connect(machine->core(), &Core::step_done, this, &StateDigestWriter::step_done);
+}
+
+StateDigestWriter::~StateDigestWriter() {
+    machine->remove_memory_access_observer(this);
+    if (fclose(file) != 0 || write_failed) {
+        fprintf(stderr, "Failure writing state digest %s\n", path.toLocal8Bit().data());
+    }
+}
+
+void StateDigestWriter::memory_access(
+    MemoryAccessKind kind,
+    Address address,
+    unsigned size,
+    Address inst_addr) {
+    (void)inst_addr;
+    if (kind != MemoryAccessKind::STORE) { return; }
+    dirty_pages.insert(address.get_raw() / DIGEST_PAGE_SIZE);
+    dirty_pages.insert((address.get_raw() + size - 1) / DIGEST_PAGE_SIZE);
+}
+
+void StateDigestWriter::step_done() {
+    CommitRecord record;
+    if (!tracker.step(record)) { return; }
+    if (record.regwrite) { gp[record.num_rd] = record.reg_value; }
+    last_pc = record.pc;
+    privilege = record.privilege;
+    if (++retired == interval) { write_digest(); }
+}
+
+void StateDigestWriter::finish() {
+    if (retired != 0) { write_digest(); }
+    if (fflush(file) != 0) { write_failed = true; }
+}
+
+void StateDigestWriter::write(const std::vector<uint8_t> &bytes) {
+    if (!write_failed && fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size()) {
+        write_failed = true;
+    }
+}
+
+void StateDigestWriter::write_digest() {
+    hash = hash_combine(hash, retired);
+    hash = hash_combine(hash, last_pc.get_raw());
+    hash = hash_combine(hash, static_cast<uint64_t>(privilege));
+    for (unsigned i = 1; i < REGISTER_COUNT; i++) {
+        hash = hash_combine(hash, gp[i]);
+    }
+    for (CSR::Id::IdxType csr : DIGEST_CSRS) {
+        hash = hash_combine(hash, machine->control_state()->read_internal(csr).as_u64());
+    }
+    // Collect pages which might have changed: stores of the core, writes to the main memory
+    // from anywhere (e.g. system calls of the OS emulation) and blocks held in write-back caches.
+    Memory *ram = machine->memory_rw();
+    std::vector<MemoryDirtyRange> ranges;
+    if (!ram->get_dirty_ranges(dirty_epoch, ranges)) {
+        // Whole content was replaced, it is not expected during a run.
+        hash = hash_combine(hash, UINT64_MAX);
+    }
+    dirty_epoch = ram->start_dirty_epoch();
+    for (const MemoryDirtyRange &range : ranges) {
+        for (uint64_t page = range.start / DIGEST_PAGE_SIZE; page <= range.last / DIGEST_PAGE_SIZE;
+             page++) {
+            dirty_pages.insert(page);
+        }
+    }
+    for (const Cache *cache : { machine->cache_data(), machine->cache_level2() }) {
+        if (cache == nullptr) { continue; }
+        for (Address block : cache->get_dirty_blocks()) {
+            dirty_pages.insert(block.get_raw() / DIGEST_PAGE_SIZE);
+        }
+    }
+
+    // The collected pages depend on the cache configuration. Only pages with changed content
+    // are hashed, which keeps the digest independent of it.
+    std::vector<uint8_t> data(DIGEST_PAGE_SIZE);
+    for (uint64_t page : dirty_pages) {
+        const uint64_t start = page * DIGEST_PAGE_SIZE;
+        // Peripherals may change their state on read.
+        if (start >= CACHE_UNCACHED_START && start <= CACHE_UNCACHED_LAST) { continue; }
+        // Read through the data cache to see the data not written back yet. Internal access
+        // has no effect on cache state or statistics.
+        for (uint64_t offset = 0; offset < DIGEST_PAGE_SIZE; offset += 4) {
+            machine->cache_data()->read(
+                &data[offset], Address(start + offset), 4, { .type = ae::INTERNAL });
+        }
+        const uint64_t content = hash_page(data.data());
+        auto last = page_hashes.find(page);
+        if (last == page_hashes.end()) {
+            std::vector<uint8_t> initial(DIGEST_PAGE_SIZE);
+            initial_memory.read(initial.data(), start, DIGEST_PAGE_SIZE, { .type = ae::INTERNAL });
+            last = page_hashes.emplace(page, hash_page(initial.data())).first;
+        }
+        if (last->second == content) { continue; }
+        last->second = content;
+        hash = hash_combine(hash, page);
+        hash = hash_combine(hash, content);
+    }
+    dirty_pages.clear();
+
+    std::vector<uint8_t> record;
+    append_uleb(record, retired);
+    for (size_t i = 0; i < sizeof(hash); i++) {
+        record.push_back((uint8_t)(hash >> (8 * i)));
+    }
+    write(record);
+    retired = 0;
+}
+
+StateDigestReader::StateDigestReader(const QString &path)
+    : file(fopen(path.toLocal8Bit().data(), "rb"))
+    , path(path) {
+    if (file == nullptr) { throw SIMULATOR_EXCEPTION(Input, "Cannot open state digest", path); }
+    char magic[sizeof(DIGEST_MAGIC)];
+    if (fread(magic, 1, sizeof(magic), file) != sizeof(magic)
+        || memcmp(magic, DIGEST_MAGIC, sizeof(magic)) != 0 || !read_uleb(interval)) {
+        fclose(file);
+        throw SIMULATOR_EXCEPTION(Input, "File is not a supported state digest", path);
+    }
+}
+
+StateDigestReader::~StateDigestReader() {
+    fclose(file);
+}
+
+bool StateDigestReader::read_uleb(uint64_t &value) {
+    value = 0;
+    unsigned shift = 0;
+    int c;
+    do {
+        c = fgetc(file);
+        if (c == EOF || shift > 63) { return false; }
+        value |= (uint64_t)(c & 0x7f) << shift;
+        shift += 7;
+    } while (c & 0x80);
+    return true;
+}
+
+bool StateDigestReader::next(StateDigest &digest) {
+    const int first = fgetc(file);
+    if (first == EOF) { return false; }
+    ungetc(first, file);
+    uint64_t count;
+    uint8_t bytes[sizeof(digest.hash)];
+    if (!read_uleb(count) || fread(bytes, 1, sizeof(bytes), file) != sizeof(bytes)) {
+        throw SIMULATOR_EXCEPTION(Input, "Corrupted state digest", path);
+    }
+    retired += count;
+    digest.retired = retired;
+    digest.hash = 0;
+    for (size_t i = 0; i < sizeof(bytes); i++) {
+        digest.hash |= (uint64_t)bytes[i] << (8 * i);
+    }
+    return true;
+}
@@ -0,0 +1,128 @@
+#ifndef STATE_DIGEST_H
+#define STATE_DIGEST_H
+
+#include "commit_log.h"
+#include "machine/core/memory_access_observer.h"
+#include "machine/machine.h"
+#include "machine/registers.h"
+
+#include <QObject>
+#include <QString>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+/** Hash of the architectural state after the given number of retired instructions. */
+struct StateDigest {
+    uint64_t retired = 0;
+    uint64_t hash = 0;
+};
+
+/**
+ * Writes a digest of the architectural state every `interval` retired
+ * instructions, so runs of different simulator versions can be compared
+ * without storing full traces.
+ *
+ * The digest covers general purpose registers, the address of the last
+ * retired instruction, privilege level, trap and translation CSRs and the
+ * content of memory pages changed since the previous digest (as seen by the
+ * core, i.e. including data held in caches). Candidate pages come from
+ * stores of the core, dirty tracking of the main memory (which also covers
+ * writes by system calls of the OS emulation) and dirty blocks of write-back
+ * caches. A page is hashed only when its content differs from the last
+ * hashed one, so the digest does not depend on the cache configuration.
+ * Each hash also covers the previous one, so a difference persists in all
+ * following digests.
+ * Registers are tracked from retired instructions, therefore the digest
+ * does not depend on the pipeline organization.
+ *
+ * File format:
+ *  - 7 byte magic `QTRVSDG` and format version byte (8 bytes),
+ *  - interval as LEB128,
+ *  - sequence of digests, each with LEB128 count of instructions retired
+ *    since the previous digest (equal to the interval except the last one)
+ *    and 8 byte little endian hash.
+ */
+class StateDigestWriter final : public QObject, public machine::MemoryAccessObserver {
+    Q_OBJECT
+public:
+    /**
+     * Has to be created before the first step, after the program is loaded.
+     * @throws SimulatorExceptionInput when the file cannot be opened
+     */
+    StateDigestWriter(machine::Machine *machine, const QString &path, uint64_t interval);
+    /** Write errors are reported to stderr. */
+    ~StateDigestWriter() override;
+
+    void memory_access(
+        machine::MemoryAccessKind kind,
+        machine::Address address,
+        unsigned size,
+        machine::Address inst_addr) override;
+
+    /** Write digest of the instructions retired after the last full interval. */
+    void finish();
+
+private slots:
+    void step_done();
+
+private:
+    void write_digest();
+    /** Later writes are skipped after a failure. */
+    void write(const std::vector<uint8_t> &bytes);
+
+    machine::Machine *const machine;
+    CommitTracker tracker;
+    const QString path;
+    FILE *file;
+    bool write_failed = false;
+    const uint64_t interval;
+    uint64_t retired = 0;
+    uint64_t hash = 0;
+    std::array<uint64_t, machine::REGISTER_COUNT> gp {};
+    machine::Address last_pc;
+    machine::CSR::PrivilegeLevel privilege = machine::CSR::PrivilegeLevel::MACHINE;
+    /** Content of the memory when the run started. */
+    const machine::Memory initial_memory;
+    /** Page numbers written since the last digest. */
+    std::set<uint64_t> dirty_pages;
+    /** Hash of the last hashed content of pages by page number. */
+    std::unordered_map<uint64_t, uint64_t> page_hashes;
+    /** Dirty epoch of the main memory started by the last digest. */
+    uint64_t dirty_epoch = 0;
+};
+
+/** Sequential reader of files produced by `StateDigestWriter`. */
+class StateDigestReader {
+public:
+    /**
+     * @throws SimulatorExceptionInput when the file cannot be opened or it is
+     *  not a state digest
+     */
+    explicit StateDigestReader(const QString &path);
+    ~StateDigestReader();
+
+    StateDigestReader(const StateDigestReader &) = delete;
+    StateDigestReader &operator=(const StateDigestReader &) = delete;
+
+    [[nodiscard]] uint64_t get_interval() const { return interval; }
+
+    /**
+     * @return false at the end of the file
+     * @throws SimulatorExceptionInput when the file is truncated
+     */
+    bool next(StateDigest &digest);
+
+private:
+    bool read_uleb(uint64_t &value);
+
+    FILE *file;
+    const QString path;
+    uint64_t interval = 0;
+    uint64_t retired = 0;
+};
+
+#endif // STATE_DIGEST_H
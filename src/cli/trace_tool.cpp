@@ -0,0 +1,139 @@
+/**
+ * Decoder of binary execution traces recorded by `qtrvsim_cli --trace-binary`.
+ */
+
+#include "execution_trace.h"
+#include "machine/simulator_exception.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <algorithm>
+#include <cinttypes>
+
+using namespace machine;
+
+void create_parser(QCommandLineParser &p) {
+    p.setApplicationDescription(
+        "Decode, filter and print binary execution trace in the text format of the CLI tracer.");
+    p.addHelpOption();
+    p.addVersionOption();
+
+    p.addPositionalArgument("FILE", "Binary execution trace");
+
+    p.addOption({ { "trace-fetch", "tr-fetch" }, "Trace fetched instruction." });
+    p.addOption({ { "trace-decode", "tr-decode" }, "Trace instruction in decode stage." });
+    p.addOption({ { "trace-execute", "tr-execute" }, "Trace instruction in execute stage." });
+    p.addOption({ { "trace-memory", "tr-memory" }, "Trace instruction in memory stage." });
+    p.addOption({ { "trace-writeback", "tr-writeback" },
+                  "Trace instruction in write back stage." });
+    p.addOption({ { "trace-pc", "tr-pc" }, "Print program counter register changes." });
+    p.addOption({ { "trace-wrmem", "tr-wr" }, "Trace writes into memory." });
+    p.addOption({ { "trace-rdmem", "tr-rd" }, "Trace reads from memory." });
+    p.addOption({ { "trace-gp", "tr-gp" },
+                  "Print general purpose register changes. You can use * for all registers.",
+                  "REG" });
+    p.addOption({ "cycles", "Print only cycles in the inclusive range.", "FROM:TO" });
+    p.addOption({ "exceptions", "Print only cycles with an exception in some stage." });
+    p.addOption({ "stats", "Print record and event counts instead of the trace." });
+}
+
+void configure_text(QCommandLineParser &p, TraceTextOptions &text) {
+    text.trace_fetch = p.isSet("trace-fetch");
+    text.trace_decode = p.isSet("trace-decode");
+    text.trace_execute = p.isSet("trace-execute");
+    text.trace_memory = p.isSet("trace-memory");
+    text.trace_writeback = p.isSet("trace-writeback");
+    text.trace_pc = p.isSet("trace-pc");
+    text.trace_wrmem = p.isSet("trace-wrmem");
+    text.trace_rdmem = p.isSet("trace-rdmem");
+    text.trace_regs_gp = p.isSet("trace-gp");
+    for (const QString &gp : p.values("trace-gp")) {
+        if (gp == "*") {
+            text.regs_to_trace.fill(true);
+        } else {
+            bool res;
+            size_t num = gp.toUInt(&res);
+            if (res && num < machine::REGISTER_COUNT) {
+                text.regs_to_trace.at(num) = true;
+            } else {
+                fprintf(
+                    stderr, "Unknown register number given for trace-gp: %s\n", qPrintable(gp));
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    if (!text.any()) {
+        // Everything by default.
+        text.trace_fetch = text.trace_decode = text.trace_execute = text.trace_memory = true;
+        text.trace_writeback = text.trace_pc = text.trace_wrmem = text.trace_rdmem = true;
+        text.trace_regs_gp = true;
+        text.regs_to_trace.fill(true);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(APP_NAME);
+    QCoreApplication::setApplicationVersion(APP_VERSION);
+
+    QCommandLineParser p;
+    create_parser(p);
+    p.process(app);
+
+    if (p.positionalArguments().size() != 1) {
+        fprintf(stderr, "Single trace file has to be specified\n");
+        exit(EXIT_FAILURE);
+    }
+
+    TraceTextOptions text;
+    configure_text(p, text);
+
+    uint64_t from_cycle = 0;
+    uint64_t to_cycle = UINT64_MAX;
+    if (p.isSet("cycles")) {
+        const QStringList range = p.value("cycles").split(':');
+        bool ok1 = range.size() == 2, ok2 = ok1;
+        if (ok1 && !range[0].isEmpty()) { from_cycle = range[0].toULongLong(&ok1, 0); }
+        if (ok2 && !range[1].isEmpty()) { to_cycle = range[1].toULongLong(&ok2, 0); }
+        if (!ok1 || !ok2) {
+            fprintf(stderr, "Cycle range specification error.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    const bool only_exceptions = p.isSet("exceptions");
+    const bool stats = p.isSet("stats");
+
+    uint64_t records = 0, reg_writes = 0, mem_reads = 0, mem_writes = 0, exceptions = 0;
+    try {
+        ExecutionTraceReader reader(p.positionalArguments().at(0));
+        ExecutionTraceRecord record;
+        while (reader.next(record)) {
+            if (record.cycle < from_cycle || record.cycle > to_cycle) { continue; }
+            const bool exception = std::any_of(
+                record.stage_excause.begin(), record.stage_excause.end(),
+                [](ExceptionCause excause) { return excause != EXCAUSE_NONE; });
+            if (only_exceptions && !exception) { continue; }
+            if (stats) {
+                records++;
+                reg_writes += record.regwrite;
+                mem_reads += record.memread;
+                mem_writes += record.memwrite;
+                exceptions += exception;
+            } else {
+                print_trace_text(record, text);
+            }
+        }
+    } catch (SimulatorException &e) {
+        fprintf(stderr, "%s\n", qPrintable(e.msg(false)));
+        exit(EXIT_FAILURE);
+    }
+
+    if (stats) {
+        printf("cycles: %" PRIu64 "\n", records);
+        printf("register-writes: %" PRIu64 "\n", reg_writes);
+        printf("memory-reads: %" PRIu64 "\n", mem_reads);
+        printf("memory-writes: %" PRIu64 "\n", mem_writes);
+        printf("exception-cycles: %" PRIu64 "\n", exceptions);
+    }
+    return 0;
+}
@@ -1,12 +1,14 @@
 #ifndef TRACER_H
 #define TRACER_H
 
+#include "execution_trace.h"
 #include "machine/instruction.h"
 #include "machine/machine.h"
 #include "machine/memory/address.h"
 #include "machine/registers.h"
 
 #include <QObject>
+#include <memory>
 
 /**
  * Watches the step by step execution of the machine and prints requested state.
@@ -16,6 +18,12 @@ class Tracer final : public QObject {
 public:
     explicit Tracer(machine::Machine *machine);
 
+    /**
+     * Record every cycle into a binary trace (see `ExecutionTraceWriter`).
+     * @throws SimulatorExceptionInput when the file cannot be opened
+     */
+    void enable_binary_trace(const QString &path);
+
 signals:
     void cycle_limit_reached();
 
@@ -24,12 +32,10 @@ private slots:
 
 private:
     const machine::CoreState &core_state;
+    std::unique_ptr<ExecutionTraceWriter> binary_trace;
 
 public:
-    std::array<bool, machine::REGISTER_COUNT> regs_to_trace = {};
-    bool trace_fetch = false, trace_decode = false, trace_execute = false, trace_memory = false,
-         trace_writeback = false, trace_pc = false, trace_wrmem = false,  trace_rdmem = false,
-         trace_regs_gp = false;
+    TraceTextOptions text;
     quint64 cycle_limit;
 };
 
@@ -126,6 +126,8 @@ MainWindow::MainWindow(QSettings *settings, QWidget *parent)
     lcd_display->hide();
     csrdock = new CsrDock(this);
     csrdock->hide();
+    cpistack = new CpiStackDock(this);
+    cpistack->hide();
     messages = new MessagesDock(this, settings);
     messages->hide();
 
@@ -161,6 +163,7 @@ MainWindow::MainWindow(QSettings *settings, QWidget *parent)
     connect(ui->actionTerminal, &QAction::triggered, this, &MainWindow::show_terminal);
     connect(ui->actionLcdDisplay, &QAction::triggered, this, &MainWindow::show_lcd_display);
     connect(ui->actionCsrShow, &QAction::triggered, this, &MainWindow::show_csrdock);
+    connect(ui->actionCpiStack, &QAction::triggered, this, &MainWindow::show_cpistack);
     connect(ui->actionCore_View_show, &QAction::triggered, this, &MainWindow::show_hide_coreview);
     connect(ui->actionMessages, &QAction::triggered, this, &MainWindow::show_messages);
     connect(ui->actionResetWindows, &QAction::triggered, this, &MainWindow::reset_windows);
@@ -321,6 +324,7 @@ void MainWindow::create_core(
     peripherals->setup(machine->peripheral_spi_led());
     lcd_display->setup(machine->peripheral_lcd_display());
     csrdock->setup(machine.data());
+    cpistack->setup(machine.data());
 
     connect(
         machine->core(), &machine::Core::step_done, program.data(),
@@ -421,6 +425,7 @@ SHOW_HANDLER(peripherals, Qt::RightDockWidgetArea, false)
 SHOW_HANDLER(terminal, Qt::RightDockWidgetArea, false)
 SHOW_HANDLER(lcd_display, Qt::RightDockWidgetArea, false)
 SHOW_HANDLER(csrdock, Qt::TopDockWidgetArea, false)
+SHOW_HANDLER(cpistack, Qt::RightDockWidgetArea, false)
 SHOW_HANDLER(messages, Qt::BottomDockWidgetArea, false)
 #undef SHOW_HANDLER
 
@@ -435,6 +440,7 @@ void MainWindow::reset_windows() {
     reset_state_terminal();
     reset_state_lcd_display();
     reset_state_csrdock();
+    reset_state_cpistack();
     reset_state_messages();
 }
 
@@ -10,6 +10,7 @@
 #include "ui_MainWindow.h"
 #include "widgets/hidingtabwidget.h"
 #include "windows/cache/cachedock.h"
+#include "windows/cpistack/cpistackdock.h"
 #include "windows/csr/csrdock.h"
 #include "windows/editor/editordock.h"
 #include "windows/editor/editortab.h"
@@ -77,6 +78,7 @@ public slots:
     void reset_state_terminal();
     void reset_state_lcd_display();
     void reset_state_csrdock();
+    void reset_state_cpistack();
     void reset_state_messages();
     void show_registers();
     void show_program();
@@ -88,6 +90,7 @@ public slots:
     void show_terminal();
     void show_lcd_display();
     void show_csrdock();
+    void show_cpistack();
     void show_hide_coreview(bool show);
     void show_messages();
     void reset_windows();
@@ -131,6 +134,7 @@ private:
     Box<TerminalDock> terminal {};
     Box<LcdDisplayDock> lcd_display {};
     CsrDock *csrdock {};
+    CpiStackDock *cpistack {};
     MessagesDock *messages {};
     bool coreview_shown = true;
 
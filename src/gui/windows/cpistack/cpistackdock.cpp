@@ -0,0 +1,53 @@
+#include "cpistackdock.h"
+
+CpiStackDock::CpiStackDock(QWidget *parent) : QDockWidget(parent) {
+    top_widget = new QWidget(this);
+    setWidget(top_widget);
+    layout = new QFormLayout(top_widget);
+
+    l_cpi = new QLabel("0.000", top_widget);
+    layout->addRow("CPI:", l_cpi);
+    for (size_t i = 0; i < machine::CPI_COMPONENT_COUNT; i++) {
+        const auto component = static_cast<machine::CpiComponent>(i);
+        bars[i] = new QProgressBar(top_widget);
+        bars[i]->setRange(0, 1000);
+        bars[i]->setValue(0);
+        bars[i]->setFormat("0");
+        layout->addRow(QString(machine::cpi_component_description(component)) + ":", bars[i]);
+    }
+
+    setObjectName("CpiStack");
+    setWindowTitle("CPI Stack");
+}
+
+void CpiStackDock::setup(machine::Machine *machine) {
+    this->machine = machine;
+    update_stack();
+    if (machine == nullptr) { return; }
+    connect(machine, &machine::Machine::post_tick, this, &CpiStackDock::update_stack);
+    connect(machine, &machine::Machine::status_change, this, &CpiStackDock::update_stack);
+}
+
+void CpiStackDock::update_stack() {
+    if (machine == nullptr || machine->core() == nullptr) {
+        l_cpi->setText("0.000");
+        for (QProgressBar *bar : bars) {
+            bar->setValue(0);
+            bar->setFormat("0");
+        }
+        return;
+    }
+    const machine::CpiStack &stack = machine->core()->get_cpi_stack();
+    uint64_t cycles = 0;
+    for (uint64_t component_cycles : stack) {
+        cycles += component_cycles;
+    }
+    const uint64_t retired = stack[static_cast<size_t>(machine::CpiComponent::BASE)];
+    const double divisor = (retired != 0) ? (double)retired : 1.0;
+    l_cpi->setText(QString::number((double)cycles / divisor, 'f', 3));
+    for (size_t i = 0; i < machine::CPI_COMPONENT_COUNT; i++) {
+        bars[i]->setValue((cycles != 0) ? (int)(stack[i] * 1000 / cycles) : 0);
+        bars[i]->setFormat(
+            QString("%1 (%2)").arg(stack[i]).arg((double)stack[i] / divisor, 0, 'f', 3));
+    }
+}
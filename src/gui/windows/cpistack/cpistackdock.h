@@ -0,0 +1,37 @@
+#ifndef CPISTACKDOCK_H
+#define CPISTACKDOCK_H
+
+#include "machine/core/cpi_stack.h"
+#include "machine/machine.h"
+
+#include <QDockWidget>
+#include <QFormLayout>
+#include <QLabel>
+#include <QPointer>
+#include <QProgressBar>
+#include <array>
+
+/**
+ * Bar chart of the CPI stack of the core. Each bar shows the share of
+ * cycles spent by a component, the label the cycles and CPI contribution.
+ */
+class CpiStackDock : public QDockWidget {
+    Q_OBJECT
+public:
+    explicit CpiStackDock(QWidget *parent);
+
+    void setup(machine::Machine *machine);
+
+private slots:
+    void update_stack();
+
+private:
+    QPointer<machine::Machine> machine;
+
+    QWidget *top_widget;
+    QFormLayout *layout;
+    QLabel *l_cpi;
+    std::array<QProgressBar *, machine::CPI_COMPONENT_COUNT> bars {};
+};
+
+#endif // CPISTACKDOCK_H
@@ -5,6 +5,7 @@
 #include "ui/hexlineedit.h"
 
 #include <QComboBox>
+#include <QHBoxLayout>
 #include <QHeaderView>
 #include <QVBoxLayout>
 #include <QWidget>
@@ -34,6 +35,10 @@ MemoryDock::MemoryDock(QWidget *parent, QSettings *settings) : Super(parent) {
 
     auto *go_edit = new HexLineEdit(nullptr, 8, 16, "0x");
 
+    find_edit = new QLineEdit();
+    find_edit->setPlaceholderText("Find (hex:DE AD ?? EF, u32:VALUE[/MASK], str:TEXT)");
+    find_status = new QLabel();
+
     auto *layout_top = new QHBoxLayout;
     layout_top->addWidget(cell_size);
     layout_top->addWidget(cached_access);
@@ -42,6 +47,10 @@ MemoryDock::MemoryDock(QWidget *parent, QSettings *settings) : Super(parent) {
     layout->addLayout(layout_top);
     layout->addWidget(memory_content);
     layout->addWidget(go_edit);
+    auto *layout_find = new QHBoxLayout;
+    layout_find->addWidget(find_edit);
+    layout_find->addWidget(find_status);
+    layout->addLayout(layout_find);
 
     content->setLayout(layout);
 
@@ -62,9 +71,11 @@ MemoryDock::MemoryDock(QWidget *parent, QSettings *settings) : Super(parent) {
         });
     connect(
         memory_content, &MemoryTableView::address_changed, go_edit,
-        [go_edit](machine::Address addr) {
+        [this, go_edit](machine::Address addr) {
             go_edit->set_value(addr.get_raw());
+            current_address = addr;
         });
+    connect(find_edit, &QLineEdit::returnPressed, this, &MemoryDock::find_next);
     connect(
         this, &MemoryDock::focus_addr, memory_content,
         &MemoryTableView::focus_address);
@@ -74,5 +85,29 @@ MemoryDock::MemoryDock(QWidget *parent, QSettings *settings) : Super(parent) {
 }
 
 void MemoryDock::setup(machine::Machine *machine) {
+    this->machine = machine;
     emit machine_setup(machine);
 }
+
+void MemoryDock::find_next() {
+    if (machine == nullptr) { return; }
+    machine::MemorySearchPattern pattern;
+    if (!machine::MemorySearchPattern::parse(
+            find_edit->text(), machine->config().get_simulated_endian(), pattern)) {
+        find_status->setText("Invalid pattern");
+        return;
+    }
+    // Main memory is mapped at its offsets. Search continues after the
+    // current address and wraps around. Dirty cache data is included.
+    const std::unique_ptr<machine::Memory> memory = machine->memory_with_cached_data();
+    std::vector<machine::Offset> matches;
+    if (memory->find(pattern, current_address.get_raw() + 1, matches, 1) == 0
+        && memory->find(pattern, 0, matches, 1) == 0) {
+        find_status->setText("Not found");
+        return;
+    }
+    find_status->clear();
+    emit focus_addr(machine::Address(matches[0]));
+    // Focusing may report the start of the row as the current address.
+    current_address = machine::Address(matches[0]);
+}
@@ -7,6 +7,7 @@
 #include <QComboBox>
 #include <QDockWidget>
 #include <QLabel>
+#include <QLineEdit>
 
 class MemoryDock : public QDockWidget {
     Q_OBJECT
@@ -22,7 +23,14 @@ signals:
     void machine_setup(machine::Machine *machine);
     void focus_addr(machine::Address);
 
+private slots:
+    void find_next();
+
 private:
+    machine::Machine *machine = nullptr;
+    QLineEdit *find_edit;
+    QLabel *find_status;
+    machine::Address current_address = machine::Address::null();
 };
 
 #endif // MEMORYDOCK_H
@@ -51,12 +51,20 @@ Core::Core(Registers *regs,
 void Core::step(bool skip_break) {
     state.cycle_count++;
     do_step(skip_break);
+    count_hpm_events(account_cpi_component());
     emit step_done(state);
 }
 
 void Core::reset() {
     state.cycle_count = 0;
     state.stall_count = 0;
+    state.fetch_seq = 0;
+    state.cpi_stack = {};
+    hpm_events = {};
+    hpm_cache_counts = {};
+    if (control_state != nullptr) {
+        control_state->set_privilege_level(CSR::PrivilegeLevel::MACHINE);
+    }
     do_reset();
 }
 
@@ -68,6 +76,46 @@ unsigned Core::get_stall_count() const {
     return state.stall_count;
 }
 
+const CpiStack &Core::get_cpi_stack() const {
+    return state.cpi_stack;
+}
+
+CpiComponent Core::account_cpi_component() {
+    const MemoryInterstage &retiring = state.pipeline.memory.result;
+    CpiComponent component = retiring.bubble_cause;
+    if (retiring.is_valid) {
+        component = (retiring.excause == EXCAUSE_NONE) ? CpiComponent::BASE : CpiComponent::EXCEPTION;
+    }
+    state.cpi_stack[static_cast<size_t>(component)]++;
+    return component;
+}
+
+/** Increment since the last sample, counters restart from zero on cache reset. */
+static uint32_t counter_delta(uint32_t current, uint32_t &last) {
+    const uint32_t delta = (current >= last) ? current - last : current;
+    last = current;
+    return delta;
+}
+
+void Core::count_hpm_events(CpiComponent component) {
+    if (control_state == nullptr) { return; }
+    hpm_events[CSR::HpmEvent::CYCLES]++;
+    if (component != CpiComponent::BASE) {
+        hpm_events[CSR::hpm_event_of_lost_cycles(component)]++;
+    }
+    for (size_t i = 0; i < hpm_caches.size(); i++) {
+        if (hpm_caches[i] == nullptr) { continue; }
+        // Hit and miss events of each cache follow each other.
+        const size_t event = CSR::HpmEvent::PROGRAM_CACHE_HITS + 2 * i;
+        hpm_events[event]
+            += counter_delta(hpm_caches[i]->get_hit_count(), hpm_cache_counts[2 * i]);
+        hpm_events[event + 1]
+            += counter_delta(hpm_caches[i]->get_miss_count(), hpm_cache_counts[2 * i + 1]);
+    }
+    control_state->count_events(hpm_events);
+    hpm_events = {};
+}
+
 Registers *Core::get_regs() const {
     return regs;
 }
@@ -84,6 +132,27 @@ FrontendMemory *Core::get_mem_program() const {
     return mem_program;
 }
 
+void Core::set_mmu(Mmu *mmu) {
+    this->mmu = mmu;
+}
+
+Mmu *Core::get_mmu() const {
+    return mmu;
+}
+
+void Core::set_pmp(Pmp *pmp) {
+    this->pmp = pmp;
+}
+
+void Core::set_hpm_caches(const Cache *program, const Cache *data, const Cache *level2) {
+    hpm_caches = { program, data, level2 };
+    for (size_t i = 0; i < hpm_caches.size(); i++) {
+        hpm_cache_counts[2 * i] = (hpm_caches[i] != nullptr) ? hpm_caches[i]->get_hit_count() : 0;
+        hpm_cache_counts[2 * i + 1]
+            = (hpm_caches[i] != nullptr) ? hpm_caches[i]->get_miss_count() : 0;
+    }
+}
+
 Predictor *Core::get_predictor() const {
     return predictor;
 }
@@ -125,6 +194,16 @@ Xlen Core::get_xlen() const {
     return xlen;
 }
 
+void Core::add_memory_access_observer(MemoryAccessObserver *observer) {
+    access_observers.push_back(observer);
+}
+
+void Core::remove_memory_access_observer(MemoryAccessObserver *observer) {
+    access_observers.erase(
+        std::remove(access_observers.begin(), access_observers.end(), observer),
+        access_observers.end());
+}
+
 void Core::register_exception_handler(ExceptionCause excause, ExceptionHandler *exhandler) {
     if (excause == EXCAUSE_NONE) {
         ex_default_handler.reset(exhandler);
@@ -142,7 +221,10 @@ bool Core::handle_exception(
     Address next_addr,
     Address jump_branch_pc,
     Address mem_ref_addr) {
-    if (excause == EXCAUSE_INSN_ILLEGAL) {
+    // Illegal instruction stops the simulation unless it traps to a handler.
+    if (excause == EXCAUSE_INSN_ILLEGAL
+        && (control_state == nullptr || control_state->read_internal(CSR::Id::MTVEC) == 0
+            || get_step_over_exception(excause))) {
         throw SIMULATOR_EXCEPTION(
             UnsupportedInstruction, "Instruction with following encoding is not supported",
             QString::number(inst.data(), 16));
@@ -153,9 +235,20 @@ bool Core::handle_exception(
     if (control_state != nullptr) {
         control_state->write_internal(CSR::Id::MEPC, inst_addr.get_raw());
         control_state->update_exception_cause(excause);
+        if (excause == EXCAUSE_INSN_ILLEGAL) {
+            control_state->write_internal(CSR::Id::MTVAL, inst.data());
+        } else if (excause == EXCAUSE_INSN_PAGE_FAULT || excause == EXCAUSE_INSN_FAULT) {
+            control_state->write_internal(CSR::Id::MTVAL, inst_addr.get_raw());
+        } else if (excause == EXCAUSE_LOAD_PAGE_FAULT || excause == EXCAUSE_STORE_PAGE_FAULT
+                   || excause == EXCAUSE_LOAD_MISALIGNED || excause == EXCAUSE_STORE_MISALIGNED
+                   || excause == EXCAUSE_LOAD_FAULT || excause == EXCAUSE_STORE_FAULT) {
+            control_state->write_internal(CSR::Id::MTVAL, mem_ref_addr.get_raw());
+        }
         if (control_state->read_internal(CSR::Id::MTVEC) != 0
             && !get_step_over_exception(excause)) {
-            control_state->exception_initiate(CSR::PrivilegeLevel::MACHINE, CSR::PrivilegeLevel::MACHINE);
+            // All traps are taken in machine mode, there is no delegation.
+            control_state->exception_initiate(
+                control_state->get_privilege_level(), CSR::PrivilegeLevel::MACHINE);
             regs->write_pc(control_state->exception_pc_address());
         }
     }
@@ -211,22 +304,29 @@ enum ExceptionCause Core::memory_special(
     bool memwrite,
     RegisterValue &towrite_val,
     RegisterValue rt_value,
-    Address mem_addr) {
+    Address mem_addr,
+    Address inst_addr) {
     Q_UNUSED(mode)
+    const unsigned size = access_control_size(memctl);
 
     switch (memctl) {
     case AC_CACHE_OP:
         mem_data->sync();
         mem_program->sync();
         break;
+    case AC_SFENCE_VMA:
+        if (mmu != nullptr) { mmu->flush(); }
+        break;
     case AC_LR32:
         if (!memread) { break; }
         state.LoadReservedRange = AddressRange(mem_addr, mem_addr + 3);
+        notify_memory_access(MemoryAccessKind::LOAD, mem_addr, size, inst_addr);
         towrite_val = (int32_t)(mem_data->read_u32(mem_addr));
         break;
     case AC_SC32:
         if (!memwrite) { break; }
         if (state.LoadReservedRange.contains(AddressRange(mem_addr, mem_addr + 3))) {
+            notify_memory_access(MemoryAccessKind::STORE, mem_addr, size, inst_addr);
             mem_data->write_u32(mem_addr, rt_value.as_u32());
             towrite_val = 0;
         } else {
@@ -237,11 +337,13 @@ enum ExceptionCause Core::memory_special(
     case AC_LR64:
         if (!memread) { break; }
         state.LoadReservedRange = AddressRange(mem_addr, mem_addr + 7);
+        notify_memory_access(MemoryAccessKind::LOAD, mem_addr, size, inst_addr);
         towrite_val = mem_data->read_u64(mem_addr);
         break;
     case AC_SC64:
         if (!memwrite) { break; }
         if (state.LoadReservedRange.contains(AddressRange(mem_addr, mem_addr + 7))) {
+            notify_memory_access(MemoryAccessKind::STORE, mem_addr, size, inst_addr);
             mem_data->write_u64(mem_addr, rt_value.as_u64());
             towrite_val = 0;
         } else {
@@ -251,6 +353,8 @@ enum ExceptionCause Core::memory_special(
     case AC_FISRT_AMO_MODIFY32 ... AC_LAST_AMO_MODIFY32:
     {
         if (!memread || !memwrite) { break; }
+        notify_memory_access(MemoryAccessKind::LOAD, mem_addr, size, inst_addr);
+        notify_memory_access(MemoryAccessKind::STORE, mem_addr, size, inst_addr);
         int32_t fetched_value;
         fetched_value = (int32_t)(mem_data->read_u32(mem_addr));
         towrite_val = amo32_operations(memctl, fetched_value, rt_value.as_u32());
@@ -261,6 +365,8 @@ enum ExceptionCause Core::memory_special(
     case AC_FISRT_AMO_MODIFY64 ... AC_LAST_AMO_MODIFY64:
     {
         if (!memread || !memwrite) { break; }
+        notify_memory_access(MemoryAccessKind::LOAD, mem_addr, size, inst_addr);
+        notify_memory_access(MemoryAccessKind::STORE, mem_addr, size, inst_addr);
         int64_t fetched_value;
         fetched_value = (int64_t)(mem_data->read_u64(mem_addr));
         towrite_val = (uint64_t)amo64_operations(memctl, fetched_value, rt_value.as_u64());
@@ -275,16 +381,30 @@ enum ExceptionCause Core::memory_special(
 }
 
 FetchState Core::fetch(PCInterstage pc, bool skip_break) {
-    if (pc.stop_if) { return {}; }
+    if (pc.stop_if) {
+        // Fetch waits until the exception reaches the end of the pipeline.
+        FetchInterstage bubble;
+        bubble.bubble_cause = CpiComponent::EXCEPTION;
+        return { FetchInternalState {}, bubble };
+    }
 
     const Address inst_addr = Address(regs->read_pc());
-    const Instruction inst(mem_program->read_u32(inst_addr));
+    Address inst_paddr = inst_addr;
     ExceptionCause excause = EXCAUSE_NONE;
+    if (mmu != nullptr) {
+        excause = mmu->translate(inst_addr, 4, MemoryAccessKind::FETCH, inst_paddr);
+    }
+    if (excause == EXCAUSE_NONE && pmp != nullptr) {
+        excause = pmp->check(inst_paddr, 4, MemoryAccessKind::FETCH);
+    }
+    // Faulting fetch passes NOP down the pipeline to carry the exception.
+    const Instruction inst = (excause == EXCAUSE_NONE)
+                                 ? Instruction(mem_program->read_u32(inst_paddr))
+                                 : Instruction::NOP;
 
-    if (!skip_break && hw_breaks.contains(inst_addr)) { excause = EXCAUSE_HWBREAK; }
-
-    if (control_state != nullptr) {
-        control_state->increment_internal(CSR::Id::MCYCLE, 1);
+    if (excause == EXCAUSE_NONE) {
+        notify_memory_access(MemoryAccessKind::FETCH, inst_paddr, 4, inst_addr);
+        if (!skip_break && hw_breaks.contains(inst_addr)) { excause = EXCAUSE_HWBREAK; }
     }
 
     if (control_state != nullptr && excause == EXCAUSE_NONE) {
@@ -295,6 +415,7 @@ FetchState Core::fetch(PCInterstage pc, bool skip_break) {
              FetchInterstage {
                  .inst = inst,
                  .inst_addr = inst_addr,
+                 .seq = ++state.fetch_seq,
                  .next_inst_addr = inst_addr + inst.size(),
                  .predicted_next_inst_addr = predictor->predict(inst, inst_addr),
                  .excause = excause,
@@ -327,16 +448,35 @@ DecodeState Core::decode(const FetchInterstage &dt) {
     const bool regwrite = flags & IMF_REGWRITE;
 
     CSR::Address csr_address = (flags & IMF_CSR) ? dt.inst.csr_address() : CSR::Address(0);
-    RegisterValue csr_read_val
-        = ((control_state != nullptr && (flags & IMF_CSR))) ? control_state->read(csr_address) : 0;
     bool csr_write = (flags & IMF_CSR) && (!(flags & IMF_CSR_TO_ALU) || (num_rs != 0));
+    if (control_state != nullptr && excause == EXCAUSE_NONE) {
+        if ((flags & IMF_CSR) && !control_state->is_access_permitted(csr_address, csr_write)) {
+            excause = EXCAUSE_INSN_ILLEGAL;
+        }
+        // Bits 29:28 of mret/sret encode the lowest privilege level allowed to execute it.
+        const auto xret_privilege
+            = static_cast<CSR::PrivilegeLevel>(get_bits(dt.inst.data(), 29, 28));
+        if ((flags & IMF_XRET) && control_state->get_privilege_level() < xret_privilege) {
+            excause = EXCAUSE_INSN_ILLEGAL;
+        }
+    }
+    RegisterValue csr_read_val
+        = (control_state != nullptr && (flags & IMF_CSR) && excause == EXCAUSE_NONE)
+              ? control_state->read(csr_address)
+              : 0;
 
     if ((flags & IMF_EXCEPTION) && (excause == EXCAUSE_NONE)) {
         if (flags & IMF_EBREAK) {
             excause = EXCAUSE_BREAK;
         } else if (flags & IMF_ECALL) {
             excause = EXCAUSE_ECALL_M;
-            // TODO: EXCAUSE_ECALL_S, EXCAUSE_ECALL_U
+            if (control_state != nullptr) {
+                switch (control_state->get_privilege_level()) {
+                case CSR::PrivilegeLevel::UNPRIVILEGED: excause = EXCAUSE_ECALL_U; break;
+                case CSR::PrivilegeLevel::SUPERVISOR: excause = EXCAUSE_ECALL_S; break;
+                default: break;
+                }
+            }
         }
     }
     if (flags & IMF_FORCE_W_OP)
@@ -350,6 +490,7 @@ DecodeState Core::decode(const FetchInterstage &dt) {
              },
              DecodeInterstage { .inst = dt.inst,
                                 .inst_addr = dt.inst_addr,
+                                .seq = dt.seq,
                                 .next_inst_addr = dt.next_inst_addr,
                                 .predicted_next_inst_addr = dt.predicted_next_inst_addr,
                                 .val_rs = val_rs,
@@ -388,7 +529,8 @@ DecodeState Core::decode(const FetchInterstage &dt) {
                                 .csr_to_alu = bool(flags & IMF_CSR_TO_ALU),
                                 .csr_write = csr_write,
                                 .xret = bool(flags & IMF_XRET),
-                                .insert_stall_before = bool(flags & IMF_CSR) } };
+                                .insert_stall_before = bool(flags & IMF_CSR),
+                                .bubble_cause = dt.bubble_cause } };
 }
 
 ExecuteState Core::execute(const DecodeInterstage &dt) {
@@ -434,6 +576,7 @@ ExecuteState Core::execute(const DecodeInterstage &dt) {
              ExecuteInterstage {
                  .inst = dt.inst,
                  .inst_addr = dt.inst_addr,
+                 .seq = dt.seq,
                  .next_inst_addr = dt.next_inst_addr,
                  .predicted_next_inst_addr = dt.predicted_next_inst_addr,
                  .branch_jal_target = branch_jal_target,
@@ -457,6 +600,7 @@ ExecuteState Core::execute(const DecodeInterstage &dt) {
                  .csr = dt.csr,
                  .csr_write = dt.csr_write,
                  .xret = dt.xret,
+                 .bubble_cause = dt.bubble_cause,
              } };
 }
 
@@ -469,20 +613,40 @@ MemoryState Core::memory(const ExecuteInterstage &dt) {
     Address computed_next_inst_addr;
 
     enum ExceptionCause excause = dt.excause;
+    // Physical address of the access, mem_addr is kept virtual for exception reporting.
+    Address mem_paddr = mem_addr;
+    if (excause == EXCAUSE_NONE && mmu != nullptr && (memread || memwrite)) {
+        excause = mmu->translate(
+            mem_addr, access_control_size(dt.memctl),
+            memwrite ? MemoryAccessKind::STORE : MemoryAccessKind::LOAD, mem_paddr);
+    }
+    if (excause == EXCAUSE_NONE && pmp != nullptr && (memread || memwrite)) {
+        excause = pmp->check(
+            mem_paddr, access_control_size(dt.memctl),
+            memwrite ? MemoryAccessKind::STORE : MemoryAccessKind::LOAD, memread && memwrite);
+    }
     if (excause == EXCAUSE_NONE) {
         if (is_special_access(dt.memctl)) {
             excause = memory_special(
-                dt.memctl, dt.inst.rt(), memread, memwrite, towrite_val, dt.val_rt, mem_addr);
+                dt.memctl, dt.inst.rt(), memread, memwrite, towrite_val, dt.val_rt, mem_paddr,
+                dt.inst_addr);
         } else if (is_regular_access(dt.memctl)) {
-            if (memwrite) { mem_data->write_ctl(dt.memctl, mem_addr, dt.val_rt); }
-            if (memread) { towrite_val = mem_data->read_ctl(dt.memctl, mem_addr); }
+            const unsigned size = access_control_size(dt.memctl);
+            if (memwrite) {
+                notify_memory_access(MemoryAccessKind::STORE, mem_paddr, size, dt.inst_addr);
+                mem_data->write_ctl(dt.memctl, mem_paddr, dt.val_rt);
+            }
+            if (memread) {
+                notify_memory_access(MemoryAccessKind::LOAD, mem_paddr, size, dt.inst_addr);
+                towrite_val = mem_data->read_ctl(dt.memctl, mem_paddr);
+            }
         } else {
             Q_ASSERT(dt.memctl == AC_NONE);
             // AC_NONE is memory NOP
         }
     }
 
-    if (dt.excause != EXCAUSE_NONE) {
+    if (excause != EXCAUSE_NONE) {
         memread = false;
         memwrite = false;
         regwrite = false;
@@ -495,9 +659,20 @@ MemoryState Core::memory(const ExecuteInterstage &dt) {
 
     computed_next_inst_addr = compute_next_inst_addr(dt, branch_bxx_taken);
 
-    bool csr_written = false;
-    if (control_state != nullptr && dt.is_valid && dt.excause == EXCAUSE_NONE) {
-        control_state->increment_internal(CSR::Id::MINSTRET, 1);
+    if (dt.is_valid && excause == EXCAUSE_NONE) { notify_instruction_retired(dt.inst_addr); }
+
+    // Instructions fetched after sfence.vma have to be translated again.
+    bool csr_written = dt.memctl == AC_SFENCE_VMA && excause == EXCAUSE_NONE;
+    if (control_state != nullptr && dt.is_valid && excause == EXCAUSE_NONE) {
+        hpm_events[CSR::HpmEvent::INSTRUCTIONS]++;
+        if (is_regular_access(dt.memctl)) {
+            hpm_events[memwrite ? CSR::HpmEvent::STORES : CSR::HpmEvent::LOADS]++;
+        } else if (is_amo_access(dt.memctl)) {
+            hpm_events[CSR::HpmEvent::AMOS]++;
+        }
+        if (dt.branch_bxx || dt.branch_jal || dt.branch_jalr) {
+            hpm_events[CSR::HpmEvent::BRANCHES]++;
+        }
         if (dt.csr_write) {
             control_state->write(dt.csr_address, dt.alu_val);
             csr_written = true;
@@ -530,6 +705,7 @@ MemoryState Core::memory(const ExecuteInterstage &dt) {
              MemoryInterstage {
                  .inst = dt.inst,
                  .inst_addr = dt.inst_addr,
+                 .seq = dt.seq,
                  .next_inst_addr = dt.next_inst_addr,
                  .predicted_next_inst_addr = dt.predicted_next_inst_addr,
                  .computed_next_inst_addr = computed_next_inst_addr,
@@ -539,12 +715,13 @@ MemoryState Core::memory(const ExecuteInterstage &dt) {
                      if (dt.branch_jalr || dt.branch_jal) return dt.next_inst_addr.get_raw();
                      return towrite_val;
                  }(),
-                 .excause = dt.excause,
+                 .excause = excause,
                  .num_rd = dt.num_rd,
                  .memtoreg = memread,
                  .regwrite = regwrite,
                  .is_valid = dt.is_valid,
                  .csr_written = csr_written,
+                 .bubble_cause = dt.bubble_cause,
              } };
 }
 
@@ -554,6 +731,7 @@ WritebackState Core::writeback(const MemoryInterstage &dt) {
     return WritebackState { WritebackInternalState {
         .inst = (dt.excause == EXCAUSE_NONE)? dt.inst: Instruction::NOP,
         .inst_addr = dt.inst_addr,
+        .seq = dt.seq,
         .value = dt.towrite_val,
         .num_rd = dt.num_rd,
         .regwrite = dt.regwrite,
@@ -637,11 +815,11 @@ void CorePipelined::do_step(bool skip_break) {
     p.fetch = fetch(pc_if, skip_break);
 
     bool exception_in_progress = mem_wb.excause != EXCAUSE_NONE;
-    if (exception_in_progress) { ex_mem.flush(); }
+    if (exception_in_progress) { ex_mem.flush(CpiComponent::EXCEPTION); }
     exception_in_progress |= ex_mem.excause != EXCAUSE_NONE;
-    if (exception_in_progress) { id_ex.flush(); }
+    if (exception_in_progress) { id_ex.flush(CpiComponent::EXCEPTION); }
     exception_in_progress |= id_ex.excause != EXCAUSE_NONE;
-    if (exception_in_progress) { if_id.flush(); }
+    if (exception_in_progress) { if_id.flush(CpiComponent::EXCEPTION); }
 
     bool stall = false;
     if (hazard_unit != MachineConfig::HU_NONE) { stall |= handle_data_hazards(); }
@@ -659,7 +837,9 @@ void CorePipelined::do_step(bool skip_break) {
     } else if (detect_mispredicted_jump() || mem_wb.csr_written) {
         /* If the jump was predicted incorrectly or csr register was written, we need to flush the
          * pipeline. */
-        flush_and_continue_from_address(mem_wb.computed_next_inst_addr);
+        flush_and_continue_from_address(
+            mem_wb.computed_next_inst_addr,
+            mem_wb.csr_written ? CpiComponent::CSR_FLUSH : CpiComponent::MISPREDICTION);
     } else if (exception_in_progress) {
         /* An exception is in progress which caused the pipeline before the exception to be flushed.
          * Therefore, next pc cannot be determined from if_id (now NOP).
@@ -668,21 +848,28 @@ void CorePipelined::do_step(bool skip_break) {
         pc_if.stop_if = true;
     } else if (stall || is_stall_requested()) {
         /* Fetch from the same PC is repeated due to stall in the pipeline. */
-        handle_stall(saved_if_id);
+        CpiComponent cause = CpiComponent::CSR_SERIALIZATION;
+        if (stall) {
+            // With forwarding, only a load result needed in EX stalls the pipeline.
+            cause = (hazard_unit == MachineConfig::HU_STALL_FORWARD) ? CpiComponent::LOAD_USE
+                                                                     : CpiComponent::RAW_STALL;
+        }
+        handle_stall(saved_if_id, cause);
     } else {
         /* Normal execution. */
         regs->write_pc(if_id.predicted_next_inst_addr);
     }
 }
 
-void CorePipelined::flush_and_continue_from_address(Address next_pc) {
+void CorePipelined::flush_and_continue_from_address(Address next_pc, CpiComponent cause) {
     regs->write_pc(next_pc);
-    if_id.flush();
-    id_ex.flush();
-    ex_mem.flush();
+    if (cause == CpiComponent::MISPREDICTION) { hpm_events[CSR::HpmEvent::BRANCH_MISPREDICTS]++; }
+    if_id.flush(cause);
+    id_ex.flush(cause);
+    ex_mem.flush(cause);
 }
 
-void CorePipelined::handle_stall(const FetchInterstage &saved_if_id) {
+void CorePipelined::handle_stall(const FetchInterstage &saved_if_id, CpiComponent cause) {
     /*
      * Stall handing:
      * - IF fetches new instruction, but it is not allowed to save into IF/ID register. This is
@@ -693,7 +880,7 @@ void CorePipelined::handle_stall(const FetchInterstage &saved_if_id) {
      * as ID repeats its execution.
      */
     if_id = saved_if_id;
-    id_ex.flush();
+    id_ex.flush(cause);
     id_ex.stall = true; // for visualization
     state.stall_count++;
 }
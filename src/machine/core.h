@@ -3,11 +3,15 @@
 
 #include "common/memory_ownership.h"
 #include "core/core_state.h"
+#include "core/memory_access_observer.h"
 #include "csr/controlstate.h"
 #include "instruction.h"
 #include "machineconfig.h"
 #include "memory/address.h"
+#include "memory/cache/cache.h"
 #include "memory/frontend_memory.h"
+#include "memory/mmu/mmu.h"
+#include "memory/pmp/pmp.h"
 #include "pipeline.h"
 #include "predictor.h"
 #include "register_value.h"
@@ -15,6 +19,7 @@
 #include "simulator_exception.h"
 
 #include <QObject>
+#include <vector>
 
 namespace machine {
 
@@ -41,12 +46,30 @@ public:
 
     unsigned get_cycle_count() const;
     unsigned get_stall_count() const;
+    /** Cycles by CPI stack component, indexed by `CpiComponent`. */
+    const CpiStack &get_cpi_stack() const;
 
     Registers *get_regs() const;
     CSR::ControlState *get_control_state() const;
     Predictor *get_predictor() const;
     FrontendMemory *get_mem_data() const;
     FrontendMemory *get_mem_program() const;
+    /**
+     * Virtual memory translation of fetches and data accesses. Without MMU
+     * (default) all addresses are physical. Core does not take ownership.
+     */
+    void set_mmu(Mmu *mmu);
+    Mmu *get_mmu() const;
+    /**
+     * Physical memory protection checked after translation. Without it all
+     * accesses are permitted. Core does not take ownership.
+     */
+    void set_pmp(Pmp *pmp);
+    /**
+     * Caches whose hits and misses are counted by performance monitor events. Any of them may
+     * be null. Core does not take ownership.
+     */
+    void set_hpm_caches(const Cache *program, const Cache *data, const Cache *level2);
     const CoreState &get_state() const;
     Xlen get_xlen() const;
 
@@ -59,6 +82,13 @@ public:
     void set_step_over_exception(enum ExceptionCause excause, bool value);
     bool get_step_over_exception(enum ExceptionCause excause) const;
 
+    /**
+     * Observers are notified about every fetch, load and store issued by the core.
+     * Core does not take ownership of the observer.
+     */
+    void add_memory_access_observer(MemoryAccessObserver *observer);
+    void remove_memory_access_observer(MemoryAccessObserver *observer);
+
     /**
      * Abstracts XLEN from code flow. XLEN core will obtain XLEN value from register value.
      * The value will be zero extended to u64.
@@ -98,6 +128,11 @@ protected:
     virtual void do_step(bool skip_break) = 0;
     virtual void do_reset() = 0;
 
+    /** Charge the cycle to the instruction or bubble leaving the memory stage. */
+    CpiComponent account_cpi_component();
+    /** Pass events of the finished cycle to the performance monitor counters. */
+    void count_hpm_events(CpiComponent component);
+
     bool handle_exception(
         ExceptionCause excause,
         const Instruction &inst,
@@ -113,12 +148,38 @@ protected:
     BORROWED CSR::ControlState *const control_state;
     BORROWED Predictor *const predictor;
     BORROWED FrontendMemory *const mem_data, *const mem_program;
+    BORROWED Mmu *mmu = nullptr;
+    BORROWED Pmp *pmp = nullptr;
 
     array<bool, EXCAUSE_COUNT> stop_on_exception {};
     array<bool, EXCAUSE_COUNT> step_over_exception {};
     QMap<Address, OWNED hwBreak *> hw_breaks {};
     QMap<ExceptionCause, OWNED ExceptionHandler *> ex_handlers;
     Box<ExceptionHandler> ex_default_handler;
+    std::vector<BORROWED MemoryAccessObserver *> access_observers;
+
+    /** Events of the current cycle, they are passed to the counters once per step. */
+    CSR::HpmEventCounts hpm_events {};
+    /** Program, data and level 2 cache. */
+    array<BORROWED const Cache *, 3> hpm_caches {};
+    /** Hit and miss counts of `hpm_caches` seen by the previous step. */
+    array<uint32_t, 6> hpm_cache_counts {};
+
+    void notify_memory_access(
+        MemoryAccessKind kind,
+        Address address,
+        unsigned size,
+        Address inst_addr) const {
+        for (auto observer : access_observers) {
+            observer->memory_access(kind, address, size, inst_addr);
+        }
+    }
+
+    void notify_instruction_retired(Address inst_addr) const {
+        for (auto observer : access_observers) {
+            observer->instruction_retired(inst_addr);
+        }
+    }
 
     FetchState fetch(PCInterstage pc, bool skip_break);
     DecodeState decode(const FetchInterstage &);
@@ -139,7 +200,8 @@ protected:
         bool memwrite,
         RegisterValue &towrite_val,
         RegisterValue rt_value,
-        Address mem_addr);
+        Address mem_addr,
+        Address inst_addr);
 };
 
 class CoreSingle : public Core {
@@ -190,15 +252,16 @@ private:
      * Typical examples are csr modifying instructions. */
     bool is_stall_requested() const;
 
-    void handle_stall(const FetchInterstage &saved_if_id);
+    void handle_stall(const FetchInterstage &saved_if_id, CpiComponent cause);
     /**
      * Typically, problem in execution is discovered in memory stage. This function flushed all
      * stages containing instructions, that would not execute in a single cycle CPU and continues
      * execution from given address.
      *
      * @param next_pc   address to continue execution from
+     * @param cause     reason of the bubbles replacing the flushed instructions
      */
-    void flush_and_continue_from_address(Address next_pc);
+    void flush_and_continue_from_address(Address next_pc, CpiComponent cause);
 };
 
 class ExceptionHandler : public QObject {
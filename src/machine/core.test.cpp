@@ -5,6 +5,10 @@
 #include "machine/memory/backend/memory.h"
 #include "machine/memory/cache/cache.h"
 #include "machine/memory/memory_bus.h"
+#include "machine/memory/mmu/mmu.h"
+#include "machine/profiler/call_profile.h"
+#include "machine/profiler/flat_profile.h"
+#include "machine/symboltable.h"
 
 #include <QVector>
 
@@ -1104,4 +1108,447 @@ void TestCore::pipecore_extension_m() {
     test_program_with_single_result<CorePipelined>();
 }
 
+// Sv32 virtual memory
+
+static void mmu_data() {
+    QTest::addColumn<unsigned>("load_address");
+    QTest::addColumn<unsigned>("x10_result");
+    QTest::addColumn<unsigned>("cause");
+
+    QTest::addRow("mapped") << 0x20000u << 0x1234u << 0u;
+    QTest::addRow("unmapped") << 0x30000u << 0u << (unsigned)EXCAUSE_LOAD_PAGE_FAULT;
+}
+
+template<typename Core>
+static void test_mmu() {
+    QFETCH(unsigned, load_address);
+    QFETCH(unsigned, x10_result);
+    QFETCH(unsigned, cause);
+
+    Memory memory_backend(BIG);
+    TrivialBus memory(&memory_backend);
+    // Root table at 0x1000 points to the second level table at 0x2000. Code page 0x10000
+    // maps to 0x4000, data page 0x20000 maps to 0x5000.
+    memory.write_u32(0x1000_addr, (2 << 10) | 0x01);
+    memory.write_u32(Address(0x2000 + 0x10 * 4), (4 << 10) | 0xcb);
+    memory.write_u32(Address(0x2000 + 0x20 * 4), (5 << 10) | 0xc7);
+    memory.write_u32(0x5000_addr, 0x1234);
+    compile_simple_program(
+        memory, 0x4000_addr, { "lw x10, 0(x1)", "nop", "nop", "nop", "nop", "nop" });
+
+    Registers registers {};
+    registers.write_gp(1, load_address);
+    registers.write_pc(0x10000_addr);
+    FalsePredictor predictor {};
+    CSR::ControlState controlst(Xlen::_32, config_isa_word_default | ConfigIsaWord::byChar('S'));
+    Core core(&registers, &predictor, &memory, &memory, &controlst, Xlen::_32, config_isa_word_default);
+    Mmu mmu(&memory, &controlst, Xlen::_32, MachineConfig());
+    core.set_mmu(&mmu);
+    controlst.write_internal(CSR::Id::SATP, ((uint64_t)1 << 31) | 1);
+    controlst.set_privilege_level(CSR::PrivilegeLevel::SUPERVISOR);
+
+    for (size_t i = 0; i < 5; i++) {
+        core.step();
+    }
+    QCOMPARE(registers.read_gp(10).as_u32(), x10_result);
+    QCOMPARE(controlst.read_internal(CSR::Id::MCAUSE).as_u32(), cause);
+    if (cause != 0) { QCOMPARE(controlst.read_internal(CSR::Id::MTVAL).as_u32(), load_address); }
+    QCOMPARE(mmu.get_tlb_data().get_miss_count(), 1u);
+    QCOMPARE(mmu.get_tlb_program().get_miss_count(), 1u);
+}
+
+void TestCore::singlecore_mmu_data() {
+    mmu_data();
+}
+
+void TestCore::pipecore_mmu_data() {
+    mmu_data();
+}
+
+void TestCore::singlecore_mmu() {
+    test_mmu<CoreSingle>();
+}
+
+void TestCore::pipecore_mmu() {
+    test_mmu<CorePipelined>();
+}
+
+// Privilege levels
+
+static void privilege_data() {
+    QTest::addColumn<QString>("instruction");
+    QTest::addColumn<unsigned>("privilege");
+    QTest::addColumn<unsigned>("cause");
+
+    const auto user = static_cast<unsigned>(CSR::PrivilegeLevel::UNPRIVILEGED);
+    const auto supervisor = static_cast<unsigned>(CSR::PrivilegeLevel::SUPERVISOR);
+    const auto illegal = static_cast<unsigned>(EXCAUSE_INSN_ILLEGAL);
+    QTest::addRow("user csr") << "csrrs x1, cycle, x0" << user << 0u;
+    QTest::addRow("machine csr in user") << "csrrs x1, mstatus, x0" << user << illegal;
+    QTest::addRow("supervisor csr in user") << "csrrs x1, satp, x0" << user << illegal;
+    QTest::addRow("supervisor csr") << "csrrs x1, satp, x0" << supervisor << 0u;
+    QTest::addRow("read-only csr write") << "csrrw x0, cycle, x1" << user << illegal;
+    QTest::addRow("mret in user") << "mret" << user << illegal;
+    QTest::addRow("mret in supervisor") << "mret" << supervisor << illegal;
+    QTest::addRow("sret in user") << "sret" << user << illegal;
+}
+
+template<typename Core>
+static void test_privilege() {
+    QFETCH(QString, instruction);
+    QFETCH(unsigned, privilege);
+    QFETCH(unsigned, cause);
+
+    Memory memory_backend(BIG);
+    TrivialBus memory(&memory_backend);
+    compile_simple_program(memory, 0x200_addr, { instruction, "nop", "nop", "nop", "nop", "nop" });
+    compile_simple_program(memory, 0x300_addr, { "nop", "nop", "nop", "nop", "nop", "nop" });
+
+    Registers registers {};
+    registers.write_pc(0x200_addr);
+    FalsePredictor predictor {};
+    CSR::ControlState controlst(Xlen::_32, config_isa_word_default | ConfigIsaWord::byChar('S'));
+    Core core(&registers, &predictor, &memory, &memory, &controlst, Xlen::_32, config_isa_word_default);
+    core.set_step_over_exception(EXCAUSE_INSN_ILLEGAL, false);
+    controlst.write_internal(CSR::Id::MTVEC, 0x300);
+    controlst.set_privilege_level(static_cast<CSR::PrivilegeLevel>(privilege));
+
+    for (size_t i = 0; i < 6; i++) {
+        core.step();
+    }
+    QCOMPARE(controlst.read_internal(CSR::Id::MCAUSE).as_u32(), cause);
+    if (cause != 0) {
+        QCOMPARE(controlst.read_internal(CSR::Id::MEPC).as_u32(), 0x200u);
+        QCOMPARE(controlst.read_internal(CSR::Id::MTVAL).as_u32(), memory.read_u32(0x200_addr));
+        QCOMPARE(
+            static_cast<unsigned>(controlst.get_privilege_level()),
+            static_cast<unsigned>(CSR::PrivilegeLevel::MACHINE));
+    } else {
+        QCOMPARE(static_cast<unsigned>(controlst.get_privilege_level()), privilege);
+    }
+}
+
+void TestCore::singlecore_privilege_data() {
+    privilege_data();
+}
+
+void TestCore::pipecore_privilege_data() {
+    privilege_data();
+}
+
+void TestCore::singlecore_privilege() {
+    test_privilege<CoreSingle>();
+}
+
+void TestCore::pipecore_privilege() {
+    test_privilege<CorePipelined>();
+}
+
+// Physical memory protection
+
+static void pmp_data() {
+    QTest::addColumn<QString>("instruction");
+    QTest::addColumn<bool>("machine_mode");
+    QTest::addColumn<unsigned>("address");
+    QTest::addColumn<unsigned>("x10_result");
+    QTest::addColumn<unsigned>("cause");
+
+    QTest::addRow("read-only load") << "lw x10, 0(x1)" << false << 0x2000u << 0x1234u << 0u;
+    QTest::addRow("read-only store")
+        << "sw x2, 0(x1)" << false << 0x2000u << 0u << (unsigned)EXCAUSE_STORE_FAULT;
+    QTest::addRow("no entry") << "lw x10, 0(x1)" << false << 0x3000u << 0u
+                              << (unsigned)EXCAUSE_LOAD_FAULT;
+    QTest::addRow("partial match") << "lw x10, 0(x1)" << false << 0x2ffeu << 0u
+                                   << (unsigned)EXCAUSE_LOAD_FAULT;
+    QTest::addRow("machine mode") << "lw x10, 0(x1)" << true << 0x3000u << 0x5678u << 0u;
+}
+
+template<typename Core>
+static void test_pmp() {
+    QFETCH(QString, instruction);
+    QFETCH(bool, machine_mode);
+    QFETCH(unsigned, address);
+    QFETCH(unsigned, x10_result);
+    QFETCH(unsigned, cause);
+
+    Memory memory_backend(BIG);
+    TrivialBus memory(&memory_backend);
+    memory.write_u32(0x2000_addr, 0x1234);
+    memory.write_u32(0x3000_addr, 0x5678);
+    compile_simple_program(memory, 0x200_addr, { instruction, "nop", "nop", "nop", "nop", "nop" });
+
+    Registers registers {};
+    registers.write_gp(1, address);
+    registers.write_gp(2, 0xabcd);
+    registers.write_pc(0x200_addr);
+    FalsePredictor predictor {};
+    CSR::ControlState controlst(Xlen::_32, config_isa_word_default | ConfigIsaWord::byChar('S'));
+    Core core(&registers, &predictor, &memory, &memory, &controlst, Xlen::_32, config_isa_word_default);
+    Pmp pmp(&controlst);
+    core.set_pmp(&pmp);
+    // Entry 0: code below 0x1000 (TOR, RX), entry 1: 0x2000-0x2fff (NAPOT, R).
+    controlst.write_internal(CSR::Id::PMPADDR0, 0x1000 >> 2);
+    controlst.write_internal(CSR::Id::PMPADDR1, (0x2000 >> 2) | ((0x1000 >> 3) - 1));
+    controlst.write_internal(CSR::Id::PMPCFG0, 0x0d | (0x19 << 8));
+    if (!machine_mode) { controlst.set_privilege_level(CSR::PrivilegeLevel::UNPRIVILEGED); }
+
+    for (size_t i = 0; i < 5; i++) {
+        core.step();
+    }
+    QCOMPARE(registers.read_gp(10).as_u32(), x10_result);
+    QCOMPARE(controlst.read_internal(CSR::Id::MCAUSE).as_u32(), cause);
+    if (cause != 0) { QCOMPARE(controlst.read_internal(CSR::Id::MTVAL).as_u32(), address); }
+    QCOMPARE(memory.read_u32(0x2000_addr), 0x1234u);
+    QVERIFY(pmp.get_cache_hit_count() > 0);
+}
+
+void TestCore::singlecore_pmp_data() {
+    pmp_data();
+}
+
+void TestCore::pipecore_pmp_data() {
+    pmp_data();
+}
+
+void TestCore::singlecore_pmp() {
+    test_pmp<CoreSingle>();
+}
+
+void TestCore::pipecore_pmp() {
+    test_pmp<CorePipelined>();
+}
+
+// Execution profile
+
+template<typename Core>
+static void test_profile() {
+    constexpr bool pipelined = std::is_same<Core, CorePipelined>::value;
+    Memory memory_backend(BIG);
+    TrivialBus memory(&memory_backend);
+    memory.write_u32(0x100_addr, 7);
+    compile_simple_program(
+        memory, 0x200_addr,
+        { "addi x1, x0, 0x100", "lw x2, 0(x1)", "add x3, x2, x2", "nop", "nop", "nop", "nop",
+          "nop" });
+
+    Registers registers {};
+    registers.write_pc(0x200_addr);
+    FalsePredictor predictor {};
+    CSR::ControlState controlst {};
+    Core core(&registers, &predictor, &memory, &memory, &controlst, Xlen::_32, config_isa_word_default);
+    FlatProfile profile;
+    for (size_t i = 0; i < 8; i++) {
+        core.step();
+        profile.record_step(core.get_state(), 0, 0);
+    }
+    QCOMPARE(registers.read_gp(3).as_u32(), 14u);
+
+    for (Address pc : { 0x200_addr, 0x204_addr, 0x208_addr }) {
+        QVERIFY(profile.find(pc) != nullptr);
+        QCOMPARE(profile.find(pc)->retired, (uint64_t)1);
+    }
+    // Pipeline fill is paid by the first instruction, load-use stall by the dependent one.
+    QCOMPARE(profile.find(0x200_addr)->cycles, (uint64_t)(pipelined ? 4 : 1));
+    QCOMPARE(profile.find(0x208_addr)->stalls, (uint64_t)(pipelined ? 1 : 0));
+    QCOMPARE(profile.find(0x208_addr)->cycles, (uint64_t)(pipelined ? 2 : 1));
+    QCOMPARE(profile.get_total().cycles, (uint64_t)8);
+    QVERIFY(profile.find(0x10000_addr) == nullptr);
+
+    SymbolTable symtab;
+    symtab.add_symbol("first", 0x200, 8);
+    symtab.add_symbol("second", 0x208, 0);
+    const std::vector<ProfileSymbol> symbols = profile.by_symbol(&symtab);
+    QCOMPARE(symbols.size(), (size_t)2);
+    const ProfileSymbol &first = (symbols[0].name == "first") ? symbols[0] : symbols[1];
+    const ProfileSymbol &second = (symbols[0].name == "first") ? symbols[1] : symbols[0];
+    QCOMPARE(first.name, QString("first"));
+    QCOMPARE(first.counters.retired, (uint64_t)2);
+    QCOMPARE(second.name, QString("second"));
+    QCOMPARE(second.counters.retired, profile.get_total().retired - 2);
+}
+
+void TestCore::singlecore_profile() {
+    test_profile<CoreSingle>();
+}
+
+void TestCore::pipecore_profile() {
+    test_profile<CorePipelined>();
+}
+
+template<typename Core>
+static void test_call_profile() {
+    Memory memory_backend(BIG);
+    TrivialBus memory(&memory_backend);
+    compile_simple_program(
+        memory, 0x200_addr, { "jal x1, 0x210", "addi x4, x0, 1", "nop", "nop" });
+    compile_simple_program(
+        memory, 0x210_addr, { "addi x3, x0, 5", "jalr x0, 0(x1)", "nop", "nop", "nop" });
+
+    Registers registers {};
+    registers.write_pc(0x200_addr);
+    FalsePredictor predictor {};
+    CSR::ControlState controlst {};
+    Core core(&registers, &predictor, &memory, &memory, &controlst, Xlen::_32, config_isa_word_default);
+    SymbolTable symtab;
+    symtab.add_symbol("main", 0x200, 0x10);
+    symtab.add_symbol("callee", 0x210, 8);
+    CallProfile profile(&symtab, &controlst);
+    uint64_t steps = 0;
+    do {
+        core.step();
+        profile.record_step(core.get_state(), 0, 0);
+        steps++;
+    } while (core.get_state().pipeline.memory.result.inst_addr != 0x204_addr && steps < 20);
+    QCOMPARE(registers.read_gp(3).as_u32(), 5u);
+    QCOMPARE(profile.get_depth(), (size_t)1);
+
+    const std::vector<CallPath> paths = profile.get_paths();
+    QCOMPARE(paths.size(), (size_t)2);
+    QCOMPARE(paths[0].frames, std::vector<QString>({ "main" }));
+    QCOMPARE(paths[0].self.retired, (uint64_t)2);
+    QCOMPARE(paths[0].inclusive.cycles, steps);
+    QCOMPARE(paths[1].frames, std::vector<QString>({ "main", "callee" }));
+    QCOMPARE(paths[1].calls, (uint64_t)1);
+    QCOMPARE(paths[1].self.retired, (uint64_t)2);
+    QCOMPARE(paths[1].inclusive.cycles, paths[1].self.cycles);
+}
+
+void TestCore::singlecore_call_profile() {
+    test_call_profile<CoreSingle>();
+}
+
+void TestCore::pipecore_call_profile() {
+    test_call_profile<CorePipelined>();
+}
+
+// CPI stack
+
+static uint64_t cpi_cycles(const Core &core, CpiComponent component) {
+    return core.get_cpi_stack()[static_cast<size_t>(component)];
+}
+
+template<typename Core>
+static void test_cpi_stack() {
+    constexpr bool pipelined = std::is_same<Core, CorePipelined>::value;
+    Memory memory_backend(BIG);
+    TrivialBus memory(&memory_backend);
+    memory.write_u32(0x100_addr, 7);
+    compile_simple_program(
+        memory, 0x200_addr,
+        { "addi x1, x0, 0x100", "lw x2, 0(x1)", "add x3, x2, x2", "jal x0, 0x220", "nop", "nop",
+          "nop", "nop", "nop", "nop", "nop", "nop", "nop", "nop" });
+
+    Registers registers {};
+    registers.write_pc(0x200_addr);
+    FalsePredictor predictor {};
+    CSR::ControlState controlst {};
+    Core core(&registers, &predictor, &memory, &memory, &controlst, Xlen::_32, config_isa_word_default);
+    for (size_t i = 0; i < 12; i++) {
+        core.step();
+    }
+    QCOMPARE(registers.read_gp(3).as_u32(), 14u);
+
+    uint64_t total = 0;
+    for (uint64_t cycles : core.get_cpi_stack()) {
+        total += cycles;
+    }
+    QCOMPARE(total, (uint64_t)core.get_cycle_count());
+    QCOMPARE(cpi_cycles(core, CpiComponent::PIPELINE_FILL), (uint64_t)(pipelined ? 3 : 0));
+    QCOMPARE(cpi_cycles(core, CpiComponent::LOAD_USE), (uint64_t)(pipelined ? 1 : 0));
+    // Not taken prediction of the jump flushes three fetched instructions.
+    QCOMPARE(cpi_cycles(core, CpiComponent::MISPREDICTION), (uint64_t)(pipelined ? 3 : 0));
+    QCOMPARE(cpi_cycles(core, CpiComponent::BASE), (uint64_t)(pipelined ? 5 : 12));
+}
+
+void TestCore::singlecore_cpi_stack() {
+    test_cpi_stack<CoreSingle>();
+}
+
+void TestCore::pipecore_cpi_stack() {
+    test_cpi_stack<CorePipelined>();
+}
+
+template<typename Core>
+static void test_hpm_counters() {
+    Memory memory_backend(BIG);
+    TrivialBus memory(&memory_backend);
+    memory.write_u32(0x100_addr, 7);
+    compile_simple_program(
+        memory, 0x200_addr,
+        { "addi x1, x0, 0x100", "lw x2, 0(x1)", "add x3, x2, x2", "csrrw x0, minstret, x1",
+          "csrrs x4, minstret, x0", "csrrs x5, hpmcounter31, x0", "nop", "nop", "nop", "nop", "nop",
+          "nop", "nop", "nop", "nop", "nop", "nop", "nop", "nop", "nop", "nop", "nop" });
+
+    Registers registers {};
+    registers.write_pc(0x200_addr);
+    FalsePredictor predictor {};
+    CSR::ControlState controlst {};
+    Core core(&registers, &predictor, &memory, &memory, &controlst, Xlen::_32, config_isa_word_default);
+    controlst.write(CSR::Address(0x33F), CSR::HpmEvent::LOADS);
+    controlst.write(CSR::Address(0x324), CSR::HpmEvent::INSTRUCTIONS);
+    controlst.write(CSR::Address(0x325), 0xfff);
+    controlst.write(CSR::Address(0x320), 1 << 4);
+    for (size_t i = 0; i < 16; i++) {
+        core.step();
+    }
+
+    // Written value is read by the next instruction, the writing one is not counted.
+    QCOMPARE(registers.read_gp(4).as_u32(), 0x100u);
+    QCOMPARE(registers.read_gp(5).as_u32(), 1u);
+    QCOMPARE(controlst.read(CSR::Address(0xB00)).as_u64(), (uint64_t)16);
+    QCOMPARE(controlst.read(CSR::Address(0xC00)).as_u64(), (uint64_t)16);
+    QCOMPARE(controlst.read(CSR::Address(0xC02)), controlst.read(CSR::Address(0xB02)));
+    // Inhibited counter and unsupported event.
+    QCOMPARE(controlst.read(CSR::Address(0xB04)).as_u64(), (uint64_t)0);
+    QCOMPARE(controlst.read(CSR::Address(0x325)).as_u64(), (uint64_t)CSR::HpmEvent::NONE);
+}
+
+void TestCore::singlecore_hpm_counters() {
+    test_hpm_counters<CoreSingle>();
+}
+
+void TestCore::pipecore_hpm_counters() {
+    test_hpm_counters<CorePipelined>();
+}
+
+template<typename Core>
+static void test_fetch_seq() {
+    constexpr bool pipelined = std::is_same<Core, CorePipelined>::value;
+    Memory memory_backend(BIG);
+    TrivialBus memory(&memory_backend);
+    memory.write_u32(0x100_addr, 7);
+    compile_simple_program(
+        memory, 0x200_addr,
+        { "addi x1, x0, 0x100", "lw x2, 0(x1)", "add x3, x2, x2", "jal x0, 0x220", "nop", "nop",
+          "nop", "nop", "nop", "nop", "nop", "nop", "nop", "nop" });
+
+    Registers registers {};
+    registers.write_pc(0x200_addr);
+    FalsePredictor predictor {};
+    CSR::ControlState controlst {};
+    Core core(&registers, &predictor, &memory, &memory, &controlst, Xlen::_32, config_isa_word_default);
+    std::vector<uint64_t> retired;
+    for (size_t i = 0; i < 12; i++) {
+        core.step();
+        const MemoryInterstage &mem = core.get_state().pipeline.memory.result;
+        if (mem.is_valid && mem.excause == EXCAUSE_NONE) { retired.push_back(mem.seq); }
+    }
+
+    QCOMPARE(core.get_state().fetch_seq, (uint64_t)12);
+    // Stall fetches the add again, the jump flushes three fetched instructions.
+    const std::vector<uint64_t> expected = pipelined
+                                               ? std::vector<uint64_t> { 1, 2, 3, 5, 9 }
+                                               : std::vector<uint64_t> { 1, 2,  3,  4, 5, 6,
+                                                                         7, 8, 9, 10, 11, 12 };
+    QCOMPARE(retired, expected);
+}
+
+void TestCore::singlecore_fetch_seq() {
+    test_fetch_seq<CoreSingle>();
+}
+
+void TestCore::pipecore_fetch_seq() {
+    test_fetch_seq<CorePipelined>();
+}
+
 QTEST_APPLESS_MAIN(TestCore)
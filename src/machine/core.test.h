@@ -45,6 +45,38 @@ private slots:
     void pipecore_extension_m_data();
     void singlecore_extension_m();
     void pipecore_extension_m();
+
+    // Sv32 virtual memory
+    void singlecore_mmu_data();
+    void pipecore_mmu_data();
+    void singlecore_mmu();
+    void pipecore_mmu();
+
+    // Privilege levels
+    void singlecore_privilege_data();
+    void pipecore_privilege_data();
+    void singlecore_privilege();
+    void pipecore_privilege();
+
+    // Physical memory protection
+    void singlecore_pmp_data();
+    void pipecore_pmp_data();
+    void singlecore_pmp();
+    void pipecore_pmp();
+
+    // Execution profile
+    void singlecore_profile();
+    void pipecore_profile();
+    void singlecore_call_profile();
+    void pipecore_call_profile();
+    // CPI stack
+    void singlecore_cpi_stack();
+    void pipecore_cpi_stack();
+    void singlecore_hpm_counters();
+    void pipecore_hpm_counters();
+    // Instruction sequence numbers
+    void singlecore_fetch_seq();
+    void pipecore_fetch_seq();
 };
 
 #endif // CORE_TEST_H
@@ -7,17 +7,24 @@
 #include "memory/address_range.h"
 
 #include <QMap>
+#include <array>
 #include <cstdint>
 #include <machineconfig.h>
 using std::uint32_t;
 
 namespace machine {
 
+using CpiStack = std::array<uint64_t, CPI_COMPONENT_COUNT>;
+
 struct CoreState {
     Pipeline pipeline = {};
     AddressRange LoadReservedRange;
     uint32_t stall_count = 0;
     uint32_t cycle_count = 0;
+    /** Number of fetched instructions, each gets the next value as its sequence number. */
+    uint64_t fetch_seq = 0;
+    /** Cycles by component, they sum up to `cycle_count`. */
+    CpiStack cpi_stack {};
 };
 
 } // namespace machine
@@ -0,0 +1,63 @@
+#ifndef CPI_STACK_H
+#define CPI_STACK_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace machine {
+
+/**
+ * Use of a cycle by the retirement slot (output of the memory stage). Each
+ * cycle either retires an instruction (base) or it is lost to the reason
+ * carried by the pipeline bubble in the slot, so the components sum up to
+ * the cycle count.
+ *
+ * Memory access penalties of caches are not simulated as stalls, therefore
+ * there is no cache miss component.
+ */
+enum class CpiComponent : uint8_t {
+    BASE,              //> Instruction retired
+    PIPELINE_FILL,     //> Empty pipeline after reset
+    LOAD_USE,          //> Load-use hazard stall (hazard unit with forwarding)
+    RAW_STALL,         //> Data hazard stall (hazard unit without forwarding)
+    CSR_SERIALIZATION, //> CSR instruction waits until older instructions leave the pipeline
+    MISPREDICTION,     //> Flush after mispredicted branch or jump
+    CSR_FLUSH,         //> Flush after CSR write, xRET or SFENCE.VMA
+    EXCEPTION,         //> Instruction raising exception and flush of younger ones
+};
+
+constexpr size_t CPI_COMPONENT_COUNT = static_cast<size_t>(CpiComponent::EXCEPTION) + 1;
+
+/** Short name used in command line reports and JSON. */
+inline const char *cpi_component_name(CpiComponent component) {
+    switch (component) {
+    case CpiComponent::BASE: return "base";
+    case CpiComponent::PIPELINE_FILL: return "pipeline-fill";
+    case CpiComponent::LOAD_USE: return "load-use";
+    case CpiComponent::RAW_STALL: return "raw-stall";
+    case CpiComponent::CSR_SERIALIZATION: return "csr-serialization";
+    case CpiComponent::MISPREDICTION: return "misprediction";
+    case CpiComponent::CSR_FLUSH: return "csr-flush";
+    case CpiComponent::EXCEPTION: return "exception";
+    }
+    return "unknown";
+}
+
+/** Human readable name used in GUI. */
+inline const char *cpi_component_description(CpiComponent component) {
+    switch (component) {
+    case CpiComponent::BASE: return "Base (retired)";
+    case CpiComponent::PIPELINE_FILL: return "Pipeline fill";
+    case CpiComponent::LOAD_USE: return "Load-use stall";
+    case CpiComponent::RAW_STALL: return "Data hazard stall";
+    case CpiComponent::CSR_SERIALIZATION: return "CSR serialization";
+    case CpiComponent::MISPREDICTION: return "Branch misprediction";
+    case CpiComponent::CSR_FLUSH: return "CSR write flush";
+    case CpiComponent::EXCEPTION: return "Exception";
+    }
+    return "Unknown";
+}
+
+} // namespace machine
+
+#endif // CPI_STACK_H
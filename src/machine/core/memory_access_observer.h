@@ -0,0 +1,47 @@
+#ifndef MEMORY_ACCESS_OBSERVER_H
+#define MEMORY_ACCESS_OBSERVER_H
+
+#include "memory/address.h"
+
+#include <cstdint>
+
+namespace machine {
+
+enum class MemoryAccessKind : uint8_t {
+    FETCH, // Instruction fetch from program memory
+    LOAD,  // Read from data memory
+    STORE, // Write to data memory
+};
+
+/**
+ * Receives every access the core issues to its top level program and data
+ * memory (usually L1 caches), before it is resolved by the memory hierarchy.
+ *
+ * Observers are registered by `Core::add_memory_access_observer`. They are
+ * called synchronously from the pipeline stage, so they have to be cheap and
+ * they must not access the simulated memory themselves.
+ */
+class MemoryAccessObserver {
+public:
+    virtual ~MemoryAccessObserver() = default;
+
+    /**
+     * @param kind          type of the access
+     * @param address       first accessed byte
+     * @param size          access size in bytes
+     * @param inst_addr     address of the instruction causing the access
+     */
+    virtual void
+    memory_access(MemoryAccessKind kind, Address address, unsigned size, Address inst_addr)
+        = 0;
+
+    /**
+     * Called when instruction passes the memory stage without exception
+     * (the same condition under which `minstret` is incremented).
+     */
+    virtual void instruction_retired(Address inst_addr) { (void)inst_addr; }
+};
+
+} // namespace machine
+
+#endif // MEMORY_ACCESS_OBSERVER_H
@@ -11,8 +11,8 @@ namespace machine { namespace CSR {
      * Spec vol. 2: Table 2.1
      */
     enum class PrivilegeLevel {
-        UNPRIVILEGED = 0b00, //> Unprivileged and User-Level CSRs, unimplemented
-        SUPERVISOR = 0b01,   //> Supervisor-Level CSRs, unimplemented
+        UNPRIVILEGED = 0b00, //> Unprivileged and User-Level CSRs
+        SUPERVISOR = 0b01,   //> Supervisor-Level CSRs, only satp is implemented
         HYPERVISOR = 0b10,   //> Hypervisor and VS CSRs, unimplemented
         MACHINE = 0b11,      //> Machine-Level CSRs
     };
@@ -20,9 +20,18 @@ namespace machine { namespace CSR {
 
     ControlState::ControlState(const ControlState &other)
         : QObject(this->parent())
-        , xlen(other.xlen), register_data(other.register_data) {}
+        , xlen(other.xlen)
+        , privilege_level(other.privilege_level)
+        , pmp_generation(other.pmp_generation)
+        , hpm_counters_selected(other.hpm_counters_selected)
+        , counters_written(other.counters_written)
+        , register_data(other.register_data) {}
 
     void ControlState::reset() {
+        privilege_level = PrivilegeLevel::MACHINE;
+        pmp_generation++;
+        hpm_counters_selected = 0;
+        counters_written = 0;
         std::transform(
             REGISTERS.begin(), REGISTERS.end(), register_data.begin(),
             [](const RegisterDesc &desc) { return desc.initial_value; });
@@ -43,8 +52,6 @@ namespace machine { namespace CSR {
     }
 
     size_t ControlState::get_register_internal_id(Address address) {
-        // if (address.get_privilege_level() != PrivilegeLevel::MACHINE)
-
         try {
             return CSR::REGISTER_MAP.at(address);
         } catch (std::out_of_range &e) {
@@ -55,7 +62,7 @@ namespace machine { namespace CSR {
     }
 
     RegisterValue ControlState::read(Address address) const {
-        // Only machine level privilege is supported so no checking is needed.
+        // Privilege is checked by the core before the access (see is_access_permitted).
         size_t reg_id = get_register_internal_id(address);
         RegisterValue value = register_data[reg_id];
         DEBUG("Read CSR[%u] == 0x%" PRIx64, address.data, value.as_u64());
@@ -94,14 +101,168 @@ namespace machine { namespace CSR {
         default_wlrl_write_handler(desc, reg, val);
     }
 
-    void ControlState::mcycle_wlrl_write_handler(
+    /** Bit of the counter in mcountinhibit, cycle is 0, instret 2 and hpmcounterN is N. */
+    static unsigned counter_index(size_t internal_id) {
+        if (internal_id == Id::MCYCLE) { return 0; }
+        if (internal_id == Id::MINSTRET) { return 2; }
+        return HPM_COUNTER_FIRST + (internal_id - Id::MHPMCOUNTER3);
+    }
+
+    static size_t counter_shadow_id(size_t internal_id) {
+        if (internal_id == Id::MCYCLE) { return Id::CYCLE; }
+        if (internal_id == Id::MINSTRET) { return Id::INSTRET; }
+        return Id::HPMCOUNTER3 + (internal_id - Id::MHPMCOUNTER3);
+    }
+
+    void ControlState::counter_wlrl_write_handler(
+        const RegisterDesc &desc,
+        RegisterValue &reg,
+        RegisterValue val) {
+        Q_UNUSED(desc)
+        const size_t internal_id = &reg - &register_data[0];
+        // Written value is visible to the next instruction, the writing one is not counted.
+        counters_written |= 1u << counter_index(internal_id);
+        uint64_t u = val.as_u64();
+        if (xlen == Xlen::_32) u &= 0xffffffff;
+        reg = u;
+        const size_t shadow_id = counter_shadow_id(internal_id);
+        register_data[shadow_id] = u;
+        write_signal(shadow_id, register_data[shadow_id]);
+    }
+
+    void ControlState::mhpmevent_wlrl_write_handler(
         const RegisterDesc &desc,
         RegisterValue &reg,
         RegisterValue val) {
         Q_UNUSED(desc)
-        reg = val;
-        register_data[Id::CYCLE] = val;
-        write_signal(Id::CYCLE, register_data[Id::CYCLE]);
+        const size_t counter = HPM_COUNTER_FIRST + (&reg - &register_data[Id::MHPMEVENT3]);
+        // Unsupported events are not counted.
+        const uint64_t event = val.as_u64();
+        reg = (event < HpmEvent::_COUNT) ? event : (uint64_t)HpmEvent::NONE;
+        if (reg.as_u64() != HpmEvent::NONE) {
+            hpm_counters_selected |= 1u << counter;
+        } else {
+            hpm_counters_selected &= ~(1u << counter);
+        }
+    }
+
+    void ControlState::set_counter(size_t internal_id, uint64_t value) {
+        if (xlen == Xlen::_32) value &= 0xffffffff;
+        register_data[internal_id] = value;
+        write_signal(internal_id, register_data[internal_id]);
+        const size_t shadow_id = counter_shadow_id(internal_id);
+        register_data[shadow_id] = value;
+        write_signal(shadow_id, register_data[shadow_id]);
+    }
+
+    void ControlState::count_events(const HpmEventCounts &events) {
+        const uint32_t inhibited = register_data[Id::MCOUNTINHIBIT].as_u32() | counters_written;
+        counters_written = 0;
+        if (!(inhibited & Field::mcountinhibit::CY.mask()) && events[HpmEvent::CYCLES] != 0) {
+            set_counter(
+                Id::MCYCLE, register_data[Id::MCYCLE].as_u64() + events[HpmEvent::CYCLES]);
+        }
+        if (!(inhibited & Field::mcountinhibit::IR.mask())
+            && events[HpmEvent::INSTRUCTIONS] != 0) {
+            set_counter(
+                Id::MINSTRET,
+                register_data[Id::MINSTRET].as_u64() + events[HpmEvent::INSTRUCTIONS]);
+        }
+        // Usually no counter is selected, so the loop is skipped.
+        for (uint32_t active = hpm_counters_selected & ~inhibited; active != 0;
+             active &= active - 1) {
+            const size_t offset = qCountTrailingZeroBits(active) - HPM_COUNTER_FIRST;
+            const uint32_t amount = events[register_data[Id::MHPMEVENT3 + offset].as_u64()];
+            if (amount == 0) { continue; }
+            const size_t counter_id = Id::MHPMCOUNTER3 + offset;
+            set_counter(counter_id, register_data[counter_id].as_u64() + amount);
+        }
+    }
+
+    void ControlState::satp_wlrl_write_handler(
+        const RegisterDesc &desc,
+        RegisterValue &reg,
+        RegisterValue val) {
+        // Writes selecting an unsupported translation mode have no effect.
+        const uint64_t mode = (xlen == Xlen::_32) ? Field::satp::MODE32.decode(val.as_u64())
+                                                  : Field::satp::MODE64.decode(val.as_u64());
+        const uint64_t paged_mode
+            = (xlen == Xlen::_32) ? Field::satp::MODE32_SV32 : Field::satp::MODE64_SV39;
+        if (mode != 0 && (mode != paged_mode || !supervisor_supported())) { return; }
+        default_wlrl_write_handler(desc, reg, val);
+    }
+
+    void ControlState::pmpcfg_wlrl_write_handler(
+        const RegisterDesc &desc,
+        RegisterValue &reg,
+        RegisterValue val) {
+        Q_UNUSED(desc)
+        // Odd configuration registers do not exist on RV64, entries are packed by eight.
+        const size_t reg_index = &reg - &register_data[Id::PMPCFG0];
+        if (xlen == Xlen::_64 && (reg_index & 1)) { return; }
+        const size_t entries = (xlen == Xlen::_32) ? 4 : 8;
+        uint64_t result = 0;
+        for (size_t i = 0; i < entries; i++) {
+            const uint64_t old_cfg = (reg.as_u64() >> (i * 8)) & 0xff;
+            uint64_t cfg = (val.as_u64() >> (i * 8)) & 0xff;
+            if (Field::pmpcfg::L.decode(old_cfg)) {
+                // Locked entries ignore writes until reset.
+                cfg = old_cfg;
+            } else {
+                cfg &= Field::pmpcfg::R.mask() | Field::pmpcfg::W.mask() | Field::pmpcfg::X.mask()
+                       | Field::pmpcfg::A.mask() | Field::pmpcfg::L.mask();
+                // Write-only combination is reserved.
+                if (!Field::pmpcfg::R.decode(cfg)) { cfg &= ~Field::pmpcfg::W.mask(); }
+            }
+            result |= cfg << (i * 8);
+        }
+        reg = result;
+        pmp_generation++;
+    }
+
+    void ControlState::pmpaddr_wlrl_write_handler(
+        const RegisterDesc &desc,
+        RegisterValue &reg,
+        RegisterValue val) {
+        Q_UNUSED(desc)
+        const size_t entry = &reg - &register_data[Id::PMPADDR0];
+        if (is_pmp_address_locked(entry)) { return; }
+        // Physical addresses have 34 bits on RV32 and 56 bits on RV64.
+        const uint64_t mask = (xlen == Xlen::_32) ? 0xffffffff : ((uint64_t)1 << 54) - 1;
+        reg = val.as_u64() & mask;
+        pmp_generation++;
+    }
+
+    std::pair<size_t, unsigned> ControlState::pmp_config_location(size_t entry) const {
+        if (xlen == Xlen::_32) { return { Id::PMPCFG0 + entry / 4, (entry % 4) * 8 }; }
+        return { Id::PMPCFG0 + (entry / 8) * 2, (entry % 8) * 8 };
+    }
+
+    uint8_t ControlState::get_pmp_config(size_t entry) const {
+        const auto location = pmp_config_location(entry);
+        return (register_data[location.first].as_u64() >> location.second) & 0xff;
+    }
+
+    uint64_t ControlState::get_pmp_address(size_t entry) const {
+        return register_data[Id::PMPADDR0 + entry].as_u64();
+    }
+
+    bool ControlState::is_pmp_address_locked(size_t entry) const {
+        if (Field::pmpcfg::L.decode(get_pmp_config(entry))) { return true; }
+        // Locked TOR entry locks also the address of the entry below.
+        if (entry + 1 >= Field::pmpcfg::ENTRY_COUNT) { return false; }
+        const uint8_t next = get_pmp_config(entry + 1);
+        return Field::pmpcfg::L.decode(next)
+               && Field::pmpcfg::A.decode(next) == Field::pmpcfg::A_TOR;
+    }
+
+    bool ControlState::supervisor_supported() const {
+        return register_data[Id::MISA].as_u64() & ConfigIsaWord::byChar('S').toUnsigned();
+    }
+
+    bool ControlState::is_access_permitted(Address address, bool write) const {
+        if (write && !address.is_writable()) { return false; }
+        return privilege_level >= address.get_privilege_level();
     }
 
     bool ControlState::operator==(const ControlState &other) const {
@@ -159,13 +320,13 @@ namespace machine { namespace CSR {
     void ControlState::exception_initiate(PrivilegeLevel act_privlev, PrivilegeLevel to_privlev) {
         size_t reg_id = Id::MSTATUS;
         RegisterValue &reg = register_data[reg_id];
-        Q_UNUSED(act_privlev)
-        Q_UNUSED(to_privlev)
 
         write_field(Field::mstatus::MPIE, read_field(Field::mstatus::MIE).as_u32());
         write_field(Field::mstatus::MIE, (uint64_t)0);
 
         write_field(Field::mstatus::MPP, static_cast<uint64_t>(act_privlev));
+        privilege_level = to_privlev;
+        trap_count++;
 
         emit write_signal(reg_id, reg);
     }
@@ -180,7 +341,13 @@ namespace machine { namespace CSR {
         write_field(Field::mstatus::MPIE, (uint64_t)1);
 
         restored_privlev = static_cast<PrivilegeLevel>(read_field(Field::mstatus::MPP).as_u32());
+        if (restored_privlev == PrivilegeLevel::HYPERVISOR
+            || (restored_privlev != PrivilegeLevel::MACHINE && !supervisor_supported())) {
+            // MPP is WARL, unsupported modes behave as machine mode.
+            restored_privlev = PrivilegeLevel::MACHINE;
+        }
         write_field(Field::mstatus::MPP, (uint64_t)0);
+        privilege_level = restored_privlev;
 
         emit write_signal(reg_id, reg);
 
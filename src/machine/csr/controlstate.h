@@ -8,6 +8,7 @@
 #include "simulator_exception.h"
 #include "bitfield.h"
 #include "config_isa.h"
+#include "csr/hpm_event.h"
 
 #include <QObject>
 #include <QString>
@@ -20,6 +21,11 @@ namespace machine { namespace CSR {
         enum IdxType{
             // Unprivileged Counter/Timers
             CYCLE,
+            INSTRET,
+            HPMCOUNTER3,
+            HPMCOUNTER31 = HPMCOUNTER3 + 28,
+            // Supervisor Protection and Translation
+            SATP,
             // Machine Information Registers
             MVENDORID,
             MARCHID,
@@ -43,9 +49,36 @@ namespace machine { namespace CSR {
             MIP,
             MTINST,
             MTVAL2,
-            // ...
+            // Machine Memory Protection
+            PMPCFG0,
+            PMPCFG1,
+            PMPCFG2,
+            PMPCFG3,
+            PMPADDR0,
+            PMPADDR1,
+            PMPADDR2,
+            PMPADDR3,
+            PMPADDR4,
+            PMPADDR5,
+            PMPADDR6,
+            PMPADDR7,
+            PMPADDR8,
+            PMPADDR9,
+            PMPADDR10,
+            PMPADDR11,
+            PMPADDR12,
+            PMPADDR13,
+            PMPADDR14,
+            PMPADDR15,
+            // Machine Counter/Timers
             MCYCLE,
             MINSTRET,
+            MHPMCOUNTER3,
+            MHPMCOUNTER31 = MHPMCOUNTER3 + 28,
+            // Machine Counter Setup
+            MCOUNTINHIBIT,
+            MHPMEVENT3,
+            MHPMEVENT31 = MHPMEVENT3 + 28,
             _COUNT,
         };
     };
@@ -107,6 +140,13 @@ namespace machine { namespace CSR {
          * amount. */
         void increment_internal(size_t internal_id, uint64_t amount);
 
+        /**
+         * Add events of a single core cycle to mcycle, minstret and to the mhpmcounterN
+         * registers selected by mhpmeventN. Counters inhibited by mcountinhibit or written by an
+         * instruction in the same cycle are not incremented.
+         */
+        void count_events(const HpmEventCounts &events);
+
         /** Reset data to initial values */
         void reset();
 
@@ -130,6 +170,26 @@ namespace machine { namespace CSR {
         bool core_interrupt_request();
         machine::Address exception_pc_address();
 
+        /** Privilege level the hart currently executes in. */
+        PrivilegeLevel get_privilege_level() const { return privilege_level; }
+        void set_privilege_level(PrivilegeLevel level) { privilege_level = level; }
+        /** Supervisor (and user) mode and paged virtual memory are enabled by 'S' in misa. */
+        bool supervisor_supported() const;
+        /**
+         * Whether the current privilege level may access the CSR (address bits 9:8). Writes to
+         * read-only CSRs (address bits 11:10 set) are never permitted.
+         */
+        bool is_access_permitted(Address address, bool write) const;
+
+        /** Configuration byte (pmpNcfg) of PMP entry. */
+        uint8_t get_pmp_config(size_t entry) const;
+        /** Address register (pmpaddrN) of PMP entry, physical address bits 2 and up. */
+        uint64_t get_pmp_address(size_t entry) const;
+        /** Changes whenever any PMP register changes, used to invalidate derived state. */
+        uint32_t get_pmp_generation() const { return pmp_generation; }
+        /** Number of traps taken, lets observers of the core follow transfers to the handler. */
+        uint64_t get_trap_count() const { return trap_count; }
+
     signals:
         void write_signal(size_t internal_reg_id, RegisterValue val);
         void read_signal(size_t internal_reg_id, RegisterValue val) const;
@@ -149,7 +209,21 @@ namespace machine { namespace CSR {
             register_data[field_desc.regId] = u;
         }
 
+        /** Set counter together with its unprivileged read-only shadow. */
+        void set_counter(size_t internal_id, uint64_t value);
+
+        /** Internal id and byte shift of the configuration of PMP entry. */
+        std::pair<size_t, unsigned> pmp_config_location(size_t entry) const;
+        bool is_pmp_address_locked(size_t entry) const;
+
         Xlen xlen = Xlen::_32; // TODO
+        PrivilegeLevel privilege_level = PrivilegeLevel::MACHINE;
+        uint32_t pmp_generation = 0;
+        uint64_t trap_count = 0;
+        /** Counters (in mcountinhibit bit layout) with an event selected by mhpmeventN. */
+        uint32_t hpm_counters_selected = 0;
+        /** Counters written since the last `count_events`, they skip the increment. */
+        uint32_t counters_written = 0;
 
         /**
          * Compacted table of existing CSR registers data. Each item is described by table
@@ -166,7 +240,23 @@ namespace machine { namespace CSR {
             const RegisterDesc &desc,
             RegisterValue &reg,
             RegisterValue val);
-        void mcycle_wlrl_write_handler(
+        void counter_wlrl_write_handler(
+            const RegisterDesc &desc,
+            RegisterValue &reg,
+            RegisterValue val);
+        void mhpmevent_wlrl_write_handler(
+            const RegisterDesc &desc,
+            RegisterValue &reg,
+            RegisterValue val);
+        void satp_wlrl_write_handler(
+            const RegisterDesc &desc,
+            RegisterValue &reg,
+            RegisterValue val);
+        void pmpcfg_wlrl_write_handler(
+            const RegisterDesc &desc,
+            RegisterValue &reg,
+            RegisterValue val);
+        void pmpaddr_wlrl_write_handler(
             const RegisterDesc &desc,
             RegisterValue &reg,
             RegisterValue val);
@@ -196,17 +286,74 @@ namespace machine { namespace CSR {
             static constexpr RegisterFieldDesc MPIE = { "MPIE", Id::MSTATUS, {1, 7}, "Previous MIE before the trap"};
             static constexpr RegisterFieldDesc SPP = { "SPP", Id::MSTATUS, {1, 8}, "System previous privilege mode"};
             static constexpr RegisterFieldDesc MPP = { "MPP", Id::MSTATUS, {2, 11}, "Machine previous privilege mode"};
+            static constexpr RegisterFieldDesc SUM = { "SUM", Id::MSTATUS, {1, 18}, "Permit supervisor user memory access"};
+            static constexpr RegisterFieldDesc MXR = { "MXR", Id::MSTATUS, {1, 19}, "Make executable readable"};
             static constexpr RegisterFieldDesc UXL = { "UXL", Id::MSTATUS, {2, 32}, "User mode XLEN (RV64 only)"};
             static constexpr RegisterFieldDesc SXL = { "SXL", Id::MSTATUS, {2, 34}, "Supervisor mode XLEN (RV64 only)"};
-            static constexpr const RegisterFieldDesc *fields[] = { &SIE, &MIE, &SPIE, &MPIE, &SPP, &MPP, &UXL, &SXL};
+            static constexpr const RegisterFieldDesc *fields[] = { &SIE, &MIE, &SPIE, &MPIE, &SPP, &MPP, &SUM, &MXR, &UXL, &SXL};
             static constexpr unsigned count = sizeof(fields) / sizeof(fields[0]);
         }
+        namespace mcountinhibit {
+            static constexpr RegisterFieldDesc CY = { "CY", Id::MCOUNTINHIBIT, {1, 0}, "Inhibit mcycle"};
+            static constexpr RegisterFieldDesc IR = { "IR", Id::MCOUNTINHIBIT, {1, 2}, "Inhibit minstret"};
+            static constexpr RegisterFieldDesc HPM = { "HPM", Id::MCOUNTINHIBIT, {29, 3}, "Inhibit mhpmcounter3-31"};
+            static constexpr const RegisterFieldDesc *fields[] = { &CY, &IR, &HPM };
+            static constexpr unsigned count = sizeof(fields) / sizeof(fields[0]);
+        }
+        namespace satp {
+            static constexpr RegisterFieldDesc MODE32 = { "MODE", Id::SATP, {1, 31}, "Translation mode (RV32)"};
+            static constexpr RegisterFieldDesc ASID32 = { "ASID", Id::SATP, {9, 22}, "Address space identifier (RV32)"};
+            static constexpr RegisterFieldDesc PPN32 = { "PPN", Id::SATP, {22, 0}, "Root page table page number (RV32)"};
+            static constexpr RegisterFieldDesc MODE64 = { "MODE", Id::SATP, {4, 60}, "Translation mode (RV64)"};
+            static constexpr RegisterFieldDesc ASID64 = { "ASID", Id::SATP, {16, 44}, "Address space identifier (RV64)"};
+            static constexpr RegisterFieldDesc PPN64 = { "PPN", Id::SATP, {44, 0}, "Root page table page number (RV64)"};
+            static constexpr uint64_t MODE32_SV32 = 1;
+            static constexpr uint64_t MODE64_SV39 = 8;
+        }
+        /** Fields of a single PMP entry configuration byte (pmpNcfg). */
+        namespace pmpcfg {
+            static constexpr BitField R = {1, 0};
+            static constexpr BitField W = {1, 1};
+            static constexpr BitField X = {1, 2};
+            static constexpr BitField A = {2, 3};
+            static constexpr BitField L = {1, 7};
+            static constexpr uint64_t A_OFF = 0;
+            static constexpr uint64_t A_TOR = 1;
+            static constexpr uint64_t A_NA4 = 2;
+            static constexpr uint64_t A_NAPOT = 3;
+            static constexpr size_t ENTRY_COUNT = 16;
+        }
     }
 
+    /** Number of the first and count of the hardware performance monitor counters. */
+    constexpr unsigned HPM_COUNTER_FIRST = 3;
+    constexpr unsigned HPM_COUNTER_COUNT = 29;
+
+    /** Expands X(N) for each hardware performance monitor counter number. */
+#define CSR_HPM_COUNTERS(X)                                                                        \
+    X(3) X(4) X(5) X(6) X(7) X(8) X(9) X(10) X(11) X(12) X(13) X(14) X(15) X(16) X(17) X(18)      \
+    X(19) X(20) X(21) X(22) X(23) X(24) X(25) X(26) X(27) X(28) X(29) X(30) X(31)
+#define CSR_HPMCOUNTER_DESC(N)                                                                     \
+    [Id::HPMCOUNTER3 + (N - 3)] = { "hpmcounter" #N, Address(0xC00 + N),                           \
+        "Performance-monitoring counter (read-only shadow).", 0, 0},
+#define CSR_MHPMCOUNTER_DESC(N)                                                                    \
+    [Id::MHPMCOUNTER3 + (N - 3)] = { "mhpmcounter" #N, Address(0xB00 + N),                         \
+        "Machine performance-monitoring counter.", 0, (register_storage_t)0xffffffffffffffff,      \
+        &ControlState::counter_wlrl_write_handler},
+#define CSR_MHPMEVENT_DESC(N)                                                                      \
+    [Id::MHPMEVENT3 + (N - 3)] = { "mhpmevent" #N, Address(0x320 + N),                             \
+        "Machine performance-monitoring event selector.", 0, (register_storage_t)0xffffffffffffffff, \
+        &ControlState::mhpmevent_wlrl_write_handler},
+
     /** Definitions of supported CSR registers */
     inline constexpr std::array<RegisterDesc, Id::_COUNT> REGISTERS { {
         // Unprivileged Counter/Timers
         [Id::CYCLE] = { "cycle", 0xC00_csr, "Cycle counter for RDCYCLE instruction.", 0, 0},
+        [Id::INSTRET] = { "instret", 0xC02_csr, "Instructions-retired counter for RDINSTRET instruction.", 0, 0},
+        CSR_HPM_COUNTERS(CSR_HPMCOUNTER_DESC)
+        // Supervisor Protection and Translation
+        [Id::SATP] = { "satp", 0x180_csr, "Supervisor address translation and protection.",
+                        0, (register_storage_t)0xffffffffffffffff, &ControlState::satp_wlrl_write_handler},
         // Priviledged Machine Mode Registers
         [Id::MVENDORID] = { "mvendorid", 0xF11_csr, "Vendor ID.", 0, 0},
         [Id::MARCHID] = { "marchid", 0xF12_csr, "Architecture ID.", 0, 0},
@@ -227,12 +374,65 @@ namespace machine { namespace CSR {
                         0, 0x00000222},
         [Id::MTINST] = { "mtinst", 0x34A_csr, "Machine trap instruction (transformed)." },
         [Id::MTVAL2] = { "mtval2", 0x34B_csr, "Machine bad guest physical address." },
+        // Machine Memory Protection
+        [Id::PMPCFG0] = { "pmpcfg0", 0x3A0_csr, "Physical memory protection configuration.",
+                        0, (register_storage_t)0xffffffffffffffff, &ControlState::pmpcfg_wlrl_write_handler},
+        [Id::PMPCFG1] = { "pmpcfg1", 0x3A1_csr, "Physical memory protection configuration.",
+                        0, (register_storage_t)0xffffffffffffffff, &ControlState::pmpcfg_wlrl_write_handler},
+        [Id::PMPCFG2] = { "pmpcfg2", 0x3A2_csr, "Physical memory protection configuration.",
+                        0, (register_storage_t)0xffffffffffffffff, &ControlState::pmpcfg_wlrl_write_handler},
+        [Id::PMPCFG3] = { "pmpcfg3", 0x3A3_csr, "Physical memory protection configuration.",
+                        0, (register_storage_t)0xffffffffffffffff, &ControlState::pmpcfg_wlrl_write_handler},
+        [Id::PMPADDR0] = { "pmpaddr0", 0x3B0_csr, "Physical memory protection address register.",
+                        0, (register_storage_t)0xffffffffffffffff, &ControlState::pmpaddr_wlrl_write_handler},
+        [Id::PMPADDR1] = { "pmpaddr1", 0x3B1_csr, "Physical memory protection address register.",
+                        0, (register_storage_t)0xffffffffffffffff, &ControlState::pmpaddr_wlrl_write_handler},
+        [Id::PMPADDR2] = { "pmpaddr2", 0x3B2_csr, "Physical memory protection address register.",
+                        0, (register_storage_t)0xffffffffffffffff, &ControlState::pmpaddr_wlrl_write_handler},
+        [Id::PMPADDR3] = { "pmpaddr3", 0x3B3_csr, "Physical memory protection address register.",
+                        0, (register_storage_t)0xffffffffffffffff, &ControlState::pmpaddr_wlrl_write_handler},
+        [Id::PMPADDR4] = { "pmpaddr4", 0x3B4_csr, "Physical memory protection address register.",
+                        0, (register_storage_t)0xffffffffffffffff, &ControlState::pmpaddr_wlrl_write_handler},
+        [Id::PMPADDR5] = { "pmpaddr5", 0x3B5_csr, "Physical memory protection address register.",
+                        0, (register_storage_t)0xffffffffffffffff, &ControlState::pmpaddr_wlrl_write_handler},
+        [Id::PMPADDR6] = { "pmpaddr6", 0x3B6_csr, "Physical memory protection address register.",
+                        0, (register_storage_t)0xffffffffffffffff, &ControlState::pmpaddr_wlrl_write_handler},
+        [Id::PMPADDR7] = { "pmpaddr7", 0x3B7_csr, "Physical memory protection address register.",
+                        0, (register_storage_t)0xffffffffffffffff, &ControlState::pmpaddr_wlrl_write_handler},
+        [Id::PMPADDR8] = { "pmpaddr8", 0x3B8_csr, "Physical memory protection address register.",
+                        0, (register_storage_t)0xffffffffffffffff, &ControlState::pmpaddr_wlrl_write_handler},
+        [Id::PMPADDR9] = { "pmpaddr9", 0x3B9_csr, "Physical memory protection address register.",
+                        0, (register_storage_t)0xffffffffffffffff, &ControlState::pmpaddr_wlrl_write_handler},
+        [Id::PMPADDR10] = { "pmpaddr10", 0x3BA_csr, "Physical memory protection address register.",
+                        0, (register_storage_t)0xffffffffffffffff, &ControlState::pmpaddr_wlrl_write_handler},
+        [Id::PMPADDR11] = { "pmpaddr11", 0x3BB_csr, "Physical memory protection address register.",
+                        0, (register_storage_t)0xffffffffffffffff, &ControlState::pmpaddr_wlrl_write_handler},
+        [Id::PMPADDR12] = { "pmpaddr12", 0x3BC_csr, "Physical memory protection address register.",
+                        0, (register_storage_t)0xffffffffffffffff, &ControlState::pmpaddr_wlrl_write_handler},
+        [Id::PMPADDR13] = { "pmpaddr13", 0x3BD_csr, "Physical memory protection address register.",
+                        0, (register_storage_t)0xffffffffffffffff, &ControlState::pmpaddr_wlrl_write_handler},
+        [Id::PMPADDR14] = { "pmpaddr14", 0x3BE_csr, "Physical memory protection address register.",
+                        0, (register_storage_t)0xffffffffffffffff, &ControlState::pmpaddr_wlrl_write_handler},
+        [Id::PMPADDR15] = { "pmpaddr15", 0x3BF_csr, "Physical memory protection address register.",
+                        0, (register_storage_t)0xffffffffffffffff, &ControlState::pmpaddr_wlrl_write_handler},
         // Machine Counter/Timers
         [Id::MCYCLE] = { "mcycle", 0xB00_csr, "Machine cycle counter.",
-                        0, (register_storage_t)0xffffffffffffffff, &ControlState::mcycle_wlrl_write_handler},
-        [Id::MINSTRET] = { "minstret", 0xB02_csr, "Machine instructions-retired counter."},
+                        0, (register_storage_t)0xffffffffffffffff, &ControlState::counter_wlrl_write_handler},
+        [Id::MINSTRET] = { "minstret", 0xB02_csr, "Machine instructions-retired counter.",
+                        0, (register_storage_t)0xffffffffffffffff, &ControlState::counter_wlrl_write_handler},
+        CSR_HPM_COUNTERS(CSR_MHPMCOUNTER_DESC)
+        // Machine Counter Setup
+        [Id::MCOUNTINHIBIT] = { "mcountinhibit", 0x320_csr, "Machine counter-inhibit register.",
+                        0, 0xfffffffd, &ControlState::default_wlrl_write_handler,
+                        {Field::mcountinhibit::fields, Field::mcountinhibit::count} },
+        CSR_HPM_COUNTERS(CSR_MHPMEVENT_DESC)
     } };
 
+#undef CSR_HPMCOUNTER_DESC
+#undef CSR_MHPMCOUNTER_DESC
+#undef CSR_MHPMEVENT_DESC
+#undef CSR_HPM_COUNTERS
+
     /** Lookup from CSR address (value used in instruction) to internal id (index in continuous
      * memory) */
     class RegisterMap {
@@ -0,0 +1,56 @@
+#ifndef QTRVSIM_CSR_HPM_EVENT_H
+#define QTRVSIM_CSR_HPM_EVENT_H
+
+#include "core/cpi_stack.h"
+
+#include <array>
+#include <cstdint>
+
+namespace machine { namespace CSR {
+    /**
+     * Events counted by hardware performance monitor counters (mhpmcounter3-31). The value is
+     * selected by writing it to the corresponding mhpmeventN register, zero stops the counter.
+     */
+    struct HpmEvent {
+        enum Type : uint8_t {
+            NONE,
+            CYCLES,
+            INSTRUCTIONS,        //> Retired instructions
+            LOADS,               //> Retired loads (without LR and AMO)
+            STORES,              //> Retired stores (without SC and AMO)
+            AMOS,                //> Retired LR, SC and AMO instructions
+            BRANCHES,            //> Retired branches and jumps
+            BRANCH_MISPREDICTS,  //> Pipeline flushes after mispredicted branch or jump
+            PROGRAM_CACHE_HITS,
+            PROGRAM_CACHE_MISSES,
+            DATA_CACHE_HITS,
+            DATA_CACHE_MISSES,
+            LEVEL2_CACHE_HITS,
+            LEVEL2_CACHE_MISSES,
+            // Cycles lost by cause, in order of `CpiComponent` without base.
+            PIPELINE_FILL_CYCLES,
+            LOAD_USE_CYCLES,
+            RAW_STALL_CYCLES,
+            CSR_SERIALIZATION_CYCLES,
+            MISPREDICTION_CYCLES,
+            CSR_FLUSH_CYCLES,
+            EXCEPTION_CYCLES,
+            _COUNT,
+        };
+    };
+
+    /** Number of occurrences of each event, indexed by `HpmEvent::Type`. */
+    using HpmEventCounts = std::array<uint32_t, HpmEvent::_COUNT>;
+
+    /** Event counting cycles not used by a retired instruction for the given reason. */
+    constexpr HpmEvent::Type hpm_event_of_lost_cycles(CpiComponent component) {
+        return static_cast<HpmEvent::Type>(
+            HpmEvent::PIPELINE_FILL_CYCLES + static_cast<unsigned>(component)
+            - static_cast<unsigned>(CpiComponent::PIPELINE_FILL));
+    }
+    static_assert(
+        hpm_event_of_lost_cycles(CpiComponent::EXCEPTION) == HpmEvent::EXCEPTION_CYCLES,
+        "Lost cycle events have to follow CPI stack components.");
+}} // namespace machine::CSR
+
+#endif // QTRVSIM_CSR_HPM_EVENT_H
@@ -473,7 +473,7 @@ static const struct InstructionMap SYSTEM_PRIV_map[] = {
     IM_UNKNOWN,
     IM_UNKNOWN,
     {"sret", IT_I, NOALU, NOMEM, nullptr, {}, 0x10200073, 0xffffffff, { .flags = IMF_SUPPORTED | IMF_XRET }, nullptr},
-    IM_UNKNOWN,
+    {"sfence.vma", IT_R, NOALU, AC_SFENCE_VMA, nullptr, {"s", "t"}, 0x12000073, 0xfe007fff, { .flags = IMF_SUPPORTED | IMF_MEM }, nullptr},
     IM_UNKNOWN,
     IM_UNKNOWN,
     IM_UNKNOWN,
@@ -1357,14 +1357,17 @@ void parse_immediate_value(
 uint16_t parse_csr_address(const QString &field_token, uint &chars_taken) {
     if (field_token.at(0).isLetter()) {
         // TODO maybe optimize
+        // The longest name wins, e.g. hpmcounter31 has hpmcounter3 as prefix.
+        uint16_t address = 0;
+        chars_taken = 0;
         for (auto &reg : CSR::REGISTERS) {
-            if (field_token.startsWith(reg.name, Qt::CaseInsensitive)) {
+            if (strlen(reg.name) > chars_taken
+                && field_token.startsWith(reg.name, Qt::CaseInsensitive)) {
                 chars_taken = strlen(reg.name);
-                return reg.address.data;
+                address = reg.address.data;
             }
         }
-        chars_taken = 0;
-        return 0;
+        return address;
     } else {
         char *r;
         uint64_t val;
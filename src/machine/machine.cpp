@@ -2,21 +2,88 @@
 
 #include "programloader.h"
 
+#include <QDateTime>
+#include <QFileInfo>
+#include <QMap>
 #include <QTime>
+#include <algorithm>
+#include <mutex>
 #include <utility>
 
 using namespace machine;
 
+/**
+ * Program images are shared by all machines running the same executable with
+ * the same memory layout. Images are never written, machines get copy-on-write
+ * copies of them.
+ */
+static std::shared_ptr<const Memory>
+get_program_image(ProgramLoader &program, const MachineConfig &config) {
+    static std::mutex images_mutex;
+    static QMap<QString, std::weak_ptr<const Memory>> images;
+
+    const QFileInfo info(config.elf());
+    const QString key = QString("%1:%2:%3:%4:%5")
+                            .arg(info.absoluteFilePath())
+                            .arg(info.size())
+                            .arg(info.lastModified().toMSecsSinceEpoch())
+                            .arg(config.memory_section_size())
+                            .arg((int)config.get_simulated_endian());
+
+    std::lock_guard<std::mutex> lock(images_mutex);
+    auto iter = images.begin();
+    while (iter != images.end()) {
+        if (iter.value().expired()) {
+            iter = images.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    std::shared_ptr<const Memory> image = images.value(key).lock();
+    if (image == nullptr) {
+        auto loaded = std::make_shared<Memory>(
+            config.get_simulated_endian(), config.memory_section_size());
+        program.to_memory(loaded.get());
+        image = loaded;
+        images.insert(key, image);
+    }
+    return image;
+}
+
+/**
+ * Memory protection options are enforced by fixed PMP regions. Executable
+ * segments form the program memory.
+ */
+static void setup_memory_protection(
+    Pmp *pmp,
+    const QVector<ProgramSegment> &segments,
+    const MachineConfig &config) {
+    const bool exec_protect = config.memory_execute_protection();
+    const bool write_protect = config.memory_write_protection();
+    // Program memory is known only for executables.
+    if (segments.isEmpty() || (!exec_protect && !write_protect)) { return; }
+    if (exec_protect) { pmp->set_fixed_default(Pmp::PERM_R | Pmp::PERM_W); }
+    for (const ProgramSegment &segment : segments) {
+        if (!segment.executable || segment.size == 0) { continue; }
+        // Segments linked as writable stay writable.
+        const bool writable = !write_protect || segment.writable;
+        pmp->add_fixed_region(
+            segment.address, segment.address + segment.size - 1,
+            Pmp::PERM_R | Pmp::PERM_X | (writable ? Pmp::PERM_W : 0));
+    }
+}
+
 Machine::Machine(MachineConfig config, bool load_symtab, bool load_executable)
     : machine_config(std::move(config))
     , stat(ST_READY) {
     regs = new Registers();
 
+    QVector<ProgramSegment> program_segments;
     if (load_executable) {
         ProgramLoader program(machine_config.elf());
         this->machine_config.set_simulated_endian(program.get_endian());
-        mem_program_only = new Memory(machine_config.get_simulated_endian());
-        program.to_memory(mem_program_only);
+        mem_program_only = get_program_image(program, machine_config);
+        program_segments = program.get_segments();
 
         if (program.get_architecture_type() == ARCH64)
             this->machine_config.set_simulated_xlen(Xlen::_64);
@@ -33,7 +100,8 @@ Machine::Machine(MachineConfig config, bool load_symtab, bool load_executable)
         }
         mem = new Memory(*mem_program_only);
     } else {
-        mem = new Memory(machine_config.get_simulated_endian());
+        mem = new Memory(
+            machine_config.get_simulated_endian(), machine_config.memory_section_size());
     }
 
     data_bus = new MemoryDataBus(machine_config.get_simulated_endian());
@@ -46,6 +114,8 @@ Machine::Machine(MachineConfig config, bool load_symtab, bool load_executable)
     setup_aclint_mtime();
     setup_aclint_mswi();
     setup_aclint_sswi();
+    setup_roi_control();
+    setup_file_mappings();
 
     unsigned access_time_read = machine_config.memory_access_time_read();
     unsigned access_time_write = machine_config.memory_access_time_write();
@@ -88,6 +158,14 @@ Machine::Machine(MachineConfig config, bool load_symtab, bool load_executable)
         cr = new CoreSingle(regs, predictor, cch_program, cch_data, controlst,
                             machine_config.get_simulated_xlen(), machine_config.get_isa_word());
     }
+    if (controlst->supervisor_supported()) {
+        mmu_unit = new Mmu(cch_data, controlst, machine_config.get_simulated_xlen(), machine_config);
+        cr->set_mmu(mmu_unit);
+    }
+    pmp_unit = new Pmp(controlst);
+    setup_memory_protection(pmp_unit, program_segments, machine_config);
+    cr->set_pmp(pmp_unit);
+    cr->set_hpm_caches(cch_program, cch_data, cch_level2);
     connect(
         this, &Machine::set_interrupt_signal, controlst, &CSR::ControlState::set_interrupt_signal);
 
@@ -159,11 +237,44 @@ void Machine::setup_aclint_sswi() {
         &Machine::set_interrupt_signal);
 }
 
+void Machine::setup_roi_control() {
+    roi_control = new RoiControl(machine_config.get_simulated_endian());
+    memory_bus_insert_range(
+        roi_control, 0xffffc200_addr, 0xffffc200_addr + ROI_CONTROL_SIZE - 1, true);
+    connect(roi_control, &RoiControl::command, this, &Machine::roi_command);
+}
+
+void Machine::setup_file_mappings() {
+    for (const FileMappingConfig &mapping : machine_config.file_mappings()) {
+        auto *file = new MappedFile(
+            machine_config.get_simulated_endian(), mapping.path, mapping.writable,
+            mapping.shared);
+        const Address start(mapping.start);
+        const uint64_t last_offset = file->get_size() - 1;
+        if (last_offset > UINT64_MAX - mapping.start) {
+            delete file;
+            throw SIMULATOR_EXCEPTION(
+                Input, "Mapped file does not fit into the address space",
+                QString("%1 at 0x%2").arg(mapping.path).arg(mapping.start, 0, 16));
+        }
+        if (!memory_bus_insert_range(file, start, start + last_offset, true)) {
+            delete file;
+            throw SIMULATOR_EXCEPTION(
+                Input, "Mapped file overlaps other device",
+                QString("%1 at 0x%2").arg(mapping.path).arg(mapping.start, 0, 16));
+        }
+    }
+}
+
 Machine::~Machine() {
     delete run_t;
     run_t = nullptr;
     delete cr;
     cr = nullptr;
+    delete mmu_unit;
+    mmu_unit = nullptr;
+    delete pmp_unit;
+    pmp_unit = nullptr;
     delete controlst;
     controlst = nullptr;
     delete regs;
@@ -178,8 +289,7 @@ Machine::~Machine() {
     cch_level2 = nullptr;
     delete data_bus;
     data_bus = nullptr;
-    delete mem_program_only;
-    mem_program_only = nullptr;
+    mem_program_only.reset();
     delete symtab;
     symtab = nullptr;
     delete predictor;
@@ -223,10 +333,37 @@ const Cache *Machine::cache_level2() {
     return cch_level2;
 }
 
+const Mmu *Machine::mmu() {
+    return mmu_unit;
+}
+
+const Pmp *Machine::pmp() {
+    return pmp_unit;
+}
+
 Cache *Machine::cache_data_rw() {
     return cch_data;
 }
 
+std::unique_ptr<Memory> Machine::memory_with_cached_data() {
+    auto memory = std::make_unique<Memory>(*mem);
+    for (const Cache *cache : { cch_data, cch_level2 }) {
+        if (cache == nullptr) { continue; }
+        const size_t block_size = cache->get_config().block_size() * BLOCK_ITEM_SIZE;
+        for (Address block : cache->get_dirty_blocks()) {
+            // Data cache sees the most recent data of both levels. Internal
+            // reads of the cache have no side effects.
+            for (size_t offset = 0; offset < block_size; offset += sizeof(uint32_t)) {
+                uint32_t value;
+                cch_data->read(&value, block + offset, sizeof(value), { .type = ae::INTERNAL });
+                memory->write(
+                    block.get_raw() + offset, &value, sizeof(value), { .type = ae::INTERNAL });
+            }
+        }
+    }
+    return memory;
+}
+
 void Machine::cache_sync() {
     if (cch_program != nullptr) {
         cch_program->sync();
@@ -338,7 +475,8 @@ void Machine::step_internal(bool skip_break) {
         QTime start_time = QTime::currentTime();
         do {
             cr->step(skip_break);
-        } while (time_chunk != 0 && stat == ST_BUSY && !skip_break
+            if (!pending_roi_commands.isEmpty()) { process_roi_commands(); }
+        } while (time_chunk != 0 && stat == ST_BUSY && !skip_break && !exit_requested
                  && start_time.msecsTo(QTime::currentTime()) < (int)time_chunk);
     } catch (SimulatorException &e) {
         run_t->stop();
@@ -346,7 +484,7 @@ void Machine::step_internal(bool skip_break) {
         emit program_trap(e);
         return;
     }
-    if (regs->read_pc() >= program_end) {
+    if (exit_requested || regs->read_pc() >= program_end) {
         run_t->stop();
         set_status(ST_EXIT);
         emit program_exit();
@@ -362,6 +500,51 @@ void Machine::step() {
     step_internal(true);
 }
 
+void Machine::roi_command(RoiCommand command, uint32_t value) {
+    // The store is still in progress, statistics are evaluated after the step.
+    pending_roi_commands.append({ command, value });
+}
+
+void Machine::process_roi_commands() {
+    const StatsSnapshot now = stats_snapshot();
+    for (const auto &pending : pending_roi_commands) {
+        const uint32_t value = pending.second;
+        switch (pending.first) {
+        case RoiCommand::ROI_BEGIN: open_regions.insert(value, now); break;
+        case RoiCommand::ROI_END: {
+            auto begin = open_regions.find(value);
+            if (begin == open_regions.end()) { break; } // End without begin is ignored.
+            StatsSnapshot diff = now;
+            diff.subtract(begin.value());
+            open_regions.erase(begin);
+            auto region = std::find_if(
+                finished_regions.begin(), finished_regions.end(), [value](const StatsRegion &r) {
+                    return r.kind == StatsRegion::ROI && r.id == value;
+                });
+            if (region == finished_regions.end()) {
+                finished_regions.append({ StatsRegion::ROI, value, 1, diff });
+            } else {
+                region->count++;
+                region->stats.add(diff);
+            }
+            break;
+        }
+        case RoiCommand::STATS_RESET: stats_base = now; break;
+        case RoiCommand::STATS_DUMP: {
+            StatsSnapshot diff = now;
+            diff.subtract(stats_base);
+            finished_regions.append({ StatsRegion::DUMP, value, 1, diff });
+            break;
+        }
+        case RoiCommand::EXIT:
+            exit_code = value;
+            exit_requested = true;
+            break;
+        }
+    }
+    pending_roi_commands.clear();
+}
+
 void Machine::step_timer() {
     step_internal();
 }
@@ -375,7 +558,15 @@ void Machine::restart() {
     cch_program->reset();
     cch_data->reset();
     cch_level2->reset();
+    if (mmu_unit != nullptr) { mmu_unit->reset(); }
+    pmp_unit->reset();
     cr->reset();
+    pending_roi_commands.clear();
+    open_regions.clear();
+    stats_base = StatsSnapshot();
+    finished_regions.clear();
+    exit_requested = false;
+    exit_code = 0;
     set_status(ST_READY);
 }
 
@@ -407,6 +598,18 @@ bool Machine::memory_bus_insert_range(
         mem_acces, start_addr, last_addr, move_ownership);
 }
 
+void Machine::add_memory_access_observer(MemoryAccessObserver *observer) {
+    if (cr != nullptr) {
+        cr->add_memory_access_observer(observer);
+    }
+}
+
+void Machine::remove_memory_access_observer(MemoryAccessObserver *observer) {
+    if (cr != nullptr) {
+        cr->remove_memory_access_observer(observer);
+    }
+}
+
 void Machine::insert_hwbreak(Address address) {
     if (cr != nullptr) {
         cr->insert_hwbreak(address);
@@ -464,3 +667,22 @@ enum ExceptionCause Machine::get_exception_cause() const {
         return (ExceptionCause)val;
     }
 }
+
+StatsSnapshot Machine::stats_snapshot() const {
+    StatsSnapshot snapshot;
+    snapshot.cycles = cr->get_cycle_count();
+    snapshot.stalls = cr->get_stall_count();
+    snapshot.cpi_stack = cr->get_cpi_stack();
+    snapshot.program_cache = CacheStats(*cch_program);
+    snapshot.data_cache = CacheStats(*cch_data);
+    snapshot.level2_cache = CacheStats(*cch_level2);
+    return snapshot;
+}
+
+const QVector<StatsRegion> &Machine::stats_regions() const {
+    return finished_regions;
+}
+
+uint32_t Machine::get_exit_code() const {
+    return exit_code;
+}
@@ -4,20 +4,27 @@
 #include "core.h"
 #include "machineconfig.h"
 #include "memory/backend/lcddisplay.h"
+#include "memory/backend/mappedfile.h"
 #include "memory/backend/peripheral.h"
 #include "memory/backend/peripspiled.h"
 #include "memory/backend/serialport.h"
 #include "memory/backend/aclintmtimer.h"
 #include "memory/backend/aclintmswi.h"
 #include "memory/backend/aclintsswi.h"
+#include "memory/backend/roicontrol.h"
 #include "memory/cache/cache.h"
 #include "memory/memory_bus.h"
 #include "predictor.h"
 #include "registers.h"
 #include "simulator_exception.h"
+#include "stats_region.h"
 #include "symboltable.h"
 
+#include <QMap>
 #include <QObject>
+#include <QVector>
+#include <memory>
+#include <utility>
 #include <QTimer>
 #include <cstdint>
 
@@ -36,10 +43,19 @@ public:
     const CSR::ControlState *control_state();
     const Memory *memory();
     Memory *memory_rw();
+    /**
+     * Copy of the main memory including data held in write-back caches, which
+     * were not written back yet. Caches are not modified.
+     */
+    std::unique_ptr<Memory> memory_with_cached_data();
     const Cache *cache_program();
     const Cache *cache_data();
     const Cache *cache_level2();
     Cache *cache_data_rw();
+    /** Present only when supervisor mode ('S' in ISA word) is enabled. */
+    const Mmu *mmu();
+    /** Physical memory protection including the memory protection options. */
+    const Pmp *pmp();
     void cache_sync();
     const MemoryDataBus *memory_data_bus();
     MemoryDataBus *memory_data_bus_rw();
@@ -79,12 +95,21 @@ public:
     void insert_hwbreak(Address address);
     void remove_hwbreak(Address address);
     bool is_hwbreak(Address address);
+    void add_memory_access_observer(MemoryAccessObserver *observer);
+    void remove_memory_access_observer(MemoryAccessObserver *observer);
     void set_stop_on_exception(enum ExceptionCause excause, bool value);
     bool get_stop_on_exception(enum ExceptionCause excause) const;
     void set_step_over_exception(enum ExceptionCause excause, bool value);
     bool get_step_over_exception(enum ExceptionCause excause) const;
     enum ExceptionCause get_exception_cause() const;
 
+    /** Current values of core and cache statistics. */
+    StatsSnapshot stats_snapshot() const;
+    /** Regions finished and statistics dumped by the guest, in order of the first finish. */
+    const QVector<StatsRegion> &stats_regions() const;
+    /** Exit code requested by the guest through `RoiControl`, zero otherwise. */
+    uint32_t get_exit_code() const;
+
 public slots:
     void play();
     void pause();
@@ -101,9 +126,12 @@ signals:
 
 private slots:
     void step_timer();
+    void roi_command(machine::RoiCommand command, uint32_t value);
 
 private:
     void step_internal(bool skip_break = false);
+    /** Evaluate guest commands issued by the last step, after its statistics are updated. */
+    void process_roi_commands();
     MachineConfig machine_config;
 
     Registers *regs = nullptr;
@@ -112,8 +140,10 @@ private:
      * Memory with loaded program only.
      * It is not used for execution, only for quick
      * simulation reset without repeated ELF file loading.
+     * It is shared by all machines running the same executable, `mem` shares
+     * its sections until they are written.
      */
-    Memory *mem_program_only = nullptr;
+    std::shared_ptr<const Memory> mem_program_only;
     MemoryDataBus *data_bus = nullptr;
     SerialPort *ser_port = nullptr;
     PeripSpiLed *perip_spi_led = nullptr;
@@ -121,10 +151,13 @@ private:
     aclint::AclintMtimer *aclint_mtimer = nullptr;
     aclint::AclintMswi *aclint_mswi = nullptr;
     aclint::AclintSswi *aclint_sswi = nullptr;
+    RoiControl *roi_control = nullptr;
     Cache *cch_program = nullptr;
     Cache *cch_data = nullptr;
     Cache *cch_level2 = nullptr;
     CSR::ControlState *controlst = nullptr;
+    Mmu *mmu_unit = nullptr;
+    Pmp *pmp_unit = nullptr;
     Predictor *predictor = nullptr;
     Core *cr = nullptr;
 
@@ -134,6 +167,16 @@ private:
     SymbolTable *symtab = nullptr;
     Address program_end = 0xffff0000_addr;
     enum Status stat = ST_READY;
+
+    QVector<std::pair<RoiCommand, uint32_t>> pending_roi_commands;
+    /** Statistics at the start of opened regions by id. */
+    QMap<uint32_t, StatsSnapshot> open_regions;
+    /** Statistics at the last reset requested by the guest. */
+    StatsSnapshot stats_base;
+    QVector<StatsRegion> finished_regions;
+    bool exit_requested = false;
+    uint32_t exit_code = 0;
+
     void set_status(enum Status st);
     void setup_serial_port();
     void setup_perip_spi_led();
@@ -141,6 +184,8 @@ private:
     void setup_aclint_mtime();
     void setup_aclint_mswi();
     void setup_aclint_sswi();
+    void setup_roi_control();
+    void setup_file_mappings();
 };
 
 } // namespace machine
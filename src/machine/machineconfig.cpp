@@ -3,6 +3,7 @@
 #include "common/endian.h"
 
 #include <QMap>
+#include <QStringList>
 #include <utility>
 
 using namespace machine;
@@ -19,7 +20,11 @@ using namespace machine;
 #define DF_MEM_ACC_BURST 0
 #define DF_MEM_ACC_LEVEL2 2
 #define DF_MEM_ACC_BURST_ENABLE false
+#define DF_MEM_SECTION_SIZE 4096
 #define DF_ELF QString("")
+#define DF_TLB_SETS 16
+#define DF_TLB_ASSOC 2
+#define DF_PWC_SIZE 0
 //////////////////////////////////////////////////////////////////////////////
 /// Default config of CacheConfig
 #define DFC_EN false
@@ -148,6 +153,44 @@ bool CacheConfig::operator!=(const CacheConfig &c) const {
     return !operator==(c);
 }
 
+bool FileMappingConfig::from_string(const QString &spec, FileMappingConfig &mapping) {
+    // Path may contain commas, so mode is separated by the last one.
+    const int comma1 = spec.indexOf(',');
+    const int comma2 = spec.lastIndexOf(',');
+    if (comma1 < 0 || comma2 <= comma1 + 1) { return false; }
+    bool ok;
+    mapping.start = spec.left(comma1).toULongLong(&ok, 0);
+    if (!ok) { return false; }
+    mapping.path = spec.mid(comma1 + 1, comma2 - comma1 - 1);
+    const QString mode = spec.mid(comma2 + 1).toLower();
+    if (mode == "ro") {
+        mapping.writable = false;
+        mapping.shared = false;
+    } else if (mode == "rw") {
+        mapping.writable = true;
+        mapping.shared = false;
+    } else if (mode == "rw-shared") {
+        mapping.writable = true;
+        mapping.shared = true;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+QString FileMappingConfig::to_string() const {
+    const char *mode = !writable ? "ro" : (shared ? "rw-shared" : "rw");
+    return QString("0x%1,%2,%3").arg(start, 0, 16).arg(path).arg(mode);
+}
+
+bool FileMappingConfig::operator==(const FileMappingConfig &c) const {
+    return start == c.start && path == c.path && writable == c.writable && shared == c.shared;
+}
+
+bool FileMappingConfig::operator!=(const FileMappingConfig &c) const {
+    return !operator==(c);
+}
+
 MachineConfig::MachineConfig() {
     simulated_endian = LITTLE;
     simulated_xlen = Xlen::_32;
@@ -162,6 +205,7 @@ MachineConfig::MachineConfig() {
     mem_acc_burst = DF_MEM_ACC_BURST;
     mem_acc_level2 = DF_MEM_ACC_LEVEL2;
     mem_acc_enable_burst = DF_MEM_ACC_BURST_ENABLE;
+    mem_section_size = DF_MEM_SECTION_SIZE;
     osem_enable = true;
     osem_known_syscall_stop = true;
     osem_unknown_syscall_stop = true;
@@ -173,6 +217,13 @@ MachineConfig::MachineConfig() {
     cch_program = CacheConfig();
     cch_data = CacheConfig();
     cch_level2 = CacheConfig();
+    tlb_prog = CacheConfig();
+    tlb_prog.set_enabled(true);
+    tlb_prog.set_set_count(DF_TLB_SETS);
+    tlb_prog.set_associativity(DF_TLB_ASSOC);
+    tlb_prog.set_replacement_policy(CacheConfig::RP_LRU);
+    tlb_dat = tlb_prog;
+    pwc_size = DF_PWC_SIZE;
 }
 
 MachineConfig::MachineConfig(const MachineConfig *config) {
@@ -189,6 +240,8 @@ MachineConfig::MachineConfig(const MachineConfig *config) {
     mem_acc_burst = config->memory_access_time_burst();
     mem_acc_level2 = config->memory_access_time_level2();
     mem_acc_enable_burst = config->memory_access_enable_burst();
+    mem_section_size = config->memory_section_size();
+    file_maps = config->file_mappings();
     osem_enable = config->osemu_enable();
     osem_known_syscall_stop = config->osemu_known_syscall_stop();
     osem_unknown_syscall_stop = config->osemu_unknown_syscall_stop();
@@ -200,6 +253,9 @@ MachineConfig::MachineConfig(const MachineConfig *config) {
     cch_program = config->cache_program();
     cch_data = config->cache_data();
     cch_level2 = config->cache_level2();
+    tlb_prog = config->tlb_program();
+    tlb_dat = config->tlb_data();
+    pwc_size = config->page_walk_cache_size();
 }
 
 #define N(STR) (prefix + QString(STR))
@@ -223,6 +279,11 @@ MachineConfig::MachineConfig(const QSettings *sts, const QString &prefix) {
     mem_acc_burst = sts->value(N("MemoryBurst"), DF_MEM_ACC_BURST).toUInt();
     mem_acc_level2 = sts->value(N("MemoryLevel2"), DF_MEM_ACC_LEVEL2).toUInt();
     mem_acc_enable_burst = sts->value(N("MemoryBurstEnable"), DF_MEM_ACC_BURST_ENABLE).toBool();
+    mem_section_size = sts->value(N("MemorySectionSize"), DF_MEM_SECTION_SIZE).toUInt();
+    for (const QString &spec : sts->value(N("FileMappings")).toStringList()) {
+        FileMappingConfig mapping;
+        if (FileMappingConfig::from_string(spec, mapping)) { file_maps.append(mapping); }
+    }
     osem_enable = sts->value(N("OsemuEnable"), true).toBool();
     osem_known_syscall_stop
         = sts->value(N("OsemuKnownSyscallStop"), true).toBool();
@@ -236,6 +297,11 @@ MachineConfig::MachineConfig(const QSettings *sts, const QString &prefix) {
     cch_program = CacheConfig(sts, N("ProgramCache_"));
     cch_data = CacheConfig(sts, N("DataCache_"));
     cch_level2 = CacheConfig(sts, N("Level2Cache_"));
+    if (sts->contains(N("ProgramTlb_Enabled"))) {
+        tlb_prog = CacheConfig(sts, N("ProgramTlb_"));
+    }
+    if (sts->contains(N("DataTlb_Enabled"))) { tlb_dat = CacheConfig(sts, N("DataTlb_")); }
+    pwc_size = sts->value(N("PageWalkCacheSize"), DF_PWC_SIZE).toUInt();
 }
 
 void MachineConfig::store(QSettings *sts, const QString &prefix) {
@@ -249,6 +315,12 @@ void MachineConfig::store(QSettings *sts, const QString &prefix) {
     sts->setValue(N("MemoryBurst"), memory_access_time_burst());
     sts->setValue(N("MemoryLevel2"), memory_access_time_level2());
     sts->setValue(N("MemoryBurstEnable"), memory_access_enable_burst());
+    sts->setValue(N("MemorySectionSize"), memory_section_size());
+    QStringList mapping_specs;
+    for (const FileMappingConfig &mapping : file_mappings()) {
+        mapping_specs.append(mapping.to_string());
+    }
+    sts->setValue(N("FileMappings"), mapping_specs);
     sts->setValue(N("OsemuEnable"), osemu_enable());
     sts->setValue(N("OsemuKnownSyscallStop"), osemu_known_syscall_stop());
     sts->setValue(N("OsemuUnknownSyscallStop"), osemu_unknown_syscall_stop());
@@ -260,6 +332,9 @@ void MachineConfig::store(QSettings *sts, const QString &prefix) {
     cch_program.store(sts, N("ProgramCache_"));
     cch_data.store(sts, N("DataCache_"));
     cch_level2.store(sts, N("Level2Cache_"));
+    tlb_prog.store(sts, N("ProgramTlb_"));
+    tlb_dat.store(sts, N("DataTlb_"));
+    sts->setValue(N("PageWalkCacheSize"), page_walk_cache_size());
 }
 
 #undef N
@@ -362,6 +437,10 @@ void MachineConfig::set_memory_access_enable_burst(bool v) {
     mem_acc_enable_burst = v;
 }
 
+void MachineConfig::set_memory_section_size(unsigned v) {
+    mem_section_size = v;
+}
+
 void MachineConfig::set_osemu_enable(bool v) {
     osem_enable = v;
 }
@@ -382,6 +461,14 @@ void MachineConfig::set_osemu_exception_stop(bool v) {
     osem_exception_stop = v;
 }
 
+void MachineConfig::set_file_mappings(const QVector<FileMappingConfig> &mappings) {
+    file_maps = mappings;
+}
+
+void MachineConfig::add_file_mapping(const FileMappingConfig &mapping) {
+    file_maps.append(mapping);
+}
+
 void MachineConfig::set_osemu_fs_root(QString v) {
     osem_fs_root = std::move(v);
 }
@@ -406,6 +493,18 @@ void MachineConfig::set_cache_level2(const CacheConfig &c) {
     cch_level2 = c;
 }
 
+void MachineConfig::set_tlb_program(const CacheConfig &c) {
+    tlb_prog = c;
+}
+
+void MachineConfig::set_tlb_data(const CacheConfig &c) {
+    tlb_dat = c;
+}
+
+void MachineConfig::set_page_walk_cache_size(unsigned v) {
+    pwc_size = v;
+}
+
 void MachineConfig::set_simulated_endian(Endian endian) {
     MachineConfig::simulated_endian = endian;
 }
@@ -464,6 +563,10 @@ bool MachineConfig::memory_access_enable_burst() const {
     return mem_acc_enable_burst;
 }
 
+unsigned MachineConfig::memory_section_size() const {
+    return mem_section_size;
+}
+
 bool MachineConfig::osemu_enable() const {
     return osem_enable;
 }
@@ -480,6 +583,10 @@ bool MachineConfig::osemu_exception_stop() const {
     return osem_exception_stop;
 }
 
+const QVector<FileMappingConfig> &MachineConfig::file_mappings() const {
+    return file_maps;
+}
+
 QString MachineConfig::osemu_fs_root() const {
     return osem_fs_root;
 }
@@ -504,6 +611,18 @@ const CacheConfig &MachineConfig::cache_level2() const {
     return cch_level2;
 }
 
+const CacheConfig &MachineConfig::tlb_program() const {
+    return tlb_prog;
+}
+
+const CacheConfig &MachineConfig::tlb_data() const {
+    return tlb_dat;
+}
+
+unsigned MachineConfig::page_walk_cache_size() const {
+    return pwc_size;
+}
+
 CacheConfig *MachineConfig::access_cache_program() {
     return &cch_program;
 }
@@ -516,6 +635,14 @@ CacheConfig *MachineConfig::access_cache_level2() {
     return &cch_level2;
 }
 
+CacheConfig *MachineConfig::access_tlb_program() {
+    return &tlb_prog;
+}
+
+CacheConfig *MachineConfig::access_tlb_data() {
+    return &tlb_dat;
+}
+
 Endian MachineConfig::get_simulated_endian() const {
     return simulated_endian;
 }
@@ -535,9 +662,11 @@ bool MachineConfig::operator==(const MachineConfig &c) const {
            && CMP(memory_execute_protection) && CMP(memory_write_protection)
            && CMP(memory_access_time_read) && CMP(memory_access_time_write)
            && CMP(memory_access_time_burst) && CMP(memory_access_time_level2)
-           && CMP(memory_access_enable_burst)
+           && CMP(memory_access_enable_burst) && CMP(memory_section_size)
+           && CMP(file_mappings)
            && CMP(elf) && CMP(cache_program)
-           && CMP(cache_data) && CMP(cache_level2);
+           && CMP(cache_data) && CMP(cache_level2)
+           && CMP(tlb_program) && CMP(tlb_data) && CMP(page_walk_cache_size);
 #undef CMP
 }
 
@@ -6,6 +6,8 @@
 
 #include <QSettings>
 #include <QString>
+#include <QVector>
+#include <cstdint>
 
 namespace machine {
 
@@ -79,6 +81,26 @@ private:
     enum WritePolicy write_pol;
 };
 
+/**
+ * Host file mapped into the simulated memory (see `MappedFile`).
+ */
+struct FileMappingConfig {
+    uint64_t start = 0;
+    QString path;
+    bool writable = false;
+    bool shared = false; //> Writes are stored to the file
+
+    /**
+     * Parse "START,PATH,MODE" where mode is ro (read only), rw (writes are
+     * private to the simulation) or rw-shared (writes go to the file).
+     */
+    static bool from_string(const QString &spec, FileMappingConfig &mapping);
+    QString to_string() const;
+
+    bool operator==(const FileMappingConfig &c) const;
+    bool operator!=(const FileMappingConfig &c) const;
+};
+
 class MachineConfig {
 public:
     MachineConfig();
@@ -112,6 +134,13 @@ public:
     void set_memory_access_time_burst(unsigned);
     void set_memory_access_time_level2(unsigned);
     void set_memory_access_enable_burst(bool);
+    // Size of lazily allocated main memory sections in bytes. It has to be
+    // a power of two from 256 B to 2 MiB.
+    void set_memory_section_size(unsigned);
+    // Host files mapped into physical address space. Their ranges must not
+    // overlap main memory (0x00000000-0xefffffff) nor peripherals.
+    void set_file_mappings(const QVector<FileMappingConfig> &);
+    void add_file_mapping(const FileMappingConfig &);
     // Operating system and exceptions setup
     void set_osemu_enable(bool);
     void set_osemu_known_syscall_stop(bool);
@@ -128,6 +157,13 @@ public:
     void set_cache_program(const CacheConfig &);
     void set_cache_data(const CacheConfig &);
     void set_cache_level2(const CacheConfig &);
+    // Configure TLBs (used only when 'S' is in the ISA word). Block size of
+    // the configuration is ignored.
+    void set_tlb_program(const CacheConfig &);
+    void set_tlb_data(const CacheConfig &);
+    // Number of non-leaf page table entries cached for page walks, zero
+    // disables the page walk cache.
+    void set_page_walk_cache_size(unsigned);
     void set_simulated_endian(Endian endian);
     void set_simulated_xlen(Xlen xlen);
     void set_isa_word(ConfigIsaWord bits);
@@ -143,6 +179,8 @@ public:
     unsigned memory_access_time_burst() const;
     unsigned memory_access_time_level2() const;
     bool memory_access_enable_burst() const;
+    unsigned memory_section_size() const;
+    const QVector<FileMappingConfig> &file_mappings() const;
     bool osemu_enable() const;
     bool osemu_known_syscall_stop() const;
     bool osemu_unknown_syscall_stop() const;
@@ -154,6 +192,9 @@ public:
     const CacheConfig &cache_program() const;
     const CacheConfig &cache_data() const;
     const CacheConfig &cache_level2() const;
+    const CacheConfig &tlb_program() const;
+    const CacheConfig &tlb_data() const;
+    unsigned page_walk_cache_size() const;
     Endian get_simulated_endian() const;
     Xlen get_simulated_xlen() const;
     ConfigIsaWord get_isa_word() const;
@@ -161,6 +202,8 @@ public:
     CacheConfig *access_cache_program();
     CacheConfig *access_cache_data();
     CacheConfig *access_cache_level2();
+    CacheConfig *access_tlb_program();
+    CacheConfig *access_tlb_data();
 
     bool operator==(const MachineConfig &c) const;
     bool operator!=(const MachineConfig &c) const;
@@ -171,12 +214,16 @@ private:
     bool exec_protect, write_protect;
     unsigned mem_acc_read, mem_acc_write, mem_acc_burst, mem_acc_level2;
     bool mem_acc_enable_burst;
+    unsigned mem_section_size;
+    QVector<FileMappingConfig> file_maps;
     bool osem_enable, osem_known_syscall_stop, osem_unknown_syscall_stop;
     bool osem_interrupt_stop, osem_exception_stop;
     bool res_at_compile;
     QString osem_fs_root;
     QString elf_path;
     CacheConfig cch_program, cch_data, cch_level2;
+    CacheConfig tlb_prog, tlb_dat;
+    unsigned pwc_size;
     Endian simulated_endian;
     Xlen simulated_xlen;
     ConfigIsaWord isa_word;
@@ -41,12 +41,13 @@ enum AccessControl {
     AC_AMOMINU64,
     AC_AMOMAXU64,
     AC_CACHE_OP,
+    AC_SFENCE_VMA,
 };
 
 constexpr AccessControl AC_FIRST_REGULAR = AC_I8;
 constexpr AccessControl AC_LAST_REGULAR = AC_U64;
 constexpr AccessControl AC_FIRST_SPECIAL = AC_LR32;
-constexpr AccessControl AC_LAST_SPECIAL = AC_CACHE_OP;
+constexpr AccessControl AC_LAST_SPECIAL = AC_SFENCE_VMA;
 constexpr AccessControl AC_FISRT_AMO_MODIFY32 = AC_AMOSWAP32;
 constexpr AccessControl AC_LAST_AMO_MODIFY32 = AC_AMOMAXU32;
 constexpr AccessControl AC_FISRT_AMO_MODIFY64 = AC_AMOSWAP64;
@@ -62,6 +63,32 @@ constexpr bool is_special_access(AccessControl type) {
 static_assert(is_special_access(AC_CACHE_OP), "");
 static_assert(is_special_access((AccessControl)11), "");
 
+/** LR, SC and AMO instructions. */
+constexpr bool is_amo_access(AccessControl type) {
+    return AC_LR32 <= type and type <= AC_AMOMAXU64;
+}
+
+/** Number of bytes transferred by an access of given type (zero for non-access). */
+constexpr unsigned access_control_size(AccessControl type) {
+    switch (type) {
+    case AC_I8:
+    case AC_U8: return 1;
+    case AC_I16:
+    case AC_U16: return 2;
+    case AC_I32:
+    case AC_U32:
+    case AC_LR32:
+    case AC_SC32:
+    case AC_AMOSWAP32 ... AC_AMOMAXU32: return 4;
+    case AC_I64:
+    case AC_U64:
+    case AC_LR64:
+    case AC_SC64:
+    case AC_AMOSWAP64 ... AC_AMOMAXU64: return 8;
+    default: return 0;
+    }
+}
+
 enum ExceptionCause {
     EXCAUSE_NONE = 0, // Use zero as default value when no exception is
     // ECAUSE_INSN_MISALIGNED - not defined for now, overlaps with EXCAUSE_NON
@@ -17,6 +17,19 @@ namespace machine {
  */
 typedef size_t Offset;
 
+/**
+ * Host memory backing a range of device offsets.
+ * @see BackendMemory::get_host_window
+ */
+struct BackendHostWindow {
+    byte *data;   //> Host pointer to `start`
+    Offset start; //> First offset backed by `data`
+    Offset last;  //> Last offset backed by `data`
+    bool writable; //> Writes through `data` are allowed
+    uint64_t *dirty_epoch;         //> Set to `*current_epoch` by direct writes
+    const uint64_t *current_epoch; //> May be null, when not tracked
+};
+
 /**
  * Interface for physical memory or periphery.
  * .
@@ -94,6 +107,19 @@ public:
      */
     [[nodiscard]] virtual enum LocationStatus location_status(Offset offset) const = 0;
 
+    /**
+     * Get host memory which backs given offset and can be accessed directly
+     * by memcpy instead of `read` and `write`. Only plain memory without side
+     * effects can provide it. Pointer stays valid until the device notifies
+     * an external change (`external_backend_change_notify`).
+     *
+     * @param offset        offset within the window
+     * @param allocate      allocate lazily allocated memory if needed
+     * @param window        filled on success
+     * @return              false when the offset has no such memory
+     */
+    virtual bool get_host_window(Offset offset, bool allocate, BackendHostWindow &window);
+
     /**
      * Endian of the simulated CPU/memory system.
      * @see BackendMemory docs
@@ -106,19 +132,26 @@ signals:
      *
      * @param mem_access    this
      * @param start_addr    affected area start
-     * @param last_addr     affected area end
+     * @param last_addr     affected area end, SIZE_MAX for the whole device
      * @param type          allowed side effects, see type declaration
      */
     void external_backend_change_notify(
         const BackendMemory *mem_access,
-        uint32_t start_addr,
-        uint32_t last_addr,
+        Offset start_addr,
+        Offset last_addr,
         AccessEffects type) const;
 };
 
 inline BackendMemory::BackendMemory(Endian simulated_machine_endian)
     : simulated_machine_endian(simulated_machine_endian) {}
 
+inline bool BackendMemory::get_host_window(Offset offset, bool allocate, BackendHostWindow &window) {
+    UNUSED(offset)
+    UNUSED(allocate)
+    UNUSED(window)
+    return false;
+}
+
 } // namespace machine
 
 #endif // BACKEND_MEMORY_H
@@ -0,0 +1,93 @@
+#include "memory/backend/mappedfile.h"
+
+#include <cstring>
+
+using namespace machine;
+
+MappedFile::MappedFile(
+    Endian simulated_machine_endian,
+    const QString &path,
+    bool writable,
+    bool shared)
+    : BackendMemory(simulated_machine_endian)
+    , file(path)
+    , writable(writable) {
+    shared = shared && writable;
+    if (!file.open(shared ? QIODevice::ReadWrite : QIODevice::ReadOnly)) {
+        throw SIMULATOR_EXCEPTION(Input, "Cannot open file for mapping", path);
+    }
+    size = (size_t)file.size();
+    if (size == 0) { throw SIMULATOR_EXCEPTION(Input, "Cannot map empty file", path); }
+    // Private mapping is writable even for file opened read only.
+    data = file.map(
+        0, (qint64)size,
+        (writable && !shared) ? QFileDevice::MapPrivateOption : QFileDevice::NoOptions);
+    if (data == nullptr) {
+        throw SIMULATOR_EXCEPTION(Input, "Cannot map file", path + ": " + file.errorString());
+    }
+}
+
+MappedFile::~MappedFile() {
+    file.unmap(data);
+}
+
+WriteResult MappedFile::write(
+    Offset destination,
+    const void *source,
+    size_t size,
+    WriteOptions options) {
+    UNUSED(options)
+
+    if (destination >= this->size) {
+        throw SIMULATOR_EXCEPTION(
+            OutOfMemoryAccess, "Trying to write outside of the mapped file",
+            QString("Accessing using offset: ") + QString::number(destination));
+    }
+    const size_t available_size = std::min(destination + size, this->size) - destination;
+    if (!writable) {
+        // Write to read only file is nop
+        return { .n_bytes = available_size, .changed = false };
+    }
+
+    bool changed = memcmp(source, data + destination, available_size) != 0;
+    if (changed) { memcpy(data + destination, source, available_size); }
+    return { .n_bytes = available_size, .changed = changed };
+}
+
+ReadResult MappedFile::read(
+    void *destination,
+    Offset source,
+    size_t size,
+    ReadOptions options) const {
+    UNUSED(options)
+
+    if (source >= this->size) {
+        throw SIMULATOR_EXCEPTION(
+            OutOfMemoryAccess, "Trying to read outside of the mapped file",
+            QString("Accessing using offset: ") + QString::number(source));
+    }
+    size = std::min(source + size, this->size) - source;
+    memcpy(destination, data + source, size);
+    return { .n_bytes = size };
+}
+
+LocationStatus MappedFile::location_status(Offset offset) const {
+    if (offset >= size) { return LOCSTAT_ILLEGAL; }
+    return writable ? LOCSTAT_NONE : LOCSTAT_READ_ONLY;
+}
+
+bool MappedFile::get_host_window(Offset offset, bool allocate, BackendHostWindow &window) {
+    UNUSED(allocate)
+    if (offset >= size) { return false; }
+    window = { .data = data,
+               .start = 0,
+               .last = size - 1,
+               .writable = writable,
+               .dirty_epoch = nullptr,
+               .current_epoch = nullptr };
+    return true;
+}
+
+size_t MappedFile::get_size() const {
+    return size;
+}
@@ -0,0 +1,64 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include "common/endian.h"
+#include "machinedefs.h"
+#include "memory/backend/backend_memory.h"
+#include "simulator_exception.h"
+
+#include <QFile>
+#include <QObject>
+#include <QString>
+#include <cstdint>
+
+namespace machine {
+
+/**
+ * Host file mapped into the simulated memory.
+ *
+ * The file is accessed through host memory mapping, so no part of it is read
+ * until the simulated program touches it and large inputs cost no copying.
+ * The file holds bytes in the order they appear in the simulated memory (the
+ * same as a memory dump), therefore no byteswap is done.
+ */
+class MappedFile final : public BackendMemory {
+    Q_OBJECT
+public:
+    /**
+     * @param writable      writes are ignored when false
+     * @param shared        writes are stored to the file, otherwise they stay
+     *                      private to the simulation
+     * @throws SimulatorExceptionInput  when the file cannot be mapped
+     */
+    MappedFile(Endian simulated_machine_endian, const QString &path, bool writable, bool shared);
+    ~MappedFile() override;
+
+    WriteResult write(
+        Offset destination,
+        const void *source,
+        size_t size,
+        WriteOptions options) override;
+
+    ReadResult read(
+        void *destination,
+        Offset source,
+        size_t size,
+        ReadOptions options) const override;
+
+    [[nodiscard]] LocationStatus location_status(Offset offset) const override;
+
+    bool get_host_window(Offset offset, bool allocate, BackendHostWindow &window) override;
+
+    /** @return  size of the mapped file in bytes */
+    [[nodiscard]] size_t get_size() const;
+
+private:
+    QFile file;
+    const bool writable;
+    size_t size = 0;
+    byte *data = nullptr;
+};
+
+} // namespace machine
+
+#endif // MAPPEDFILE_H
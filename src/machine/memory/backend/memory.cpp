@@ -3,6 +3,9 @@
 #include "common/endian.h"
 #include "simulator_exception.h"
 
+#include <QStringList>
+#include <algorithm>
+#include <cstring>
 #include <memory>
 
 namespace machine {
@@ -15,7 +18,9 @@ MemorySection::MemorySection(
 
 MemorySection::MemorySection(const MemorySection &other)
     : BackendMemory(other.simulated_machine_endian)
-    , dt(other.dt) {}
+    , dt(other.dt)
+    , write_epoch(other.write_epoch)
+    , block_epochs(other.block_epochs) {}
 
 WriteResult MemorySection::write(Offset dst_offset, const void *source, size_t size, WriteOptions options) {
     UNUSED(options)
@@ -71,6 +76,10 @@ const byte *MemorySection::data() const {
     return this->dt.data();
 }
 
+byte *MemorySection::data() {
+    return this->dt.data();
+}
+
 bool MemorySection::operator==(const MemorySection &other) const {
     return this->dt == other.dt;
 }
@@ -79,108 +88,193 @@ bool MemorySection::operator!=(const MemorySection &ms) const {
     return !this->operator==(ms);
 }
 
-// Settings sanity checks
-static_assert(
-    MEMORY_SECTION_SIZE != 0,
-    "Nonzero memory section size is required.");
-static_assert(
-    MEMORY_TREE_ROW_SIZE != 0,
-    "Nonzero memory tree row size is required.");
-static_assert(
-    ((32 - MEMORY_SECTION_BITS) % MEMORY_TREE_BITS) == 0,
-    "Number of bits in tree row has to be exact division of available number "
-    "of bits.");
+void MemorySection::acquire() const {
+    ref_count.fetch_add(1, std::memory_order_relaxed);
+}
 
-/**
- * Generate mask to get memory section index from address.
- *
- * Memory section of section_size 2^`section_size` separably addressable units
- * each of section_size 2^`unit_size` bytes.
- *
- * Example:
- *  `MemorySection` of 256x1B index is received as
- *  ```address & generate_mask(8, 0)```
- */
-constexpr uint64_t generate_mask(size_t section_size, size_t unit_size) {
-    return ((1U << section_size) - 1) << unit_size;
+bool MemorySection::release() const {
+    return ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1;
 }
 
-/**
- * Get index in row for given offset and row number i
- */
-constexpr size_t tree_row_bit_offset(size_t i) {
-    return 32 - MEMORY_TREE_BITS - i * MEMORY_TREE_BITS;
+bool MemorySection::is_shared() const {
+    return ref_count.load(std::memory_order_acquire) > 1;
 }
 
-/*
- * Select branch index from memory tree.
- */
-constexpr size_t get_tree_row(size_t offset, size_t i) {
-    return (offset & generate_mask(MEMORY_TREE_BITS, tree_row_bit_offset(i)))
-           >> tree_row_bit_offset(i);
+void MemorySection::mark_dirty(size_t offset, size_t size, uint64_t epoch, bool track_blocks) {
+    if (track_blocks && block_epochs.empty()) {
+        // Earlier writes are known only for the whole section.
+        block_epochs.assign(
+            (length() + MEMORY_DIRTY_BLOCK_SIZE - 1) >> MEMORY_DIRTY_BLOCK_BITS, write_epoch);
+    }
+    write_epoch = epoch;
+    // Once allocated, blocks are kept up to date even if tracking was disabled.
+    if (!block_epochs.empty() && size > 0) {
+        for (size_t block = offset >> MEMORY_DIRTY_BLOCK_BITS;
+             block <= (offset + size - 1) >> MEMORY_DIRTY_BLOCK_BITS; block++) {
+            block_epochs[block] = epoch;
+        }
+    }
+}
+
+uint64_t MemorySection::get_write_epoch() const {
+    return write_epoch;
+}
+
+const std::vector<uint64_t> &MemorySection::get_block_epochs() const {
+    return block_epochs;
 }
 
-Memory::Memory() : BackendMemory(BIG) {
+uint64_t *MemorySection::access_write_epoch() {
+    return &write_epoch;
+}
+
+// Settings sanity checks
+static_assert(
+    MEMORY_TREE_ROW_SIZE != 0,
+    "Nonzero memory tree row size is required.");
+static_assert(
+    MEMORY_SECTION_BITS >= MEMORY_SECTION_BITS_MIN
+        && MEMORY_SECTION_BITS <= MEMORY_SECTION_BITS_MAX,
+    "Default memory section size has to be supported.");
+static_assert(
+    MEMORY_TREE_POOL_CHUNK != 0,
+    "Nonzero number of nodes in pool chunk is required.");
+
+// Hosts with 32-bit size_t (e.g. WebAssembly) can address only 32-bit memory.
+constexpr size_t OFFSET_BITS = std::min(MEMORY_ADDRESS_BITS, sizeof(Offset) * 8);
+// Section index is always shorter than offset, so all ones are never used.
+constexpr size_t INVALID_SECTION_INDEX = SIZE_MAX;
+
+Memory::Memory() : Memory(BIG) {
     // This is dummy constructor for qt internal uses only.
-    this->mt_root = nullptr;
 }
 
-Memory::Memory(Endian simulated_machine_endian)
+Memory::Memory(Endian simulated_machine_endian, size_t section_size)
     : BackendMemory(simulated_machine_endian) {
+    set_section_size(section_size);
     this->mt_root = allocate_section_tree();
+    flush_lookup_cache();
 }
 
 Memory::Memory(const Memory &other)
-    : BackendMemory(other.simulated_machine_endian) {
+    : BackendMemory(other.simulated_machine_endian)
+    , section_bits(other.section_bits)
+    , tree_depth(other.tree_depth) {
     this->mt_root = copy_section_tree(other.get_memory_tree_root(), 0);
+    flush_lookup_cache();
+    start_reset_epoch(other.dirty_epoch);
+    // Sections of the original became shared, so they are not directly
+    // writable anymore.
+    emit other.external_backend_change_notify(&other, 0, SIZE_MAX, ae::INTERNAL);
 }
 
 Memory::~Memory() {
-    free_section_tree(this->mt_root, 0);
-    delete[] this->mt_root;
+    clear();
 }
 
 void Memory::reset() {
-    free_section_tree(this->mt_root, 0);
-    delete[] this->mt_root;
+    clear();
     this->mt_root = allocate_section_tree();
+    start_reset_epoch(0);
+    // Invalidates host windows of the old sections.
+    emit external_backend_change_notify(this, 0, SIZE_MAX, ae::INTERNAL);
 }
 
 void Memory::reset(const Memory &m) {
-    free_section_tree(this->mt_root, 0);
+    if (&m == this) { return; }
+    clear();
+    set_section_size(m.get_section_size());
     this->mt_root = copy_section_tree(m.get_memory_tree_root(), 0);
+    start_reset_epoch(m.dirty_epoch);
+    emit external_backend_change_notify(this, 0, SIZE_MAX, ae::INTERNAL);
+    emit m.external_backend_change_notify(&m, 0, SIZE_MAX, ae::INTERNAL);
+}
+
+bool Memory::is_valid_section_size(size_t section_size) {
+    return section_size >= ((size_t)1 << MEMORY_SECTION_BITS_MIN)
+           && section_size <= ((size_t)1 << MEMORY_SECTION_BITS_MAX)
+           && (section_size & (section_size - 1)) == 0;
+}
+
+void Memory::set_section_size(size_t section_size) {
+    if (!is_valid_section_size(section_size)) {
+        throw SIMULATOR_EXCEPTION(
+            Sanity, "Unsupported memory section size",
+            QString("Section size: ") + QString::number(section_size));
+    }
+    section_bits = 0;
+    while (((size_t)1 << section_bits) < section_size) {
+        section_bits++;
+    }
+    // Topmost row may use only part of its entries.
+    tree_depth = (OFFSET_BITS - section_bits + MEMORY_TREE_BITS - 1) / MEMORY_TREE_BITS;
+}
+
+size_t Memory::get_section_size() const {
+    return (size_t)1 << section_bits;
+}
+
+/**
+ * Select branch index from memory tree row at given depth.
+ */
+size_t Memory::tree_row(size_t offset, size_t depth) const {
+    const size_t shift = section_bits + (tree_depth - 1 - depth) * MEMORY_TREE_BITS;
+    return (offset >> shift) & (MEMORY_TREE_ROW_SIZE - 1);
 }
 
 MemorySection *Memory::get_section(size_t offset, bool create) const {
+    const size_t section_index = offset >> section_bits;
+    LookupCacheEntry &cached
+        = lookup_cache[section_index & (MEMORY_LOOKUP_CACHE_SIZE - 1)];
+    if (cached.section_index == section_index && !(create && cached.sec->is_shared())) {
+        return cached.sec;
+    }
+
     union MemoryTree *w = this->mt_root;
     size_t row_num;
     // Walk memory tree branch from root to leaf and create new nodes when
     // needed and requested (`create` flag).
-    for (size_t i = 0; i < (MEMORY_TREE_DEPTH - 1); i++) {
-        row_num = get_tree_row(offset, i);
+    for (size_t i = 0; i < (tree_depth - 1); i++) {
+        row_num = tree_row(offset, i);
         if (w[row_num].subtree == nullptr) {
             // We don't have this tree so allocate it.
             if (!create) {
-                // If we shouldn't be creating it than just return// null.
+                // If we shouldn't be creating it than just return null.
                 return nullptr;
             }
-            w[row_num].subtree = allocate_section_tree();
+            // Nodes are owned by the pool, which is not part of the logical
+            // state of the memory.
+            w[row_num].subtree = const_cast<Memory *>(this)->allocate_section_tree();
         }
         w = w[row_num].subtree;
     }
-    row_num = get_tree_row(offset, MEMORY_TREE_DEPTH - 1);
+    row_num = tree_row(offset, tree_depth - 1);
     if (w[row_num].sec == nullptr) {
         if (!create) {
             return nullptr;
         }
         w[row_num].sec
-            = new MemorySection(MEMORY_SECTION_SIZE, simulated_machine_endian);
+            = new MemorySection(get_section_size(), simulated_machine_endian);
+    } else if (create && w[row_num].sec->is_shared()) {
+        // Section is going to be written, so it has to be private.
+        auto *copy = new MemorySection(*w[row_num].sec);
+        if (w[row_num].sec->release()) {
+            // The other owner released it meanwhile.
+            delete w[row_num].sec;
+        }
+        w[row_num].sec = copy;
+        // Host windows of the shared section are stale now.
+        const size_t start = section_index << section_bits;
+        emit external_backend_change_notify(
+            this, start, start + get_section_size() - 1, ae::INTERNAL);
     }
+    // Only existing sections are cached, so creation needs no invalidation.
+    cached = { .section_index = section_index, .sec = w[row_num].sec };
     return w[row_num].sec;
 }
 
-size_t get_section_offset_mask(size_t addr) {
-    return addr & generate_mask(MEMORY_SECTION_BITS, 0);
+void Memory::flush_lookup_cache() const {
+    lookup_cache.fill({ .section_index = INVALID_SECTION_INDEX, .sec = nullptr });
 }
 
 WriteResult Memory::write(
@@ -194,8 +288,13 @@ WriteResult Memory::write(
             Offset _destination, const void *_source, size_t _size,
             WriteOptions) {
             MemorySection *section = this->get_section(_destination, true);
-            return section->write(
-                get_section_offset_mask(_destination), _source, _size, {});
+            const size_t section_offset = _destination & (get_section_size() - 1);
+            WriteResult result = section->write(section_offset, _source, _size, {});
+            if (result.changed) {
+                section->mark_dirty(
+                    section_offset, result.n_bytes, dirty_epoch, track_dirty_blocks);
+            }
+            return result;
         });
 }
 
@@ -211,22 +310,41 @@ ReadResult Memory::read(
             ReadOptions _options) -> ReadResult {
             MemorySection *section = this->get_section(_source, false);
             if (section == nullptr) {
+                // Read ends at the section boundary as if the section existed.
+                const size_t section_size = get_section_size();
+                _size = std::min(_size, section_size - (_source & (section_size - 1)));
                 memset(_destination, 0, _size);
                 // TODO Warning read of uninitialized memory
                 return { .n_bytes = _size };
             } else {
                 return section->read(
-                    _destination, get_section_offset_mask(_source), _size,
+                    _destination, _source & (get_section_size() - 1), _size,
                     _options);
             }
         });
 }
 
+bool Memory::get_host_window(Offset offset, bool allocate, BackendHostWindow &window) {
+    MemorySection *section = get_section(offset, allocate);
+    if (section == nullptr) { return false; }
+    const Offset start = offset & ~(get_section_size() - 1);
+    // Direct writes can stamp only the section epoch.
+    window = { .data = section->data(),
+               .start = start,
+               .last = start + get_section_size() - 1,
+               .writable = !section->is_shared() && !track_dirty_blocks
+                           && section->get_block_epochs().empty(),
+               .dirty_epoch = section->access_write_epoch(),
+               .current_epoch = &dirty_epoch };
+    return true;
+}
+
 uint32_t Memory::get_change_counter() const {
     return change_counter;
 }
 
 bool Memory::operator==(const Memory &m) const {
+    if (section_bits != m.section_bits) { return false; }
     return compare_section_tree(this->mt_root, m.get_memory_tree_root(), 0);
 }
 
@@ -239,31 +357,45 @@ const union machine::MemoryTree *Memory::get_memory_tree_root() const {
 }
 
 union machine::MemoryTree *Memory::allocate_section_tree() {
-    auto *mt = new union MemoryTree[MEMORY_TREE_ROW_SIZE];
-    memset(mt, 0, sizeof *mt * MEMORY_TREE_ROW_SIZE);
-    return mt;
+    if (tree_pool_used == MEMORY_TREE_POOL_CHUNK) {
+        // Value initialization clears all nodes of the chunk.
+        tree_pool.push_back(std::make_unique<union MemoryTree[]>(
+            MEMORY_TREE_POOL_CHUNK * MEMORY_TREE_ROW_SIZE));
+        tree_pool_used = 0;
+    }
+    return &tree_pool.back()[MEMORY_TREE_ROW_SIZE * tree_pool_used++];
 }
 
 void Memory::free_section_tree(union MemoryTree *mt, size_t depth) {
-    if (depth < (MEMORY_TREE_DEPTH - 1)) { // Following level is memory tree
+    // Nodes themselves are released with the pool.
+    if (depth < (tree_depth - 1)) { // Following level is memory tree
         for (size_t i = 0; i < MEMORY_TREE_ROW_SIZE; i++) {
             if (mt[i].subtree != nullptr) {
                 free_section_tree(mt[i].subtree, depth + 1);
-                delete[] mt[i].subtree;
             }
         }
     } else { // Following level is memory section
         for (size_t i = 0; i < MEMORY_TREE_ROW_SIZE; i++) {
-            delete mt[i].sec;
+            if (mt[i].sec != nullptr && mt[i].sec->release()) { delete mt[i].sec; }
         }
     }
 }
 
+void Memory::clear() {
+    if (this->mt_root != nullptr) {
+        free_section_tree(this->mt_root, 0);
+        this->mt_root = nullptr;
+    }
+    tree_pool.clear();
+    tree_pool_used = MEMORY_TREE_POOL_CHUNK;
+    flush_lookup_cache();
+}
+
 bool Memory::compare_section_tree(
     const union MemoryTree *mt1,
     const union MemoryTree *mt2,
-    size_t depth) {
-    if (depth < (MEMORY_TREE_DEPTH - 1)) { // Following level is memory tree
+    size_t depth) const {
+    if (depth < (tree_depth - 1)) { // Following level is memory tree
         for (size_t i = 0; i < MEMORY_TREE_ROW_SIZE; i++) {
             if (((mt1[i].subtree == nullptr || mt2[i].subtree == nullptr)
                  && mt1[i].subtree != mt2[i].subtree)
@@ -275,10 +407,9 @@ bool Memory::compare_section_tree(
         }
     } else { // Following level is memory section
         for (size_t i = 0; i < MEMORY_TREE_ROW_SIZE; i++) {
-            if (((mt1[i].sec == nullptr || mt2[i].sec == nullptr)
-                 && mt1[i].sec != mt2[i].sec)
-                || (mt1[i].sec != nullptr && mt2[i].sec != nullptr
-                    && *mt1[i].sec != *mt2[i].sec)) {
+            // Shared sections are equal without comparing the content.
+            if (mt1[i].sec == mt2[i].sec) { continue; }
+            if (mt1[i].sec == nullptr || mt2[i].sec == nullptr || *mt1[i].sec != *mt2[i].sec) {
                 return false;
             }
         }
@@ -286,10 +417,94 @@ bool Memory::compare_section_tree(
     return true;
 }
 
+struct Memory::DiffState {
+    /** Content of unallocated sections. */
+    std::vector<byte> zeros;
+    std::vector<MemoryDiffRange> &ranges;
+    size_t max_ranges;
+
+    bool add(Offset start, Offset last) {
+        if (!ranges.empty() && ranges.back().last + 1 == start) {
+            ranges.back().last = last;
+            return true;
+        }
+        if (ranges.size() >= max_ranges) { return false; }
+        ranges.push_back({ .start = start, .last = last });
+        return true;
+    }
+
+    bool compare(const byte *a, const byte *b, size_t size, Offset base) {
+        // Equal chunks are skipped by memcmp (vectorized by the C library),
+        // only differing ones are examined byte by byte.
+        constexpr size_t CHUNK_SIZE = 64;
+        for (size_t chunk = 0; chunk < size; chunk += CHUNK_SIZE) {
+            const size_t chunk_end = std::min(chunk + CHUNK_SIZE, size);
+            if (memcmp(a + chunk, b + chunk, chunk_end - chunk) == 0) { continue; }
+            size_t i = chunk;
+            while (i < chunk_end) {
+                if (a[i] == b[i]) {
+                    i++;
+                    continue;
+                }
+                const size_t start = i;
+                while (i < chunk_end && a[i] != b[i]) {
+                    i++;
+                }
+                if (!add(base + start, base + i - 1)) { return false; }
+            }
+        }
+        return true;
+    }
+};
+
+bool Memory::diff(
+    const Memory &other,
+    std::vector<MemoryDiffRange> &ranges,
+    size_t max_ranges) const {
+    SANITY_ASSERT(
+        section_bits == other.section_bits, "Compared memories have to use the same section size.");
+    ranges.clear();
+    DiffState state { .zeros = std::vector<byte>(get_section_size(), 0),
+                      .ranges = ranges,
+                      .max_ranges = max_ranges };
+    return diff_section_tree(this->mt_root, other.mt_root, 0, 0, state);
+}
+
+bool Memory::diff_section_tree(
+    const union MemoryTree *mt1,
+    const union MemoryTree *mt2,
+    size_t depth,
+    Offset base,
+    DiffState &state) const {
+    const size_t shift = section_bits + (tree_depth - 1 - depth) * MEMORY_TREE_BITS;
+    for (size_t i = 0; i < MEMORY_TREE_ROW_SIZE; i++) {
+        const Offset offset = base + ((Offset)i << shift);
+        if (depth < (tree_depth - 1)) { // Following level is memory tree
+            const union MemoryTree *sub1 = (mt1 != nullptr) ? mt1[i].subtree : nullptr;
+            const union MemoryTree *sub2 = (mt2 != nullptr) ? mt2[i].subtree : nullptr;
+            if (sub1 == sub2) { continue; } // Both unallocated
+            if (!diff_section_tree(sub1, sub2, depth + 1, offset, state)) { return false; }
+            continue;
+        }
+        // Following level is memory section
+        const MemorySection *sec1 = (mt1 != nullptr) ? mt1[i].sec : nullptr;
+        const MemorySection *sec2 = (mt2 != nullptr) ? mt2[i].sec : nullptr;
+        // Shared sections are equal without comparing the content.
+        if (sec1 == sec2) { continue; }
+        if (!state.compare(
+                (sec1 != nullptr) ? sec1->data() : state.zeros.data(),
+                (sec2 != nullptr) ? sec2->data() : state.zeros.data(), get_section_size(),
+                offset)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 union machine::MemoryTree *
 Memory::copy_section_tree(const union MemoryTree *mt, size_t depth) {
     union MemoryTree *nmt = allocate_section_tree();
-    if (depth < (MEMORY_TREE_DEPTH - 1)) { // Following level is memory tree
+    if (depth < (tree_depth - 1)) { // Following level is memory tree
         for (size_t i = 0; i < MEMORY_TREE_ROW_SIZE; i++) {
             if (mt[i].subtree != nullptr) {
                 nmt[i].subtree = copy_section_tree(mt[i].subtree, depth + 1);
@@ -298,12 +513,269 @@ Memory::copy_section_tree(const union MemoryTree *mt, size_t depth) {
     } else { // Following level is memory section
         for (size_t i = 0; i < MEMORY_TREE_ROW_SIZE; i++) {
             if (mt[i].sec != nullptr) {
-                nmt[i].sec = new MemorySection(*mt[i].sec);
+                mt[i].sec->acquire();
+                nmt[i].sec = mt[i].sec;
             }
         }
     }
     return nmt;
 }
+
+uint64_t Memory::start_dirty_epoch() {
+    return ++dirty_epoch;
+}
+
+uint64_t Memory::get_dirty_epoch() const {
+    return dirty_epoch;
+}
+
+void Memory::start_reset_epoch(uint64_t other_epoch) {
+    // Shared sections keep epochs of the other memory, which are all older.
+    dirty_epoch = std::max(dirty_epoch, other_epoch) + 1;
+    reset_epoch = dirty_epoch;
+}
+
+bool Memory::get_dirty_ranges(uint64_t since_epoch, std::vector<MemoryDirtyRange> &ranges) const {
+    ranges.clear();
+    if (since_epoch <= reset_epoch) { return false; }
+    collect_dirty_ranges(this->mt_root, 0, 0, since_epoch, ranges);
+    return true;
+}
+
+void Memory::collect_dirty_ranges(
+    const union MemoryTree *mt,
+    size_t depth,
+    Offset base,
+    uint64_t since_epoch,
+    std::vector<MemoryDirtyRange> &ranges) const {
+    const size_t shift = section_bits + (tree_depth - 1 - depth) * MEMORY_TREE_BITS;
+    auto add_range = [&](Offset start, Offset last) {
+        if (!ranges.empty() && ranges.back().last + 1 == start) {
+            ranges.back().last = last;
+        } else {
+            ranges.push_back({ .start = start, .last = last });
+        }
+    };
+    for (size_t i = 0; i < MEMORY_TREE_ROW_SIZE; i++) {
+        const Offset offset = base + ((Offset)i << shift);
+        if (depth < (tree_depth - 1)) { // Following level is memory tree
+            if (mt[i].subtree != nullptr) {
+                collect_dirty_ranges(mt[i].subtree, depth + 1, offset, since_epoch, ranges);
+            }
+            continue;
+        }
+        // Following level is memory section
+        const MemorySection *sec = mt[i].sec;
+        if (sec == nullptr || sec->get_write_epoch() < since_epoch) { continue; }
+        const std::vector<uint64_t> &blocks = sec->get_block_epochs();
+        if (blocks.empty()) {
+            add_range(offset, offset + get_section_size() - 1);
+            continue;
+        }
+        for (size_t block = 0; block < blocks.size(); block++) {
+            if (blocks[block] >= since_epoch) {
+                const Offset start = offset + (block << MEMORY_DIRTY_BLOCK_BITS);
+                add_range(start, start + MEMORY_DIRTY_BLOCK_SIZE - 1);
+            }
+        }
+    }
+}
+
+void Memory::set_dirty_block_tracking(bool enable) {
+    if (enable != track_dirty_blocks) {
+        track_dirty_blocks = enable;
+        // Host windows have to be fetched again with the new write policy.
+        emit external_backend_change_notify(this, 0, SIZE_MAX, ae::INTERNAL);
+    }
+}
+
+bool Memory::dirty_block_tracking() const {
+    return track_dirty_blocks;
+}
+
+bool MemorySearchPattern::parse(const QString &spec, Endian endian, MemorySearchPattern &pattern) {
+    pattern.bytes.clear();
+    pattern.mask.clear();
+    const int colon = spec.indexOf(':');
+    if (colon < 0) { return false; }
+    const QString kind = spec.left(colon).toLower();
+    const QString value = spec.mid(colon + 1);
+
+    if (kind == "str") {
+        const QByteArray text = value.toUtf8();
+        pattern.bytes.assign(text.constData(), text.constData() + text.size());
+        pattern.mask.assign(text.size(), 0xff);
+    } else if (kind == "hex") {
+        QString digits = value;
+        digits.remove(" ");
+        if (digits.startsWith("0x", Qt::CaseInsensitive)) { digits = digits.mid(2); }
+        if (digits.size() % 2 != 0) { return false; }
+        for (int i = 0; i < digits.size(); i += 2) {
+            const QString byte_digits = digits.mid(i, 2);
+            if (byte_digits == "??") {
+                pattern.bytes.push_back(0);
+                pattern.mask.push_back(0);
+                continue;
+            }
+            bool ok;
+            pattern.bytes.push_back((byte)byte_digits.toUInt(&ok, 16));
+            pattern.mask.push_back(0xff);
+            if (!ok) { return false; }
+        }
+    } else if (kind == "u32" || kind == "u64") {
+        const size_t size = (kind == "u32") ? 4 : 8;
+        const QStringList parts = value.split('/');
+        if (parts.size() > 2) { return false; }
+        bool ok;
+        const uint64_t number = parts[0].toULongLong(&ok, 0);
+        if (!ok) { return false; }
+        uint64_t mask = UINT64_MAX;
+        if (parts.size() == 2) {
+            mask = parts[1].toULongLong(&ok, 0);
+            if (!ok) { return false; }
+        }
+        for (size_t i = 0; i < size; i++) {
+            // Byte of given significance is stored at this index.
+            const size_t shift = ((endian == LITTLE) ? i : size - 1 - i) * 8;
+            pattern.bytes.push_back((byte)(number >> shift));
+            pattern.mask.push_back((byte)(mask >> shift));
+        }
+    } else {
+        return false;
+    }
+    return !pattern.bytes.empty();
+}
+
+/**
+ * Prepared search. Candidates are located by memchr (vectorized by the C
+ * library) on the anchor byte, which has full mask, and then compared
+ * as a whole.
+ */
+struct Memory::SearchState {
+    SearchState(
+        const MemorySearchPattern &pattern,
+        Offset from,
+        std::vector<Offset> &matches,
+        size_t max_matches)
+        : pattern(pattern)
+        , length(pattern.bytes.size())
+        , from(from)
+        , matches(matches)
+        , max_matches(max_matches) {
+        exact = std::all_of(
+            pattern.mask.begin(), pattern.mask.end(), [](byte m) { return m == 0xff; });
+        // Prefer nonzero anchor as zeros are the most common bytes in memory.
+        for (size_t i = 0; i < length; i++) {
+            if (pattern.mask[i] != 0xff) { continue; }
+            if (!has_anchor || (pattern.bytes[anchor] == 0 && pattern.bytes[i] != 0)) {
+                anchor = i;
+                has_anchor = true;
+            }
+        }
+    }
+
+    [[nodiscard]] bool matches_at(const byte *data) const {
+        if (exact) { return memcmp(data, pattern.bytes.data(), length) == 0; }
+        for (size_t i = 0; i < length; i++) {
+            if ((data[i] ^ pattern.bytes[i]) & pattern.mask[i]) { return false; }
+        }
+        return true;
+    }
+
+    /**
+     * Scan candidates starting from `first` to `last` in buffer, which has
+     * to contain the whole pattern for each of them.
+     * @return false when the search should stop
+     */
+    bool scan(const byte *data, size_t first, size_t last, Offset base) {
+        if (first > last) { return true; }
+        if (!has_anchor) {
+            for (size_t i = first; i <= last; i++) {
+                if (matches_at(data + i) && !add(base + i)) { return false; }
+            }
+            return true;
+        }
+        const byte anchor_value = pattern.bytes[anchor];
+        const byte *cursor = data + first + anchor;
+        const byte *end = data + last + anchor + 1;
+        while (cursor < end) {
+            cursor = static_cast<const byte *>(memchr(cursor, anchor_value, end - cursor));
+            if (cursor == nullptr) { break; }
+            const byte *candidate = cursor - anchor;
+            if (matches_at(candidate) && !add(base + (candidate - data))) { return false; }
+            cursor++;
+        }
+        return true;
+    }
+
+    bool add(Offset offset) {
+        matches.push_back(offset);
+        return ++found < max_matches;
+    }
+
+    const MemorySearchPattern &pattern;
+    const size_t length;
+    const Offset from;
+    std::vector<Offset> &matches;
+    const size_t max_matches;
+    size_t found = 0;
+    bool exact = true;
+    bool has_anchor = false;
+    size_t anchor = 0;
+};
+
+size_t Memory::find(
+    const MemorySearchPattern &pattern,
+    Offset from,
+    std::vector<Offset> &matches,
+    size_t max_matches) const {
+    SANITY_ASSERT(pattern.bytes.size() == pattern.mask.size(), "Pattern mask size mismatch.");
+    if (pattern.bytes.empty() || max_matches == 0) { return 0; }
+    SearchState state(pattern, from, matches, max_matches);
+    find_in_tree(this->mt_root, 0, 0, state);
+    return state.found;
+}
+
+bool Memory::find_in_tree(
+    const union MemoryTree *mt,
+    size_t depth,
+    Offset base,
+    SearchState &state) const {
+    const size_t shift = section_bits + (tree_depth - 1 - depth) * MEMORY_TREE_BITS;
+    for (size_t i = 0; i < MEMORY_TREE_ROW_SIZE; i++) {
+        const Offset offset = base + ((Offset)i << shift);
+        const Offset last = offset + (((Offset)1 << shift) - 1);
+        if (last < state.from) { continue; }
+        if (depth < (tree_depth - 1)) { // Following level is memory tree
+            if (mt[i].subtree != nullptr && !find_in_tree(mt[i].subtree, depth + 1, offset, state)) {
+                return false;
+            }
+        } else if (mt[i].sec != nullptr && !find_in_section(mt[i].sec, offset, state)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Memory::find_in_section(const MemorySection *sec, Offset base, SearchState &state) const {
+    const size_t section_size = get_section_size();
+    const size_t first = (state.from > base) ? state.from - base : 0;
+    const size_t length = state.length;
+    // Occurrences fully inside of the section are scanned in place.
+    if (length <= section_size
+        && !state.scan(sec->data(), first, section_size - length, base)) {
+        return false;
+    }
+    // Occurrences continuing to the following memory are scanned in a copy.
+    const size_t tail_first = std::max(first, (length <= section_size) ? section_size - length + 1 : 0);
+    if (tail_first >= section_size) { return true; }
+    std::vector<byte> tail(section_size - tail_first + length - 1);
+    memcpy(tail.data(), sec->data() + tail_first, section_size - tail_first);
+    read(tail.data() + (section_size - tail_first), base + section_size, length - 1,
+         { .type = ae::INTERNAL });
+    return state.scan(tail.data(), 0, section_size - tail_first - 1, base + tail_first);
+}
+
 LocationStatus Memory::location_status(Offset offset) const {
     UNUSED(offset)
     // Lazy allocation of memory is only internal implementation detail.
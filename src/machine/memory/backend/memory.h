@@ -10,11 +10,18 @@
 #include "utils.h"
 
 #include <QObject>
+#include <array>
+#include <atomic>
 #include <cstdint>
+#include <memory>
+#include <vector>
 
 namespace machine {
 
 /**
+ * Sections are reference counted to be shared by copies of `Memory` until
+ * one of them writes to the section (copy-on-write).
+ *
  * NOTE: Internal endian of memory must be the same as endian of the whole
  * simulated machine. Therefore it does not have internal_endian field.
  */
@@ -40,28 +47,91 @@ public:
 
     [[nodiscard]] size_t length() const;
     [[nodiscard]] const byte *data() const;
+    [[nodiscard]] byte *data();
 
     bool operator==(const MemorySection &) const;
     bool operator!=(const MemorySection &) const;
 
+    void acquire() const;
+    /** @return true when the last reference was dropped */
+    bool release() const;
+    [[nodiscard]] bool is_shared() const;
+
+    /**
+     * Record write to given part of the section in given dirty epoch.
+     * Per block epochs are recorded only when `track_blocks` is set.
+     */
+    void mark_dirty(size_t offset, size_t size, uint64_t epoch, bool track_blocks);
+    [[nodiscard]] uint64_t get_write_epoch() const;
+    /** Epochs of `MEMORY_DIRTY_BLOCK_SIZE` blocks, empty when not tracked. */
+    [[nodiscard]] const std::vector<uint64_t> &get_block_epochs() const;
+    /** Used by direct writes through host window. */
+    [[nodiscard]] uint64_t *access_write_epoch();
+
 private:
     std::vector<byte> dt;
+    mutable std::atomic<uint32_t> ref_count { 1 };
+    uint64_t write_epoch = 0;
+    std::vector<uint64_t> block_epochs;
 };
 
 //////////////////////////////////////////////////////////////////////////////
 /// Some optimisation options
-// How big memory sections will be in bits (2^8=256 bytes)
-constexpr size_t MEMORY_SECTION_BITS = 8;
-// How big one row of lookup tree will be in bits (2^4=16)
-constexpr size_t MEMORY_TREE_BITS = 4;
+// Default size of memory sections in bits (2^12=4 KiB)
+constexpr size_t MEMORY_SECTION_BITS = 12;
+// Smallest and largest supported section size in bits (256 B and 2 MiB)
+constexpr size_t MEMORY_SECTION_BITS_MIN = 8;
+constexpr size_t MEMORY_SECTION_BITS_MAX = 21;
+// How big one row of lookup tree will be in bits (2^9=512)
+constexpr size_t MEMORY_TREE_BITS = 9;
+// Number of tree nodes allocated at once by the node pool
+constexpr size_t MEMORY_TREE_POOL_CHUNK = 16;
+// Number of entries of direct mapped section lookup cache in bits
+constexpr size_t MEMORY_LOOKUP_CACHE_BITS = 6;
+// Width of the address space covered by the memory
+constexpr size_t MEMORY_ADDRESS_BITS = 64;
+// Granularity of optional fine dirty tracking in bits (2^6=64 bytes)
+constexpr size_t MEMORY_DIRTY_BLOCK_BITS = 6;
 //////////////////////////////////////////////////////////////////////////////
 // Size of one section
 constexpr size_t MEMORY_SECTION_SIZE = (1u << MEMORY_SECTION_BITS);
 // Size of one memory row
 constexpr size_t MEMORY_TREE_ROW_SIZE = (1u << MEMORY_TREE_BITS);
-// Depth of tree
-constexpr size_t MEMORY_TREE_DEPTH
-    = ((32 - MEMORY_SECTION_BITS) / MEMORY_TREE_BITS);
+// Number of entries of section lookup cache
+constexpr size_t MEMORY_LOOKUP_CACHE_SIZE = (1u << MEMORY_LOOKUP_CACHE_BITS);
+// Size of block of fine dirty tracking
+constexpr size_t MEMORY_DIRTY_BLOCK_SIZE = (1u << MEMORY_DIRTY_BLOCK_BITS);
+
+/** Range of offsets (inclusive) reported by dirty tracking. */
+struct MemoryDirtyRange {
+    Offset start;
+    Offset last;
+};
+
+/** Range of offsets (inclusive), where two memories differ. */
+struct MemoryDiffRange {
+    Offset start;
+    Offset last;
+};
+
+/**
+ * Byte sequence searched by `Memory::find`. Bits cleared in mask match any
+ * value.
+ */
+struct MemorySearchPattern {
+    std::vector<byte> bytes;
+    std::vector<byte> mask;
+
+    /**
+     * Parse pattern specification:
+     *  - `hex:DEADBEEF` byte sequence, `??` matches any byte (spaces ignored)
+     *  - `u32:VALUE[/MASK]` and `u64:VALUE[/MASK]` integer in given endian
+     *  - `str:TEXT` UTF-8 string
+     *
+     * @return  false when the specification is invalid
+     */
+    static bool parse(const QString &spec, Endian endian, MemorySearchPattern &pattern);
+};
 
 union MemoryTree {
     union MemoryTree *subtree;
@@ -69,6 +139,23 @@ union MemoryTree {
 };
 
 /**
+ * Sparse memory covering the whole 64-bit address space.
+ *
+ * Memory is split into sections of configurable size (power of two between
+ * 256 B and 2 MiB), which are allocated on first write. Sections are looked up
+ * in a radix tree with rows of `MEMORY_TREE_ROW_SIZE` entries. Tree nodes are
+ * allocated from a pool owned by the memory and released all at once. Recently
+ * used sections are remembered in a small direct mapped cache, so the tree is
+ * walked only when the access moves to a section not accessed recently.
+ *
+ * Copies share sections with the original, a section is copied on the first
+ * write to it. Copy and reset from another memory only copy the tree.
+ *
+ * Writes, which change the content, stamp the section (and optionally its
+ * 64 B blocks) with the current dirty epoch. Consumer starts a new epoch by
+ * `start_dirty_epoch` and later collects ranges written since then, so any
+ * number of consumers can track changes independently.
+ *
  * NOTE: Internal endian of memory must be the same as endian of the whole
  * simulated machine. Therefore it does not have internal_endian field.
  */
@@ -77,7 +164,9 @@ class Memory final : public BackendMemory {
 public:
     // This is dummy constructor for qt internal uses only.
     Memory();
-    explicit Memory(Endian simulated_machine_endian);
+    explicit Memory(
+        Endian simulated_machine_endian,
+        size_t section_size = MEMORY_SECTION_SIZE);
     Memory(const Memory &);
     ~Memory() override;
     void reset(); // Reset whole content of memory (removes old tree and creates
@@ -86,6 +175,10 @@ public:
 
     // returns section containing given address
     [[nodiscard]] MemorySection *get_section(size_t offset, bool create) const;
+    [[nodiscard]] size_t get_section_size() const;
+
+    /** Section size has to be a power of two in the supported range. */
+    static bool is_valid_section_size(size_t section_size);
 
     WriteResult write(
         Offset destination,
@@ -101,22 +194,125 @@ public:
 
     [[nodiscard]] LocationStatus location_status(Offset offset) const override;
 
+    /** Window covers single section. */
+    bool get_host_window(Offset offset, bool allocate, BackendHostWindow &window) override;
+
+    /**
+     * Memories are equal when the same sections are allocated and their
+     * content is equal. Memories with different section size are never equal.
+     */
     bool operator==(const Memory &) const;
     bool operator!=(const Memory &) const;
 
+    /**
+     * Collect ranges of bytes differing from the other memory, ordered by
+     * offset. Unallocated memory is compared as zeros and sections shared
+     * between the memories are skipped without comparing. Both memories have
+     * to use the same section size.
+     *
+     * @param max_ranges    comparison stops when more ranges would be needed
+     * @return              false when the comparison was stopped
+     */
+    bool diff(
+        const Memory &other,
+        std::vector<MemoryDiffRange> &ranges,
+        size_t max_ranges = SIZE_MAX) const;
+
     [[nodiscard]] const union MemoryTree *get_memory_tree_root() const;
 
+    /**
+     * Start a new dirty epoch.
+     *
+     * @return  epoch to be passed to `get_dirty_ranges` to get ranges written
+     *          from now on
+     */
+    uint64_t start_dirty_epoch();
+    [[nodiscard]] uint64_t get_dirty_epoch() const;
+
+    /**
+     * Collect ranges written in `since_epoch` or later, ordered by offset.
+     * Adjacent ranges are merged.
+     *
+     * @return  false when the whole content was replaced (reset) since the
+     *          epoch, consumer has to process the whole memory then
+     */
+    bool get_dirty_ranges(uint64_t since_epoch, std::vector<MemoryDirtyRange> &ranges) const;
+
+    /**
+     * Track writes in `MEMORY_DIRTY_BLOCK_SIZE` blocks instead of whole
+     * sections. It costs memory for every written section and disables
+     * direct writes through host windows.
+     */
+    void set_dirty_block_tracking(bool enable);
+    [[nodiscard]] bool dirty_block_tracking() const;
+
+    /**
+     * Find occurrences of the pattern starting in allocated sections at
+     * `from` or later, in increasing order. Unallocated memory is skipped
+     * without reading (although it reads as zeros, it is not reported), but
+     * occurrence may continue to it.
+     *
+     * @param max_matches   search stops after this number of matches
+     * @return              number of matches added to `matches`
+     */
+    size_t find(
+        const MemorySearchPattern &pattern,
+        Offset from,
+        std::vector<Offset> &matches,
+        size_t max_matches = SIZE_MAX) const;
+
 private:
-    union MemoryTree *mt_root;
+    struct LookupCacheEntry {
+        size_t section_index;
+        MemorySection *sec;
+    };
+
+    size_t section_bits = MEMORY_SECTION_BITS;
+    size_t tree_depth = 0;
+    union MemoryTree *mt_root = nullptr;
+    std::vector<std::unique_ptr<union MemoryTree[]>> tree_pool;
+    size_t tree_pool_used = MEMORY_TREE_POOL_CHUNK;
+    mutable std::array<LookupCacheEntry, MEMORY_LOOKUP_CACHE_SIZE> lookup_cache {};
     uint32_t change_counter = 0;
-    static union MemoryTree *allocate_section_tree();
-    static void free_section_tree(union MemoryTree *, size_t depth);
-    static bool compare_section_tree(
+    uint64_t dirty_epoch = 1;
+    uint64_t reset_epoch = 0; //> Epoch, in which the content was replaced
+    bool track_dirty_blocks = false;
+
+    void set_section_size(size_t section_size);
+    union MemoryTree *allocate_section_tree();
+    void free_section_tree(union MemoryTree *, size_t depth);
+    void clear();
+    void flush_lookup_cache() const;
+    [[nodiscard]] size_t tree_row(size_t offset, size_t depth) const;
+    bool compare_section_tree(
+        const union MemoryTree *,
+        const union MemoryTree *,
+        size_t depth) const;
+    union MemoryTree *copy_section_tree(const union MemoryTree *, size_t depth);
+    struct DiffState;
+    /** Either tree may be null. @return false when the diff should stop */
+    bool diff_section_tree(
+        const union MemoryTree *,
+        const union MemoryTree *,
+        size_t depth,
+        Offset base,
+        DiffState &state) const;
+    void collect_dirty_ranges(
         const union MemoryTree *,
+        size_t depth,
+        Offset base,
+        uint64_t since_epoch,
+        std::vector<MemoryDirtyRange> &ranges) const;
+    struct SearchState;
+    /** @return false when the search should stop */
+    bool find_in_tree(
         const union MemoryTree *,
-        size_t depth);
-    static union MemoryTree *
-    copy_section_tree(const union MemoryTree *, size_t depth);
+        size_t depth,
+        Offset base,
+        SearchState &state) const;
+    bool find_in_section(const MemorySection *sec, Offset base, SearchState &state) const;
+    /** Content was replaced, epochs of the old content are meaningless. */
+    void start_reset_epoch(uint64_t other_epoch);
     [[nodiscard]] uint32_t get_change_counter() const;
 };
 } // namespace machine
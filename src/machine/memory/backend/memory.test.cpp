@@ -2,11 +2,16 @@
 
 #include "common/endian.h"
 #include "machine/machinedefs.h"
+#include "machine/memory/backend/mappedfile.h"
 #include "machine/memory/backend/memory.h"
 #include "machine/memory/memory_bus.h"
+#include "machine/memory/memory_image.h"
 #include "machine/memory/memory_utils.h"
 #include "tests/utils/integer_decomposition.h"
 
+#include <QDir>
+#include <QFile>
+#include <QtEndian>
 #include <cinttypes>
 
 using namespace machine;
@@ -369,4 +374,442 @@ void TestMemory::memory_memtest() {
     }
 }
 
+void TestMemory::memory_sparse_data() {
+    QTest::addColumn<Offset>("section_size");
+    QTest::addColumn<Offset>("address");
+
+    constexpr array<Offset, 3> section_sizes { 0x100, 0x1000, 0x200000 };
+    constexpr array<Offset, 3> addresses { 0xFFFFFF00, 0x100000000, 0xFFFFFFFFFFFFFFF0 };
+    for (auto section_size : section_sizes) {
+        for (auto address : addresses) {
+            QTest::addRow("section_size=0x%lx, address=0x%lx", section_size, address)
+                << section_size << address;
+        }
+    }
+}
+
+void TestMemory::memory_sparse() {
+    QFETCH(Offset, section_size);
+    QFETCH(Offset, address);
+    if (sizeof(Offset) < sizeof(uint64_t) && address > UINT32_MAX) {
+        QSKIP("Host cannot address 64-bit memory.");
+    }
+
+    Memory m(LITTLE, section_size);
+    QCOMPARE(m.get_section_size(), section_size);
+
+    // High addresses must not alias with the low ones.
+    memory_write_u32(&m, address, 0x11223344);
+    memory_write_u32(&m, address & 0xFFFFFFFF, 0x55667788);
+    if (address > UINT32_MAX) {
+        QCOMPARE(memory_read_u32(&m, address), (uint32_t)0x11223344);
+    }
+    QCOMPARE(memory_read_u32(&m, address & 0xFFFFFFFF), (uint32_t)0x55667788);
+
+    // Read crossing into section, which has not been allocated, reads zeros.
+    if (address + section_size > address) {
+        Offset last = (address | (section_size - 1)) - 1;
+        memory_write_u16(&m, last, 0xaabb);
+        QCOMPARE(memory_read_u32(&m, last), (uint32_t)0xaabb);
+        QCOMPARE(m.get_section(last + 2, false), (MemorySection *)nullptr);
+    }
+
+    // Lookup cache has to forget sections of the previous tree.
+    Memory copy(m);
+    QCOMPARE(copy, m);
+    m.reset();
+    QCOMPARE(m.get_section(address, false), (MemorySection *)nullptr);
+    QCOMPARE(memory_read_u32(&m, address & 0xFFFFFFFF), (uint32_t)0);
+    QVERIFY(copy != m);
+    m.reset(copy);
+    QCOMPARE(copy, m);
+    QCOMPARE(memory_read_u32(&m, address & 0xFFFFFFFF), (uint32_t)0x55667788);
+
+    // Memories with different geometry are not comparable.
+    Memory other(LITTLE, section_size == 0x1000 ? 0x100 : 0x1000);
+    QVERIFY(other != Memory(LITTLE, section_size));
+}
+
+void TestMemory::memory_bus_dispatch() {
+    Memory low(LITTLE), small(LITTLE), high(LITTLE), tail(LITTLE);
+    MemoryDataBus bus(LITTLE);
+    QVERIFY(bus.insert_device_to_range(&low, 0x0_addr, 0xefffffff_addr, false));
+    // Smaller than a page and not aligned.
+    QVERIFY(bus.insert_device_to_range(&small, 0xf0000010_addr, 0xf000001f_addr, false));
+    // Above the page table.
+    QVERIFY(bus.insert_device_to_range(&high, 0x100000000_addr, 0x1ffffffff_addr, false));
+    QVERIFY(bus.insert_device_to_range(&tail, 0xf0001800_addr, 0xf0003fff_addr, false));
+    QVERIFY(!bus.insert_device_to_range(&tail, 0xf0000018_addr, 0xf000001b_addr, false));
+
+    bus.write_u32(0xeffffffc_addr, 0x11111111);
+    bus.write_u32(0xf0000010_addr, 0x22222222);
+    bus.write_u32(0x100000004_addr, 0x33333333);
+    bus.write_u32(0xf0002000_addr, 0x44444444);
+    bus.write_u32(0xf0000020_addr, 0x55555555); // Nothing is mapped here.
+    QCOMPARE(memory_read_u32(&low, 0xeffffffc), (uint32_t)0x11111111);
+    QCOMPARE(memory_read_u32(&small, 0x0), (uint32_t)0x22222222);
+    QCOMPARE(memory_read_u32(&high, 0x4), (uint32_t)0x33333333);
+    QCOMPARE(memory_read_u32(&tail, 0x800), (uint32_t)0x44444444);
+    QCOMPARE(bus.read_u32(0xf0000010_addr), (uint32_t)0x22222222);
+    QCOMPARE(bus.read_u32(0xf0000020_addr), (uint32_t)0);
+
+    // Removed devices must not be found through the page table or last hit.
+    QVERIFY(bus.remove_device(&small));
+    QCOMPARE(bus.read_u32(0xf0000010_addr), (uint32_t)0);
+    QCOMPARE(bus.read_u32(0xf0002000_addr), (uint32_t)0x44444444);
+    bus.clean_range(0xf0000000_addr, 0x1ffffffff_addr);
+    QCOMPARE(bus.read_u32(0xf0002000_addr), (uint32_t)0);
+    QCOMPARE(bus.read_u32(0x100000004_addr), (uint32_t)0);
+    QCOMPARE(bus.read_u32(0xeffffffc_addr), (uint32_t)0x11111111);
+}
+
+void TestMemory::memory_host_window() {
+    Memory mem(LITTLE, 0x1000);
+    MemoryDataBus bus(LITTLE);
+    QVERIFY(bus.insert_device_to_range(&mem, 0x10000800_addr, 0x1fffffff_addr, false));
+
+    HostWindow window;
+    // Nothing is allocated yet.
+    QVERIFY(!bus.get_host_window(0x10001000_addr, false, window));
+    QVERIFY(bus.get_host_window(0x10001000_addr, true, window));
+    // Window is limited to the section, which is shifted by the range start.
+    QCOMPARE(window.start, 0x10000800_addr);
+    QCOMPARE(window.last, 0x100017ff_addr);
+    QVERIFY(window.covers(0x100017fc_addr, 4));
+    QVERIFY(!window.covers(0x100017fe_addr, 4));
+
+    const uint32_t counter = bus.get_change_counter();
+    const uint32_t value = 0x11223344;
+    QVERIFY(window.write(0x10001000_addr, &value, sizeof(value)));
+    QVERIFY(!window.write(0x10001000_addr, &value, sizeof(value)));
+    QCOMPARE(bus.get_change_counter(), counter + 1);
+    QCOMPARE(bus.read_u32(0x10001000_addr), value);
+    bus.write_u32(0x10001004_addr, 0x55667788);
+    uint32_t read_back = 0;
+    window.read(&read_back, 0x10001004_addr, sizeof(read_back));
+    QCOMPARE(read_back, (uint32_t)0x55667788);
+
+    // Windows do not survive memory reset nor change of the mapping.
+    mem.reset();
+    QVERIFY(!window.covers(0x10001000_addr, 4));
+    QVERIFY(bus.get_host_window(0x10001000_addr, true, window));
+    bus.clean_range(0x10000800_addr, 0x1fffffff_addr);
+    QVERIFY(!window.covers(0x10001000_addr, 4));
+    QVERIFY(!bus.get_host_window(0x10001000_addr, true, window));
+}
+
+void TestMemory::memory_copy_on_write() {
+    Memory original(LITTLE);
+    memory_write_u32(&original, 0x1000, 0x11223344);
+    memory_write_u32(&original, 0x2000, 0x55667788);
+
+    Memory copy(original);
+    // Sections are shared until written.
+    QCOMPARE(copy.get_section(0x1000, false), original.get_section(0x1000, false));
+    QVERIFY(copy.get_section(0x1000, false)->is_shared());
+
+    memory_write_u32(&copy, 0x1000, 0x99aabbcc);
+    QVERIFY(copy.get_section(0x1000, false) != original.get_section(0x1000, false));
+    QCOMPARE(memory_read_u32(&original, 0x1000), (uint32_t)0x11223344);
+    QCOMPARE(memory_read_u32(&copy, 0x1000), (uint32_t)0x99aabbcc);
+    QCOMPARE(copy.get_section(0x2000, false), original.get_section(0x2000, false));
+
+    // Writes to the original do not leak to the copy either.
+    memory_write_u32(&original, 0x2000, 0);
+    QCOMPARE(memory_read_u32(&copy, 0x2000), (uint32_t)0x55667788);
+
+    // Shared memory is not writable through a window until unshared.
+    copy.reset(original);
+    BackendHostWindow window {};
+    QVERIFY(copy.get_host_window(0x1000, false, window));
+    QVERIFY(!window.writable);
+    QVERIFY(copy.get_host_window(0x1000, true, window));
+    QVERIFY(window.writable);
+    QVERIFY(copy.get_section(0x1000, false) != original.get_section(0x1000, false));
+    QCOMPARE(copy, original);
+
+    // Unsharing notifies the whole section, also above 4 GiB.
+    Memory high(LITTLE);
+    memory_write_u32(&high, 0x100001000, 1);
+    Memory high_copy(high);
+    MemoryDataBus bus(LITTLE);
+    QVERIFY(bus.insert_device_to_range(&high_copy, 0x0_addr, 0x1ffffffff_addr, false));
+    Address notified_start, notified_last;
+    QObject::connect(
+        &bus, &FrontendMemory::external_change_notify,
+        [&](const FrontendMemory *, Address start_addr, Address last_addr, AccessEffects) {
+            notified_start = start_addr;
+            notified_last = last_addr;
+        });
+    bus.write_u32(0x100001004_addr, 2);
+    QCOMPARE(notified_start, 0x100001000_addr);
+    QCOMPARE(notified_last, 0x100001fff_addr);
+    QCOMPARE(memory_read_u32(&high, 0x100001004), (uint32_t)0);
+}
+
+void TestMemory::memory_dirty_tracking() {
+    Memory m(LITTLE);
+    std::vector<MemoryDirtyRange> ranges;
+    memory_write_u32(&m, 0x1000, 1);
+
+    const uint64_t epoch = m.start_dirty_epoch();
+    QVERIFY(m.get_dirty_ranges(epoch, ranges));
+    QVERIFY(ranges.empty());
+
+    // Writes of the same value do not dirty the memory.
+    memory_write_u32(&m, 0x1000, 1);
+    QVERIFY(m.get_dirty_ranges(epoch, ranges));
+    QVERIFY(ranges.empty());
+
+    // Section granularity, adjacent sections are merged.
+    memory_write_u32(&m, 0x2004, 2);
+    memory_write_u32(&m, 0x3ffc, 3);
+    memory_write_u32(&m, 0x8000, 4);
+    QVERIFY(m.get_dirty_ranges(epoch, ranges));
+    QCOMPARE(ranges.size(), (size_t)2);
+    QCOMPARE(ranges[0].start, (Offset)0x2000);
+    QCOMPARE(ranges[0].last, (Offset)0x3fff);
+    QCOMPARE(ranges[1].start, (Offset)0x8000);
+    QCOMPARE(ranges[1].last, (Offset)0x8fff);
+
+    // Block granularity.
+    m.set_dirty_block_tracking(true);
+    const uint64_t block_epoch = m.start_dirty_epoch();
+    memory_write_u32(&m, 0x2040, 5);
+    memory_write_u32(&m, 0x203e, 0x60000); // Crosses block boundary
+    QVERIFY(m.get_dirty_ranges(block_epoch, ranges));
+    QCOMPARE(ranges.size(), (size_t)1);
+    QCOMPARE(ranges[0].start, (Offset)0x2000);
+    QCOMPARE(ranges[0].last, (Offset)0x207f);
+    // Earlier writes are still reported for the whole section.
+    QVERIFY(m.get_dirty_ranges(epoch, ranges));
+    QCOMPARE(ranges[0].start, (Offset)0x2000);
+    QCOMPARE(ranges[0].last, (Offset)0x3fff);
+
+    // Host window writes are tracked too.
+    m.set_dirty_block_tracking(false);
+    const uint64_t window_epoch = m.start_dirty_epoch();
+    BackendHostWindow window {};
+    QVERIFY(m.get_host_window(0x8000, false, window));
+    QVERIFY(window.writable);
+    uint32_t change_counter = 0;
+    HostWindow host_window { .data = window.data,
+                             .start = Address(window.start),
+                             .last = Address(window.last),
+                             .change_counter = &change_counter,
+                             .writable = window.writable,
+                             .dirty_epoch = window.dirty_epoch,
+                             .current_epoch = window.current_epoch };
+    uint32_t value = 7;
+    QVERIFY(host_window.write(Address(0x8010), &value, sizeof(value)));
+    QVERIFY(m.get_dirty_ranges(window_epoch, ranges));
+    QCOMPARE(ranges.size(), (size_t)1);
+    QCOMPARE(ranges[0].start, (Offset)0x8000);
+
+    // Reset invalidates all epochs started before.
+    m.reset();
+    QVERIFY(!m.get_dirty_ranges(window_epoch, ranges));
+    QVERIFY(m.get_dirty_ranges(m.start_dirty_epoch(), ranges));
+}
+
+void TestMemory::memory_find() {
+    Memory m(LITTLE);
+    std::vector<Offset> matches;
+    memory_write_u32(&m, 0x1000, 0xefbeadde);
+    memory_write_u32(&m, 0x1ffe, 0xefbeadde); // Crosses section boundary
+    memory_write_u32(&m, 0x2ffc, 0xefbeadde);
+    memory_write_u16(&m, 0x5ffe, 0xadde); // Continues to unallocated section
+
+    MemorySearchPattern pattern;
+    QVERIFY(MemorySearchPattern::parse("hex:DEADBEEF", LITTLE, pattern));
+    QCOMPARE(m.find(pattern, 0, matches), (size_t)3);
+    QCOMPARE(matches, (std::vector<Offset> { 0x1000, 0x1ffe, 0x2ffc }));
+
+    matches.clear();
+    QCOMPARE(m.find(pattern, 0x1001, matches, 1), (size_t)1);
+    QCOMPARE(matches, (std::vector<Offset> { 0x1ffe }));
+
+    // Masked value, zeros of unallocated memory are matched but not reported.
+    matches.clear();
+    QVERIFY(MemorySearchPattern::parse("u32:0x0000adde/0x0000ffff", LITTLE, pattern));
+    QCOMPARE(m.find(pattern, 0x2000, matches), (size_t)2);
+    QCOMPARE(matches, (std::vector<Offset> { 0x2ffc, 0x5ffe }));
+
+    matches.clear();
+    QVERIFY(MemorySearchPattern::parse("hex:?? AD", LITTLE, pattern));
+    QCOMPARE(m.find(pattern, 0, matches), (size_t)4);
+    QCOMPARE(matches, (std::vector<Offset> { 0x1000, 0x1ffe, 0x2ffc, 0x5ffe }));
+
+    QVERIFY(MemorySearchPattern::parse("u32:0xdeadbeef", BIG, pattern));
+    QCOMPARE(pattern.bytes, (std::vector<byte> { 0xde, 0xad, 0xbe, 0xef }));
+    QVERIFY(!MemorySearchPattern::parse("hex:ABC", LITTLE, pattern));
+    QVERIFY(!MemorySearchPattern::parse("f32:1.0", LITTLE, pattern));
+}
+
+void TestMemory::memory_diff() {
+    Memory before(LITTLE);
+    std::vector<MemoryDiffRange> ranges;
+    memory_write_u32(&before, 0x1000, 0x01020304);
+    memory_write_u32(&before, 0x3000, 0x05060708);
+
+    Memory after(before);
+    QVERIFY(after.diff(before, ranges));
+    QVERIFY(ranges.empty());
+
+    memory_write_u8(&after, 0x1001, 0xff);
+    memory_write_u16(&after, 0x1002, 0xffff); // Adjacent ranges are merged
+    memory_write_u8(&after, 0x1040, 0xff);    // Next compared chunk
+    memory_write_u32(&after, 0x3000, 0);      // Same as unallocated memory
+    memory_write_u32(&after, 0x5ffe, 0xaabbccdd);
+    QVERIFY(after.diff(before, ranges));
+    QCOMPARE(ranges.size(), (size_t)4);
+    QCOMPARE(ranges[0].start, (Offset)0x1001);
+    QCOMPARE(ranges[0].last, (Offset)0x1003);
+    QCOMPARE(ranges[1].start, (Offset)0x1040);
+    QCOMPARE(ranges[1].last, (Offset)0x1040);
+    QCOMPARE(ranges[2].start, (Offset)0x3000);
+    QCOMPARE(ranges[2].last, (Offset)0x3003);
+    QCOMPARE(ranges[3].start, (Offset)0x5ffe);
+    QCOMPARE(ranges[3].last, (Offset)0x6001);
+
+    // Unallocated memory on the other side compares as zeros.
+    QVERIFY(Memory(LITTLE).diff(after, ranges));
+    QCOMPARE(ranges.size(), (size_t)3);
+    QCOMPARE(ranges[1].start, (Offset)0x1040);
+
+    QVERIFY(!after.diff(before, ranges, 2));
+    QCOMPARE(ranges.size(), (size_t)2);
+}
+
+void TestMemory::memory_image() {
+    // Codec round trip, including lengths longer than the token fields.
+    std::vector<uint8_t> data(100000);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (i < 50000) ? (uint8_t)(i * 7 / 300) : (uint8_t)(i * 2654435761u >> 24);
+    }
+    std::vector<uint8_t> encoded;
+    memory_image_compress(data.data(), data.size(), encoded);
+    QVERIFY(encoded.size() < data.size());
+    std::vector<uint8_t> decoded(data.size());
+    QVERIFY(memory_image_decompress(encoded.data(), encoded.size(), decoded.data(), data.size()));
+    QCOMPARE(decoded, data);
+    QVERIFY(!memory_image_decompress(
+        encoded.data(), encoded.size() / 2, decoded.data(), data.size()));
+
+    Memory source(LITTLE);
+    MemoryDataBus source_bus(LITTLE);
+    QVERIFY(source_bus.insert_device_to_range(&source, 0x0_addr, 0xffffffff_addr, false));
+    source_bus.write(0x10010_addr, data.data(), data.size(), { .type = ae::INTERNAL });
+    memory_write_u32(&source, 0x90000, 0x12345678);
+
+    const QString path = QDir::temp().filePath("qtrvsim_memory_image_test.img");
+    for (bool compress : { false, true }) {
+        save_memory_image(path, &source_bus, 0x10000_addr, 0x80000, compress);
+        QVERIFY(is_memory_image(path));
+
+        Memory target(LITTLE);
+        MemoryDataBus target_bus(LITTLE);
+        QVERIFY(target_bus.insert_device_to_range(&target, 0x0_addr, 0xffffffff_addr, false));
+        // Only chunks containing the data are stored.
+        QCOMPARE(load_memory_image(path, &target_bus, 0x10000_addr), (uint64_t)0x19000);
+        // Outside of the dumped range.
+        QCOMPARE(memory_read_u32(&target, 0x90000), (uint32_t)0);
+        std::vector<MemoryDiffRange> ranges;
+        QVERIFY(target.diff(source, ranges));
+        QCOMPARE(ranges.size(), (size_t)1);
+        QCOMPARE(ranges[0].start, (Offset)0x90000);
+
+        // Relocated load.
+        QCOMPARE(load_memory_image(path, &target_bus, 0x200000_addr), (uint64_t)0x19000);
+        QCOMPARE(memory_read_u32(&target, 0x200010), memory_read_u32(&source, 0x10010));
+    }
+
+    // Parts of the dumped range which are not stored are cleared, the rest is kept.
+    Memory target(LITTLE);
+    MemoryDataBus target_bus(LITTLE);
+    QVERIFY(target_bus.insert_device_to_range(&target, 0x0_addr, 0xffffffff_addr, false));
+    for (Offset offset : { 0x10000, 0x50000, 0x8fffc, 0x90000 }) {
+        memory_write_u32(&target, offset, 0xdeadbeef);
+    }
+    QCOMPARE(load_memory_image(path, &target_bus, 0x10000_addr), (uint64_t)0x19000);
+    QCOMPARE(memory_read_u32(&target, 0x10000), (uint32_t)0);
+    QCOMPARE(memory_read_u32(&target, 0x50000), (uint32_t)0);
+    QCOMPARE(memory_read_u32(&target, 0x8fffc), (uint32_t)0);
+    QCOMPARE(memory_read_u32(&target, 0x90000), (uint32_t)0xdeadbeef);
+
+    // Stored range outside of the dumped range is rejected.
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    uint64_t table_offset = 0;
+    QVERIFY(file.seek(24));
+    QCOMPARE(file.read(reinterpret_cast<char *>(&table_offset), 8), (qint64)8);
+    const uint64_t address = qToLittleEndian<uint64_t>(0xfffffffffff00000);
+    QVERIFY(file.seek(qFromLittleEndian(table_offset)));
+    QCOMPARE(file.write(reinterpret_cast<const char *>(&address), 8), (qint64)8);
+    file.close();
+    bool rejected = false;
+    try {
+        load_memory_image(path, &target_bus, 0x10000_addr);
+    } catch (SimulatorExceptionInput &) { rejected = true; }
+    QVERIFY(rejected);
+    QCOMPARE(memory_read_u32(&target, 0x10010), memory_read_u32(&source, 0x10010));
+    QFile::remove(path);
+}
+
+void TestMemory::memory_mapped_file() {
+    const QString path = QDir::temp().filePath("qtrvsim_mapped_file_test.bin");
+    const QByteArray content("\x11\x22\x33\x44\x55\x66\x77\x88", 8);
+    auto write_file = [&](const QByteArray &data) {
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        QCOMPARE(file.write(data), (qint64)data.size());
+    };
+    auto read_file = [&]() {
+        QFile file(path);
+        return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    };
+
+    write_file(content);
+    {
+        // Writes to read only file are ignored.
+        MappedFile file(LITTLE, path, false, false);
+        QCOMPARE(file.get_size(), (size_t)8);
+        MemoryDataBus bus(LITTLE);
+        QVERIFY(bus.insert_device_to_range(&file, 0x20000000_addr, 0x20000007_addr, false));
+        QCOMPARE(bus.read_u32(0x20000004_addr), (uint32_t)0x88776655);
+        QCOMPARE(file.location_status(4), LOCSTAT_READ_ONLY);
+        bus.write_u32(0x20000000_addr, 0xaabbccdd);
+        QCOMPARE(bus.read_u32(0x20000000_addr), (uint32_t)0x44332211);
+    }
+    QCOMPARE(read_file(), content);
+    {
+        // Private writes are visible to the simulation only.
+        MappedFile file(LITTLE, path, true, false);
+        MemoryDataBus bus(LITTLE);
+        QVERIFY(bus.insert_device_to_range(&file, 0x20000000_addr, 0x20000007_addr, false));
+        QCOMPARE(file.location_status(4), LOCSTAT_NONE);
+        bus.write_u32(0x20000000_addr, 0xaabbccdd);
+        QCOMPARE(bus.read_u32(0x20000000_addr), (uint32_t)0xaabbccdd);
+        QCOMPARE(bus.read_u32(0x20000004_addr), (uint32_t)0x88776655);
+    }
+    QCOMPARE(read_file(), content);
+    {
+        // Shared writes are stored to the file.
+        MappedFile file(LITTLE, path, true, true);
+        MemoryDataBus bus(LITTLE);
+        QVERIFY(bus.insert_device_to_range(&file, 0x20000000_addr, 0x20000007_addr, false));
+        bus.write_u32(0x20000004_addr, 0xaabbccdd);
+        QCOMPARE(bus.read_u32(0x20000004_addr), (uint32_t)0xaabbccdd);
+    }
+    QCOMPARE(read_file(), QByteArray("\x11\x22\x33\x44\xdd\xcc\xbb\xaa", 8));
+
+    write_file({});
+    bool rejected = false;
+    try {
+        MappedFile file(LITTLE, path, false, false);
+    } catch (SimulatorExceptionInput &) { rejected = true; }
+    QVERIFY(rejected);
+    QFile::remove(path);
+}
+
 QTEST_APPLESS_MAIN(TestMemory)
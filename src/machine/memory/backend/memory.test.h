@@ -22,6 +22,16 @@ private slots:
     static void memory_read_ctl();
     static void memory_memtest_data();
     static void memory_memtest();
+    static void memory_sparse_data();
+    static void memory_sparse();
+    static void memory_bus_dispatch();
+    static void memory_host_window();
+    static void memory_copy_on_write();
+    static void memory_dirty_tracking();
+    static void memory_find();
+    static void memory_diff();
+    static void memory_image();
+    static void memory_mapped_file();
 };
 
 #endif // MEMORY_TEST_H
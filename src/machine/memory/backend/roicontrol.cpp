@@ -0,0 +1,49 @@
+#include "memory/backend/roicontrol.h"
+
+#include "common/endian.h"
+
+using namespace machine;
+
+static constexpr Offset ROI_CONTROL_LAST_o = static_cast<Offset>(RoiCommand::EXIT) * 4;
+
+RoiControl::RoiControl(Endian simulated_machine_endian)
+    : BackendMemory(simulated_machine_endian) {}
+
+RoiControl::~RoiControl() = default;
+
+WriteResult RoiControl::write(
+    Offset destination,
+    const void *source,
+    size_t size,
+    WriteOptions options) {
+    UNUSED(options)
+    return write_by_u32(
+        destination, source, size, [&](Offset) { return 0u; },
+        [&](Offset src, uint32_t value) {
+            return write_reg(src, byteswap_if(value, internal_endian != simulated_machine_endian));
+        });
+}
+
+ReadResult RoiControl::read(
+    void *destination,
+    Offset source,
+    size_t size,
+    ReadOptions options) const {
+    UNUSED(options)
+    // Registers are write-only.
+    return read_by_u32(destination, source, size, [&](Offset) { return 0u; });
+}
+
+bool RoiControl::write_reg(Offset destination, uint32_t value) {
+    Q_ASSERT((destination & 3U) == 0); // uint32_t aligned
+    if (destination > ROI_CONTROL_LAST_o) {
+        printf("[WARNING] RoiControl: write to non-writable location.\n");
+        return false;
+    }
+    emit command(static_cast<RoiCommand>(destination / 4), value);
+    return false;
+}
+
+LocationStatus RoiControl::location_status(Offset offset) const {
+    return (offset <= ROI_CONTROL_LAST_o + 3) ? LOCSTAT_NONE : LOCSTAT_ILLEGAL;
+}
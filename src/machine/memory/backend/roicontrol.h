@@ -0,0 +1,64 @@
+#ifndef ROICONTROL_H
+#define ROICONTROL_H
+
+#include "common/endian.h"
+#include "memory/backend/backend_memory.h"
+
+#include <cstdint>
+
+namespace machine {
+
+/** Size of the register window of `RoiControl`. */
+constexpr Offset ROI_CONTROL_SIZE = 0x20;
+
+/**
+ * Commands of `RoiControl`, the register of each command is at offset
+ * 4 * command. Written value is the argument of the command.
+ */
+enum class RoiCommand : uint8_t {
+    ROI_BEGIN,   //> Start region of interest with id given by the value
+    ROI_END,     //> End region of interest with id given by the value
+    STATS_RESET, //> Start accumulating dumped statistics from now
+    STATS_DUMP,  //> Record statistics since the last reset tagged by the value
+    EXIT,        //> Stop simulation with the value as exit code
+};
+
+/**
+ * Guest interface to simulator statistics (region of interest markers,
+ * statistics reset and dump and exit), similar to gem5 pseudo instructions.
+ * The device only reports the commands, they are evaluated by the machine.
+ */
+class RoiControl final : public BackendMemory {
+    Q_OBJECT
+public:
+    explicit RoiControl(Endian simulated_machine_endian);
+    ~RoiControl() override;
+
+signals:
+    void command(machine::RoiCommand command, uint32_t value);
+
+public:
+    WriteResult write(
+        Offset destination,
+        const void *source,
+        size_t size,
+        WriteOptions options) override;
+
+    ReadResult read(
+        void *destination,
+        Offset source,
+        size_t size,
+        ReadOptions options) const override;
+
+    [[nodiscard]] LocationStatus location_status(Offset offset) const override;
+
+private:
+    bool write_reg(Offset destination, uint32_t value);
+
+    /** endian of internal registers of the periphery use. */
+    static constexpr Endian internal_endian = NATIVE_ENDIAN;
+};
+
+} // namespace machine
+
+#endif // ROICONTROL_H
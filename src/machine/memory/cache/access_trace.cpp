@@ -0,0 +1,140 @@
+#include "memory/cache/access_trace.h"
+
+#include "common/logging.h"
+#include "simulator_exception.h"
+#include "utils.h"
+
+#include <cstring>
+
+LOG_CATEGORY("machine.AccessTrace");
+
+namespace machine {
+
+static constexpr char TRACE_MAGIC[8] = { 'Q', 'T', 'R', 'V', 'A', 'T', 'R', 1 };
+static constexpr size_t TRACE_BUFFER_SIZE = 1 << 16;
+// Tag byte, at most 10 bytes of LEB128 encoded 64-bit delta.
+static constexpr size_t TRACE_MAX_RECORD_SIZE = 11;
+
+static inline size_t stream_of(MemoryAccessKind kind) {
+    return (kind == MemoryAccessKind::FETCH) ? 0 : 1;
+}
+
+static inline uint8_t size_to_log2(unsigned size) {
+    switch (size) {
+    case 1: return 0;
+    case 2: return 1;
+    case 4: return 2;
+    default: return 3;
+    }
+}
+
+AccessTraceWriter::AccessTraceWriter(const QString &path)
+    : path(path)
+    , file(fopen(path.toLocal8Bit().data(), "wb")) {
+    if (file == nullptr) {
+        throw SIMULATOR_EXCEPTION(Input, "Cannot open access trace file for writing", path);
+    }
+    buffer.reserve(TRACE_BUFFER_SIZE + TRACE_MAX_RECORD_SIZE);
+    buffer.insert(buffer.end(), std::begin(TRACE_MAGIC), std::end(TRACE_MAGIC));
+}
+
+AccessTraceWriter::~AccessTraceWriter() {
+    flush();
+    if (fclose(file) != 0 || write_failed) {
+        ERROR("Failure writing access trace %s", qPrintable(path));
+    }
+}
+
+void AccessTraceWriter::memory_access(
+    MemoryAccessKind kind,
+    Address address,
+    unsigned size,
+    Address inst_addr) {
+    UNUSED(inst_addr)
+    const size_t stream = stream_of(kind);
+    const uint64_t raw = address.get_raw();
+    const int64_t delta = (int64_t)(raw - last_address[stream]);
+    last_address[stream] = raw;
+
+    buffer.push_back((uint8_t)kind | (uint8_t)(size_to_log2(size) << 2));
+    uint64_t zigzag = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+    do {
+        uint8_t b = zigzag & 0x7f;
+        zigzag >>= 7;
+        buffer.push_back(b | (zigzag != 0 ? 0x80 : 0));
+    } while (zigzag != 0);
+
+    record_count++;
+    if (buffer.size() >= TRACE_BUFFER_SIZE) { flush(); }
+}
+
+void AccessTraceWriter::flush() {
+    if (!buffer.empty()) {
+        if (!write_failed && fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+            write_failed = true;
+        }
+        buffer.clear();
+    }
+    if (fflush(file) != 0) { write_failed = true; }
+}
+
+uint64_t AccessTraceWriter::get_record_count() const {
+    return record_count;
+}
+
+AccessTraceReader::AccessTraceReader(const QString &path)
+    : file(fopen(path.toLocal8Bit().data(), "rb"))
+    , buffer(TRACE_BUFFER_SIZE) {
+    if (file == nullptr) {
+        throw SIMULATOR_EXCEPTION(Input, "Cannot open access trace file", path);
+    }
+    char magic[sizeof(TRACE_MAGIC)];
+    if (fread(magic, 1, sizeof(magic), file) != sizeof(magic)
+        || memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0) {
+        fclose(file);
+        throw SIMULATOR_EXCEPTION(Input, "File is not a supported access trace", path);
+    }
+}
+
+AccessTraceReader::~AccessTraceReader() {
+    fclose(file);
+}
+
+bool AccessTraceReader::read_byte(uint8_t &value) {
+    if (buffer_pos == buffer_len) {
+        buffer_len = fread(buffer.data(), 1, buffer.size(), file);
+        buffer_pos = 0;
+        if (buffer_len == 0) { return false; }
+    }
+    value = buffer[buffer_pos++];
+    return true;
+}
+
+bool AccessTraceReader::next(AccessTraceRecord &record) {
+    uint8_t tag;
+    if (!read_byte(tag)) { return false; }
+    if ((tag & 0x3) > (uint8_t)MemoryAccessKind::STORE || (tag >> 4) != 0) {
+        throw SIMULATOR_EXCEPTION(Input, "Corrupted access trace", "invalid record tag");
+    }
+
+    uint64_t zigzag = 0;
+    uint8_t b;
+    unsigned shift = 0;
+    do {
+        if (!read_byte(b) || shift > 63) {
+            throw SIMULATOR_EXCEPTION(Input, "Corrupted access trace", "truncated record");
+        }
+        zigzag |= (uint64_t)(b & 0x7f) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    const int64_t delta = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+
+    record.kind = (MemoryAccessKind)(tag & 0x3);
+    record.size = 1u << (tag >> 2);
+    const size_t stream = stream_of(record.kind);
+    last_address[stream] += (uint64_t)delta;
+    record.address = Address(last_address[stream]);
+    return true;
+}
+
+} // namespace machine
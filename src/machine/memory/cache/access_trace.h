@@ -0,0 +1,102 @@
+#ifndef ACCESS_TRACE_H
+#define ACCESS_TRACE_H
+
+#include "core/memory_access_observer.h"
+#include "memory/address.h"
+
+#include <QString>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace machine {
+
+/**
+ * One access of the recorded L1 address stream.
+ */
+struct AccessTraceRecord {
+    MemoryAccessKind kind;
+    uint8_t size;
+    Address address;
+};
+
+/**
+ * Records the instruction and data address streams issued by the core into a
+ * compact binary file, so that cache configurations can be evaluated later
+ * without rerunning the program (see `CacheSweep`).
+ *
+ * File format:
+ *  - 7 byte magic `QTRVATR` and format version byte (8 bytes),
+ *  - sequence of records, each consisting of a tag byte and a variable
+ *    length address delta.
+ *
+ * The tag byte holds the access kind in bits 0-1 and log2 of the access size
+ * in bits 2-3. The delta is the difference to the previous address of the
+ * same stream (fetches form one stream, loads and stores the other) encoded
+ * as zig-zag LEB128. Sequential instruction fetch therefore costs two bytes
+ * per access.
+ */
+class AccessTraceWriter final : public MemoryAccessObserver {
+public:
+    /**
+     * @param path  file to write, truncated when it exists
+     * @throws SimulatorExceptionInput when the file cannot be opened
+     */
+    explicit AccessTraceWriter(const QString &path);
+    ~AccessTraceWriter() override;
+
+    void memory_access(MemoryAccessKind kind, Address address, unsigned size, Address inst_addr)
+        override;
+
+    /**
+     * Write buffered records to the file. Records are dropped after a write
+     * failure, which is reported when the writer is destroyed.
+     */
+    void flush();
+
+    [[nodiscard]] uint64_t get_record_count() const;
+
+private:
+    const QString path;
+    FILE *file;
+    std::vector<uint8_t> buffer;
+    std::array<uint64_t, 2> last_address {};
+    uint64_t record_count = 0;
+    bool write_failed = false;
+};
+
+/**
+ * Sequential reader of files produced by `AccessTraceWriter`.
+ */
+class AccessTraceReader {
+public:
+    /**
+     * @throws SimulatorExceptionInput when the file cannot be opened or it is
+     *  not an access trace
+     */
+    explicit AccessTraceReader(const QString &path);
+    ~AccessTraceReader();
+
+    AccessTraceReader(const AccessTraceReader &) = delete;
+    AccessTraceReader &operator=(const AccessTraceReader &) = delete;
+
+    /**
+     * @return false at the end of the trace
+     * @throws SimulatorExceptionInput when the trace is truncated or corrupted
+     */
+    bool next(AccessTraceRecord &record);
+
+private:
+    bool read_byte(uint8_t &value);
+
+    FILE *file;
+    std::vector<uint8_t> buffer;
+    size_t buffer_pos = 0;
+    size_t buffer_len = 0;
+    std::array<uint64_t, 2> last_address {};
+};
+
+} // namespace machine
+
+#endif // ACCESS_TRACE_H
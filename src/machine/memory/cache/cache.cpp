@@ -19,8 +19,8 @@ Cache::Cache(
     : FrontendMemory(memory->simulated_machine_endian)
     , cache_config(config)
     , mem(memory)
-    , uncached_start(0xf0000000_addr)
-    , uncached_last(0xfffffffe_addr)
+    , uncached_start(CACHE_UNCACHED_START)
+    , uncached_last(CACHE_UNCACHED_LAST)
     , access_pen_r(memory_access_penalty_r)
     , access_pen_w(memory_access_penalty_w)
     , access_pen_b(memory_access_penalty_b)
@@ -53,7 +53,7 @@ WriteResult Cache::write(
         mem_writes++;
         emit memory_writes_update(mem_writes);
         update_all_statistics();
-        return mem->write(destination, source, size, options);
+        return write_lower(destination, source, size, options);
     }
 
     // FIXME: Get rid of the cast
@@ -66,7 +66,7 @@ WriteResult Cache::write(
         mem_writes++;
         emit memory_writes_update(mem_writes);
         update_all_statistics();
-        return mem->write(destination, source, size, options);
+        return write_lower(destination, source, size, options);
     }
 
     return { .n_bytes = size, .changed = changed };
@@ -79,10 +79,12 @@ ReadResult Cache::read(
     ReadOptions options) const {
     if (!cache_config.enabled() || is_in_uncached_area(source)
         || is_in_uncached_area(source + size)) {
-        mem_reads++;
-        emit memory_reads_update(mem_reads);
-        update_all_statistics();
-        return mem->read(destination, source, size, options);
+        if (options.type != ae::INTERNAL) {
+            mem_reads++;
+            emit memory_reads_update(mem_reads);
+            update_all_statistics();
+        }
+        return read_lower(destination, source, size, options);
     }
 
     if (options.type == ae::INTERNAL) {
@@ -98,6 +100,34 @@ ReadResult Cache::read(
 
     return {};
 }
+ReadResult Cache::read_lower(
+    void *destination,
+    Address source,
+    size_t size,
+    ReadOptions options) const {
+    if (lower_window.covers(source, size)
+        || (mem->get_host_window(source, false, lower_window)
+            && lower_window.covers(source, size))) {
+        lower_window.read(destination, source, size);
+        return { .n_bytes = size };
+    }
+    return mem->read(destination, source, size, options);
+}
+
+WriteResult Cache::write_lower(
+    Address destination,
+    const void *source,
+    size_t size,
+    WriteOptions options) const {
+    if ((lower_window.writable && lower_window.covers(destination, size))
+        || (mem->get_host_window(destination, true, lower_window) && lower_window.writable
+            && lower_window.covers(destination, size))) {
+        return { .n_bytes = size,
+                 .changed = lower_window.write(destination, source, size) };
+    }
+    return mem->write(destination, source, size, options);
+}
+
 bool Cache::is_in_uncached_area(Address source) const {
     return (source >= uncached_start && source <= uncached_last);
 }
@@ -201,6 +231,7 @@ bool Cache::access(
         if (access_type == WRITE
             && cache_config.write_policy() == CacheConfig::WP_THROUGH_NOALLOC) {
             miss_write++;
+            if (miss_observer != nullptr) { miss_observer->cache_miss(address, access_type); }
             emit miss_update(get_miss_count());
             update_all_statistics();
 
@@ -242,9 +273,10 @@ bool Cache::access(
         } else {
             miss_read++;
         }
+        if (miss_observer != nullptr) { miss_observer->cache_miss(address, access_type); }
         emit miss_update(get_miss_count());
 
-        mem->read(
+        read_lower(
             cd.data.data(), calc_base_address(loc.tag, loc.row),
             cache_config.block_size() * BLOCK_ITEM_SIZE,
             { .type = ae::REGULAR });
@@ -321,7 +353,7 @@ size_t Cache::find_block_index(const CacheLocation &loc) const {
 void Cache::kick(size_t way, size_t row) const {
     struct CacheLine &cd = dt[way][row];
     if (cd.dirty && cache_config.write_policy() == CacheConfig::WP_BACK) {
-        mem->write(
+        write_lower(
             calc_base_address(cd.tag, row), cd.data.data(),
             cache_config.block_size() * BLOCK_ITEM_SIZE, {});
         mem_writes += cache_config.block_size();
@@ -391,6 +423,23 @@ const CacheConfig &Cache::get_config() const {
     return cache_config;
 }
 
+std::vector<Address> Cache::get_dirty_blocks() const {
+    std::vector<Address> blocks;
+    if (cache_config.write_policy() != CacheConfig::WP_BACK) { return blocks; }
+    for (const auto &way : dt) {
+        for (size_t row = 0; row < way.size(); row++) {
+            if (way[row].valid && way[row].dirty) {
+                blocks.push_back(calc_base_address(way[row].tag, row));
+            }
+        }
+    }
+    return blocks;
+}
+
+void Cache::set_miss_observer(CacheMissObserver *observer) {
+    miss_observer = observer;
+}
+
 uint32_t Cache::get_change_counter() const {
     return change_counter;
 }
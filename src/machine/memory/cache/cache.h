@@ -12,6 +12,25 @@
 namespace machine {
 
 constexpr size_t BLOCK_ITEM_SIZE = sizeof(uint32_t);
+/** Accesses to this address range (peripherals) bypass the cache. */
+constexpr uint64_t CACHE_UNCACHED_START = 0xf0000000;
+constexpr uint64_t CACHE_UNCACHED_LAST = 0xfffffffe;
+
+/**
+ * Receives misses of a cache (see `Cache::set_miss_observer`), e.g. to
+ * attribute them to instructions and data objects.
+ */
+class CacheMissObserver {
+public:
+    virtual ~CacheMissObserver() = default;
+
+    /**
+     * Called for each block missing in the cache, before it is filled.
+     *
+     * @param address  first byte of the access within the missing block
+     */
+    virtual void cache_miss(Address address, AccessType access_type) = 0;
+};
 
 /**
  * NOTE ON TERMINOLOGY:
@@ -89,6 +108,12 @@ public:
 
     const CacheConfig &get_config() const;
 
+    /** Base addresses of blocks written to the cache but not to the lower level yet. */
+    std::vector<Address> get_dirty_blocks() const;
+
+    /** Report misses to the observer (null to disable), it is not owned by the cache. */
+    void set_miss_observer(CacheMissObserver *observer);
+
     enum LocationStatus location_status(Address address) const override;
 
 signals:
@@ -118,6 +143,7 @@ private:
     const uint32_t access_pen_r, access_pen_w, access_pen_b;
     const bool access_ena_b;
     const std::unique_ptr<CachePolicy> replacement_policy;
+    CacheMissObserver *miss_observer = nullptr;
 
     mutable std::vector<std::vector<CacheLine>> dt;
 
@@ -125,8 +151,26 @@ private:
                      mem_reads = 0, mem_writes = 0, burst_reads = 0,
                      burst_writes = 0, change_counter = 0;
 
+    /** Window of the lower level memory used by `read_lower`/`write_lower`. */
+    mutable HostWindow lower_window;
+
     void internal_read(Address source, void *destination, size_t size) const;
 
+    /**
+     * Access lower level memory directly through host window when possible,
+     * otherwise by its `read`/`write`. Statistics are updated by the caller.
+     */
+    ReadResult read_lower(
+        void *destination,
+        Address source,
+        size_t size,
+        ReadOptions options) const;
+    WriteResult write_lower(
+        Address destination,
+        const void *source,
+        size_t size,
+        WriteOptions options) const;
+
     bool access(
         Address address,
         void *buffer,
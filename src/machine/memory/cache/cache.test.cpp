@@ -4,7 +4,10 @@
 #include "machine/memory/backend/memory.h"
 #include "machine/memory/cache/cache.h"
 #include "machine/memory/cache/cache_policy.h"
+#include "machine/memory/cache/cache_sweep.h"
 #include "machine/memory/memory_bus.h"
+#include "machine/memory/reuse_analysis.h"
+#include "machine/profiler/miss_profile.h"
 #include "tests/data/cache_test_performance_data.h"
 
 #include <tests/utils/integer_decomposition.h>
@@ -249,4 +252,192 @@ void TestCache::cache_correctness() {
     }
 }
 
+void TestCache::cache_sweep_data() {
+    QTest::addColumn<CacheConfig>("cache_config");
+
+    for (auto cache_config : get_testing_cache_configs()) {
+        if (cache_config.replacement_policy() == CacheConfig::RP_RAND) { continue; }
+        QTest::addRow(
+            "cache_config={ %d, r=%d, wr=%d, s=%d, b=%d, a=%d }", cache_config.enabled(),
+            cache_config.replacement_policy(), cache_config.write_policy(),
+            cache_config.set_count(), cache_config.block_size(), cache_config.associativity())
+            << cache_config;
+    }
+}
+
+/**
+ * Compares hits and misses of a sweep (all configurations at once) with the
+ * real cache on the same access stream.
+ */
+void TestCache::cache_sweep() {
+    QFETCH(CacheConfig, cache_config);
+
+    Memory mem(LITTLE);
+    MemoryDataBus bus(LITTLE);
+    bus.insert_device_to_range(&mem, 0_addr, 0xffffffff_addr, false);
+    Cache cache(&bus, &cache_config);
+
+    CacheSweep sweep;
+    for (auto config : get_testing_cache_configs()) {
+        sweep.add_config(CacheSweepStream::DATA, config);
+    }
+
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < 2000; i++) {
+        seed = seed * 1103515245 + 12345;
+        // Small working set with some misaligned and uncached accesses.
+        const Address address(((seed >> 8) % 0x100) + ((i % 97 == 0) ? 0xf0000000 : 0x1000));
+        const unsigned size = 1u << ((seed >> 20) % 4);
+        const bool write = (seed >> 24) % 3 == 0;
+        const MemoryAccessKind kind = write ? MemoryAccessKind::STORE : MemoryAccessKind::LOAD;
+        uint64_t value = i;
+        if (write) {
+            cache.write(address, &value, size, {});
+        } else {
+            cache.read(&value, address, size, {});
+        }
+        sweep.feed({ .kind = kind, .size = (uint8_t)size, .address = address });
+        // Fetch stream must not affect data caches.
+        sweep.feed({ .kind = MemoryAccessKind::FETCH, .size = 4, .address = address });
+    }
+
+    for (const auto &result : sweep.get_results()) {
+        if (result.config != cache_config) { continue; }
+        QCOMPARE(result.get_miss_count(), (uint64_t)cache.get_miss_count());
+        QCOMPARE(
+            result.get_access_count(),
+            (uint64_t)(cache.get_hit_count() + cache.get_miss_count()));
+    }
+}
+
+/**
+ * Direct mapped cache with two single word blocks, so blocks with the same
+ * parity of the word index conflict.
+ */
+void TestCache::cache_miss_profile() {
+    CacheConfig cache_config;
+    cache_config.set_enabled(true);
+    cache_config.set_replacement_policy(CacheConfig::RP_LRU);
+    cache_config.set_write_policy(CacheConfig::WP_BACK);
+    cache_config.set_set_count(2);
+    cache_config.set_block_size(1);
+    cache_config.set_associativity(1);
+
+    Memory mem(LITTLE);
+    MemoryDataBus bus(LITTLE);
+    bus.insert_device_to_range(&mem, 0_addr, 0xffffffff_addr, false);
+    Cache cache(&bus, &cache_config);
+    SymbolTable symtab;
+    symtab.add_symbol("array", 0x1000, 8);
+    MissProfile profile(&symtab, cache_config);
+    cache.set_miss_observer(&profile);
+
+    // Compulsory A and B, A conflicts with B, compulsory C and D, A does not fit anymore.
+    const std::vector<pair<uint64_t, uint64_t>> accesses {
+        { 0x200, 0x1000 }, { 0x204, 0x1008 }, { 0x200, 0x1000 },
+        { 0x204, 0x1010 }, { 0x204, 0x1004 }, { 0x200, 0x1000 },
+    };
+    for (const auto &access : accesses) {
+        uint32_t value;
+        profile.memory_access(
+            MemoryAccessKind::LOAD, Address(access.second), 4, Address(access.first));
+        cache.read(&value, Address(access.second), 4, {});
+    }
+
+    const MissCounters total = profile.get_total();
+    QCOMPARE(total.accesses, (uint64_t)6);
+    QCOMPARE(total.misses, (uint64_t)cache.get_miss_count());
+    QCOMPARE(total.compulsory, (uint64_t)4);
+    QCOMPARE(total.conflict, (uint64_t)1);
+    QCOMPARE(total.capacity, (uint64_t)1);
+
+    const std::vector<MissInstruction> instructions = profile.by_instruction();
+    QCOMPARE(instructions.size(), (size_t)2);
+    QCOMPARE(instructions[0].inst_addr, 0x200_addr);
+    QCOMPARE(instructions[0].counters.misses, (uint64_t)3);
+    QVERIFY(instructions[0].load && !instructions[0].store);
+
+    const std::vector<MissObject> objects = profile.by_object();
+    QCOMPARE(objects.size(), (size_t)2);
+    QCOMPARE(objects[0].name, QString("array"));
+    QCOMPARE(objects[0].counters.accesses, (uint64_t)4);
+    QCOMPARE(objects[0].counters.misses, (uint64_t)4);
+    QCOMPARE(objects[1].name, QString());
+    QCOMPARE(objects[1].counters.misses, (uint64_t)2);
+}
+
+void TestCache::cache_reuse_analysis() {
+    SymbolTable symtab;
+    symtab.add_symbol("array", 0x1000, 8);
+    // Blocks of 4 bytes, windows of 4 instructions, pages of 16 bytes.
+    ReuseAnalysis analysis(&symtab, 4, 4, 16);
+
+    // Cold A, B, C, then A after B and C, B after C and A, A after B, A again.
+    for (uint64_t address : { 0x1000, 0x1004, 0x1008, 0x1000, 0x1004, 0x1000, 0x1002 }) {
+        analysis.memory_access(MemoryAccessKind::LOAD, Address(address), 4, 0x200_addr);
+    }
+    for (int i = 0; i < 4; i++) {
+        analysis.instruction_retired(0x200_addr);
+    }
+    analysis.memory_access(MemoryAccessKind::STORE, 0x1100_addr, 4, 0x204_addr);
+    analysis.memory_access(MemoryAccessKind::STORE, 0x1000_addr, 4, 0x204_addr);
+    analysis.memory_access(MemoryAccessKind::FETCH, 0x200_addr, 4, 0x200_addr);
+    analysis.instruction_retired(0x204_addr);
+    analysis.instruction_retired(0x208_addr);
+
+    const ReuseHistogram &data = analysis.get_histogram(false);
+    QCOMPARE(data.cold, (uint64_t)4);
+    QCOMPARE(data.buckets[0], (uint64_t)1);
+    QCOMPARE(data.buckets[1], (uint64_t)2);
+    QCOMPARE(data.buckets[2], (uint64_t)2);
+    QCOMPARE(data.get_access_count(), (uint64_t)9);
+    QCOMPARE(analysis.get_histogram(true).cold, (uint64_t)1);
+    QCOMPARE(analysis.get_histogram(true).get_access_count(), (uint64_t)1);
+
+    // The last window is incomplete.
+    QString working_set;
+    QTextStream out(&working_set);
+    analysis.write_working_set_csv(out);
+    out.flush();
+    QCOMPARE(
+        working_set, QString("instructions,program_blocks,program_pages,data_blocks,data_pages\n"
+                             "4,0,0,3,1\n"
+                             "6,1,1,2,2\n"));
+}
+
+void TestCache::cache_internal_read() {
+    Memory mem(LITTLE);
+    MemoryDataBus bus(LITTLE);
+    bus.insert_device_to_range(&mem, 0_addr, 0xffffffff_addr, false);
+    memory_write_u32(&mem, 0x100, 0x12345678);
+    uint32_t value = 0;
+
+    // Internal reads (e.g. by the state digest) do not change any statistics.
+    CacheConfig disabled_config;
+    disabled_config.set_enabled(false);
+    Cache disabled(&bus, &disabled_config);
+    disabled.read(&value, 0x100_addr, 4, { .type = ae::INTERNAL });
+    QCOMPARE(value, (uint32_t)0x12345678);
+    QCOMPARE(disabled.get_read_count(), 0u);
+    disabled.read(&value, 0x100_addr, 4, {});
+    QCOMPARE(disabled.get_read_count(), 1u);
+
+    CacheConfig cache_config;
+    cache_config.set_enabled(true);
+    cache_config.set_set_count(2);
+    cache_config.set_block_size(2);
+    cache_config.set_associativity(1);
+    Cache cache(&bus, &cache_config);
+    cache.read(&value, Address(CACHE_UNCACHED_START), 4, { .type = ae::INTERNAL });
+    cache.read(&value, 0x100_addr, 4, { .type = ae::INTERNAL });
+    QCOMPARE(value, (uint32_t)0x12345678);
+    QCOMPARE(cache.get_read_count(), 0u);
+    QCOMPARE(cache.get_hit_count(), 0u);
+    QCOMPARE(cache.get_miss_count(), 0u);
+    cache.read(&value, Address(CACHE_UNCACHED_START), 4, {});
+    QCOMPARE(cache.get_read_count(), 1u);
+    cache.read(&value, 0x100_addr, 4, {});
+    QCOMPARE(cache.get_miss_count(), 1u);
+}
+
 QTEST_APPLESS_MAIN(TestCache)
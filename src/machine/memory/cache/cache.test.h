@@ -10,6 +10,11 @@ private slots:
     static void cache();
     static void cache_correctness_data();
     static void cache_correctness();
+    static void cache_sweep_data();
+    static void cache_sweep();
+    static void cache_miss_profile();
+    static void cache_reuse_analysis();
+    static void cache_internal_read();
 };
 
 #endif // CACHE_TEST_H
@@ -0,0 +1,281 @@
+#include "memory/cache/cache_sweep.h"
+
+#include "memory/cache/cache.h"
+#include "memory/cache/cache_policy.h"
+#include "simulator_exception.h"
+
+#include <algorithm>
+#include <exception>
+#include <map>
+#include <thread>
+#include <tuple>
+
+namespace machine {
+
+uint64_t CacheSweepResult::get_access_count() const {
+    return hit_read + miss_read + hit_write + miss_write;
+}
+
+uint64_t CacheSweepResult::get_miss_count() const {
+    return miss_read + miss_write;
+}
+
+double CacheSweepResult::get_miss_rate() const {
+    const uint64_t accesses = get_access_count();
+    return (accesses == 0) ? 0.0 : (double)get_miss_count() / (double)accesses;
+}
+
+/**
+ * Common interface of the configuration evaluators. Each model owns its
+ * counters, so distinct models can be fed from different threads.
+ */
+class CacheSweepModel {
+public:
+    CacheSweepModel(CacheSweepStream stream, const CacheConfig &config)
+        : stream(stream)
+        , config(config)
+        , block_bytes(config.block_size() * BLOCK_ITEM_SIZE) {}
+    virtual ~CacheSweepModel() = default;
+
+    void feed(const AccessTraceRecord &record) {
+        const bool is_program = record.kind == MemoryAccessKind::FETCH;
+        if (is_program != (stream == CacheSweepStream::PROGRAM)) { return; }
+        const uint64_t start = record.address.get_raw();
+        const uint64_t end = start + record.size;
+        // Same condition as in `Cache::read` and `Cache::write`.
+        if ((start >= CACHE_UNCACHED_START && start <= CACHE_UNCACHED_LAST)
+            || (end >= CACHE_UNCACHED_START && end <= CACHE_UNCACHED_LAST)) {
+            return;
+        }
+        const AccessType type = (record.kind == MemoryAccessKind::STORE) ? WRITE : READ;
+        // Access crossing block boundary is split as in `Cache::access`.
+        for (uint64_t block = start / block_bytes; block * block_bytes < end; block++) {
+            access(block % config.set_count(), block / config.set_count(), type);
+        }
+    }
+
+    virtual void collect(std::vector<CacheSweepResult> &results) const = 0;
+
+protected:
+    virtual void access(size_t row, uint64_t tag, AccessType type) = 0;
+
+    const CacheSweepStream stream;
+    const CacheConfig config;
+    const uint64_t block_bytes;
+};
+
+/**
+ * Stack distance (Mattson) analysis of LRU caches sharing set count and block
+ * size. Each set keeps its blocks ordered from the most recently used. Access
+ * found at depth `d` hits in all caches with associativity greater than `d`.
+ * Stacks are bounded by the largest associativity of the group as deeper
+ * entries would miss in every evaluated cache anyway.
+ */
+class CacheSweepStackDistance final : public CacheSweepModel {
+public:
+    CacheSweepStackDistance(CacheSweepStream stream, const CacheConfig &config)
+        : CacheSweepModel(stream, config) {}
+
+    void add_result_index(size_t index, unsigned associativity) {
+        result_indexes.emplace_back(index, associativity);
+        max_associativity = std::max(max_associativity, associativity);
+    }
+
+    void allocate() {
+        stacks.assign((size_t)config.set_count() * max_associativity, 0);
+        depths.assign(config.set_count(), 0);
+        // Last item counts accesses not found in the stack.
+        histogram_read.assign(max_associativity + 1, 0);
+        histogram_write.assign(max_associativity + 1, 0);
+    }
+
+    void collect(std::vector<CacheSweepResult> &results) const override {
+        for (auto [index, associativity] : result_indexes) {
+            CacheSweepResult &result = results.at(index);
+            for (size_t d = 0; d <= max_associativity; d++) {
+                if (d < associativity) {
+                    result.hit_read += histogram_read[d];
+                    result.hit_write += histogram_write[d];
+                } else {
+                    result.miss_read += histogram_read[d];
+                    result.miss_write += histogram_write[d];
+                }
+            }
+        }
+    }
+
+protected:
+    void access(size_t row, uint64_t tag, AccessType type) override {
+        uint64_t *stack = &stacks[row * max_associativity];
+        unsigned &depth = depths[row];
+        unsigned d = 0;
+        while (d < depth && stack[d] != tag) {
+            d++;
+        }
+        ((type == WRITE) ? histogram_write : histogram_read)[(d < depth) ? d : max_associativity]++;
+        if (d == depth) {
+            // Not found, the least recently used entry falls out of the stack.
+            if (depth < max_associativity) { depth++; }
+            d = depth - 1;
+        }
+        std::move_backward(stack, stack + d, stack + d + 1);
+        stack[0] = tag;
+    }
+
+private:
+    std::vector<std::tuple<size_t, unsigned>> result_indexes;
+    unsigned max_associativity = 0;
+    std::vector<uint64_t> stacks;
+    std::vector<unsigned> depths;
+    std::vector<uint64_t> histogram_read;
+    std::vector<uint64_t> histogram_write;
+};
+
+/**
+ * Tag only replay of a single configuration with the replacement policy used
+ * by `Cache`.
+ */
+class CacheSweepReplay final : public CacheSweepModel {
+public:
+    CacheSweepReplay(CacheSweepStream stream, const CacheConfig &config, size_t result_index)
+        : CacheSweepModel(stream, config)
+        , result_index(result_index)
+        , lines((size_t)config.associativity() * config.set_count())
+        , policy(CachePolicy::get_policy_instance(&config)) {}
+
+    void collect(std::vector<CacheSweepResult> &results) const override {
+        CacheSweepResult &result = results.at(result_index);
+        result.hit_read += hit_read;
+        result.miss_read += miss_read;
+        result.hit_write += hit_write;
+        result.miss_write += miss_write;
+    }
+
+protected:
+    void access(size_t row, uint64_t tag, AccessType type) override {
+        size_t way = 0;
+        while (way < config.associativity()
+               && (!line(way, row).valid || line(way, row).tag != tag)) {
+            way++;
+        }
+        if (way >= config.associativity()) {
+            if (type == WRITE && config.write_policy() == CacheConfig::WP_THROUGH_NOALLOC) {
+                miss_write++;
+                return;
+            }
+            way = policy->select_way_to_evict(row);
+            line(way, row).valid = false;
+            policy->update_stats(way, row, false);
+        }
+        Line &l = line(way, row);
+        if (l.valid) {
+            (type == WRITE) ? hit_write++ : hit_read++;
+        } else {
+            (type == WRITE) ? miss_write++ : miss_read++;
+            l.valid = true;
+            l.tag = tag;
+        }
+        policy->update_stats(way, row, true);
+    }
+
+private:
+    struct Line {
+        bool valid = false;
+        uint64_t tag = 0;
+    };
+
+    Line &line(size_t way, size_t row) { return lines[way * config.set_count() + row]; }
+
+    const size_t result_index;
+    std::vector<Line> lines;
+    std::unique_ptr<CachePolicy> policy;
+    uint64_t hit_read = 0, miss_read = 0, hit_write = 0, miss_write = 0;
+};
+
+CacheSweep::CacheSweep() = default;
+CacheSweep::~CacheSweep() = default;
+
+void CacheSweep::add_config(CacheSweepStream stream, const CacheConfig &config) {
+    SANITY_ASSERT(!models_prepared, "Configurations cannot be added after the sweep started.");
+    results.push_back({ .stream = stream, .config = config });
+}
+
+void CacheSweep::prepare_models() {
+    if (models_prepared) { return; }
+    models_prepared = true;
+
+    std::map<std::tuple<CacheSweepStream, unsigned, unsigned>, CacheSweepStackDistance *> groups;
+    for (size_t i = 0; i < results.size(); i++) {
+        const CacheConfig &config = results[i].config;
+        if (!config.enabled()) { continue; }
+        if (config.replacement_policy() == CacheConfig::RP_LRU
+            && config.write_policy() != CacheConfig::WP_THROUGH_NOALLOC) {
+            auto key = std::make_tuple(results[i].stream, config.set_count(), config.block_size());
+            auto group = groups.find(key);
+            if (group == groups.end()) {
+                auto model = std::make_unique<CacheSweepStackDistance>(results[i].stream, config);
+                group = groups.emplace(key, model.get()).first;
+                models.push_back(std::move(model));
+            }
+            group->second->add_result_index(i, config.associativity());
+        } else {
+            models.push_back(std::make_unique<CacheSweepReplay>(results[i].stream, config, i));
+        }
+    }
+    for (auto &group : groups) {
+        group.second->allocate();
+    }
+}
+
+void CacheSweep::feed(const AccessTraceRecord &record) {
+    prepare_models();
+    for (auto &model : models) {
+        model->feed(record);
+    }
+}
+
+void CacheSweep::run(const QString &trace_path, unsigned jobs) {
+    prepare_models();
+    jobs = std::max(1u, std::min(jobs, (unsigned)models.size()));
+
+    auto replay = [&](unsigned job) {
+        AccessTraceReader reader(trace_path);
+        AccessTraceRecord record {};
+        while (reader.next(record)) {
+            for (size_t i = job; i < models.size(); i += jobs) {
+                models[i]->feed(record);
+            }
+        }
+    };
+
+    if (jobs == 1) {
+        replay(0);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    std::vector<std::exception_ptr> errors(jobs);
+    for (unsigned job = 0; job < jobs; job++) {
+        workers.emplace_back([&, job] {
+            try {
+                replay(job);
+            } catch (...) { errors[job] = std::current_exception(); }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    for (auto &error : errors) {
+        if (error) { std::rethrow_exception(error); }
+    }
+}
+
+std::vector<CacheSweepResult> CacheSweep::get_results() const {
+    std::vector<CacheSweepResult> collected = results;
+    for (const auto &model : models) {
+        model->collect(collected);
+    }
+    return collected;
+}
+
+} // namespace machine
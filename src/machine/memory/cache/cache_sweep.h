@@ -0,0 +1,82 @@
+#ifndef CACHE_SWEEP_H
+#define CACHE_SWEEP_H
+
+#include "machineconfig.h"
+#include "memory/cache/access_trace.h"
+
+#include <QString>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace machine {
+
+/** Address stream of the access trace a swept cache is connected to. */
+enum class CacheSweepStream { PROGRAM, DATA };
+
+struct CacheSweepResult {
+    CacheSweepStream stream;
+    CacheConfig config;
+    uint64_t hit_read = 0;
+    uint64_t miss_read = 0;
+    uint64_t hit_write = 0;
+    uint64_t miss_write = 0;
+
+    [[nodiscard]] uint64_t get_access_count() const;
+    [[nodiscard]] uint64_t get_miss_count() const;
+    [[nodiscard]] double get_miss_rate() const;
+};
+
+class CacheSweepModel;
+
+/**
+ * Evaluates many cache configurations against a single recorded access trace
+ * (see `AccessTraceWriter`).
+ *
+ * Hit and miss counts are the same as those of `Cache` connected to the core
+ * during the recorded run (uncached area and accesses crossing block boundary
+ * are handled the same way).
+ *
+ * LRU configurations which allocate on write and share set count and block
+ * size are evaluated together by stack distance (Mattson) analysis. One pass
+ * produces results for all associativities of such group. Remaining
+ * configurations are replayed on a tag only model using the replacement
+ * policies of `Cache`. The independent models can be distributed over
+ * multiple threads, each one reading the trace on its own.
+ *
+ * NOTE: Cache flushes (e.g. caused by cache control instructions) are not part
+ * of the trace, so results may differ for programs using them.
+ */
+class CacheSweep {
+public:
+    CacheSweep();
+    ~CacheSweep();
+
+    /** Disabled configurations are accepted and report no accesses. */
+    void add_config(CacheSweepStream stream, const CacheConfig &config);
+
+    /** Process single access by all configurations in the calling thread. */
+    void feed(const AccessTraceRecord &record);
+
+    /**
+     * Process the whole trace file.
+     *
+     * @param jobs  maximal number of worker threads
+     * @throws SimulatorExceptionInput when the trace cannot be read
+     */
+    void run(const QString &trace_path, unsigned jobs = 1);
+
+    /** Results in the order in which configurations were added. */
+    [[nodiscard]] std::vector<CacheSweepResult> get_results() const;
+
+private:
+    void prepare_models();
+
+    std::vector<CacheSweepResult> results;
+    std::vector<std::unique_ptr<CacheSweepModel>> models;
+    bool models_prepared = false;
+};
+
+} // namespace machine
+
+#endif // CACHE_SWEEP_H
@@ -111,6 +111,13 @@ LocationStatus FrontendMemory::location_status(Address address) const {
     return LOCSTAT_NONE;
 }
 
+bool FrontendMemory::get_host_window(Address address, bool allocate, HostWindow &window) const {
+    UNUSED(address)
+    UNUSED(allocate)
+    UNUSED(window)
+    return false;
+}
+
 template<typename T>
 T FrontendMemory::read_generic(Address address, AccessEffects type) const {
     T value;
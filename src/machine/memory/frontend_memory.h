@@ -16,6 +16,50 @@ using ae = machine::AccessEffects;
 
 namespace machine {
 
+/**
+ * Host memory backing a range of simulated addresses (e.g. a section of RAM),
+ * which can be accessed by memcpy instead of walking the memory hierarchy.
+ * Data are stored in the simulated machine endian.
+ *
+ * The window is valid while `*generation` keeps the value it had, when the
+ * window was obtained. Direct writes, which change the content, have to
+ * increment `*change_counter` to keep change tracking of the owner working.
+ * Windows obtained without allocation may be read only (e.g. memory shared
+ * with another copy).
+ */
+struct HostWindow {
+    byte *data = nullptr; //> Host pointer to `start`
+    Address start = Address::null();
+    Address last = Address::null();
+    const uint32_t *generation = nullptr;
+    uint32_t valid_generation = 0;
+    uint32_t *change_counter = nullptr;
+    bool writable = false;
+    // Dirty tracking of the backing memory, stamped by direct writes.
+    uint64_t *dirty_epoch = nullptr;
+    const uint64_t *current_epoch = nullptr;
+
+    /** Whole access is inside of a still valid window. */
+    [[nodiscard]] inline bool covers(Address address, size_t size) const {
+        return generation != nullptr && *generation == valid_generation && address >= start
+               && address <= last && size - 1 <= (uint64_t)(last - address);
+    }
+
+    inline void read(void *destination, Address source, size_t size) const {
+        memcpy(destination, data + (source - start), size);
+    }
+
+    /** @return true when the content changed */
+    inline bool write(Address destination, const void *source, size_t size) const {
+        byte *target = data + (destination - start);
+        if (memcmp(target, source, size) == 0) { return false; }
+        memcpy(target, source, size);
+        (*change_counter)++;
+        if (current_epoch != nullptr) { *dirty_epoch = *current_epoch; }
+        return true;
+    }
+};
+
 /**
  * # What is frontend memory
  *
@@ -88,6 +132,18 @@ public:
 
     virtual void sync();
     [[nodiscard]] virtual LocationStatus location_status(Address address) const;
+
+    /**
+     * Get host memory backing given address, see `HostWindow`.
+     *
+     * Only levels which do not need to observe individual accesses (the memory
+     * bus) provide windows. Caches use windows of the lower level to speed up
+     * accesses they pass through. Default implementation provides none.
+     *
+     * @param allocate      allocate lazily allocated backing memory if needed
+     * @return              false when address is not backed by plain memory
+     */
+    virtual bool get_host_window(Address address, bool allocate, HostWindow &window) const;
     [[nodiscard]] virtual uint32_t get_change_counter() const = 0;
 
     /**
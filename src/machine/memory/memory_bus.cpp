@@ -6,7 +6,8 @@
 using namespace machine;
 
 MemoryDataBus::MemoryDataBus(Endian simulated_endian)
-    : FrontendMemory(simulated_endian) {};
+    : FrontendMemory(simulated_endian)
+    , page_directory(PAGE_TABLE_SIZE) {};
 
 MemoryDataBus::~MemoryDataBus() {
     ranges_by_addr.clear(); // No stored values are owned.
@@ -95,8 +96,46 @@ enum LocationStatus MemoryDataBus::location_status(Address address) const {
     return range->device->location_status(address - range->start_addr);
 }
 
+bool MemoryDataBus::get_host_window(Address address, bool allocate, HostWindow &window) const {
+    const RangeDesc *range = find_range(address);
+    BackendHostWindow device_window {};
+    if (range == nullptr
+        || !range->device->get_host_window(
+            address - range->start_addr, allocate, device_window)) {
+        return false;
+    }
+    const Address start = range->start_addr + device_window.start;
+    const Address last = range->start_addr + device_window.last;
+    window = { .data = device_window.data,
+               .start = std::max(start, range->start_addr),
+               .last = std::min(last, range->last_addr),
+               .generation = &host_window_generation,
+               .valid_generation = host_window_generation,
+               .change_counter = &change_counter,
+               .writable = device_window.writable,
+               .dirty_epoch = device_window.dirty_epoch,
+               .current_epoch = device_window.current_epoch };
+    window.data += window.start - start;
+    return true;
+}
+
 const MemoryDataBus::RangeDesc *
 MemoryDataBus::find_range(Address address) const {
+    if (last_range != nullptr && last_range->contains(address)) {
+        return last_range;
+    }
+
+    const uint64_t page = address.get_raw() >> PAGE_BITS;
+    if (page < PAGE_TABLE_SIZE * PAGE_TABLE_SIZE) {
+        const PageDirectoryEntry &dir = page_directory[page >> PAGE_TABLE_BITS];
+        const RangeDesc *range
+            = (dir.pages != nullptr) ? (*dir.pages)[page & (PAGE_TABLE_SIZE - 1)] : dir.range;
+        if (range != nullptr) {
+            last_range = range;
+            return range;
+        }
+    }
+
     // lowerBound finds range what has highest key (which is range->last_addr)
     // less then or equal to address.
     // See comment in insert_device_to_range for description, why this works.
@@ -107,12 +146,55 @@ MemoryDataBus::find_range(Address address) const {
 
     const RangeDesc *range = iter.value();
     if (address >= range->start_addr && address <= range->last_addr) {
+        last_range = range;
         return range;
     }
 
     return nullptr;
 }
 
+void MemoryDataBus::rebuild_page_table() {
+    last_range = nullptr;
+    host_window_generation++;
+    for (auto &dir : page_directory) {
+        dir.range = nullptr;
+        dir.pages.reset();
+    }
+    for (const RangeDesc *range : ranges_by_addr) {
+        // Only pages completely covered by the range are mapped.
+        const uint64_t page_mask = ((uint64_t)1 << PAGE_BITS) - 1;
+        const uint64_t start = range->start_addr.get_raw();
+        const uint64_t last = range->last_addr.get_raw();
+        const uint64_t first_page = (start >> PAGE_BITS) + ((start & page_mask) != 0);
+        const uint64_t end_page = (last >> PAGE_BITS) + ((last & page_mask) == page_mask);
+        const uint64_t table_end = PAGE_TABLE_SIZE * PAGE_TABLE_SIZE;
+        if (first_page < std::min(end_page, table_end)) {
+            map_pages(range, first_page, std::min(end_page, table_end) - 1);
+        }
+    }
+}
+
+void MemoryDataBus::map_pages(const RangeDesc *range, uint64_t first_page, uint64_t last_page) {
+    for (uint64_t page = first_page; page <= last_page;) {
+        PageDirectoryEntry &dir = page_directory[page >> PAGE_TABLE_BITS];
+        const uint64_t row_first = page & ~(uint64_t)(PAGE_TABLE_SIZE - 1);
+        const uint64_t row_last = row_first + PAGE_TABLE_SIZE - 1;
+        if (page == row_first && last_page >= row_last) {
+            // Ranges do not overlap, so nothing else can be in this row.
+            dir.range = range;
+        } else {
+            if (dir.pages == nullptr) {
+                dir.pages = std::make_unique<PageTableRow>();
+                dir.pages->fill(nullptr);
+            }
+            for (uint64_t p = page; p <= std::min(last_page, row_last); p++) {
+                (*dir.pages)[p & (PAGE_TABLE_SIZE - 1)] = range;
+            }
+        }
+        page = row_last + 1;
+    }
+}
+
 bool MemoryDataBus::insert_device_to_range(
     BackendMemory *device,
     Address start_addr,
@@ -140,6 +222,7 @@ bool MemoryDataBus::insert_device_to_range(
     connect(
         device, &BackendMemory::external_backend_change_notify, this,
         &MemoryDataBus::range_backend_external_change);
+    rebuild_page_table();
     return true;
 }
 
@@ -150,6 +233,7 @@ bool MemoryDataBus::remove_device(BackendMemory *device) {
     }
 
     ranges_by_addr.remove(range->last_addr);
+    rebuild_page_table();
     if (range->owns_device) {
         delete range->device;
     }
@@ -159,15 +243,20 @@ bool MemoryDataBus::remove_device(BackendMemory *device) {
 }
 
 void MemoryDataBus::clean_range(Address start_addr, Address last_addr) {
+    // Removal invalidates iterators of the map, so collect devices first.
+    QVector<BackendMemory *> devices;
     for (auto iter = ranges_by_addr.lowerBound(start_addr);
          iter != ranges_by_addr.end(); iter++) {
         const RangeDesc *range = iter.value();
         if (range->start_addr <= last_addr) {
-            remove_device(range->device);
+            devices.append(range->device);
         } else {
             break;
         }
     }
+    for (BackendMemory *device : devices) {
+        remove_device(device);
+    }
 }
 
 void MemoryDataBus::range_backend_external_change(
@@ -176,15 +265,19 @@ void MemoryDataBus::range_backend_external_change(
     Offset last_offset,
     AccessEffects type) {
     change_counter++;
+    host_window_generation++;
 
     // We only use device here for lookup, so const_cast is safe as find takes
     // it by const reference .
     for (auto i = ranges_by_device.find(const_cast<BackendMemory *>(device));
          i != ranges_by_device.end(); i++) {
         const RangeDesc *range = i.value();
+        // Change of the whole device is notified with the maximal offset, so
+        // clamp it to the mapped range to avoid overflow.
+        const Offset range_last = range->last_addr - range->start_addr;
         emit external_change_notify(
             this, range->start_addr + start_offset,
-            std::max(range->start_addr + last_offset, range->last_addr), type);
+            range->start_addr + std::min(last_offset, range_last), type);
     }
 }
 
@@ -10,7 +10,10 @@
 
 #include <QMultiMap>
 #include <QObject>
+#include <array>
 #include <cstdint>
+#include <memory>
+#include <vector>
 
 namespace machine {
 
@@ -29,6 +32,11 @@ namespace machine {
  * range descriptions to relative offset within the given backend memory device.
  * Downstream (frontend -> backend) communication is performed directly and
  * upstream communication is done via "external_change" signals.
+ *
+ * Ranges are found through a two level page table covering the lower 4 GiB,
+ * which maps pages fully covered by a single range directly to it. Pages with
+ * multiple or no devices and addresses above the table fall back to the range
+ * map. The last range found is tried first.
  */
 class MemoryDataBus : public FrontendMemory {
     Q_OBJECT
@@ -111,6 +119,9 @@ public:
 
     enum LocationStatus location_status(Address address) const override;
 
+    /** Window is limited to a single device range. */
+    bool get_host_window(Address address, bool allocate, HostWindow &window) const override;
+
 private slots:
     /**
      * Receive external changes in underlying memory devices.
@@ -130,6 +141,29 @@ private:
      */
     QMap<Address, const RangeDesc *> ranges_by_addr;
     mutable uint32_t change_counter = 0;
+    // Incremented whenever host windows may become invalid.
+    uint32_t host_window_generation = 0;
+
+    // Granularity of page table in bits (4 KiB)
+    static constexpr size_t PAGE_BITS = 12;
+    // Bits of page number resolved by each table level
+    static constexpr size_t PAGE_TABLE_BITS = 10;
+    static constexpr size_t PAGE_TABLE_SIZE = (size_t)1 << PAGE_TABLE_BITS;
+    using PageTableRow = std::array<const RangeDesc *, PAGE_TABLE_SIZE>;
+    /** Top level entry, `range` is used when the whole row belongs to it. */
+    struct PageDirectoryEntry {
+        const RangeDesc *range = nullptr;
+        std::unique_ptr<PageTableRow> pages;
+    };
+    std::vector<PageDirectoryEntry> page_directory;
+    mutable const RangeDesc *last_range = nullptr;
+
+    /**
+     * Refill page table from `ranges_by_addr`. Has to be called after each
+     * change of the ranges.
+     */
+    void rebuild_page_table();
+    void map_pages(const RangeDesc *range, uint64_t first_page, uint64_t last_page);
 
     /**
      * Helper to write into single range. Used by `write`.
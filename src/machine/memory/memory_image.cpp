@@ -0,0 +1,332 @@
+#include "memory/memory_image.h"
+
+#include "simulator_exception.h"
+
+#include <QFile>
+#include <algorithm>
+#include <cstring>
+
+namespace machine {
+
+static constexpr char IMAGE_MAGIC[8] = { 'Q', 'T', 'R', 'V', 'I', 'M', 'G', 1 };
+static constexpr size_t IMAGE_HEADER_SIZE = 40;
+static constexpr size_t IMAGE_ENTRY_SIZE = 32;
+
+enum ImageEncoding : uint32_t {
+    ENCODING_RAW = 0,
+    ENCODING_LZ = 1,
+};
+
+struct ImageEntry {
+    uint64_t address;
+    uint64_t size;
+    uint64_t offset;
+    uint32_t stored_size;
+    uint32_t encoding;
+};
+
+static void put_le(std::vector<uint8_t> &out, uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        out.push_back((uint8_t)(value >> (8 * i)));
+    }
+}
+
+static uint64_t get_le(const uint8_t *data, size_t size) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; i++) {
+        value |= (uint64_t)data[i] << (8 * i);
+    }
+    return value;
+}
+
+/* LZ codec (LZ4 block layout) */
+
+static constexpr size_t LZ_MIN_MATCH = 4;
+static constexpr size_t LZ_MAX_OFFSET = 0xffff;
+static constexpr unsigned LZ_HASH_BITS = 16;
+
+static void lz_put_length(std::vector<uint8_t> &out, size_t length) {
+    // Remainder above the 4-bit token field.
+    for (; length >= 255; length -= 255) {
+        out.push_back(255);
+    }
+    out.push_back((uint8_t)length);
+}
+
+static void lz_put_sequence(
+    std::vector<uint8_t> &out,
+    const uint8_t *literals,
+    size_t literal_count,
+    size_t offset,
+    size_t match_length) {
+    const size_t match_code = (match_length != 0) ? match_length - LZ_MIN_MATCH : 0;
+    out.push_back(
+        (uint8_t)(std::min<size_t>(literal_count, 15) << 4 | std::min<size_t>(match_code, 15)));
+    if (literal_count >= 15) { lz_put_length(out, literal_count - 15); }
+    out.insert(out.end(), literals, literals + literal_count);
+    if (match_length == 0) { return; } // Last sequence
+    put_le(out, offset, 2);
+    if (match_code >= 15) { lz_put_length(out, match_code - 15); }
+}
+
+void memory_image_compress(const uint8_t *data, size_t size, std::vector<uint8_t> &out) {
+    std::vector<uint32_t> table(1u << LZ_HASH_BITS, UINT32_MAX);
+    size_t anchor = 0;
+    size_t pos = 0;
+    while (pos + LZ_MIN_MATCH <= size) {
+        uint32_t sequence;
+        memcpy(&sequence, data + pos, sizeof(sequence));
+        const uint32_t hash = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+        const uint32_t candidate = table[hash];
+        table[hash] = (uint32_t)pos;
+        if (candidate == UINT32_MAX || pos - candidate > LZ_MAX_OFFSET
+            || memcmp(data + candidate, data + pos, LZ_MIN_MATCH) != 0) {
+            pos++;
+            continue;
+        }
+        size_t length = LZ_MIN_MATCH;
+        while (pos + length < size && data[candidate + length] == data[pos + length]) {
+            length++;
+        }
+        lz_put_sequence(out, data + anchor, pos - anchor, pos - candidate, length);
+        pos += length;
+        anchor = pos;
+    }
+    lz_put_sequence(out, data + anchor, size - anchor, 0, 0);
+}
+
+bool memory_image_decompress(
+    const uint8_t *encoded,
+    size_t encoded_size,
+    uint8_t *data,
+    size_t size) {
+    const uint8_t *in = encoded;
+    const uint8_t *const in_end = encoded + encoded_size;
+    size_t out = 0;
+    auto get_length = [&](size_t &length) -> bool {
+        uint8_t b;
+        do {
+            if (in == in_end) { return false; }
+            b = *in++;
+            length += b;
+        } while (b == 255);
+        return true;
+    };
+    while (in < in_end) {
+        const uint8_t token = *in++;
+        size_t literal_count = token >> 4;
+        if (literal_count == 15 && !get_length(literal_count)) { return false; }
+        if (literal_count > (size_t)(in_end - in) || literal_count > size - out) { return false; }
+        memcpy(data + out, in, literal_count);
+        in += literal_count;
+        out += literal_count;
+        if (in == in_end) { break; } // Last sequence has no match.
+
+        if (in_end - in < 2) { return false; }
+        const size_t offset = get_le(in, 2);
+        in += 2;
+        size_t length = (token & 0xf) + LZ_MIN_MATCH;
+        if ((token & 0xf) == 15 && !get_length(length)) { return false; }
+        if (offset == 0 || offset > out || length > size - out) { return false; }
+        // Source may overlap the destination (repeated pattern).
+        for (size_t i = 0; i < length; i++, out++) {
+            data[out] = data[out - offset];
+        }
+    }
+    return out == size;
+}
+
+/* Image file */
+
+void save_memory_image(
+    const QString &path,
+    const FrontendMemory *mem,
+    Address start,
+    uint64_t length,
+    bool compress) {
+    FILE *file = fopen(path.toLocal8Bit().data(), "wb");
+    if (file == nullptr) {
+        throw SIMULATOR_EXCEPTION(Input, "Cannot open memory image file for writing", path);
+    }
+    uint64_t file_pos = 0;
+    bool write_ok = true;
+    auto write = [&](const void *data, size_t size) {
+        write_ok &= fwrite(data, 1, size, file) == size;
+        file_pos += size;
+    };
+
+    // Header is written again when the table offset is known.
+    const std::vector<uint8_t> placeholder(IMAGE_HEADER_SIZE, 0);
+    write(placeholder.data(), placeholder.size());
+
+    std::vector<ImageEntry> entries;
+    std::vector<uint8_t> range_data;
+    std::vector<uint8_t> encoded;
+    uint64_t range_start = 0;
+    auto write_range = [&]() {
+        if (range_data.empty()) { return; }
+        ImageEntry entry { .address = start.get_raw() + range_start,
+                           .size = range_data.size(),
+                           .offset = 0,
+                           .stored_size = (uint32_t)range_data.size(),
+                           .encoding = ENCODING_RAW };
+        encoded.clear();
+        if (compress) { memory_image_compress(range_data.data(), range_data.size(), encoded); }
+        if (compress && encoded.size() < range_data.size()) {
+            entry.offset = file_pos;
+            entry.stored_size = (uint32_t)encoded.size();
+            entry.encoding = ENCODING_LZ;
+            write(encoded.data(), encoded.size());
+        } else {
+            const std::vector<uint8_t> padding(
+                (MEMORY_IMAGE_ALIGNMENT - file_pos % MEMORY_IMAGE_ALIGNMENT)
+                    % MEMORY_IMAGE_ALIGNMENT,
+                0);
+            write(padding.data(), padding.size());
+            entry.offset = file_pos;
+            write(range_data.data(), range_data.size());
+        }
+        entries.push_back(entry);
+        range_data.clear();
+    };
+
+    std::vector<uint8_t> chunk(MEMORY_IMAGE_CHUNK_SIZE);
+    static const uint8_t zeros[MEMORY_IMAGE_CHUNK_SIZE] = {};
+    for (uint64_t pos = 0; pos < length; pos += MEMORY_IMAGE_CHUNK_SIZE) {
+        const size_t size = std::min<uint64_t>(MEMORY_IMAGE_CHUNK_SIZE, length - pos);
+        mem->read(chunk.data(), start + pos, size, { .type = ae::INTERNAL });
+        if (memcmp(chunk.data(), zeros, size) == 0) {
+            write_range();
+            continue;
+        }
+        if (range_data.empty()) { range_start = pos; }
+        range_data.insert(range_data.end(), chunk.begin(), chunk.begin() + size);
+        if (range_data.size() >= MEMORY_IMAGE_MAX_RANGE_SIZE) { write_range(); }
+    }
+    write_range();
+
+    const uint64_t table_offset = file_pos;
+    std::vector<uint8_t> table;
+    for (const ImageEntry &entry : entries) {
+        put_le(table, entry.address, 8);
+        put_le(table, entry.size, 8);
+        put_le(table, entry.offset, 8);
+        put_le(table, entry.stored_size, 4);
+        put_le(table, entry.encoding, 4);
+    }
+    write(table.data(), table.size());
+
+    std::vector<uint8_t> header(std::begin(IMAGE_MAGIC), std::end(IMAGE_MAGIC));
+    put_le(header, start.get_raw(), 8);
+    put_le(header, length, 8);
+    put_le(header, table_offset, 8);
+    put_le(header, entries.size(), 4);
+    put_le(header, 0, 4);
+    write_ok &= fseek(file, 0, SEEK_SET) == 0;
+    write(header.data(), header.size());
+
+    if (fclose(file) != 0 || !write_ok) {
+        throw SIMULATOR_EXCEPTION(Input, "Failed to write memory image file", path);
+    }
+}
+
+uint64_t load_memory_image(const QString &path, FrontendMemory *mem, Address start) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        throw SIMULATOR_EXCEPTION(Input, "Cannot open memory image file", path);
+    }
+    const uint64_t file_size = file.size();
+    QByteArray content;
+    const uint8_t *data = (file_size != 0) ? file.map(0, file_size) : nullptr;
+    if (data == nullptr) {
+        // Mapping is not supported by all files (e.g. pipes).
+        content = file.readAll();
+        data = reinterpret_cast<const uint8_t *>(content.constData());
+    }
+    auto corrupted = [&](const char *reason) {
+        return SIMULATOR_EXCEPTION(Input, QString("Corrupted memory image: ") + reason, path);
+    };
+
+    if (file_size < IMAGE_HEADER_SIZE || memcmp(data, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0) {
+        throw SIMULATOR_EXCEPTION(Input, "File is not a supported memory image", path);
+    }
+    const uint64_t base = get_le(data + 8, 8);
+    const uint64_t length = get_le(data + 16, 8);
+    const uint64_t table_offset = get_le(data + 24, 8);
+    const uint64_t entry_count = get_le(data + 32, 4);
+    if (table_offset > file_size || entry_count > (file_size - table_offset) / IMAGE_ENTRY_SIZE) {
+        throw corrupted("range table out of file");
+    }
+    if (length != 0 && length - 1 > UINT64_MAX - start.get_raw()) {
+        throw SIMULATOR_EXCEPTION(Input, "Memory image does not fit to the address space", path);
+    }
+
+    std::vector<ImageEntry> entries;
+    for (uint64_t i = 0; i < entry_count; i++) {
+        const uint8_t *raw_entry = data + table_offset + i * IMAGE_ENTRY_SIZE;
+        const ImageEntry entry { .address = get_le(raw_entry, 8),
+                                 .size = get_le(raw_entry + 8, 8),
+                                 .offset = get_le(raw_entry + 16, 8),
+                                 .stored_size = (uint32_t)get_le(raw_entry + 24, 4),
+                                 .encoding = (uint32_t)get_le(raw_entry + 28, 4) };
+        if (entry.address < base || entry.address - base > length
+            || entry.size > length - (entry.address - base)) {
+            throw corrupted("range outside of the dumped range");
+        }
+        if (entry.offset > file_size || entry.stored_size > file_size - entry.offset) {
+            throw corrupted("range payload out of file");
+        }
+        entries.push_back(entry);
+    }
+    std::sort(entries.begin(), entries.end(), [](const ImageEntry &a, const ImageEntry &b) {
+        return a.address < b.address;
+    });
+
+    // Parts of the range which are not stored were zero when dumped. Only nonzero chunks are
+    // cleared, so memory which was never written is not allocated.
+    std::vector<uint8_t> chunk(MEMORY_IMAGE_CHUNK_SIZE);
+    static const uint8_t zeros[MEMORY_IMAGE_CHUNK_SIZE] = {};
+    auto clear = [&](uint64_t from, uint64_t to) {
+        for (uint64_t pos = from; pos < to; pos += MEMORY_IMAGE_CHUNK_SIZE) {
+            const size_t size = std::min<uint64_t>(MEMORY_IMAGE_CHUNK_SIZE, to - pos);
+            mem->read(chunk.data(), start + pos, size, { .type = ae::INTERNAL });
+            if (memcmp(chunk.data(), zeros, size) != 0) {
+                mem->write(start + pos, zeros, size, { .type = ae::INTERNAL });
+            }
+        }
+    };
+
+    uint64_t written = 0;
+    uint64_t cleared_until = 0;
+    std::vector<uint8_t> decoded;
+    for (const ImageEntry &entry : entries) {
+        const uint8_t *payload = data + entry.offset;
+        if (entry.encoding == ENCODING_LZ) {
+            if (entry.size > MEMORY_IMAGE_MAX_RANGE_SIZE) { throw corrupted("range too long"); }
+            decoded.resize(entry.size);
+            if (!memory_image_decompress(payload, entry.stored_size, decoded.data(), entry.size)) {
+                throw corrupted("invalid compressed data");
+            }
+            payload = decoded.data();
+        } else if (entry.encoding != ENCODING_RAW || entry.stored_size != entry.size) {
+            throw corrupted("invalid range encoding");
+        }
+        const uint64_t offset = entry.address - base;
+        clear(cleared_until, offset);
+        mem->write(start + offset, payload, entry.size, { .type = ae::INTERNAL });
+        cleared_until = std::max(cleared_until, offset + entry.size);
+        written += entry.size;
+    }
+    clear(cleared_until, length);
+    return written;
+}
+
+bool is_memory_image(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) { return false; }
+    char magic[sizeof(IMAGE_MAGIC)];
+    return file.read(magic, sizeof(magic)) == sizeof(magic)
+           && memcmp(magic, IMAGE_MAGIC, sizeof(magic)) == 0;
+}
+
+} // namespace machine
@@ -0,0 +1,81 @@
+#ifndef MEMORY_IMAGE_H
+#define MEMORY_IMAGE_H
+
+#include "memory/address.h"
+#include "memory/frontend_memory.h"
+
+#include <QString>
+#include <cstdint>
+#include <vector>
+
+namespace machine {
+
+/**
+ * Sparse binary image of a memory range, a fast replacement of the text
+ * dumps with one word per line.
+ *
+ * File format (all integers little endian):
+ *  - 40 byte header: 7 byte magic `QTRVIMG` and format version byte
+ *    (8 bytes), u64 base address and u64 length of the dumped range, u64 file
+ *    offset of the range table, u32 number of stored ranges and u32 reserved
+ *    zero,
+ *  - payloads,
+ *  - range table: for each range u64 address, u64 size, u64 payload file
+ *    offset, u32 payload size and u32 encoding (0 raw, 1 LZ).
+ *
+ * Only chunks of `MEMORY_IMAGE_CHUNK_SIZE` bytes containing nonzero data are
+ * stored, the rest of the dumped range reads as zeros. Raw payloads are
+ * aligned to `MEMORY_IMAGE_ALIGNMENT` in the file, so the image is mapped
+ * into the host memory and written by bulk writes when loaded.
+ *
+ * LZ encoding follows the LZ4 block layout (sequences of literals and
+ * matches with 16-bit offsets), it does not depend on any external library.
+ */
+constexpr size_t MEMORY_IMAGE_CHUNK_SIZE = 4096;
+constexpr size_t MEMORY_IMAGE_ALIGNMENT = 4096;
+/** Longer nonzero runs are split to limit buffers of compression. */
+constexpr size_t MEMORY_IMAGE_MAX_RANGE_SIZE = 4 * 1024 * 1024;
+
+/**
+ * Store content of the memory range to the image file.
+ *
+ * @param compress  use LZ encoding for ranges where it saves space
+ * @throws SimulatorExceptionInput when the file cannot be written
+ */
+void save_memory_image(
+    const QString &path,
+    const FrontendMemory *mem,
+    Address start,
+    uint64_t length,
+    bool compress);
+
+/**
+ * Write content of the image to the memory. Stored ranges are relocated by
+ * the difference between `start` and the base address of the image. Parts
+ * of the dumped range not stored in the image are cleared to zeros.
+ *
+ * @return number of bytes written from the stored ranges
+ * @throws SimulatorExceptionInput when the file is not a valid image
+ */
+uint64_t load_memory_image(const QString &path, FrontendMemory *mem, Address start);
+
+/** File starts with the image magic. */
+bool is_memory_image(const QString &path);
+
+/** Append LZ encoded data to `out`. */
+void memory_image_compress(const uint8_t *data, size_t size, std::vector<uint8_t> &out);
+
+/**
+ * Decode LZ encoded data of exactly `size` bytes.
+ *
+ * @return false when the encoded data are corrupted
+ */
+bool memory_image_decompress(
+    const uint8_t *encoded,
+    size_t encoded_size,
+    uint8_t *data,
+    size_t size);
+
+} // namespace machine
+
+#endif // MEMORY_IMAGE_H
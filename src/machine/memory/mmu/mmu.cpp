@@ -0,0 +1,240 @@
+#include "memory/mmu/mmu.h"
+
+namespace machine {
+
+static constexpr unsigned PAGE_BITS = 12;
+static constexpr uint64_t PAGE_OFFSET_MASK = ((uint64_t)1 << PAGE_BITS) - 1;
+
+// Page table entry bits
+static constexpr uint64_t PTE_V = 1 << 0;
+static constexpr uint64_t PTE_R = 1 << 1;
+static constexpr uint64_t PTE_W = 1 << 2;
+static constexpr uint64_t PTE_X = 1 << 3;
+static constexpr uint64_t PTE_U = 1 << 4;
+static constexpr uint64_t PTE_A = 1 << 6;
+static constexpr uint64_t PTE_D = 1 << 7;
+static constexpr unsigned PTE_PPN_SHIFT = 10;
+// Sv39 bits 63:54 are reserved (or used by unsupported extensions).
+static constexpr unsigned SV39_PTE_RESERVED_SHIFT = 54;
+static constexpr unsigned SV39_VA_BITS = 39;
+
+static ExceptionCause page_fault(MemoryAccessKind kind) {
+    switch (kind) {
+    case MemoryAccessKind::FETCH: return EXCAUSE_INSN_PAGE_FAULT;
+    case MemoryAccessKind::LOAD: return EXCAUSE_LOAD_PAGE_FAULT;
+    case MemoryAccessKind::STORE: return EXCAUSE_STORE_PAGE_FAULT;
+    }
+    Q_UNREACHABLE();
+}
+
+Mmu::Mmu(
+    FrontendMemory *walk_memory,
+    const CSR::ControlState *control_state,
+    Xlen xlen,
+    const MachineConfig &config)
+    : walk_memory(walk_memory)
+    , control_state(control_state)
+    , xlen(xlen)
+    , levels((xlen == Xlen::_32) ? 2 : 3)
+    , vpn_bits((xlen == Xlen::_32) ? 10 : 9)
+    , tlb_program(config.tlb_program())
+    , tlb_data(config.tlb_data())
+    , walk_cache(config.page_walk_cache_size()) {}
+
+ExceptionCause
+Mmu::translate(Address vaddr, unsigned size, MemoryAccessKind kind, Address &paddr) {
+    paddr = vaddr;
+    const CSR::PrivilegeLevel privilege = control_state->get_privilege_level();
+    if (privilege == CSR::PrivilegeLevel::MACHINE) { return EXCAUSE_NONE; }
+
+    const uint64_t satp = control_state->read_internal(CSR::Id::SATP).as_u64();
+    uint64_t root_table;
+    if (xlen == Xlen::_32) {
+        if (CSR::Field::satp::MODE32.decode(satp) != CSR::Field::satp::MODE32_SV32) {
+            return EXCAUSE_NONE;
+        }
+        root_table = CSR::Field::satp::PPN32.decode(satp) << PAGE_BITS;
+    } else {
+        if (CSR::Field::satp::MODE64.decode(satp) != CSR::Field::satp::MODE64_SV39) {
+            return EXCAUSE_NONE;
+        }
+        root_table = CSR::Field::satp::PPN64.decode(satp) << PAGE_BITS;
+    }
+    if (satp != active_satp) {
+        // ASIDs are not tracked, switching address space invalidates everything.
+        flush();
+        active_satp = satp;
+    }
+
+    const uint64_t va = vaddr.get_raw();
+    if ((va & PAGE_OFFSET_MASK) + size > PAGE_OFFSET_MASK + 1) {
+        return (kind == MemoryAccessKind::STORE) ? EXCAUSE_STORE_MISALIGNED
+                                                 : EXCAUSE_LOAD_MISALIGNED;
+    }
+    if (xlen == Xlen::_64) {
+        // Bits 63:39 have to be copies of bit 38.
+        const int64_t extended = (int64_t)(va << (64 - SV39_VA_BITS)) >> (64 - SV39_VA_BITS);
+        if ((uint64_t)extended != va) { return page_fault(kind); }
+    }
+
+    const uint64_t vpn = (va >> PAGE_BITS) & (((uint64_t)1 << (levels * vpn_bits)) - 1);
+    Tlb &tlb = (kind == MemoryAccessKind::FETCH) ? tlb_program : tlb_data;
+    uint64_t ppn;
+    uint8_t pte_bits;
+    if (const TlbEntry *entry = tlb.find(vpn)) {
+        ppn = entry->ppn;
+        pte_bits = entry->pte_bits;
+    } else {
+        if (!walk(root_table, vpn, ppn, pte_bits)) { return page_fault(kind); }
+        tlb.insert(vpn, ppn, pte_bits);
+    }
+    if (!is_permitted(pte_bits, kind, privilege)) { return page_fault(kind); }
+
+    paddr = Address((ppn << PAGE_BITS) | (va & PAGE_OFFSET_MASK));
+    return EXCAUSE_NONE;
+}
+
+bool Mmu::walk(uint64_t root_table, uint64_t vpn, uint64_t &ppn, uint8_t &pte_bits) {
+    const unsigned pte_size = (xlen == Xlen::_32) ? 4 : 8;
+    const uint64_t ppn_mask = (xlen == Xlen::_32) ? 0x3fffff : 0xfffffffffff;
+    const uint64_t index_mask = ((uint64_t)1 << vpn_bits) - 1;
+
+    walk_count++;
+    uint64_t table = root_table;
+    unsigned level = levels - 1;
+    if (!walk_cache.empty()) {
+        // The deepest cached entry skips the most memory reads.
+        bool hit = false;
+        for (unsigned l = 1; l < levels && !hit; l++) {
+            if (const WalkCacheEntry *cached = walk_cache_find(l, vpn >> (l * vpn_bits))) {
+                table = cached->table;
+                level = l - 1;
+                hit = true;
+            }
+        }
+        hit ? walk_cache_hits++ : walk_cache_misses++;
+    }
+
+    while (true) {
+        const Address pte_addr(table + ((vpn >> (level * vpn_bits)) & index_mask) * pte_size);
+        const uint64_t pte = (pte_size == 4) ? walk_memory->read_u32(pte_addr)
+                                             : walk_memory->read_u64(pte_addr);
+        walk_memory_reads++;
+
+        if (!(pte & PTE_V) || (!(pte & PTE_R) && (pte & PTE_W))) { return false; }
+        if (xlen == Xlen::_64 && (pte >> SV39_PTE_RESERVED_SHIFT) != 0) { return false; }
+        const uint64_t pte_ppn = (pte >> PTE_PPN_SHIFT) & ppn_mask;
+
+        if (pte & (PTE_R | PTE_X)) {
+            // Leaf, superpage has to be aligned to its size.
+            const uint64_t offset_mask = ((uint64_t)1 << (level * vpn_bits)) - 1;
+            if (pte_ppn & offset_mask) { return false; }
+            ppn = pte_ppn | (vpn & offset_mask);
+            pte_bits = (uint8_t)pte;
+            return true;
+        }
+        if (level == 0) { return false; }
+        table = pte_ppn << PAGE_BITS;
+        walk_cache_insert(level, vpn >> (level * vpn_bits), table);
+        level--;
+    }
+}
+
+bool Mmu::is_permitted(
+    uint8_t pte_bits,
+    MemoryAccessKind kind,
+    CSR::PrivilegeLevel privilege) const {
+    if (!(pte_bits & PTE_A)) { return false; }
+    const bool user_page = pte_bits & PTE_U;
+    if (privilege == CSR::PrivilegeLevel::UNPRIVILEGED && !user_page) { return false; }
+
+    switch (kind) {
+    case MemoryAccessKind::FETCH:
+        // Supervisor never executes from user pages.
+        return (pte_bits & PTE_X) && (privilege == CSR::PrivilegeLevel::UNPRIVILEGED || !user_page);
+    case MemoryAccessKind::LOAD:
+    case MemoryAccessKind::STORE: {
+        if (privilege == CSR::PrivilegeLevel::SUPERVISOR && user_page
+            && !control_state->read_field(CSR::Field::mstatus::SUM).as_u64()) {
+            return false;
+        }
+        if (kind == MemoryAccessKind::STORE) { return (pte_bits & PTE_W) && (pte_bits & PTE_D); }
+        return (pte_bits & PTE_R)
+               || ((pte_bits & PTE_X) && control_state->read_field(CSR::Field::mstatus::MXR).as_u64());
+    }
+    }
+    Q_UNREACHABLE();
+}
+
+const Mmu::WalkCacheEntry *Mmu::walk_cache_find(unsigned level, uint64_t vpn_tag) {
+    for (auto &entry : walk_cache) {
+        if (entry.valid && entry.level == level && entry.vpn_tag == vpn_tag) {
+            entry.last_use = ++walk_cache_time;
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+void Mmu::walk_cache_insert(unsigned level, uint64_t vpn_tag, uint64_t table) {
+    if (walk_cache.empty()) { return; }
+    // Fully associative, least recently used entry is replaced.
+    WalkCacheEntry *victim = &walk_cache.front();
+    for (auto &entry : walk_cache) {
+        if (!entry.valid) {
+            victim = &entry;
+            break;
+        }
+        if (entry.last_use < victim->last_use) { victim = &entry; }
+    }
+    *victim = { .valid = true,
+                .level = level,
+                .vpn_tag = vpn_tag,
+                .table = table,
+                .last_use = ++walk_cache_time };
+}
+
+void Mmu::flush() {
+    tlb_program.flush();
+    tlb_data.flush();
+    for (auto &entry : walk_cache) {
+        entry.valid = false;
+    }
+}
+
+void Mmu::reset() {
+    tlb_program.reset();
+    tlb_data.reset();
+    flush();
+    active_satp = 0;
+    walk_count = 0;
+    walk_memory_reads = 0;
+    walk_cache_hits = 0;
+    walk_cache_misses = 0;
+}
+
+const Tlb &Mmu::get_tlb_program() const {
+    return tlb_program;
+}
+
+const Tlb &Mmu::get_tlb_data() const {
+    return tlb_data;
+}
+
+uint32_t Mmu::get_walk_count() const {
+    return walk_count;
+}
+
+uint32_t Mmu::get_walk_memory_read_count() const {
+    return walk_memory_reads;
+}
+
+uint32_t Mmu::get_walk_cache_hit_count() const {
+    return walk_cache_hits;
+}
+
+uint32_t Mmu::get_walk_cache_miss_count() const {
+    return walk_cache_misses;
+}
+
+} // namespace machine
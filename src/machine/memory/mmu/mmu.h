@@ -0,0 +1,101 @@
+#ifndef MMU_H
+#define MMU_H
+
+#include "common/memory_ownership.h"
+#include "core/memory_access_observer.h"
+#include "csr/controlstate.h"
+#include "machineconfig.h"
+#include "machinedefs.h"
+#include "memory/address.h"
+#include "memory/frontend_memory.h"
+#include "memory/mmu/tlb.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace machine {
+
+/**
+ * Page based virtual memory (Sv32 on RV32, Sv39 on RV64).
+ *
+ * Translation applies to accesses in supervisor and user mode once satp
+ * selects the paged mode. Page tables are read through the data cache, so
+ * walks show up in its statistics as they would in hardware. Instruction
+ * fetches and data accesses have separate TLBs. Optional page walk cache keeps
+ * recently used non-leaf entries, so a walk can start at a lower level.
+ *
+ * Accessed and dirty bits are never set by the MMU. Access to a page with
+ * A clear (or store to a page with D clear) raises page fault and the
+ * supervisor is expected to update the entry (Svade behavior).
+ */
+class Mmu {
+public:
+    /**
+     * @param walk_memory       memory used to read page tables
+     * @param control_state     source of satp, mstatus and current privilege
+     * @param xlen              selects Sv32 or Sv39
+     * @param config            TLB and page walk cache configuration
+     */
+    Mmu(FrontendMemory *walk_memory,
+        const CSR::ControlState *control_state,
+        Xlen xlen,
+        const MachineConfig &config);
+
+    /**
+     * Translate virtual address of an access.
+     *
+     * Access crossing page boundary under translation raises misaligned
+     * exception as it may map to discontinuous physical memory.
+     *
+     * @param paddr     set to translated address on success
+     * @return          EXCAUSE_NONE on success, page fault or misaligned cause
+     */
+    ExceptionCause translate(Address vaddr, unsigned size, MemoryAccessKind kind, Address &paddr);
+
+    /** Invalidate TLBs and page walk cache (sfence.vma). */
+    void flush();
+    /** Invalidate everything and clear statistics. */
+    void reset();
+
+    [[nodiscard]] const Tlb &get_tlb_program() const;
+    [[nodiscard]] const Tlb &get_tlb_data() const;
+    [[nodiscard]] uint32_t get_walk_count() const;
+    [[nodiscard]] uint32_t get_walk_memory_read_count() const;
+    [[nodiscard]] uint32_t get_walk_cache_hit_count() const;
+    [[nodiscard]] uint32_t get_walk_cache_miss_count() const;
+
+private:
+    struct WalkCacheEntry {
+        bool valid = false;
+        unsigned level = 0;   //> Level of the cached non-leaf entry
+        uint64_t vpn_tag = 0; //> VPN bits translated by levels above and including `level`
+        uint64_t table = 0;   //> Physical address of the next level table
+        uint64_t last_use = 0;
+    };
+
+    bool walk(uint64_t root_table, uint64_t vpn, uint64_t &ppn, uint8_t &pte_bits);
+    const WalkCacheEntry *walk_cache_find(unsigned level, uint64_t vpn_tag);
+    void walk_cache_insert(unsigned level, uint64_t vpn_tag, uint64_t table);
+    bool is_permitted(uint8_t pte_bits, MemoryAccessKind kind, CSR::PrivilegeLevel privilege) const;
+
+    BORROWED FrontendMemory *const walk_memory;
+    BORROWED const CSR::ControlState *const control_state;
+    const Xlen xlen;
+    const unsigned levels;
+    const unsigned vpn_bits;
+    Tlb tlb_program;
+    Tlb tlb_data;
+    std::vector<WalkCacheEntry> walk_cache;
+    uint64_t walk_cache_time = 0;
+    /** Translations cached in TLBs belong to this satp value. */
+    uint64_t active_satp = 0;
+
+    uint32_t walk_count = 0;
+    uint32_t walk_memory_reads = 0;
+    uint32_t walk_cache_hits = 0;
+    uint32_t walk_cache_misses = 0;
+};
+
+} // namespace machine
+
+#endif // MMU_H
@@ -0,0 +1,69 @@
+#include "memory/mmu/tlb.h"
+
+namespace machine {
+
+Tlb::Tlb(const CacheConfig &config)
+    : config(config)
+    , entries(config.enabled() ? (size_t)config.set_count() * config.associativity() : 0)
+    , replacement_policy(CachePolicy::get_policy_instance(&config)) {}
+
+const TlbEntry *Tlb::find(uint64_t vpn) {
+    if (config.enabled()) {
+        const size_t row = vpn % config.set_count();
+        for (size_t way = 0; way < config.associativity(); way++) {
+            TlbEntry &e = entry(way, row);
+            if (e.valid && e.vpn == vpn) {
+                hit_count++;
+                replacement_policy->update_stats(way, row, true);
+                return &e;
+            }
+        }
+    }
+    miss_count++;
+    return nullptr;
+}
+
+void Tlb::insert(uint64_t vpn, uint64_t ppn, uint8_t pte_bits) {
+    if (!config.enabled()) { return; }
+    const size_t row = vpn % config.set_count();
+    size_t way = 0;
+    while (way < config.associativity() && entry(way, row).valid) {
+        way++;
+    }
+    if (way == config.associativity()) { way = replacement_policy->select_way_to_evict(row); }
+    entry(way, row) = { .valid = true, .vpn = vpn, .ppn = ppn, .pte_bits = pte_bits };
+    replacement_policy->update_stats(way, row, true);
+}
+
+void Tlb::flush() {
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (!entries[i].valid) { continue; }
+        entries[i].valid = false;
+        replacement_policy->update_stats(i / config.set_count(), i % config.set_count(), false);
+    }
+}
+
+void Tlb::reset() {
+    flush();
+    hit_count = 0;
+    miss_count = 0;
+}
+
+const CacheConfig &Tlb::get_config() const {
+    return config;
+}
+
+uint32_t Tlb::get_hit_count() const {
+    return hit_count;
+}
+
+uint32_t Tlb::get_miss_count() const {
+    return miss_count;
+}
+
+double Tlb::get_hit_rate() const {
+    const uint32_t lookups = hit_count + miss_count;
+    return (lookups == 0) ? 0.0 : (double)hit_count / (double)lookups * 100.0;
+}
+
+} // namespace machine
@@ -0,0 +1,60 @@
+#ifndef TLB_H
+#define TLB_H
+
+#include "machineconfig.h"
+#include "memory/cache/cache_policy.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace machine {
+
+struct TlbEntry {
+    bool valid = false;
+    uint64_t vpn = 0;     //> Virtual page number (of 4 KiB page)
+    uint64_t ppn = 0;     //> Physical page number (of 4 KiB page)
+    uint8_t pte_bits = 0; //> Low byte of the leaf page table entry (permissions, A, D)
+};
+
+/**
+ * Translation lookaside buffer.
+ *
+ * Organization is described by `CacheConfig` (set count, associativity and
+ * replacement policy, block size is not used) and replacement is handled by
+ * the same policies as in `Cache`. Superpages are stored as separate entries
+ * for each accessed 4 KiB page.
+ *
+ * Disabled TLB holds no entries, so every lookup misses.
+ */
+class Tlb {
+public:
+    explicit Tlb(const CacheConfig &config);
+
+    /** Lookup translation of the page, counted in hit/miss statistics. */
+    const TlbEntry *find(uint64_t vpn);
+    void insert(uint64_t vpn, uint64_t ppn, uint8_t pte_bits);
+    /** Invalidate all entries. */
+    void flush();
+    /** Invalidate all entries and clear statistics. */
+    void reset();
+
+    [[nodiscard]] const CacheConfig &get_config() const;
+    [[nodiscard]] uint32_t get_hit_count() const;
+    [[nodiscard]] uint32_t get_miss_count() const;
+    /** Percentage of lookups that hit. */
+    [[nodiscard]] double get_hit_rate() const;
+
+private:
+    TlbEntry &entry(size_t way, size_t row) { return entries[way * config.set_count() + row]; }
+
+    const CacheConfig config;
+    std::vector<TlbEntry> entries;
+    std::unique_ptr<CachePolicy> replacement_policy;
+    uint32_t hit_count = 0;
+    uint32_t miss_count = 0;
+};
+
+} // namespace machine
+
+#endif // TLB_H
@@ -0,0 +1,148 @@
+#include "memory/pmp/pmp.h"
+
+namespace machine {
+
+namespace pmpcfg = CSR::Field::pmpcfg;
+
+static ExceptionCause access_fault(MemoryAccessKind kind) {
+    switch (kind) {
+    case MemoryAccessKind::FETCH: return EXCAUSE_INSN_FAULT;
+    case MemoryAccessKind::LOAD: return EXCAUSE_LOAD_FAULT;
+    case MemoryAccessKind::STORE: return EXCAUSE_STORE_FAULT;
+    }
+    Q_UNREACHABLE();
+}
+
+Pmp::Pmp(const CSR::ControlState *control_state)
+    : control_state(control_state)
+    , active_generation(control_state->get_pmp_generation()) {
+    refresh();
+}
+
+void Pmp::set_fixed_default(uint8_t permissions) {
+    fixed_default = permissions;
+    refresh();
+}
+
+void Pmp::add_fixed_region(uint64_t start, uint64_t last, uint8_t permissions) {
+    fixed_regions.push_back({ .start = start, .last = last, .permissions = permissions, .locked = true });
+    refresh();
+}
+
+void Pmp::refresh() {
+    active_generation = control_state->get_pmp_generation();
+    pmp_regions.clear();
+    pmp_enabled = false;
+    uint64_t previous_address = 0;
+    for (size_t i = 0; i < pmpcfg::ENTRY_COUNT; i++) {
+        const uint8_t cfg = control_state->get_pmp_config(i);
+        const uint64_t address = control_state->get_pmp_address(i);
+        const uint64_t mode = pmpcfg::A.decode(cfg);
+        Region region { .start = 0,
+                        .last = 0,
+                        .permissions = (uint8_t)(cfg & PERM_RWX),
+                        .locked = pmpcfg::L.decode(cfg) != 0 };
+        if (mode != pmpcfg::A_OFF) { pmp_enabled = true; }
+        if (mode == pmpcfg::A_TOR) {
+            // Empty range matches nothing, but still counts as enabled entry.
+            if (address > previous_address) {
+                region.start = previous_address << 2;
+                region.last = (address << 2) - 1;
+                pmp_regions.push_back(region);
+            }
+        } else if (mode == pmpcfg::A_NA4) {
+            region.start = address << 2;
+            region.last = region.start + 3;
+            pmp_regions.push_back(region);
+        } else if (mode == pmpcfg::A_NAPOT) {
+            // Trailing ones encode size of 2^(ones + 3) bytes.
+            const unsigned ones = (~address == 0) ? 64 : __builtin_ctzll(~address);
+            if (ones >= 61) {
+                region.start = 0;
+                region.last = UINT64_MAX;
+            } else {
+                region.start = (address & ~(((uint64_t)1 << ones) - 1)) << 2;
+                region.last = region.start + ((uint64_t)1 << (ones + 3)) - 1;
+            }
+            pmp_regions.push_back(region);
+        }
+        previous_address = address;
+    }
+    active = pmp_enabled || fixed_default != PERM_RWX || !fixed_regions.empty();
+    cache.fill({});
+}
+
+bool Pmp::lookup(uint64_t start, uint64_t last, bool machine, uint8_t &permissions) const {
+    uint8_t fixed = fixed_default;
+    for (const Region &region : fixed_regions) {
+        if (region.last < start || region.start > last) { continue; }
+        if (region.start > start || region.last < last) { return false; }
+        fixed = region.permissions;
+        break;
+    }
+    uint8_t pmp = (machine || !pmp_enabled) ? (uint8_t)PERM_RWX : 0;
+    for (const Region &region : pmp_regions) {
+        if (region.last < start || region.start > last) { continue; }
+        // Partial match fails regardless of mode and permissions.
+        if (region.start > start || region.last < last) { return false; }
+        pmp = (machine && !region.locked) ? (uint8_t)PERM_RWX : region.permissions;
+        break;
+    }
+    permissions = fixed & pmp;
+    return true;
+}
+
+ExceptionCause
+Pmp::check_active(Address paddr, unsigned size, MemoryAccessKind kind, bool read_modify_write) {
+    const uint64_t start = paddr.get_raw();
+    const uint64_t last = start + size - 1;
+    const bool machine = control_state->get_privilege_level() == CSR::PrivilegeLevel::MACHINE;
+
+    uint8_t required;
+    switch (kind) {
+    case MemoryAccessKind::FETCH: required = PERM_X; break;
+    case MemoryAccessKind::LOAD: required = PERM_R; break;
+    default: required = PERM_W | (read_modify_write ? PERM_R : 0); break;
+    }
+
+    uint8_t permissions = 0;
+    bool matched;
+    const uint64_t page = start >> PAGE_BITS;
+    if (page == (last >> PAGE_BITS)) {
+        CacheEntry &entry = cache[page & (CACHE_SIZE - 1)];
+        const uint64_t tag = (page << 1) | (machine ? 1 : 0);
+        if (entry.tag == tag) {
+            cache_hits++;
+        } else {
+            cache_misses++;
+            entry.tag = tag;
+            const uint64_t page_start = page << PAGE_BITS;
+            entry.uniform = lookup(
+                page_start, page_start + ((uint64_t)1 << PAGE_BITS) - 1, machine,
+                entry.permissions);
+        }
+        permissions = entry.permissions;
+        matched = entry.uniform || lookup(start, last, machine, permissions);
+    } else {
+        matched = lookup(start, last, machine, permissions);
+    }
+
+    if (matched && (permissions & required) == required) { return EXCAUSE_NONE; }
+    return access_fault(kind);
+}
+
+void Pmp::reset() {
+    cache.fill({});
+    cache_hits = 0;
+    cache_misses = 0;
+}
+
+uint32_t Pmp::get_cache_hit_count() const {
+    return cache_hits;
+}
+
+uint32_t Pmp::get_cache_miss_count() const {
+    return cache_misses;
+}
+
+} // namespace machine
@@ -0,0 +1,115 @@
+#ifndef PMP_H
+#define PMP_H
+
+#include "common/memory_ownership.h"
+#include "core/memory_access_observer.h"
+#include "csr/controlstate.h"
+#include "machinedefs.h"
+#include "memory/address.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace machine {
+
+/**
+ * Physical memory protection (RISC-V PMP) together with the memory protection
+ * options of the simulator.
+ *
+ * PMP entries are read from pmpcfg and pmpaddr CSRs, TOR, NA4 and NAPOT
+ * matching is supported with 4 byte granularity. Protection options of
+ * `MachineConfig` are given by fixed regions, which apply in all privilege
+ * modes on top of the PMP entries.
+ *
+ * Permissions are cached for 4 KiB pages covered uniformly by both fixed
+ * regions and PMP entries, other pages are resolved for each access. The cache
+ * is dropped whenever PMP CSRs change. When nothing is configured, the check
+ * ends after comparing the CSR generation.
+ *
+ * NOTE: Page table walks are not checked.
+ * NOTE: Supervisor and user accesses not matched by any entry fail only when
+ * some entry is enabled, so programs which never configure PMP keep working
+ * (the specification requires at least one matching entry).
+ */
+class Pmp {
+public:
+    /** Permission bits, the same as in pmpcfg. */
+    enum Permission : uint8_t {
+        PERM_R = 1 << 0,
+        PERM_W = 1 << 1,
+        PERM_X = 1 << 2,
+        PERM_RWX = PERM_R | PERM_W | PERM_X,
+    };
+
+    explicit Pmp(const CSR::ControlState *control_state);
+
+    /** Permissions of memory outside of all fixed regions (all by default). */
+    void set_fixed_default(uint8_t permissions);
+    /** Regions are matched in the order of addition. */
+    void add_fixed_region(uint64_t start, uint64_t last, uint8_t permissions);
+
+    /**
+     * Check access to physical memory in the current privilege mode.
+     *
+     * @param read_modify_write     store which reads the memory too (AMO)
+     * @return                      EXCAUSE_NONE or access fault of given kind
+     */
+    inline ExceptionCause check(
+        Address paddr,
+        unsigned size,
+        MemoryAccessKind kind,
+        bool read_modify_write = false) {
+        if (control_state->get_pmp_generation() != active_generation) { refresh(); }
+        if (!active) { return EXCAUSE_NONE; }
+        return check_active(paddr, size, kind, read_modify_write);
+    }
+
+    /** Drop cached permissions and clear statistics. */
+    void reset();
+
+    [[nodiscard]] uint32_t get_cache_hit_count() const;
+    [[nodiscard]] uint32_t get_cache_miss_count() const;
+
+private:
+    struct Region {
+        uint64_t start;
+        uint64_t last;
+        uint8_t permissions;
+        bool locked; //> Applies to machine mode too
+    };
+    struct CacheEntry {
+        uint64_t tag = UINT64_MAX; //> Page number and machine mode flag
+        uint8_t permissions = 0;
+        bool uniform = false; //> Whole page has the same permissions
+    };
+
+    static constexpr unsigned PAGE_BITS = 12;
+    static constexpr size_t CACHE_SIZE = 256;
+
+    /** Decode PMP CSRs and drop the cache. */
+    void refresh();
+    ExceptionCause
+    check_active(Address paddr, unsigned size, MemoryAccessKind kind, bool read_modify_write);
+    /**
+     * Permissions of bytes from `start` to `last`.
+     * @return  false when some region covers the bytes only partially
+     */
+    bool lookup(uint64_t start, uint64_t last, bool machine, uint8_t &permissions) const;
+
+    BORROWED const CSR::ControlState *const control_state;
+    uint8_t fixed_default = PERM_RWX;
+    std::vector<Region> fixed_regions;
+    std::vector<Region> pmp_regions;
+    bool pmp_enabled = false;
+    /** Anything may deny an access, the check cannot be skipped. */
+    bool active = false;
+    uint32_t active_generation;
+    std::array<CacheEntry, CACHE_SIZE> cache;
+    uint32_t cache_hits = 0;
+    uint32_t cache_misses = 0;
+};
+
+} // namespace machine
+
+#endif // PMP_H
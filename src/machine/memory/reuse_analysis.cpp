@@ -0,0 +1,293 @@
+#include "memory/reuse_analysis.h"
+
+#include "utils.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+namespace machine {
+
+static unsigned log2_of(unsigned value) {
+    unsigned bits = 0;
+    while ((1u << (bits + 1)) <= value) {
+        bits++;
+    }
+    return bits;
+}
+
+uint32_t TimestampTree::count_of(uint32_t node) const {
+    return (node == NIL) ? 0 : nodes[node].count;
+}
+
+void TimestampTree::update(uint32_t node) {
+    nodes[node].count = 1 + count_of(nodes[node].left) + count_of(nodes[node].right);
+}
+
+void TimestampTree::split(uint32_t node, uint64_t key, uint32_t &left, uint32_t &right) {
+    // Keys lower than `key` go to left.
+    if (node == NIL) {
+        left = right = NIL;
+    } else if (nodes[node].key < key) {
+        split(nodes[node].right, key, nodes[node].right, right);
+        left = node;
+        update(node);
+    } else {
+        split(nodes[node].left, key, left, nodes[node].left);
+        right = node;
+        update(node);
+    }
+}
+
+uint32_t TimestampTree::merge(uint32_t left, uint32_t right) {
+    if (left == NIL) { return right; }
+    if (right == NIL) { return left; }
+    if (nodes[left].priority > nodes[right].priority) {
+        nodes[left].right = merge(nodes[left].right, right);
+        update(left);
+        return left;
+    } else {
+        nodes[right].left = merge(left, nodes[right].left);
+        update(right);
+        return right;
+    }
+}
+
+void TimestampTree::insert(uint64_t key) {
+    // Xorshift is sufficient for treap priorities.
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+
+    uint32_t node;
+    if (!free_nodes.empty()) {
+        node = free_nodes.back();
+        free_nodes.pop_back();
+    } else {
+        node = (uint32_t)nodes.size();
+        nodes.emplace_back();
+    }
+    nodes[node] = { .key = key, .priority = random_state, .left = NIL, .right = NIL, .count = 1 };
+
+    uint32_t left, right;
+    split(root, key, left, right);
+    root = merge(merge(left, node), right);
+}
+
+void TimestampTree::erase(uint64_t key) {
+    uint32_t left, middle, right;
+    split(root, key, left, right);
+    split(right, key + 1, middle, right);
+    if (middle != NIL) {
+        // Keys are unique, so middle is a single node.
+        free_nodes.push_back(middle);
+    }
+    root = merge(left, right);
+}
+
+uint64_t TimestampTree::count_greater(uint64_t key) const {
+    uint64_t result = 0;
+    uint32_t node = root;
+    while (node != NIL) {
+        if (nodes[node].key > key) {
+            result += 1 + count_of(nodes[node].right);
+            node = nodes[node].left;
+        } else {
+            node = nodes[node].right;
+        }
+    }
+    return result;
+}
+
+size_t TimestampTree::size() const {
+    return count_of(root);
+}
+
+void ReuseHistogram::add(uint64_t distance) {
+    size_t bucket = 0;
+    while (distance != 0 && bucket < BUCKET_COUNT - 1) {
+        distance >>= 1;
+        bucket++;
+    }
+    buckets[bucket]++;
+}
+
+uint64_t ReuseHistogram::get_access_count() const {
+    uint64_t count = cold;
+    for (auto bucket : buckets) {
+        count += bucket;
+    }
+    return count;
+}
+
+ReuseAnalysis::ReuseAnalysis(
+    const SymbolTable *symtab,
+    unsigned block_size,
+    uint64_t window_length,
+    unsigned page_size)
+    : symbols(symtab)
+    , block_bits(log2_of(block_size))
+    , page_bits(log2_of(page_size))
+    , window_length(window_length) {
+    for (auto &stream : streams) {
+        stream.by_symbol.resize(symbols.size() + 1);
+    }
+}
+
+void ReuseAnalysis::memory_access(
+    MemoryAccessKind kind,
+    Address address,
+    unsigned size,
+    Address inst_addr) {
+    UNUSED(size)
+    UNUSED(inst_addr)
+    Stream &stream = streams[(kind == MemoryAccessKind::FETCH) ? 0 : 1];
+    const uint64_t block = address.get_raw() >> block_bits;
+    const int symbol = symbols.find(address.get_raw());
+    ReuseHistogram &by_symbol = stream.by_symbol[(symbol < 0) ? symbols.size() : symbol];
+
+    auto found = stream.blocks.find(block);
+    if (found == stream.blocks.end()) {
+        stream.total.cold++;
+        by_symbol.cold++;
+        found = stream.blocks.insert({ block, { 0, 0 } }).first;
+    } else {
+        const uint64_t distance = stream.tree.count_greater(found->second.last_access);
+        stream.total.add(distance);
+        by_symbol.add(distance);
+        stream.tree.erase(found->second.last_access);
+    }
+    found->second.last_access = stream.time;
+    stream.tree.insert(stream.time);
+    stream.time++;
+
+    if (found->second.last_window != window_index) {
+        found->second.last_window = window_index;
+        stream.window_blocks++;
+    }
+    uint64_t &page_window = stream.pages[address.get_raw() >> page_bits];
+    if (page_window != window_index) {
+        page_window = window_index;
+        stream.window_pages++;
+    }
+}
+
+void ReuseAnalysis::instruction_retired(Address inst_addr) {
+    UNUSED(inst_addr)
+    retired++;
+    if (window_length != 0 && retired % window_length == 0) { close_window(); }
+}
+
+void ReuseAnalysis::close_window() {
+    windows.push_back({ .instructions = retired,
+                        .program_blocks = streams[0].window_blocks,
+                        .program_pages = streams[0].window_pages,
+                        .data_blocks = streams[1].window_blocks,
+                        .data_pages = streams[1].window_pages });
+    for (auto &stream : streams) {
+        stream.window_blocks = 0;
+        stream.window_pages = 0;
+    }
+    window_index++;
+}
+
+const ReuseHistogram &ReuseAnalysis::get_histogram(bool program) const {
+    return streams[program ? 0 : 1].total;
+}
+
+static const char *stream_name(size_t stream) {
+    return (stream == 0) ? "program" : "data";
+}
+
+void ReuseAnalysis::write_csv_histogram(
+    QTextStream &out,
+    const char *stream,
+    const QString &symbol,
+    const ReuseHistogram &histogram) const {
+    out << stream << ",\"" << symbol << "\",cold,," << histogram.cold << "\n";
+    for (size_t i = 0; i < ReuseHistogram::BUCKET_COUNT; i++) {
+        if (histogram.buckets[i] == 0) { continue; }
+        const uint64_t from = (i == 0) ? 0 : (uint64_t)1 << (i - 1);
+        const uint64_t to = (i == 0) ? 0 : ((uint64_t)1 << i) - 1;
+        out << stream << ",\"" << symbol << "\"," << from << "," << to << ","
+            << histogram.buckets[i] << "\n";
+    }
+}
+
+void ReuseAnalysis::write_reuse_csv(QTextStream &out) const {
+    out << "stream,symbol,distance_from,distance_to,count\n";
+    for (size_t s = 0; s < streams.size(); s++) {
+        write_csv_histogram(out, stream_name(s), "*", streams[s].total);
+        for (size_t i = 0; i <= symbols.size(); i++) {
+            const ReuseHistogram &histogram = streams[s].by_symbol[i];
+            if (histogram.get_access_count() == 0) { continue; }
+            write_csv_histogram(
+                out, stream_name(s), (i < symbols.size()) ? symbols.name(i) : "?", histogram);
+        }
+    }
+}
+
+static QJsonObject histogram_to_json(const ReuseHistogram &histogram) {
+    QJsonArray buckets;
+    size_t used = ReuseHistogram::BUCKET_COUNT;
+    while (used > 0 && histogram.buckets[used - 1] == 0) {
+        used--;
+    }
+    for (size_t i = 0; i < used; i++) {
+        buckets.append((double)histogram.buckets[i]);
+    }
+    return { { "cold", (double)histogram.cold }, { "log2_buckets", buckets } };
+}
+
+void ReuseAnalysis::write_reuse_json(QTextStream &out) const {
+    QJsonObject root;
+    root["block_size"] = 1 << block_bits;
+    for (size_t s = 0; s < streams.size(); s++) {
+        QJsonObject by_symbol;
+        for (size_t i = 0; i <= symbols.size(); i++) {
+            const ReuseHistogram &histogram = streams[s].by_symbol[i];
+            if (histogram.get_access_count() == 0) { continue; }
+            by_symbol[(i < symbols.size()) ? symbols.name(i) : "?"] = histogram_to_json(histogram);
+        }
+        root[stream_name(s)] = QJsonObject { { "total", histogram_to_json(streams[s].total) },
+                                             { "symbols", by_symbol } };
+    }
+    out << QJsonDocument(root).toJson();
+}
+
+void ReuseAnalysis::write_working_set_csv(QTextStream &out) const {
+    out << "instructions,program_blocks,program_pages,data_blocks,data_pages\n";
+    for (const auto &w : windows) {
+        out << w.instructions << "," << w.program_blocks << "," << w.program_pages << ","
+            << w.data_blocks << "," << w.data_pages << "\n";
+    }
+    if (window_length == 0 || retired % window_length != 0) {
+        out << retired << "," << streams[0].window_blocks << "," << streams[0].window_pages
+            << "," << streams[1].window_blocks << "," << streams[1].window_pages << "\n";
+    }
+}
+
+void ReuseAnalysis::write_working_set_json(QTextStream &out) const {
+    QJsonArray array;
+    auto add = [&](uint64_t instructions, uint64_t pb, uint64_t pp, uint64_t db, uint64_t dp) {
+        array.append(QJsonObject { { "instructions", (double)instructions },
+                                   { "program_blocks", (double)pb },
+                                   { "program_pages", (double)pp },
+                                   { "data_blocks", (double)db },
+                                   { "data_pages", (double)dp } });
+    };
+    for (const auto &w : windows) {
+        add(w.instructions, w.program_blocks, w.program_pages, w.data_blocks, w.data_pages);
+    }
+    if (window_length == 0 || retired % window_length != 0) {
+        add(retired, streams[0].window_blocks, streams[0].window_pages, streams[1].window_blocks,
+            streams[1].window_pages);
+    }
+    QJsonObject root { { "block_size", 1 << block_bits },
+                       { "page_size", 1 << page_bits },
+                       { "window_length", (double)window_length },
+                       { "windows", array } };
+    out << QJsonDocument(root).toJson();
+}
+
+} // namespace machine
@@ -0,0 +1,138 @@
+#ifndef REUSE_ANALYSIS_H
+#define REUSE_ANALYSIS_H
+
+#include "core/memory_access_observer.h"
+#include "symboltable.h"
+
+#include <QTextStream>
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace machine {
+
+/**
+ * Order statistic tree (treap) of timestamps. It answers the number of stored
+ * timestamps greater than the given one in logarithmic time, which is what the
+ * reuse distance computation needs.
+ */
+class TimestampTree {
+public:
+    void insert(uint64_t key);
+    void erase(uint64_t key);
+    /** Number of stored keys greater than `key`. */
+    [[nodiscard]] uint64_t count_greater(uint64_t key) const;
+    [[nodiscard]] size_t size() const;
+
+private:
+    static constexpr uint32_t NIL = UINT32_MAX;
+    struct Node {
+        uint64_t key;
+        uint32_t priority;
+        uint32_t left, right;
+        uint32_t count;
+    };
+
+    [[nodiscard]] uint32_t count_of(uint32_t node) const;
+    void update(uint32_t node);
+    void split(uint32_t node, uint64_t key, uint32_t &left, uint32_t &right);
+    uint32_t merge(uint32_t left, uint32_t right);
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> free_nodes;
+    uint32_t root = NIL;
+    uint32_t random_state = 2463534242;
+};
+
+/**
+ * Reuse distance histogram. Reuse distance is the number of distinct blocks
+ * accessed between two accesses to the same block. Bucket 0 counts distance
+ * zero, bucket `i` distances from 2^(i-1) to 2^i - 1.
+ */
+struct ReuseHistogram {
+    static constexpr size_t BUCKET_COUNT = 40;
+    std::array<uint64_t, BUCKET_COUNT> buckets {};
+    uint64_t cold = 0; //> First access to the block
+
+    void add(uint64_t distance);
+    [[nodiscard]] uint64_t get_access_count() const;
+};
+
+/**
+ * Collects reuse distance histograms (per symbol) and working set sizes over
+ * instruction windows from the access stream of the core.
+ *
+ * Instruction and data streams are analysed separately as they are served by
+ * separate L1 caches. Accesses are tracked in blocks of configurable size,
+ * working set is reported both in blocks and in pages.
+ */
+class ReuseAnalysis final : public MemoryAccessObserver {
+public:
+    /**
+     * @param symtab            symbols used to attribute accesses, may be null
+     * @param block_size        tracking granularity in bytes (power of two)
+     * @param window_length     working set window length in retired instructions
+     * @param page_size         page size in bytes (power of two)
+     */
+    ReuseAnalysis(
+        const SymbolTable *symtab,
+        unsigned block_size = 64,
+        uint64_t window_length = 10000,
+        unsigned page_size = 4096);
+
+    void memory_access(MemoryAccessKind kind, Address address, unsigned size, Address inst_addr)
+        override;
+    void instruction_retired(Address inst_addr) override;
+
+    /** CSV with a row for each stream, symbol and histogram bucket. */
+    void write_reuse_csv(QTextStream &out) const;
+    void write_reuse_json(QTextStream &out) const;
+    /** CSV with a row for each window. The last window may be incomplete. */
+    void write_working_set_csv(QTextStream &out) const;
+    void write_working_set_json(QTextStream &out) const;
+
+    [[nodiscard]] const ReuseHistogram &get_histogram(bool program) const;
+
+private:
+    struct Stream {
+        struct BlockState {
+            uint64_t last_access;
+            uint64_t last_window;
+        };
+        TimestampTree tree;
+        std::unordered_map<uint64_t, BlockState> blocks;
+        std::unordered_map<uint64_t, uint64_t> pages; // page -> last window
+        uint64_t time = 0;
+        ReuseHistogram total;
+        std::vector<ReuseHistogram> by_symbol; // last item for unknown symbol
+        uint64_t window_blocks = 0;
+        uint64_t window_pages = 0;
+    };
+
+    struct WindowRecord {
+        uint64_t instructions;
+        uint64_t program_blocks, program_pages;
+        uint64_t data_blocks, data_pages;
+    };
+
+    void close_window();
+    void write_csv_histogram(
+        QTextStream &out,
+        const char *stream,
+        const QString &symbol,
+        const ReuseHistogram &histogram) const;
+
+    const SymbolAddressIndex symbols;
+    const unsigned block_bits;
+    const unsigned page_bits;
+    const uint64_t window_length;
+    std::array<Stream, 2> streams;
+    uint64_t retired = 0;
+    uint64_t window_index = 1; // Zero is used for "never touched".
+    std::vector<WindowRecord> windows;
+};
+
+} // namespace machine
+
+#endif // REUSE_ANALYSIS_H
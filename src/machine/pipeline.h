@@ -15,6 +15,7 @@
 #ifndef STAGES_H
 #define STAGES_H
 
+#include "core/cpi_stack.h"
 #include "instruction.h"
 #include "machinedefs.h"
 #include "memory/address.h"
@@ -42,6 +43,8 @@ struct PCState {
 struct FetchInterstage {
     Instruction inst = Instruction::NOP; // Loaded instruction
     Address inst_addr = STAGEADDR_NONE;  // Address of instruction
+    /** Unique number of the fetched instruction (see `CoreState::fetch_seq`), zero for bubble. */
+    uint64_t seq = 0;
     Address next_inst_addr = 0_addr;     // `inst_addr` + `inst.size()`
     /** Inspecting other stages to get this value is problematic due to stalls and flushed.
      * Therefore we pass it through the whole pipeline. */
@@ -49,9 +52,15 @@ struct FetchInterstage {
     enum ExceptionCause excause = EXCAUSE_NONE;
     bool is_valid = false;
 
+    /** Reason of the bubble when the stage does not hold an instruction. */
+    CpiComponent bubble_cause = CpiComponent::PIPELINE_FILL;
+
 public:
-    /** Reset to value corresponding to NOP. */
-    void flush() { *this = {}; }
+    /** Reset to value corresponding to NOP inserted for the given reason. */
+    void flush(CpiComponent cause) {
+        *this = {};
+        bubble_cause = cause;
+    }
 };
 
 struct FetchInternalState {
@@ -79,6 +88,7 @@ struct FetchState {
 struct DecodeInterstage {
     Instruction inst = Instruction::NOP;
     Address inst_addr = STAGEADDR_NONE;
+    uint64_t seq = 0;
     Address next_inst_addr = 0_addr;
     Address predicted_next_inst_addr = 0_addr;
     RegisterValue val_rs = 0;        // Value from register rs
@@ -119,9 +129,15 @@ struct DecodeInterstage {
     bool xret = false;        // Return from exception, MRET and SRET
     bool insert_stall_before = false;
 
+    /** Reason of the bubble when the stage does not hold an instruction. */
+    CpiComponent bubble_cause = CpiComponent::PIPELINE_FILL;
+
 public:
-    /** Reset to value corresponding to NOP. */
-    void flush() { *this = {}; }
+    /** Reset to value corresponding to NOP inserted for the given reason. */
+    void flush(CpiComponent cause) {
+        *this = {};
+        bubble_cause = cause;
+    }
 };
 
 struct DecodeInternalState {
@@ -156,6 +172,7 @@ struct DecodeState {
 struct ExecuteInterstage {
     Instruction inst = Instruction::NOP;
     Address inst_addr = STAGEADDR_NONE;
+    uint64_t seq = 0;
     Address next_inst_addr = 0_addr;
     Address predicted_next_inst_addr = 0_addr;
     Address branch_jal_target = 0_addr; //> Potential branch target (inst_addr + 4 + imm).
@@ -180,9 +197,15 @@ struct ExecuteInterstage {
     bool csr_write = false;
     bool xret = false;
 
+    /** Reason of the bubble when the stage does not hold an instruction. */
+    CpiComponent bubble_cause = CpiComponent::PIPELINE_FILL;
+
 public:
-    /** Reset to value corresponding to NOP. */
-    void flush() { *this = {}; }
+    /** Reset to value corresponding to NOP inserted for the given reason. */
+    void flush(CpiComponent cause) {
+        *this = {};
+        bubble_cause = cause;
+    }
 };
 
 struct ExecuteInternalState {
@@ -234,6 +257,7 @@ struct ExecuteState {
 struct MemoryInterstage {
     Instruction inst = Instruction::NOP;
     Address inst_addr = STAGEADDR_NONE;
+    uint64_t seq = 0;
     Address next_inst_addr = 0_addr;
     Address predicted_next_inst_addr = 0_addr;
     Address computed_next_inst_addr = 0_addr;
@@ -246,9 +270,15 @@ struct MemoryInterstage {
     bool is_valid = false;
     bool csr_written = false;
 
+    /** Reason of the bubble when the stage does not hold an instruction. */
+    CpiComponent bubble_cause = CpiComponent::PIPELINE_FILL;
+
 public:
-    /** Reset to value corresponding to NOP. */
-    void flush() { *this = {}; }
+    /** Reset to value corresponding to NOP inserted for the given reason. */
+    void flush(CpiComponent cause) {
+        *this = {};
+        bubble_cause = cause;
+    }
 };
 
 struct MemoryInternalState {
@@ -286,6 +316,7 @@ struct MemoryState {
 struct WritebackInternalState {
     Instruction inst = Instruction::NOP;
     Address inst_addr = STAGEADDR_NONE;
+    uint64_t seq = 0;
     RegisterValue value = 0;
     RegisterId num_rd = 0;
     bool regwrite = false;
@@ -0,0 +1,249 @@
+#include "profiler/call_profile.h"
+
+#include <map>
+
+namespace machine {
+
+/** Deeper calls are charged to the deepest node (e.g. unbounded recursion). */
+static constexpr size_t MAX_TREE_DEPTH = 256;
+static constexpr uint64_t NO_RETURN = UINT64_MAX;
+/** Name of costs before the first instruction retired. */
+static const char *const UNATTRIBUTED_NAME = "[unattributed]";
+
+static constexpr uint8_t OPCODE_JAL = 0x6f;
+static constexpr uint8_t OPCODE_JALR = 0x67;
+
+/** Return address registers of the calling convention (ra and alternate t0). */
+static bool is_link(uint8_t reg) {
+    return reg == 1 || reg == 5;
+}
+
+CallProfile::CallProfile(const SymbolTable *symtab, const CSR::ControlState *control_state)
+    : symbols(symtab, true)
+    , functions(symtab, false)
+    , control_state(control_state)
+    , last_trap_count((control_state != nullptr) ? control_state->get_trap_count() : 0) {
+    nodes.push_back(
+        { .function = 0, .parent = ROOT, .trap = false, .calls = 0, .self = {}, .children = {} });
+}
+
+uint64_t CallProfile::function_of(uint64_t address) const {
+    const int index = symbols.find(address);
+    return (index >= 0) ? symbols.start(index) : address;
+}
+
+QString CallProfile::function_name(uint64_t function) const {
+    const int index = symbols.find(function);
+    if (index >= 0 && symbols.start(index) == function) { return symbols.name(index); }
+    return QString("0x") + QString::number(function, 16);
+}
+
+ProfileCounters &CallProfile::current() {
+    return nodes[stack.empty() ? ROOT : stack.back().node].self;
+}
+
+void CallProfile::push(uint64_t target, uint64_t return_addr, bool trap) {
+    const uint64_t function = function_of(target);
+    const uint32_t parent = stack.empty() ? ROOT : stack.back().node;
+    uint32_t node = parent;
+    if (stack.size() < MAX_TREE_DEPTH) {
+        node = UINT32_MAX;
+        for (uint32_t child : nodes[parent].children) {
+            if (nodes[child].function == function && nodes[child].trap == trap) {
+                node = child;
+                break;
+            }
+        }
+        if (node == UINT32_MAX) {
+            node = (uint32_t)nodes.size();
+            nodes.push_back({ .function = function,
+                              .parent = parent,
+                              .trap = trap,
+                              .calls = 0,
+                              .self = {},
+                              .children = {} });
+            nodes[parent].children.push_back(node);
+        }
+    }
+    nodes[node].calls++;
+    stack.push_back({ node, return_addr, trap });
+}
+
+void CallProfile::pop_return(uint64_t target) {
+    // Returns never leave the trap handler, only mret does.
+    for (size_t i = stack.size(); i-- > 0 && !stack[i].trap;) {
+        if (stack[i].return_addr == target) {
+            stack.resize(i);
+            return;
+        }
+    }
+    // Unknown return address (e.g. return from the entry function), the next retired
+    // instruction starts a new base frame when the stack is empty.
+    if (!stack.empty() && !stack.back().trap) { stack.pop_back(); }
+}
+
+void CallProfile::pop_trap() {
+    for (size_t i = stack.size(); i-- > 0;) {
+        if (stack[i].trap) {
+            stack.resize(i);
+            return;
+        }
+    }
+    // Return without a known trap (e.g. the initial switch to user mode) is a jump anywhere.
+    stack.clear();
+}
+
+void CallProfile::follow_control_flow(const MemoryInterstage &mem_wb) {
+    const uint8_t opcode = mem_wb.inst.opcode();
+    if (opcode != OPCODE_JAL && opcode != OPCODE_JALR) { return; }
+    const uint8_t rd = mem_wb.inst.rd();
+    const uint8_t rs = (opcode == OPCODE_JALR) ? mem_wb.inst.rs() : 0;
+    const uint64_t target = mem_wb.computed_next_inst_addr.get_raw();
+
+    if (is_link(rd)) {
+        // Coroutine swap returns from the current function and calls the target.
+        if (is_link(rs) && rd != rs && !stack.empty() && !stack.back().trap) { stack.pop_back(); }
+        push(target, mem_wb.next_inst_addr.get_raw(), false);
+    } else if (is_link(rs)) {
+        pop_return(target);
+    } else if (!stack.empty()) {
+        const int index = functions.find(target);
+        if (index >= 0 && functions.start(index) == target
+            && nodes[stack.back().node].function != function_of(target)) {
+            // Tail call, the callee returns directly to our caller.
+            const Frame frame = stack.back();
+            stack.pop_back();
+            push(target, frame.return_addr, frame.trap);
+        }
+    }
+}
+
+void CallProfile::record_step(
+    const CoreState &state,
+    uint32_t program_misses,
+    uint32_t data_misses) {
+    const MemoryInterstage &mem_wb = state.pipeline.memory.result;
+    pending_cycles++;
+    if (mem_wb.is_valid && mem_wb.excause == EXCAUSE_NONE) {
+        if (stack.empty()) { push(mem_wb.inst_addr.get_raw(), NO_RETURN, false); }
+        ProfileCounters &counters = current();
+        counters.retired++;
+        counters.cycles += pending_cycles;
+        pending_cycles = 0;
+    }
+    if (state.stall_count != last_stall_count) {
+        current().stalls += state.stall_count - last_stall_count;
+        last_stall_count = state.stall_count;
+    }
+    if (program_misses != last_program_misses) {
+        current().program_misses += program_misses - last_program_misses;
+        last_program_misses = program_misses;
+    }
+    if (data_misses != last_data_misses) {
+        current().data_misses += data_misses - last_data_misses;
+        last_data_misses = data_misses;
+    }
+
+    // Control transfers take effect for the following instructions.
+    if (mem_wb.is_valid && mem_wb.excause == EXCAUSE_NONE) {
+        if (state.pipeline.memory.internal.xret) {
+            pop_trap();
+        } else {
+            follow_control_flow(mem_wb);
+        }
+    }
+    if (control_state != nullptr && control_state->get_trap_count() != last_trap_count) {
+        last_trap_count = control_state->get_trap_count();
+        // Vectored interrupts are charged to the handler base.
+        const uint64_t handler = control_state->read_internal(CSR::Id::MTVEC).as_u64();
+        push(handler & ~UINT64_C(3), NO_RETURN, true);
+    }
+}
+
+std::vector<ProfileCounters> CallProfile::inclusive_costs() const {
+    std::vector<ProfileCounters> inclusive(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        inclusive[i] = nodes[i].self;
+    }
+    // Children are always created after their parents.
+    for (size_t i = nodes.size(); i-- > 1;) {
+        inclusive[nodes[i].parent].add(inclusive[i]);
+    }
+    return inclusive;
+}
+
+std::vector<CallPath> CallProfile::get_paths() const {
+    const std::vector<ProfileCounters> inclusive = inclusive_costs();
+    std::vector<CallPath> paths;
+    if (!nodes[ROOT].self.empty()) {
+        paths.push_back({ { UNATTRIBUTED_NAME }, 0, nodes[ROOT].self, nodes[ROOT].self });
+    }
+    for (size_t i = 1; i < nodes.size(); i++) {
+        if (inclusive[i].empty()) { continue; }
+        CallPath path { {}, nodes[i].calls, nodes[i].self, inclusive[i] };
+        for (size_t node = i; node != ROOT; node = nodes[node].parent) {
+            path.frames.insert(path.frames.begin(), function_name(nodes[node].function));
+        }
+        paths.push_back(std::move(path));
+    }
+    return paths;
+}
+
+static void write_callgrind_costs(QTextStream &out, const ProfileCounters &counters) {
+    out << counters.retired << " " << counters.cycles << " " << counters.stalls << " "
+        << counters.program_misses << " " << counters.data_misses << "\n";
+}
+
+void CallProfile::write_callgrind(QTextStream &out) const {
+    struct Edge {
+        uint64_t calls = 0;
+        ProfileCounters inclusive;
+    };
+    struct Function {
+        ProfileCounters self;
+        std::map<uint64_t, Edge> callees;
+    };
+    // Calling contexts are merged by function, callgrind does not know them.
+    const std::vector<ProfileCounters> inclusive = inclusive_costs();
+    std::map<uint64_t, Function> by_function;
+    for (size_t i = 1; i < nodes.size(); i++) {
+        by_function[nodes[i].function].self.add(nodes[i].self);
+        if (nodes[i].parent != ROOT) {
+            Edge &edge = by_function[nodes[nodes[i].parent].function].callees[nodes[i].function];
+            edge.calls += nodes[i].calls;
+            edge.inclusive.add(inclusive[i]);
+        }
+    }
+
+    out << "# callgrind format\n"
+        << "version: 1\n"
+        << "creator: qtrvsim\n"
+        << "events: Ir Cycles Stalls I1mr D1mr\n"
+        << "summary: ";
+    write_callgrind_costs(out, inclusive[ROOT]);
+    if (!nodes[ROOT].self.empty()) {
+        out << "\nfn=" << UNATTRIBUTED_NAME << "\n0 ";
+        write_callgrind_costs(out, nodes[ROOT].self);
+    }
+    for (const auto &function : by_function) {
+        out << "\nfn=" << function_name(function.first) << "\n0 ";
+        write_callgrind_costs(out, function.second.self);
+        for (const auto &callee : function.second.callees) {
+            out << "cfn=" << function_name(callee.first) << "\n"
+                << "calls=" << callee.second.calls << " 0\n0 ";
+            write_callgrind_costs(out, callee.second.inclusive);
+        }
+    }
+}
+
+void CallProfile::write_folded(QTextStream &out) const {
+    for (const CallPath &path : get_paths()) {
+        if (path.self.cycles == 0) { continue; }
+        for (size_t i = 0; i < path.frames.size(); i++) {
+            out << (i == 0 ? "" : ";") << path.frames[i];
+        }
+        out << " " << path.self.cycles << "\n";
+    }
+}
+
+} // namespace machine
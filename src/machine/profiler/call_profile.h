@@ -0,0 +1,121 @@
+#ifndef CALL_PROFILE_H
+#define CALL_PROFILE_H
+
+#include "core/core_state.h"
+#include "csr/controlstate.h"
+#include "profiler/flat_profile.h"
+#include "symboltable.h"
+
+#include <QString>
+#include <QTextStream>
+#include <cstdint>
+#include <vector>
+
+namespace machine {
+
+/** Costs of a single call path (node of the calling context tree). */
+struct CallPath {
+    /** Function names from the outermost one. */
+    std::vector<QString> frames;
+    /** Number of times the last function was entered from this path. */
+    uint64_t calls = 0;
+    /** Costs of instructions of the last function itself. */
+    ProfileCounters self;
+    /** Costs including everything called from this path. */
+    ProfileCounters inclusive;
+};
+
+/**
+ * Call graph profile collected from the core state after each step.
+ *
+ * Shadow call stack follows the return address stack hints of the RISC-V
+ * calling convention: `jal`/`jalr` writing a link register (`ra` or `t0`)
+ * is a call, `jalr` reading a link register and not writing one is a
+ * return, `jalr` with both links pops and pushes (coroutine swap). Jump
+ * without link to the start of a sized function symbol is a tail call and
+ * replaces the top frame. Returns pop all frames up to the one with the
+ * matching return address, so frames skipped by `longjmp` do not stay on
+ * the stack.
+ *
+ * Traps taken (counted by `CSR::ControlState`) push a trap frame of the
+ * handler, `mret` pops everything up to and including the trap frame.
+ *
+ * Costs are charged the same way as in `FlatProfile` to the calling context
+ * tree node of the top frame.
+ */
+class CallProfile {
+public:
+    /**
+     * @param symtab         symbols naming the functions (labels extend to the
+     *  next symbol), may be null
+     * @param control_state  source of trap notifications, may be null
+     */
+    CallProfile(const SymbolTable *symtab, const CSR::ControlState *control_state);
+
+    /**
+     * Account a single step of the core.
+     *
+     * @param program_misses  miss count of the program cache (it is compared
+     *  with the value of the previous step)
+     * @param data_misses     miss count of the data cache
+     */
+    void record_step(const CoreState &state, uint32_t program_misses, uint32_t data_misses);
+
+    /** Current depth of the shadow call stack. */
+    [[nodiscard]] size_t get_depth() const { return stack.size(); }
+
+    /** All call paths with nonzero inclusive costs, callers before callees. */
+    [[nodiscard]] std::vector<CallPath> get_paths() const;
+
+    /** Callgrind format with call edges and inclusive costs, for KCachegrind. */
+    void write_callgrind(QTextStream &out) const;
+    /** Folded call stacks of cycles, for flamegraph.pl. */
+    void write_folded(QTextStream &out) const;
+
+private:
+    /** Node of the calling context tree. */
+    struct Node {
+        /** Entry address of the function, start of its symbol when known. */
+        uint64_t function;
+        uint32_t parent;
+        bool trap;
+        uint64_t calls;
+        ProfileCounters self;
+        std::vector<uint32_t> children;
+    };
+    struct Frame {
+        uint32_t node;
+        /** Address the function should return to. */
+        uint64_t return_addr;
+        bool trap;
+    };
+
+    static constexpr uint32_t ROOT = 0;
+
+    [[nodiscard]] uint64_t function_of(uint64_t address) const;
+    [[nodiscard]] QString function_name(uint64_t function) const;
+    [[nodiscard]] std::vector<ProfileCounters> inclusive_costs() const;
+    ProfileCounters &current();
+    void push(uint64_t target, uint64_t return_addr, bool trap);
+    void pop_return(uint64_t target);
+    void pop_trap();
+    void follow_control_flow(const MemoryInterstage &mem_wb);
+
+    const SymbolAddressIndex symbols;
+    /** Sized symbols only, labels inside functions are not tail call targets. */
+    const SymbolAddressIndex functions;
+    const CSR::ControlState *const control_state;
+
+    std::vector<Node> nodes;
+    /** Base frame is pushed by the next retired instruction when the stack is empty. */
+    std::vector<Frame> stack;
+    uint64_t pending_cycles = 0;
+    uint64_t last_trap_count = 0;
+    uint32_t last_stall_count = 0;
+    uint32_t last_program_misses = 0;
+    uint32_t last_data_misses = 0;
+};
+
+} // namespace machine
+
+#endif // CALL_PROFILE_H
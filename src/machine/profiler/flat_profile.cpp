@@ -0,0 +1,193 @@
+#include "profiler/flat_profile.h"
+
+#include <algorithm>
+
+namespace machine {
+
+/** Regions grow by this many instructions. */
+static constexpr uint64_t REGION_GRANULE = 1024;
+static constexpr uint64_t REGION_GRANULE_BYTES = REGION_GRANULE * 4;
+/** Farther addresses start a new region (4 MiB of code). */
+static constexpr uint64_t REGION_MAX_SLOTS = 1 << 20;
+
+void ProfileCounters::add(const ProfileCounters &other) {
+    retired += other.retired;
+    cycles += other.cycles;
+    stalls += other.stalls;
+    program_misses += other.program_misses;
+    data_misses += other.data_misses;
+}
+
+bool ProfileCounters::empty() const {
+    return retired == 0 && cycles == 0 && stalls == 0 && program_misses == 0 && data_misses == 0;
+}
+
+void FlatProfile::record_step(
+    const CoreState &state,
+    uint32_t program_misses,
+    uint32_t data_misses) {
+    const MemoryInterstage &mem_wb = state.pipeline.memory.result;
+    pending_cycles++;
+    if (mem_wb.is_valid && mem_wb.excause == EXCAUSE_NONE) {
+        ProfileCounters &counters = at(mem_wb.inst_addr);
+        counters.retired++;
+        counters.cycles += pending_cycles;
+        pending_cycles = 0;
+    }
+    if (state.stall_count != last_stall_count) {
+        const DecodeInterstage &id_ex = state.pipeline.decode.result;
+        if (id_ex.is_valid) { at(id_ex.inst_addr).stalls += state.stall_count - last_stall_count; }
+        last_stall_count = state.stall_count;
+    }
+    if (program_misses != last_program_misses) {
+        const FetchInterstage &if_id = state.pipeline.fetch.result;
+        if (if_id.is_valid) {
+            at(if_id.inst_addr).program_misses += program_misses - last_program_misses;
+        }
+        last_program_misses = program_misses;
+    }
+    if (data_misses != last_data_misses) {
+        if (mem_wb.is_valid) { at(mem_wb.inst_addr).data_misses += data_misses - last_data_misses; }
+        last_data_misses = data_misses;
+    }
+}
+
+bool FlatProfile::overlaps(uint64_t start, uint64_t end, size_t except) const {
+    for (size_t i = 0; i < regions.size(); i++) {
+        const Region &region = regions[i];
+        if (i != except && region.base < end && start < region.base + region.instructions.size() * 4) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ProfileCounters &FlatProfile::at_slow(uint64_t pc) {
+    for (size_t i = 0; i < regions.size(); i++) {
+        const uint64_t index = (pc - regions[i].base) >> 2;
+        if (index < regions[i].instructions.size()) {
+            last_region = i;
+            return regions[i].instructions[index];
+        }
+    }
+
+    // Regions are aligned to the granule, so a new granule never overlaps them partially.
+    const uint64_t start = pc & ~(REGION_GRANULE_BYTES - 1);
+    const uint64_t end = start + REGION_GRANULE_BYTES;
+    for (size_t i = 0; i < regions.size(); i++) {
+        Region &region = regions[i];
+        const uint64_t region_end = region.base + region.instructions.size() * 4;
+        if (pc >= region_end && (end - region.base) / 4 <= REGION_MAX_SLOTS
+            && !overlaps(region_end, end, i)) {
+            region.instructions.resize((end - region.base) / 4);
+            last_region = i;
+            return region.instructions[(pc - region.base) >> 2];
+        }
+        if (pc < region.base && (region_end - start) / 4 <= REGION_MAX_SLOTS
+            && !overlaps(start, region.base, i)) {
+            region.instructions.insert(region.instructions.begin(), (region.base - start) / 4, {});
+            region.base = start;
+            last_region = i;
+            return region.instructions[(pc - start) >> 2];
+        }
+    }
+    regions.push_back({ start, std::vector<ProfileCounters>(REGION_GRANULE) });
+    last_region = regions.size() - 1;
+    return regions.back().instructions[(pc - start) >> 2];
+}
+
+const ProfileCounters *FlatProfile::find(Address pc) const {
+    for (const Region &region : regions) {
+        const uint64_t index = (pc.get_raw() - region.base) >> 2;
+        if (index < region.instructions.size()) { return &region.instructions[index]; }
+    }
+    return nullptr;
+}
+
+ProfileCounters FlatProfile::get_total() const {
+    ProfileCounters total;
+    for (const Region &region : regions) {
+        for (const ProfileCounters &counters : region.instructions) {
+            total.add(counters);
+        }
+    }
+    return total;
+}
+
+void FlatProfile::for_each(
+    const std::function<void(Address, const ProfileCounters &)> &visit) const {
+    std::vector<const Region *> sorted;
+    for (const Region &region : regions) {
+        sorted.push_back(&region);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const Region *a, const Region *b) {
+        return a->base < b->base;
+    });
+    for (const Region *region : sorted) {
+        for (size_t i = 0; i < region->instructions.size(); i++) {
+            const ProfileCounters &counters = region->instructions[i];
+            if (!counters.empty()) { visit(Address(region->base + i * 4), counters); }
+        }
+    }
+}
+
+std::vector<ProfileSymbol> FlatProfile::by_symbol(const SymbolTable *symtab) const {
+    const SymbolAddressIndex symbols(symtab, true);
+    std::vector<ProfileSymbol> result(symbols.size() + 1);
+    for (size_t i = 0; i < symbols.size(); i++) {
+        result[i].name = symbols.name(i);
+        result[i].start = symbols.start(i);
+    }
+    result.back().start = 0;
+    for_each([&](Address pc, const ProfileCounters &counters) {
+        const int index = symbols.find(pc.get_raw());
+        result[(index >= 0) ? index : symbols.size()].counters.add(counters);
+    });
+    result.erase(
+        std::remove_if(
+            result.begin(), result.end(),
+            [](const ProfileSymbol &symbol) { return symbol.counters.empty(); }),
+        result.end());
+    std::stable_sort(
+        result.begin(), result.end(), [](const ProfileSymbol &a, const ProfileSymbol &b) {
+            return a.counters.cycles > b.counters.cycles;
+        });
+    return result;
+}
+
+static QString function_name(const SymbolAddressIndex &symbols, int index) {
+    return (index >= 0) ? symbols.name(index) : QStringLiteral("[unknown]");
+}
+
+void FlatProfile::write_callgrind(QTextStream &out, const SymbolTable *symtab) const {
+    const SymbolAddressIndex symbols(symtab, true);
+    const ProfileCounters total = get_total();
+    out << "# callgrind format\n"
+        << "version: 1\n"
+        << "creator: qtrvsim\n"
+        << "positions: instr\n"
+        << "events: Ir Cycles Stalls I1mr D1mr\n"
+        << "summary: " << total.retired << " " << total.cycles << " " << total.stalls << " "
+        << total.program_misses << " " << total.data_misses << "\n\n";
+    int current = -2; // Differs from all symbol indexes including "unknown".
+    for_each([&](Address pc, const ProfileCounters &counters) {
+        const int index = symbols.find(pc.get_raw());
+        if (index != current) {
+            out << "fn=" << function_name(symbols, index) << "\n";
+            current = index;
+        }
+        out << "0x" << QString::number(pc.get_raw(), 16) << " " << counters.retired << " "
+            << counters.cycles << " " << counters.stalls << " " << counters.program_misses << " "
+            << counters.data_misses << "\n";
+    });
+}
+
+void FlatProfile::write_folded(QTextStream &out, const SymbolTable *symtab) const {
+    for (const ProfileSymbol &symbol : by_symbol(symtab)) {
+        if (symbol.counters.cycles == 0) { continue; }
+        out << (symbol.name.isEmpty() ? QStringLiteral("[unknown]") : symbol.name) << " "
+            << symbol.counters.cycles << "\n";
+    }
+}
+
+} // namespace machine
@@ -0,0 +1,107 @@
+#ifndef FLAT_PROFILE_H
+#define FLAT_PROFILE_H
+
+#include "core/core_state.h"
+#include "memory/address.h"
+#include "symboltable.h"
+
+#include <QString>
+#include <QTextStream>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace machine {
+
+/** Events attributed to a single instruction (or summed over a function). */
+struct ProfileCounters {
+    uint64_t retired = 0;
+    /** Cycles up to and including the retirement of the instruction. */
+    uint64_t cycles = 0;
+    /** Cycles the instruction was stalled in decode by the hazard unit. */
+    uint64_t stalls = 0;
+    uint64_t program_misses = 0;
+    uint64_t data_misses = 0;
+
+    void add(const ProfileCounters &other);
+    [[nodiscard]] bool empty() const;
+};
+
+struct ProfileSymbol {
+    /** Empty for addresses not covered by any symbol. */
+    QString name;
+    SymbolValue start = 0;
+    ProfileCounters counters;
+};
+
+/**
+ * Flat execution profile collected from the core state after each step.
+ *
+ * Each cycle is charged to the next instruction which retires (leaves the
+ * memory stage without exception), so pipeline bubbles after a mispredicted
+ * branch or an exception are paid by the instruction they delay. Stalls are
+ * charged to the instruction held in decode, cache misses to the instruction
+ * fetched (program cache) or in the memory stage (data cache) in the step.
+ *
+ * Counters are kept in flat arrays indexed by `(pc - base) / 4`. A new array
+ * (region) is started only when the program jumps too far from all known
+ * regions, so a typical program uses a single one.
+ */
+class FlatProfile {
+public:
+    /**
+     * Account a single step of the core.
+     *
+     * @param program_misses  miss count of the program cache (it is compared
+     *  with the value of the previous step)
+     * @param data_misses     miss count of the data cache
+     */
+    void record_step(const CoreState &state, uint32_t program_misses, uint32_t data_misses);
+
+    /** @return counters of the address or null when it was never recorded */
+    [[nodiscard]] const ProfileCounters *find(Address pc) const;
+    [[nodiscard]] ProfileCounters get_total() const;
+
+    /** Visit nonempty counters in increasing order of addresses. */
+    void for_each(const std::function<void(Address, const ProfileCounters &)> &visit) const;
+
+    /**
+     * Counters summed over symbols (labels extend to the next symbol), sorted
+     * by cycles from the most expensive.
+     */
+    [[nodiscard]] std::vector<ProfileSymbol> by_symbol(const SymbolTable *symtab) const;
+
+    /** Callgrind format with instruction positions, for KCachegrind. */
+    void write_callgrind(QTextStream &out, const SymbolTable *symtab) const;
+    /** Folded stacks of cycles (one frame per function), for flamegraph.pl. */
+    void write_folded(QTextStream &out, const SymbolTable *symtab) const;
+
+private:
+    struct Region {
+        uint64_t base;
+        std::vector<ProfileCounters> instructions;
+    };
+
+    ProfileCounters &at(Address pc) {
+        if (last_region < regions.size()) {
+            Region &region = regions[last_region];
+            // Addresses below the base wrap around to a large index.
+            const uint64_t index = (pc.get_raw() - region.base) >> 2;
+            if (index < region.instructions.size()) { return region.instructions[index]; }
+        }
+        return at_slow(pc.get_raw());
+    }
+    ProfileCounters &at_slow(uint64_t pc);
+    [[nodiscard]] bool overlaps(uint64_t start, uint64_t end, size_t except) const;
+
+    std::vector<Region> regions;
+    size_t last_region = 0;
+    uint64_t pending_cycles = 0;
+    uint32_t last_stall_count = 0;
+    uint32_t last_program_misses = 0;
+    uint32_t last_data_misses = 0;
+};
+
+} // namespace machine
+
+#endif // FLAT_PROFILE_H
@@ -0,0 +1,144 @@
+#include "profiler/miss_profile.h"
+
+#include <algorithm>
+
+namespace machine {
+
+void MissCounters::add(const MissCounters &other) {
+    accesses += other.accesses;
+    misses += other.misses;
+    compulsory += other.compulsory;
+    capacity += other.capacity;
+    conflict += other.conflict;
+}
+
+MissProfile::MissProfile(const SymbolTable *symtab, const CacheConfig &config)
+    : objects(symtab)
+    , block_bytes(std::max(1u, config.block_size()) * BLOCK_ITEM_SIZE)
+    , capacity(std::max(1u, config.set_count() * config.associativity()))
+    , object_counters(objects.size() + 1) {}
+
+void MissProfile::touch(uint64_t block) {
+    touched.insert(block);
+    auto iter = resident.find(block);
+    if (iter != resident.end()) {
+        lru.splice(lru.begin(), lru, iter->second);
+        return;
+    }
+    if (resident.size() >= capacity) {
+        // Reuse the node of the evicted block.
+        auto last = std::prev(lru.end());
+        resident.erase(*last);
+        *last = block;
+        lru.splice(lru.begin(), lru, last);
+    } else {
+        lru.push_front(block);
+    }
+    resident.emplace(block, lru.begin());
+}
+
+void MissProfile::apply_pending() {
+    if (!pending) { return; }
+    for (uint64_t block = pending_first; block <= pending_last; block++) {
+        touch(block);
+    }
+    pending = false;
+}
+
+void MissProfile::memory_access(
+    MemoryAccessKind kind,
+    Address address,
+    unsigned size,
+    Address inst_addr) {
+    if (kind == MemoryAccessKind::FETCH) { return; }
+    const uint64_t first = address.get_raw() / block_bytes;
+    const uint64_t last = (address.get_raw() + std::max(size, 1u) - 1) / block_bytes;
+    // Repeated access to the same blocks (e.g. load and store of AMO) cannot change the LRU
+    // order, so it is merged and the classification still sees the state before the first one.
+    if (!pending || first != pending_first || last != pending_last) {
+        apply_pending();
+        pending_first = first;
+        pending_last = last;
+        pending = true;
+    }
+
+    MissInstruction &instruction = instructions[inst_addr.get_raw()];
+    instruction.inst_addr = inst_addr;
+    instruction.load |= (kind == MemoryAccessKind::LOAD);
+    instruction.store |= (kind == MemoryAccessKind::STORE);
+    instruction.counters.accesses++;
+    last_instruction = &instruction;
+
+    const int object = objects.find(address.get_raw());
+    last_object = (object >= 0) ? object : objects.size();
+    object_counters[last_object].accesses++;
+}
+
+void MissProfile::cache_miss(Address address, AccessType access_type) {
+    (void)access_type;
+    // Misses before the first reported access are charged to the unknown object only.
+    MissCounters unattributed;
+    MissCounters &instruction
+        = (last_instruction != nullptr) ? last_instruction->counters : unattributed;
+    MissCounters &object = (last_instruction != nullptr) ? object_counters[last_object]
+                                                           : object_counters.back();
+
+    const uint64_t block = address.get_raw() / block_bytes;
+    const bool compulsory = touched.count(block) == 0;
+    const bool conflict = !compulsory && resident.count(block) != 0;
+    for (MissCounters *counters : { &instruction, &object }) {
+        counters->misses++;
+        if (compulsory) {
+            counters->compulsory++;
+        } else if (conflict) {
+            counters->conflict++;
+        } else {
+            counters->capacity++;
+        }
+    }
+}
+
+MissCounters MissProfile::get_total() const {
+    MissCounters total;
+    for (const MissCounters &counters : object_counters) {
+        total.add(counters);
+    }
+    return total;
+}
+
+std::vector<MissInstruction> MissProfile::by_instruction() const {
+    std::vector<MissInstruction> result;
+    result.reserve(instructions.size());
+    for (const auto &instruction : instructions) {
+        result.push_back(instruction.second);
+    }
+    std::sort(
+        result.begin(), result.end(), [](const MissInstruction &a, const MissInstruction &b) {
+            if (a.counters.misses != b.counters.misses) {
+                return a.counters.misses > b.counters.misses;
+            }
+            return a.inst_addr < b.inst_addr;
+        });
+    return result;
+}
+
+std::vector<MissObject> MissProfile::by_object() const {
+    std::vector<MissObject> result;
+    for (size_t i = 0; i < object_counters.size(); i++) {
+        if (object_counters[i].accesses == 0 && object_counters[i].misses == 0) { continue; }
+        MissObject object;
+        if (i < objects.size()) {
+            object.name = objects.name(i);
+            object.start = objects.start(i);
+            object.end = objects.end(i);
+        }
+        object.counters = object_counters[i];
+        result.push_back(object);
+    }
+    std::stable_sort(result.begin(), result.end(), [](const MissObject &a, const MissObject &b) {
+        return a.counters.misses > b.counters.misses;
+    });
+    return result;
+}
+
+} // namespace machine
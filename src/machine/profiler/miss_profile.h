@@ -0,0 +1,100 @@
+#ifndef MISS_PROFILE_H
+#define MISS_PROFILE_H
+
+#include "core/memory_access_observer.h"
+#include "machineconfig.h"
+#include "memory/cache/cache.h"
+#include "symboltable.h"
+
+#include <QString>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace machine {
+
+/** Accesses and misses of an instruction or a data object. */
+struct MissCounters {
+    uint64_t accesses = 0;
+    uint64_t misses = 0;
+    /** First access to the block. */
+    uint64_t compulsory = 0;
+    /** Miss also in a fully associative LRU cache of the same size. */
+    uint64_t capacity = 0;
+    /** Miss caused by the limited associativity only. */
+    uint64_t conflict = 0;
+
+    void add(const MissCounters &other);
+};
+
+struct MissInstruction {
+    Address inst_addr;
+    bool load = false;
+    bool store = false;
+    MissCounters counters;
+};
+
+struct MissObject {
+    /** Empty for addresses not covered by any sized symbol. */
+    QString name;
+    SymbolValue start = 0;
+    SymbolValue end = 0;
+    MissCounters counters;
+};
+
+/**
+ * Data-centric profile of data cache misses.
+ *
+ * Accesses are reported by the core (as `MemoryAccessObserver`), misses by
+ * the data cache (as `CacheMissObserver`). A miss belongs to the last access
+ * reported before it. Misses are attributed to the instruction and to the
+ * data object (sized symbol, e.g. global variable or array) containing the
+ * address and classified as compulsory, capacity or conflict by a fully
+ * associative LRU cache with the same number of blocks simulated alongside.
+ */
+class MissProfile final : public MemoryAccessObserver, public CacheMissObserver {
+public:
+    /**
+     * @param symtab  data objects, may be null
+     * @param config  configuration of the observed cache
+     */
+    MissProfile(const SymbolTable *symtab, const CacheConfig &config);
+
+    void memory_access(MemoryAccessKind kind, Address address, unsigned size, Address inst_addr)
+        override;
+    void cache_miss(Address address, AccessType access_type) override;
+
+    [[nodiscard]] MissCounters get_total() const;
+    /** Instructions accessing data, sorted by misses from the most missing. */
+    [[nodiscard]] std::vector<MissInstruction> by_instruction() const;
+    /** Data objects with some accesses, sorted by misses from the most missing. */
+    [[nodiscard]] std::vector<MissObject> by_object() const;
+
+private:
+    /** Update the fully associative model by the blocks of the previous access. */
+    void apply_pending();
+    void touch(uint64_t block);
+
+    const SymbolAddressIndex objects;
+    const uint64_t block_bytes;
+    const size_t capacity;
+
+    std::unordered_map<uint64_t, MissInstruction> instructions;
+    std::vector<MissCounters> object_counters; // last item for unknown object
+    MissInstruction *last_instruction = nullptr;
+    size_t last_object = 0;
+
+    /** Blocks of the last access, they are touched when the next access comes. */
+    uint64_t pending_first = 0, pending_last = 0;
+    bool pending = false;
+    /** Fully associative LRU cache, most recently used block first. */
+    std::list<uint64_t> lru;
+    std::unordered_map<uint64_t, std::list<uint64_t>::iterator> resident;
+    std::unordered_set<uint64_t> touched;
+};
+
+} // namespace machine
+
+#endif // MISS_PROFILE_H
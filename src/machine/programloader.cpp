@@ -121,30 +121,35 @@ ProgramLoader::~ProgramLoader() {
 }
 
 void ProgramLoader::to_memory(Memory *mem) {
-    // Load program to memory (just dump it byte by byte)
+    size_t file_size = 0;
+    const char *f = elf_rawfile(this->elf, &file_size);
+    // Each segment is copied by a single write, which allocates only the
+    // touched sections. Part of the segment not backed by the file (.bss) is
+    // left unallocated as unallocated memory reads as zeros.
+    auto load_segment = [&](uint64_t base_address, uint64_t offset, uint64_t size) {
+        if (offset > file_size || size > file_size - offset) {
+            throw SIMULATOR_EXCEPTION(
+                Input, "Elf program segment exceeds file size",
+                QString("Segment at 0x") + QString::number(base_address, 16));
+        }
+        if (size == 0) { return; }
+        mem->write(base_address, f + offset, size, { .type = ae::INTERNAL });
+    };
     if (architecture_type == ARCH32) {
         for (size_t phdrs_i : this->indexes_of_load_sections) {
-            uint32_t base_address = this->sections_headers.arch32[phdrs_i].p_vaddr;
-            char *f = elf_rawfile(this->elf, nullptr);
-            for (unsigned y = 0; y < this->sections_headers.arch32[phdrs_i].p_filesz; y++) {
-                const auto buffer = (uint8_t)f[this->sections_headers.arch32[phdrs_i].p_offset + y];
-                memory_write_u8(mem, base_address + y, buffer);
-            }
+            const Elf32_Phdr &phdr = this->sections_headers.arch32[phdrs_i];
+            load_segment(phdr.p_vaddr, phdr.p_offset, phdr.p_filesz);
         }
     } else if (architecture_type == ARCH64) {
         for (size_t phdrs_i : this->indexes_of_load_sections) {
-            uint32_t base_address = this->sections_headers.arch64[phdrs_i].p_vaddr;
-            char *f = elf_rawfile(this->elf, nullptr);
-            for (unsigned y = 0; y < this->sections_headers.arch64[phdrs_i].p_filesz; y++) {
-                const auto buffer = (uint8_t)f[this->sections_headers.arch64[phdrs_i].p_offset + y];
-                memory_write_u8(mem, base_address + y, buffer);
-            }
+            const Elf64_Phdr &phdr = this->sections_headers.arch64[phdrs_i];
+            load_segment(phdr.p_vaddr, phdr.p_offset, phdr.p_filesz);
         }
     }
 }
 
 Address ProgramLoader::end() {
-    uint32_t last = 0;
+    uint64_t last = 0;
     // Go trough all sections and found out last one
     if (architecture_type == ARCH32) {
         for (size_t i : this->indexes_of_load_sections) {
@@ -162,6 +167,26 @@ Address ProgramLoader::end() {
                                  // deeper
 }
 
+QVector<ProgramSegment> ProgramLoader::get_segments() const {
+    QVector<ProgramSegment> segments;
+    auto add_segment = [&](uint64_t address, uint64_t size, uint64_t flags) {
+        segments.append({ .address = address,
+                          .size = size,
+                          .writable = (flags & PF_W) != 0,
+                          .executable = (flags & PF_X) != 0 });
+    };
+    for (size_t i : this->indexes_of_load_sections) {
+        if (architecture_type == ARCH32) {
+            const Elf32_Phdr &phdr = this->sections_headers.arch32[i];
+            add_segment(phdr.p_vaddr, phdr.p_memsz, phdr.p_flags);
+        } else {
+            const Elf64_Phdr &phdr = this->sections_headers.arch64[i];
+            add_segment(phdr.p_vaddr, phdr.p_memsz, phdr.p_flags);
+        }
+    }
+    return segments;
+}
+
 Address ProgramLoader::get_executable_entry() const {
     return executable_entry;
 }
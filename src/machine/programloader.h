@@ -18,6 +18,14 @@ enum ArchitectureType {
     ARCH64,
 };
 
+/** Loadable segment of the executable. */
+struct ProgramSegment {
+    uint64_t address;
+    uint64_t size; //> Size in memory, including zero filled part
+    bool writable;
+    bool executable;
+};
+
 class ProgramLoader {
 public:
     explicit ProgramLoader(const char *file);
@@ -36,6 +44,8 @@ public:
     /** Tells whether the executable is 32bit or 64bit. */
     ArchitectureType get_architecture_type() const;
 
+    QVector<ProgramSegment> get_segments() const;
+
 private:
     QFile elf_file;
     Elf *elf;
@@ -3,8 +3,12 @@
 #include "machine/instruction.h"
 #include "machine/memory/memory_utils.h"
 #include "machine/programloader.h"
+#include "machine/simulator_exception.h"
 #include "memory/backend/memory.h"
 
+#include <QDir>
+#include <cstring>
+
 using namespace machine;
 
 // This is common program start (initial value of program counter)
@@ -31,4 +35,108 @@ void TestProgramLoader::program_loader() {
     // sections)
 }
 
+struct TestSegment {
+    uint32_t address;
+    QByteArray data;
+    uint32_t mem_size;
+};
+
+/** Builds a minimal 32bit little endian RISC-V executable with given load segments. */
+static QByteArray make_executable(const QVector<TestSegment> &segments) {
+    Elf32_Ehdr ehdr {};
+    memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+    ehdr.e_ident[EI_CLASS] = ELFCLASS32;
+    ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+    ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+    ehdr.e_type = ET_EXEC;
+    ehdr.e_machine = EM_RISCV;
+    ehdr.e_version = EV_CURRENT;
+    ehdr.e_entry = PC_INIT;
+    ehdr.e_phoff = sizeof(Elf32_Ehdr);
+    ehdr.e_ehsize = sizeof(Elf32_Ehdr);
+    ehdr.e_phentsize = sizeof(Elf32_Phdr);
+    ehdr.e_phnum = segments.size();
+
+    QByteArray headers((const char *)&ehdr, sizeof(ehdr));
+    QByteArray contents;
+    uint32_t offset = sizeof(Elf32_Ehdr) + segments.size() * sizeof(Elf32_Phdr);
+    for (const TestSegment &segment : segments) {
+        Elf32_Phdr phdr {};
+        phdr.p_type = PT_LOAD;
+        phdr.p_offset = offset;
+        phdr.p_vaddr = segment.address;
+        phdr.p_paddr = segment.address;
+        phdr.p_filesz = segment.data.size();
+        phdr.p_memsz = segment.mem_size;
+        phdr.p_flags = PF_R | PF_W;
+        headers.append((const char *)&phdr, sizeof(phdr));
+        contents.append(segment.data);
+        offset += segment.data.size();
+    }
+    return headers + contents;
+}
+
+static QString write_executable(const QByteArray &content) {
+    const QString path = QDir::temp().filePath("qtrvsim_program_loader_test.elf");
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) { return {}; }
+    file.write(content);
+    return path;
+}
+
+void TestProgramLoader::program_loader_segments() {
+    // Segment spans several memory sections and starts in the middle of one.
+    QByteArray data;
+    for (int i = 0; i < 3 * (int)MEMORY_SECTION_SIZE; i++) {
+        data.append((char)(i * 7 + 1));
+    }
+    const QByteArray code("\x13\x00\x00\x00", 4); // nop
+    const uint32_t data_address = 0x10000100;
+    const uint32_t bss_size = 2 * MEMORY_SECTION_SIZE;
+    const QString path = write_executable(make_executable({
+        { PC_INIT, code, (uint32_t)code.size() },
+        { data_address, data, (uint32_t)data.size() + bss_size },
+    }));
+    QVERIFY(!path.isEmpty());
+
+    ProgramLoader pl(path);
+    QCOMPARE(pl.get_executable_entry(), Address(PC_INIT));
+    const QVector<ProgramSegment> segments = pl.get_segments();
+    QCOMPARE(segments.size(), 2);
+    QCOMPARE(segments[1].address, (uint64_t)data_address);
+    QCOMPARE(segments[1].size, (uint64_t)data.size() + bss_size);
+    QCOMPARE(pl.end(), Address(data_address + data.size() + 0x10));
+
+    Memory m(LITTLE);
+    pl.to_memory(&m);
+    QCOMPARE(memory_read_u32(&m, PC_INIT), (uint32_t)0x00000013);
+    QCOMPARE(memory_read_u8(&m, data_address - 1), (uint8_t)0);
+    for (int i = 0; i < data.size(); i++) {
+        QCOMPARE(memory_read_u8(&m, data_address + i), (uint8_t)data[i]);
+    }
+    // Part of the segment not backed by the file reads as zeros.
+    for (uint32_t i = 0; i < bss_size; i += 4) {
+        QCOMPARE(memory_read_u32(&m, data_address + data.size() + i), (uint32_t)0);
+    }
+    QFile::remove(path);
+}
+
+void TestProgramLoader::program_loader_segment_exceeds_file() {
+    QByteArray content = make_executable({ { PC_INIT, QByteArray(16, '\x13'), 16 } });
+    // Cut off the end of the segment data.
+    content.chop(4);
+    const QString path = write_executable(content);
+    QVERIFY(!path.isEmpty());
+
+    ProgramLoader pl(path);
+    Memory m(LITTLE);
+    bool rejected = false;
+    try {
+        pl.to_memory(&m);
+    } catch (SimulatorExceptionInput &) { rejected = true; }
+    QVERIFY(rejected);
+    QCOMPARE(memory_read_u32(&m, PC_INIT), (uint32_t)0);
+    QFile::remove(path);
+}
+
 QTEST_APPLESS_MAIN(TestProgramLoader)
\ No newline at end of file
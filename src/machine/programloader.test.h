@@ -6,8 +6,10 @@
 class TestProgramLoader : public QObject {
     Q_OBJECT
 
-public slots:
+private slots:
     void program_loader();
+    void program_loader_segments();
+    void program_loader_segment_exceeds_file();
 };
 
 #endif // PROGRAMLOADER_TEST_H
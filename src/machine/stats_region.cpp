@@ -0,0 +1,50 @@
+#include "stats_region.h"
+
+namespace machine {
+
+CacheStats::CacheStats(const Cache &cache)
+    : hits(cache.get_hit_count())
+    , misses(cache.get_miss_count())
+    , memory_reads(cache.get_read_count())
+    , memory_writes(cache.get_write_count())
+    , stalled_cycles(cache.get_stall_count()) {}
+
+void CacheStats::add(const CacheStats &other) {
+    hits += other.hits;
+    misses += other.misses;
+    memory_reads += other.memory_reads;
+    memory_writes += other.memory_writes;
+    stalled_cycles += other.stalled_cycles;
+}
+
+void CacheStats::subtract(const CacheStats &other) {
+    hits -= other.hits;
+    misses -= other.misses;
+    memory_reads -= other.memory_reads;
+    memory_writes -= other.memory_writes;
+    stalled_cycles -= other.stalled_cycles;
+}
+
+void StatsSnapshot::add(const StatsSnapshot &other) {
+    cycles += other.cycles;
+    stalls += other.stalls;
+    for (size_t i = 0; i < CPI_COMPONENT_COUNT; i++) {
+        cpi_stack[i] += other.cpi_stack[i];
+    }
+    program_cache.add(other.program_cache);
+    data_cache.add(other.data_cache);
+    level2_cache.add(other.level2_cache);
+}
+
+void StatsSnapshot::subtract(const StatsSnapshot &other) {
+    cycles -= other.cycles;
+    stalls -= other.stalls;
+    for (size_t i = 0; i < CPI_COMPONENT_COUNT; i++) {
+        cpi_stack[i] -= other.cpi_stack[i];
+    }
+    program_cache.subtract(other.program_cache);
+    data_cache.subtract(other.data_cache);
+    level2_cache.subtract(other.level2_cache);
+}
+
+} // namespace machine
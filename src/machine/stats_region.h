@@ -0,0 +1,59 @@
+#ifndef STATS_REGION_H
+#define STATS_REGION_H
+
+#include "core/core_state.h"
+#include "memory/cache/cache.h"
+
+#include <cstdint>
+
+namespace machine {
+
+/** Statistics counters of a cache. */
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t memory_reads = 0;
+    uint64_t memory_writes = 0;
+    uint64_t stalled_cycles = 0;
+
+    CacheStats() = default;
+    explicit CacheStats(const Cache &cache);
+    void add(const CacheStats &other);
+    void subtract(const CacheStats &other);
+};
+
+/**
+ * Statistics of the machine at some moment or of a part of the execution
+ * (difference of two snapshots).
+ */
+struct StatsSnapshot {
+    uint64_t cycles = 0;
+    uint64_t stalls = 0;
+    CpiStack cpi_stack {};
+    CacheStats program_cache;
+    CacheStats data_cache;
+    CacheStats level2_cache;
+
+    [[nodiscard]] uint64_t retired() const {
+        return cpi_stack[static_cast<size_t>(CpiComponent::BASE)];
+    }
+    void add(const StatsSnapshot &other);
+    void subtract(const StatsSnapshot &other);
+};
+
+/** Statistics of guest marked part of the execution, see `RoiControl`. */
+struct StatsRegion {
+    enum Kind {
+        ROI,  //> All executions between begin and end of the region with the id
+        DUMP, //> From the last statistics reset to the dump with the id as tag
+    };
+    Kind kind;
+    uint32_t id;
+    /** Number of region executions accumulated in `stats`. */
+    uint64_t count;
+    StatsSnapshot stats;
+};
+
+} // namespace machine
+
+#endif // STATS_REGION_H
@@ -1,5 +1,7 @@
 #include "symboltable.h"
 
+#include <algorithm>
+#include <limits>
 #include <utility>
 
 using namespace machine;
@@ -86,3 +88,62 @@ bool SymbolTable::location_to_name(QString &name, SymbolValue value) const {
 QStringList SymbolTable::names() const {
     return map_name_to_symbol.keys();
 }
+
+QList<const SymbolTableEntry *> SymbolTable::entries() const {
+    QList<const SymbolTableEntry *> list;
+    for (auto iter = map_value_to_symbol.cbegin(); iter != map_value_to_symbol.cend(); ++iter) {
+        list.append(iter.value());
+    }
+    return list;
+}
+
+SymbolAddressIndex::SymbolAddressIndex(const SymbolTable *symtab, bool with_labels) {
+    if (symtab == nullptr) { return; }
+    const QList<const SymbolTableEntry *> entries = symtab->entries();
+    for (int i = 0; i < entries.size(); i++) {
+        const SymbolTableEntry *entry = entries[i];
+        SymbolValue end = entry->value + entry->size;
+        if (entry->size == 0) {
+            if (!with_labels) { continue; }
+            // Label at the same address as a known range is its alias.
+            if (!ranges.empty() && ranges.back().start == entry->value) { continue; }
+            end = std::numeric_limits<SymbolValue>::max();
+            for (int j = i + 1; j < entries.size(); j++) {
+                if (entries[j]->value > entry->value) {
+                    end = entries[j]->value;
+                    break;
+                }
+            }
+        }
+        // Aliases of already known range are skipped.
+        if (!ranges.empty() && ranges.back().start == entry->value && ranges.back().end == end) {
+            continue;
+        }
+        ranges.push_back({ entry->value, end, entry->name });
+    }
+}
+
+int SymbolAddressIndex::find(SymbolValue address) const {
+    auto iter = std::upper_bound(
+        ranges.begin(), ranges.end(), address,
+        [](SymbolValue value, const Range &range) { return value < range.start; });
+    if (iter == ranges.begin()) { return -1; }
+    --iter;
+    return (address < iter->end) ? (int)(iter - ranges.begin()) : -1;
+}
+
+size_t SymbolAddressIndex::size() const {
+    return ranges.size();
+}
+
+const QString &SymbolAddressIndex::name(size_t index) const {
+    return ranges.at(index).name;
+}
+
+SymbolValue SymbolAddressIndex::start(size_t index) const {
+    return ranges.at(index).start;
+}
+
+SymbolValue SymbolAddressIndex::end(size_t index) const {
+    return ranges.at(index).end;
+}
@@ -8,6 +8,7 @@
 #include <QObject>
 #include <QString>
 #include <QStringList>
+#include <vector>
 
 namespace machine {
 
@@ -61,6 +62,8 @@ public:
     void remove_symbol(const QString &name);
 
     QStringList names() const;
+    /** All symbols ordered by their value. */
+    QList<const SymbolTableEntry *> entries() const;
 public slots:
     bool name_to_value(SymbolValue &value, const QString &name) const;
     /**
@@ -75,6 +78,37 @@ private:
     QMultiMap<SymbolValue, SymbolTableEntry *> map_value_to_symbol;
 };
 
+/**
+ * Snapshot of sized symbols ordered by address, used to quickly attribute
+ * addresses to symbols (e.g. for statistics collected for each access).
+ *
+ * Symbols with zero size (labels) are omitted unless requested. When symbols
+ * overlap, only the one starting last before the address is considered.
+ */
+class SymbolAddressIndex {
+public:
+    /**
+     * @param with_labels  labels extend up to the next symbol (code of assembly
+     *  programs is usually covered only by labels)
+     */
+    explicit SymbolAddressIndex(const SymbolTable *symtab = nullptr, bool with_labels = false);
+
+    /** @return index of the symbol containing the address or -1 */
+    [[nodiscard]] int find(SymbolValue address) const;
+
+    [[nodiscard]] size_t size() const;
+    [[nodiscard]] const QString &name(size_t index) const;
+    [[nodiscard]] SymbolValue start(size_t index) const;
+    [[nodiscard]] SymbolValue end(size_t index) const;
+
+private:
+    struct Range {
+        SymbolValue start, end;
+        QString name;
+    };
+    std::vector<Range> ranges;
+};
+
 } // namespace machine
 
 #endif // SYMBOLTABLE_H